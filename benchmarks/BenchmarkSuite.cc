@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "BenchmarkSuite.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace gazebo_fmi
+{
+
+std::string escapeJSON(const std::string& string)
+{
+    std::string escaped;
+    for (const char c : string)
+    {
+        switch (c)
+        {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void writeJSONObject(std::ostream& stream, const BenchmarkParameters& object)
+{
+    stream << "{";
+    bool first = true;
+    for (const auto& entry : object)
+    {
+        stream << (first ? " " : ", ") << "\"" << escapeJSON(entry.first) << "\": \"" << escapeJSON(entry.second) << "\"";
+        first = false;
+    }
+    stream << (first ? "}" : " }");
+}
+
+BenchmarkParameters benchmarkContext(const BenchmarkParameters& properties)
+{
+    BenchmarkParameters context = properties;
+
+    char date[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    context["date"] = date;
+
+    char host[256] = {0};
+    if (gethostname(host, sizeof(host)-1) == 0)
+    {
+        context["host"] = host;
+    }
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos)
+        {
+            context["cpu_model"] = line.substr(line.find(':') + 2);
+            break;
+        }
+    }
+
+    context["num_cpus"] = std::to_string(std::thread::hardware_concurrency());
+    return context;
+}
+
+double BenchmarkResult::meanInNanoseconds() const
+{
+    if (samplesInNanoseconds.empty())
+    {
+        return 0.0;
+    }
+    return std::accumulate(samplesInNanoseconds.begin(), samplesInNanoseconds.end(), 0.0)/samplesInNanoseconds.size();
+}
+
+double BenchmarkResult::medianInNanoseconds() const
+{
+    if (samplesInNanoseconds.empty())
+    {
+        return 0.0;
+    }
+    std::vector<double> sorted = samplesInNanoseconds;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t middle = sorted.size()/2;
+    return (sorted.size() % 2 == 1) ? sorted[middle] : 0.5*(sorted[middle-1] + sorted[middle]);
+}
+
+double BenchmarkResult::minInNanoseconds() const
+{
+    return samplesInNanoseconds.empty() ? 0.0 : *std::min_element(samplesInNanoseconds.begin(), samplesInNanoseconds.end());
+}
+
+double BenchmarkResult::maxInNanoseconds() const
+{
+    return samplesInNanoseconds.empty() ? 0.0 : *std::max_element(samplesInNanoseconds.begin(), samplesInNanoseconds.end());
+}
+
+double BenchmarkResult::stddevInNanoseconds() const
+{
+    if (samplesInNanoseconds.size() < 2)
+    {
+        return 0.0;
+    }
+    const double mean = this->meanInNanoseconds();
+    double sumOfSquares = 0.0;
+    for (const double sample : samplesInNanoseconds)
+    {
+        sumOfSquares += (sample - mean)*(sample - mean);
+    }
+    return std::sqrt(sumOfSquares/(samplesInNanoseconds.size() - 1));
+}
+
+bool BenchmarkSuite::parseCommandLine(int argc, char** argv, BenchmarkSuiteOptions& options)
+{
+    for (int i=1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = (i+1 < argc);
+        if (argument == "--output" && hasValue)
+        {
+            options.outputPath = argv[++i];
+        }
+        else if (argument == "--filter" && hasValue)
+        {
+            options.filter = argv[++i];
+        }
+        else if (argument == "--repetitions" && hasValue)
+        {
+            const long repetitions = std::strtol(argv[++i], nullptr, 10);
+            if (repetitions <= 0)
+            {
+                std::cerr << argv[0] << ": the number of repetitions must be positive." << std::endl;
+                return false;
+            }
+            options.repetitions = static_cast<size_t>(repetitions);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--output <json file>] [--filter <string>] [--repetitions <n>]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+BenchmarkSuite::BenchmarkSuite(const BenchmarkSuiteOptions& options): m_options(options)
+{
+}
+
+bool BenchmarkSuite::isSelected(const std::string& name) const
+{
+    return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+}
+
+void BenchmarkSuite::runBatch(const std::string& name,
+                              const BenchmarkParameters& parameters,
+                              const size_t iterations,
+                              const std::function<void(size_t)>& body)
+{
+    if (!this->isSelected(name))
+    {
+        return;
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.parameters = parameters;
+    result.iterationsPerSample = iterations;
+
+    // Warm-up
+    body(1);
+
+    for (size_t repetition=0; repetition < m_options.repetitions; repetition++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        const auto end = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double, std::nano>(end - start).count();
+        result.samplesInNanoseconds.push_back(elapsed/iterations);
+    }
+
+    this->addResult(result);
+}
+
+void BenchmarkSuite::runIsolated(const std::string& name,
+                                 const BenchmarkParameters& parameters,
+                                 const size_t repetitions,
+                                 const std::function<void()>& setup,
+                                 const std::function<void()>& body,
+                                 const std::function<void()>& teardown)
+{
+    if (!this->isSelected(name))
+    {
+        return;
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.parameters = parameters;
+    result.iterationsPerSample = 1;
+
+    for (size_t repetition=0; repetition < repetitions; repetition++)
+    {
+        setup();
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const auto end = std::chrono::steady_clock::now();
+        teardown();
+        result.samplesInNanoseconds.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    this->addResult(result);
+}
+
+void BenchmarkSuite::addResult(const BenchmarkResult& result)
+{
+    std::cerr << result.name;
+    for (const auto& parameter : result.parameters)
+    {
+        std::cerr << " " << parameter.first << "=" << parameter.second;
+    }
+    std::cerr << ": median " << result.medianInNanoseconds() << " ns" << std::endl;
+
+    m_results.push_back(result);
+}
+
+size_t BenchmarkSuite::getRepetitions() const
+{
+    return m_options.repetitions;
+}
+
+const std::vector<BenchmarkResult>& BenchmarkSuite::getResults() const
+{
+    return m_results;
+}
+
+bool BenchmarkSuite::writeJSON() const
+{
+    const BenchmarkParameters context = benchmarkContext(m_options.context);
+
+    std::ostringstream json;
+    json.precision(std::numeric_limits<double>::max_digits10);
+    json << "{\n  \"context\": ";
+    writeJSONObject(json, context);
+    json << ",\n  \"benchmarks\": [";
+    for (size_t i=0; i < m_results.size(); i++)
+    {
+        const BenchmarkResult& result = m_results[i];
+        json << (i == 0 ? "\n" : ",\n");
+        json << "    { \"name\": \"" << escapeJSON(result.name) << "\", \"parameters\": ";
+        writeJSONObject(json, result.parameters);
+        json << ", \"repetitions\": " << result.samplesInNanoseconds.size()
+             << ", \"iterations\": " << result.iterationsPerSample
+             << ", \"unit\": \"ns\""
+             << ", \"mean\": " << result.meanInNanoseconds()
+             << ", \"median\": " << result.medianInNanoseconds()
+             << ", \"min\": " << result.minInNanoseconds()
+             << ", \"max\": " << result.maxInNanoseconds()
+             << ", \"stddev\": " << result.stddevInNanoseconds() << " }";
+    }
+    json << "\n  ]\n}\n";
+
+    if (m_options.outputPath.empty())
+    {
+        std::cout << json.str();
+        return true;
+    }
+
+    std::ofstream file(m_options.outputPath);
+    file << json.str();
+    file.close();
+    if (file.fail())
+    {
+        std::cerr << "gazebo_fmi: impossible to write the benchmark results to " << m_options.outputPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_BENCHMARK_SUITE_HH
+#define GAZEBO_FMI_BENCHMARK_SUITE_HH
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gazebo_fmi
+{
+    /// \brief Parameters of a benchmark (for example the FMU or the number of variables), written as strings in the JSON output
+    using BenchmarkParameters = std::map<std::string, std::string>;
+
+    /// \brief Result of a benchmark
+    struct BenchmarkResult
+    {
+        std::string name;
+        BenchmarkParameters parameters;
+
+        /// \brief Number of calls of the benchmarked operation in each sample
+        size_t iterationsPerSample{1};
+
+        /// \brief Time of a single call of the benchmarked operation, for each sample
+        std::vector<double> samplesInNanoseconds;
+
+        double meanInNanoseconds() const;
+        double medianInNanoseconds() const;
+        double minInNanoseconds() const;
+        double maxInNanoseconds() const;
+        double stddevInNanoseconds() const;
+    };
+
+    /// \brief Options of a BenchmarkSuite
+    struct BenchmarkSuiteOptions
+    {
+        /// \brief Path of the JSON file with the results, if empty the results are written on the standard output
+        std::string outputPath;
+
+        /// \brief Only the benchmarks whose name contains this string are run
+        std::string filter;
+
+        /// \brief Number of samples of each benchmark
+        size_t repetitions{10};
+
+        /// \brief Free-form properties of the run (for example the build type), added to the context of the JSON output
+        BenchmarkParameters context;
+    };
+
+    /// \brief Escape a string to be written in a JSON string literal
+    std::string escapeJSON(const std::string& string);
+
+    /// \brief Write a JSON object with string values
+    void writeJSONObject(std::ostream& stream, const BenchmarkParameters& object);
+
+    /// \brief Description of the machine and of the time of a benchmark run (date, host, cpu_model, num_cpus),
+    ///        merged with the additional properties
+    BenchmarkParameters benchmarkContext(const BenchmarkParameters& properties);
+
+    /// \brief Minimal benchmark runner, collecting the results of a set of benchmarks and writing them in JSON
+    ///
+    /// The JSON output has the form:
+    /// ~~~
+    /// {
+    ///   "context": { "date": "...", "host": "...", "cpu_model": "...", "num_cpus": "...", ... },
+    ///   "benchmarks": [
+    ///     { "name": "...", "parameters": { ... }, "repetitions": ..., "iterations": ..., "unit": "ns",
+    ///       "mean": ..., "median": ..., "min": ..., "max": ..., "stddev": ... },
+    ///     ...
+    ///   ]
+    /// }
+    /// ~~~
+    /// where the statistics are computed over the samples of the time of a single call of the benchmarked operation,
+    /// so the results of different releases can be compared benchmark by benchmark.
+    class BenchmarkSuite
+    {
+    private:
+        BenchmarkSuiteOptions m_options;
+        std::vector<BenchmarkResult> m_results;
+
+    public:
+        /// \brief Parse the command line options --output <file>, --filter <string> and --repetitions <n>
+        /// @return true if the options were parsed correctly, false otherwise
+        static bool parseCommandLine(int argc, char** argv, BenchmarkSuiteOptions& options);
+
+        explicit BenchmarkSuite(const BenchmarkSuiteOptions& options);
+
+        /// \brief return true if the benchmark is selected by the filter
+        bool isSelected(const std::string& name) const;
+
+        /// \brief Run a benchmark timing batches of calls
+        ///
+        /// For each repetition, body(iterations) is called once and timed, and it is expected to perform
+        /// the benchmarked operation iterations times, so that the overhead of the timer is amortized.
+        /// A first untimed call of body(1) is used as warm-up.
+        void runBatch(const std::string& name,
+                      const BenchmarkParameters& parameters,
+                      const size_t iterations,
+                      const std::function<void(size_t)>& body);
+
+        /// \brief Run a benchmark timing single calls, with an untimed setup and teardown around each call
+        ///
+        /// For each of the repetitions, setup(), body() and teardown() are called and only body() is timed.
+        /// No warm-up is performed, so that the first call can be measured by using a single repetition.
+        void runIsolated(const std::string& name,
+                         const BenchmarkParameters& parameters,
+                         const size_t repetitions,
+                         const std::function<void()>& setup,
+                         const std::function<void()>& body,
+                         const std::function<void()>& teardown);
+
+        /// \brief Add a result measured by the caller
+        void addResult(const BenchmarkResult& result);
+
+        /// \brief Number of repetitions of runBatch
+        size_t getRepetitions() const;
+
+        /// \brief Results collected so far
+        const std::vector<BenchmarkResult>& getResults() const;
+
+        /// \brief Write the results in JSON to the output file, or to the standard output
+        /// @return true if the results were written correctly, false otherwise
+        bool writeJSON() const;
+    };
+}
+
+#endif
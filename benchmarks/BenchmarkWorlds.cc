@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "BenchmarkWorlds.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace gazebo_fmi
+{
+
+// Distance between two pendulums of a model, and between the rows of pendulums
+static const double s_pendulumSpacing = 0.3;
+static const size_t s_pendulumsPerRow = 32;
+
+// Initial angle of the pendulums
+static const double s_initialAngle = 1.0;
+
+bool parseBenchmarkMode(const std::string& modeString, BenchmarkMode& mode)
+{
+    for (const BenchmarkMode candidate : {BenchmarkMode::serial, BenchmarkMode::threads, BenchmarkMode::scheduler})
+    {
+        if (modeString == benchmarkModeToString(candidate))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* benchmarkModeToString(const BenchmarkMode mode)
+{
+    switch (mode)
+    {
+        case BenchmarkMode::serial:
+            return "serial";
+        case BenchmarkMode::threads:
+            return "threads";
+        case BenchmarkMode::scheduler:
+            return "scheduler";
+    }
+    return "unknown";
+}
+
+static void pendulumSDF(std::ostringstream& sdf,
+                        const std::string& linkName,
+                        const std::string& jointName,
+                        const size_t index)
+{
+    const double x = s_pendulumSpacing*(index % s_pendulumsPerRow);
+    const double y = s_pendulumSpacing*(index / s_pendulumsPerRow);
+    sdf << "    <link name=\"" << linkName << "\">\n"
+        << "      <pose>" << x << " " << y << " 1.0 " << s_initialAngle << " 0 0</pose>\n"
+        << "      <inertial>\n"
+        << "        <pose>0 0 -0.5 0 0 0</pose>\n"
+        << "        <mass>1.0</mass>\n"
+        << "        <inertia><ixx>0.01</ixx><iyy>0.01</iyy><izz>0.01</izz><ixy>0</ixy><ixz>0</ixz><iyz>0</iyz></inertia>\n"
+        << "      </inertial>\n"
+        << "    </link>\n"
+        << "    <joint name=\"" << jointName << "\" type=\"revolute\">\n"
+        << "      <parent>base</parent>\n"
+        << "      <child>" << linkName << "</child>\n"
+        << "      <axis>\n"
+        << "        <xyz>1 0 0</xyz>\n"
+        << "        <dynamics><damping>0.1</damping></dynamics>\n"
+        << "      </axis>\n"
+        << "    </joint>\n";
+}
+
+std::string actuatedModelSDF(const ActuatedModelOptions& options)
+{
+    std::ostringstream sdf;
+    sdf << "  <model name=\"" << options.name << "\">\n"
+        << "    <pose>" << options.x << " " << options.y << " 0 0 0 0</pose>\n"
+        << "    <link name=\"base\">\n"
+        << "      <inertial><mass>100</mass></inertial>\n"
+        << "    </link>\n"
+        << "    <joint name=\"fixed_to_world\" type=\"fixed\">\n"
+        << "      <parent>world</parent>\n"
+        << "      <child>base</child>\n"
+        << "    </joint>\n";
+
+    for (size_t i=0; i < options.nrOfJoints; i++)
+    {
+        pendulumSDF(sdf, "link_" + std::to_string(i), "joint_" + std::to_string(i), i);
+    }
+
+    for (size_t i=0; i < options.nrOfFluidLinks; i++)
+    {
+        pendulumSDF(sdf, "fluid_link_" + std::to_string(i), "fluid_joint_" + std::to_string(i), options.nrOfJoints + i);
+    }
+
+    if (options.nrOfJoints > 0 && !options.actuatorFMUs.empty())
+    {
+        sdf << "    <plugin name=\"actuator_plugin\" filename=\"libFMIActuatorPlugin.so\">\n";
+        for (size_t i=0; i < options.nrOfJoints; i++)
+        {
+            sdf << "      <actuator>\n"
+                << "        <name>actuator_" << i << "</name>\n"
+                << "        <joint>joint_" << i << "</joint>\n"
+                << "        <fmu>" << options.actuatorFMUs[i % options.actuatorFMUs.size()] << "</fmu>\n"
+                << "        <disable_velocity_effort_limits>true</disable_velocity_effort_limits>\n"
+                << "      </actuator>\n";
+        }
+        sdf << "    </plugin>\n";
+    }
+
+    // A single fluid dynamics plugin simulates all the fluid links, so that its FMUs can be stepped by its threads
+    if (options.nrOfFluidLinks > 0 && !options.fluidFMUs.empty())
+    {
+        sdf << "    <plugin name=\"fluid_dynamics_plugin\" filename=\"libFMISingleBodyFluidDynamicsPlugin.so\">\n";
+        if (options.nrOfFluidThreads > 1)
+        {
+            sdf << "      <threads>" << options.nrOfFluidThreads << "</threads>\n";
+        }
+        for (size_t i=0; i < options.nrOfFluidLinks; i++)
+        {
+            sdf << "      <single_body_fluid_dynamics>\n"
+                << "        <name>fluid_dynamics_" << i << "</name>\n"
+                << "        <link>fluid_link_" << i << "</link>\n"
+                << "        <fmu>" << options.fluidFMUs[i % options.fluidFMUs.size()] << "</fmu>\n"
+                << "      </single_body_fluid_dynamics>\n";
+        }
+        sdf << "    </plugin>\n";
+    }
+
+    sdf << "  </model>\n";
+    return sdf.str();
+}
+
+std::string worldSDF(const BenchmarkWorldOptions& options, const std::vector<std::string>& modelsSDF)
+{
+    std::ostringstream sdf;
+    sdf << "<?xml version=\"1.0\" ?>\n"
+        << "<sdf version=\"1.5\">\n"
+        << "<world name=\"" << options.name << "\">\n"
+        << "  <physics name=\"benchmark_physics\" type=\"" << options.physicsEngine << "\" default=\"true\">\n"
+        << "    <max_step_size>" << options.stepSizeInSeconds << "</max_step_size>\n"
+        << "    <real_time_factor>1.0</real_time_factor>\n"
+        << "    <real_time_update_rate>" << options.realTimeUpdateRate << "</real_time_update_rate>\n"
+        << "  </physics>\n";
+
+    // The world plugins are loaded before the model plugins, so these register with the scheduler
+    if (options.mode == BenchmarkMode::scheduler)
+    {
+        sdf << "  <plugin name=\"fmi_scheduler_plugin\" filename=\"libFMISchedulerPlugin.so\">\n"
+            << "    <threads>" << options.nrOfThreads << "</threads>\n"
+            << "  </plugin>\n";
+    }
+
+    for (const std::string& modelSDF : modelsSDF)
+    {
+        sdf << modelSDF;
+    }
+
+    sdf << "</world>\n"
+        << "</sdf>\n";
+    return sdf.str();
+}
+
+std::string scalingWorldSDF(const BenchmarkWorldOptions& worldOptions,
+                            const size_t nrOfRobots,
+                            const ActuatedModelOptions& robotOptions)
+{
+    // Distance between the robots, larger than the footprint of a robot
+    const size_t nrOfPendulums = robotOptions.nrOfJoints + robotOptions.nrOfFluidLinks;
+    const double robotSpacing = s_pendulumSpacing*std::min(nrOfPendulums, s_pendulumsPerRow) + 2.0;
+    const size_t robotsPerRow = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(nrOfRobots))));
+    const double rowSpacing = s_pendulumSpacing*(nrOfPendulums/s_pendulumsPerRow + 1) + 2.0;
+
+    std::vector<std::string> modelsSDF;
+    for (size_t i=0; i < nrOfRobots; i++)
+    {
+        ActuatedModelOptions options = robotOptions;
+        options.name = robotOptions.name + "_" + std::to_string(i);
+        options.x = robotSpacing*(i % robotsPerRow);
+        options.y = rowSpacing*(i / robotsPerRow);
+        options.nrOfFluidThreads = worldOptions.mode == BenchmarkMode::threads ? worldOptions.nrOfThreads : 1;
+        modelsSDF.push_back(actuatedModelSDF(options));
+    }
+
+    return worldSDF(worldOptions, modelsSDF);
+}
+
+std::vector<std::string> splitCommaSeparatedList(const std::string& list)
+{
+    std::vector<std::string> elements;
+    std::istringstream stream(list);
+    std::string element;
+    while (std::getline(stream, element, ','))
+    {
+        if (!element.empty())
+        {
+            elements.push_back(element);
+        }
+    }
+    return elements;
+}
+
+bool parseCount(const std::string& value, size_t& count)
+{
+    char* end = nullptr;
+    const long parsed = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed < 0)
+    {
+        return false;
+    }
+    count = static_cast<size_t>(parsed);
+    return true;
+}
+
+bool parseCountList(const std::string& value, std::vector<size_t>& counts)
+{
+    counts.clear();
+    for (const std::string& element : splitCommaSeparatedList(value))
+    {
+        size_t count;
+        if (!parseCount(element, count))
+        {
+            return false;
+        }
+        counts.push_back(count);
+    }
+    return !counts.empty();
+}
+
+void printInvalidOptionValue(const char* programName, const std::string& option, const std::string& value)
+{
+    std::cerr << programName << ": invalid value " << value << " for option " << option << std::endl;
+}
+
+bool parseWorldGeneratorOption(const std::string& option,
+                               const std::string& value,
+                               BenchmarkWorldOptions& worldOptions,
+                               ActuatedModelOptions& robotOptions)
+{
+    char* end = nullptr;
+    if (option == "--actuator-fmus")
+    {
+        robotOptions.actuatorFMUs = splitCommaSeparatedList(value);
+        return true;
+    }
+    else if (option == "--fluid-fmus")
+    {
+        robotOptions.fluidFMUs = splitCommaSeparatedList(value);
+        return true;
+    }
+    else if (option == "--physics")
+    {
+        worldOptions.physicsEngine = value;
+        return true;
+    }
+    else if (option == "--step-size")
+    {
+        worldOptions.stepSizeInSeconds = std::strtod(value.c_str(), &end);
+        return *end == '\0' && worldOptions.stepSizeInSeconds > 0.0;
+    }
+    else if (option == "--real-time-update-rate")
+    {
+        worldOptions.realTimeUpdateRate = std::strtod(value.c_str(), &end);
+        return *end == '\0' && worldOptions.realTimeUpdateRate >= 0.0;
+    }
+    else if (option == "--mode")
+    {
+        return parseBenchmarkMode(value, worldOptions.mode);
+    }
+    else if (option == "--threads")
+    {
+        return parseCount(value, worldOptions.nrOfThreads) && worldOptions.nrOfThreads > 0;
+    }
+    return false;
+}
+
+bool writeStringToFile(const std::string& filePath, const std::string& content)
+{
+    std::ofstream file(filePath);
+    file << content;
+    file.close();
+    if (file.fail())
+    {
+        std::cerr << "gazebo_fmi: impossible to write " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_BENCHMARK_WORLDS_HH
+#define GAZEBO_FMI_BENCHMARK_WORLDS_HH
+
+#include <string>
+#include <vector>
+
+namespace gazebo_fmi
+{
+    /// \brief How the plugins of a generated world step their FMUs
+    enum class BenchmarkMode
+    {
+        /// \brief All the FMUs are stepped in the physics thread, one plugin after the other
+        serial,
+        /// \brief The FMUs of each fluid dynamics plugin are stepped in the threads of the plugin,
+        ///        the ones of the actuator plugins in the physics thread
+        threads,
+        /// \brief The FMUs of all the plugins are stepped in the threads of the FMIScheduler world plugin
+        scheduler
+    };
+
+    /// \brief Convert a string (serial, threads, scheduler) to a BenchmarkMode
+    /// @return true if the string is a valid mode, false otherwise
+    bool parseBenchmarkMode(const std::string& modeString, BenchmarkMode& mode);
+
+    /// \brief Convert a BenchmarkMode to a string
+    const char* benchmarkModeToString(const BenchmarkMode mode);
+
+    /// \brief Options of a model generated by actuatedModelSDF
+    struct ActuatedModelOptions
+    {
+        /// \brief Name of the model
+        std::string name{"actuated_model"};
+
+        /// \brief Number of revolute joints, all connecting a pendulum link to the base of the model
+        size_t nrOfJoints{1};
+
+        /// \brief FMUs of the actuators, used cyclically for the joints. If empty, the FMI actuator plugin is not added.
+        std::vector<std::string> actuatorFMUs;
+
+        /// \brief Number of additional pendulums, each with a FMI single body fluid dynamics plugin
+        size_t nrOfFluidLinks{0};
+
+        /// \brief FMUs of the fluid dynamics plugin, used cyclically for the fluid links
+        std::vector<std::string> fluidFMUs;
+
+        /// \brief Number of threads of the fluid dynamics plugin, the threads element is added only if larger than 1
+        size_t nrOfFluidThreads{1};
+
+        /// \brief Position of the base of the model in the world
+        double x{0.0};
+        double y{0.0};
+    };
+
+    /// \brief Options of a world generated by worldSDF
+    struct BenchmarkWorldOptions
+    {
+        std::string name{"default"};
+
+        /// \brief Physics engine type
+        std::string physicsEngine{"ode"};
+
+        /// \brief Physics step size
+        double stepSizeInSeconds{0.001};
+
+        /// \brief Real time update rate, 0 for running as fast as possible
+        double realTimeUpdateRate{0.0};
+
+        /// \brief How the plugins step their FMUs
+        BenchmarkMode mode{BenchmarkMode::serial};
+
+        /// \brief Number of threads of the fluid dynamics plugins (threads mode) or of the scheduler (scheduler mode)
+        size_t nrOfThreads{1};
+    };
+
+    /// \brief SDF of a model with a base fixed to the world and nrOfJoints pendulums attached to it
+    ///        by revolute joints, optionally actuated by a FMI actuator plugin, and nrOfFluidLinks
+    ///        pendulums subject to the forces computed by a FMI single body fluid dynamics plugin
+    ///
+    /// The links have no collisions, so that the cost of a step is dominated by the joints and the plugins.
+    /// The pendulums start tilted, so that they swing and the inputs of the FMUs are not constant.
+    std::string actuatedModelSDF(const ActuatedModelOptions& options);
+
+    /// \brief SDF of a world containing the specified models (as returned by actuatedModelSDF),
+    ///        and the FMIScheduler plugin in scheduler mode
+    std::string worldSDF(const BenchmarkWorldOptions& options, const std::vector<std::string>& modelsSDF);
+
+    /// \brief SDF of a world with nrOfRobots copies of the model described by robotOptions,
+    ///        named <robotOptions.name>_<index> and placed on a grid, whose plugins step their FMUs as specified
+    ///        by the mode of worldOptions
+    std::string scalingWorldSDF(const BenchmarkWorldOptions& worldOptions,
+                                const size_t nrOfRobots,
+                                const ActuatedModelOptions& robotOptions);
+
+    /// \brief Parse a command line option of the world generator, that is one of:
+    ///        --actuator-fmus <fmu,fmu,...>, --fluid-fmus <fmu,fmu,...>, --physics <engine>,
+    ///        --step-size <seconds>, --real-time-update-rate <Hz>, --mode <serial|threads|scheduler>
+    ///        and --threads <n>
+    /// @return true if the option is one of the above and its value is valid, false otherwise
+    bool parseWorldGeneratorOption(const std::string& option,
+                                   const std::string& value,
+                                   BenchmarkWorldOptions& worldOptions,
+                                   ActuatedModelOptions& robotOptions);
+
+    /// \brief Split a comma separated list
+    std::vector<std::string> splitCommaSeparatedList(const std::string& list);
+
+    /// \brief Parse a non-negative integer command line value
+    /// @return true if value is a non-negative integer, false otherwise (count is left unchanged)
+    bool parseCount(const std::string& value, size_t& count);
+
+    /// \brief Parse a comma separated list of non-negative integers
+    /// @return true if the list is not empty and all its elements are valid, false otherwise
+    bool parseCountList(const std::string& value, std::vector<size_t>& counts);
+
+    /// \brief Print on the standard error the message for an invalid value of a command line option
+    void printInvalidOptionValue(const char* programName, const std::string& option, const std::string& value);
+
+    /// \brief Write a string to file
+    /// @return true if the file was written correctly, false otherwise
+    bool writeStringToFile(const std::string& filePath, const std::string& content);
+}
+
+#endif
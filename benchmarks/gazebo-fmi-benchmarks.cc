@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/gazebo_config.h>
+#include <gazebo/common/SystemPaths.hh>
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+#include <gazebo_fmi/GazeboFMIUtils.hh>
+
+#include "BenchmarkSuite.hh"
+#include "BenchmarkWorlds.hh"
+
+/// Microbenchmarks of FMUCoSimulation and of the hot paths of the FMI actuator plugin,
+/// based on the reference FMUs. See the README for the description of the benchmarks and of the output.
+
+using namespace gazebo_fmi;
+
+static std::string referenceFMUPath(const std::string& fmuName)
+{
+    return std::string(GAZEBO_FMI_REFERENCE_FMUS_DIR) + "/" + fmuName + ".fmu";
+}
+
+static bool loadFMU(FMUCoSimulation& fmu, const std::string& fmuName)
+{
+    if (!fmu.load(referenceFMUPath(fmuName), fmuName + "_benchmark", 0.0))
+    {
+        std::cerr << "gazebo-fmi-benchmarks: impossible to load the reference FMU " << fmuName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool benchmarkLoad(BenchmarkSuite& suite)
+{
+    const std::string fmuName = "ReferenceIdentity";
+    FMUCoSimulation fmu;
+    bool ok = true;
+    auto load = [&]() { ok = loadFMU(fmu, fmuName) && ok; };
+    auto unload = [&]() { fmu.unload(); };
+    auto nothing = [](){};
+
+    // The first load in the process also includes the first read of the FMU and of its shared library from disk
+    suite.runIsolated("FMUCoSimulation/load/cold", {{"fmu", fmuName}}, 1, nothing, load, unload);
+    suite.runIsolated("FMUCoSimulation/load/warm", {{"fmu", fmuName}}, suite.getRepetitions(), nothing, load, unload);
+    return ok;
+}
+
+static bool benchmarkResetInstance(BenchmarkSuite& suite)
+{
+    if (!suite.isSelected("FMUCoSimulation/resetInstance"))
+    {
+        return true;
+    }
+
+    for (const std::string fmuName : {"ReferenceIdentity", "ReferenceBusyWorkHeavy"})
+    {
+        FMUCoSimulation fmu;
+        if (!loadFMU(fmu, fmuName))
+        {
+            return false;
+        }
+        suite.runBatch("FMUCoSimulation/resetInstance", {{"fmu", fmuName}}, 100, [&](size_t iterations)
+        {
+            for (size_t i=0; i < iterations; i++)
+            {
+                fmu.resetInstance(0.0);
+            }
+        });
+    }
+    return true;
+}
+
+static bool benchmarkSetGet(BenchmarkSuite& suite)
+{
+    if (!suite.isSelected("FMUCoSimulation/setInputVariables") && !suite.isSelected("FMUCoSimulation/getOutputVariables"))
+    {
+        return true;
+    }
+
+    FMUCoSimulation fmu;
+    std::vector<fmi2_value_reference_t> inputRef, outputRef;
+    if (!loadFMU(fmu, "ReferenceIdentity") ||
+        !fmu.getInputVariableRefs({"actuatorInput"}, inputRef) ||
+        !fmu.getOutputVariableRefs({"jointTorque"}, outputRef))
+    {
+        return false;
+    }
+
+    // The identity FMU has a single input and a single output, so the same value reference is repeated
+    // to measure the cost of set and get as a function of the number of variables
+    for (const size_t nrOfVariables : {1, 10, 100, 1000, 10000})
+    {
+        const std::vector<fmi2_value_reference_t> inputRefs(nrOfVariables, inputRef[0]);
+        const std::vector<fmi2_value_reference_t> outputRefs(nrOfVariables, outputRef[0]);
+        std::vector<double> buffer(nrOfVariables, 1.0);
+        const size_t iterations = std::max<size_t>(1, 100000/nrOfVariables);
+        const BenchmarkParameters parameters = {{"fmu", "ReferenceIdentity"}, {"variables", std::to_string(nrOfVariables)}};
+
+        suite.runBatch("FMUCoSimulation/setInputVariables", parameters, iterations, [&](size_t iterations)
+        {
+            for (size_t i=0; i < iterations; i++)
+            {
+                fmu.setInputVariables(inputRefs, buffer);
+            }
+        });
+        suite.runBatch("FMUCoSimulation/getOutputVariables", parameters, iterations, [&](size_t iterations)
+        {
+            for (size_t i=0; i < iterations; i++)
+            {
+                fmu.getOutputVariables(outputRefs, buffer);
+            }
+        });
+    }
+    return true;
+}
+
+static bool benchmarkDoStep(BenchmarkSuite& suite)
+{
+    if (!suite.isSelected("FMUCoSimulation/doStep"))
+    {
+        return true;
+    }
+
+    const double stepSizeInSeconds = 0.001;
+    for (const std::string fmuName : {"ReferenceIdentity", "ReferenceBusyWork", "ReferenceBusyWorkHeavy"})
+    {
+        FMUCoSimulation fmu;
+        if (!loadFMU(fmu, fmuName))
+        {
+            return false;
+        }
+        double time = 0.0;
+        const size_t iterations = (fmuName == "ReferenceBusyWorkHeavy") ? 100 : 10000;
+        suite.runBatch("FMUCoSimulation/doStep", {{"fmu", fmuName}, {"step_size", std::to_string(stepSizeInSeconds)}}, iterations,
+                       [&](size_t iterations)
+        {
+            for (size_t i=0; i < iterations; i++)
+            {
+                fmu.doStep(time, stepSizeInSeconds);
+                time += stepSizeInSeconds;
+            }
+        });
+    }
+    return true;
+}
+
+static gazebo::physics::WorldPtr loadBenchmarkWorld(const std::string& name, const ActuatedModelOptions& modelOptions)
+{
+    BenchmarkWorldOptions worldOptions;
+    worldOptions.name = name;
+    const std::string worldPath = std::string(CMAKE_CURRENT_BINARY_DIR) + "/" + name + ".world";
+    if (!writeStringToFile(worldPath, worldSDF(worldOptions, {actuatedModelSDF(modelOptions)})))
+    {
+        return nullptr;
+    }
+    return gazebo::loadWorld(worldPath);
+}
+
+static bool benchmarkComputeJointAcceleration(BenchmarkSuite& suite)
+{
+    if (!suite.isSelected("GazeboFMIUtils/ComputeJointAcceleration") && !suite.isSelected("GazeboFMIUtils/JointAccelerationCache"))
+    {
+        return true;
+    }
+
+    // All the joints connect a pendulum to the base, so the base is shared by all the joints
+    const size_t nrOfJoints = 10;
+    ActuatedModelOptions modelOptions;
+    modelOptions.name = "pendulum";
+    modelOptions.nrOfJoints = nrOfJoints;
+    gazebo::physics::WorldPtr world = loadBenchmarkWorld("benchmark_compute_joint_acceleration", modelOptions);
+    if (!world)
+    {
+        return false;
+    }
+
+    // Run a few steps, so that the accelerations are not trivially zero
+    gazebo::runWorld(world, 10);
+
+#if GAZEBO_MAJOR_VERSION >= 8
+    gazebo::physics::ModelPtr model = world->ModelByName(modelOptions.name);
+#else
+    gazebo::physics::ModelPtr model = world->GetModel(modelOptions.name);
+#endif
+    gazebo::physics::JointPtr joint = model ? model->GetJoint("joint_0") : nullptr;
+    if (!joint)
+    {
+        std::cerr << "gazebo-fmi-benchmarks: impossible to find the joint of the benchmark world." << std::endl;
+        return false;
+    }
+
+    volatile double acceleration = 0.0;
+    suite.runBatch("GazeboFMIUtils/ComputeJointAcceleration", {{"joint_type", "revolute"}}, 10000, [&](size_t iterations)
+    {
+        for (size_t i=0; i < iterations; i++)
+        {
+            acceleration = ComputeJointAcceleration(joint);
+        }
+    });
+
+    // Accelerations of all the joints, reading the kinematics of the shared base once
+    JointAccelerationCache cache;
+    cache.configure(model->GetJoints());
+    std::vector<double> accelerations(model->GetJoints().size());
+    suite.runBatch("GazeboFMIUtils/JointAccelerationCache", {{"joint_type", "revolute"}, {"joints", std::to_string(nrOfJoints)}}, 1000,
+                   [&](size_t iterations)
+    {
+        for (size_t i=0; i < iterations; i++)
+        {
+            cache.compute(accelerations.data());
+        }
+    });
+
+    gazebo::physics::remove_worlds();
+    return true;
+}
+
+static bool benchmarkActuatorPluginStep(BenchmarkSuite& suite)
+{
+    const size_t stepsPerSample = 100;
+    for (const size_t nrOfActuators : {1, 10, 100})
+    {
+        // The cost of the BeforePhysicsUpdateCallback of the plugin is the difference between the
+        // step of a world with the plugin and the step of the same world without the plugin
+        for (const bool withPlugin : {false, true})
+        {
+            const std::string name = withPlugin ? "FMIActuatorPlugin/worldStep" : "FMIActuatorPlugin/worldStepWithoutPlugin";
+            if (!suite.isSelected(name))
+            {
+                continue;
+            }
+
+            ActuatedModelOptions modelOptions;
+            modelOptions.name = "actuated_model";
+            modelOptions.nrOfJoints = nrOfActuators;
+            if (withPlugin)
+            {
+                modelOptions.actuatorFMUs = {"ReferenceIdentity.fmu"};
+            }
+
+            const std::string worldName = "benchmark_" + std::to_string(nrOfActuators) + (withPlugin ? "_actuators" : "_joints");
+            gazebo::physics::WorldPtr world = loadBenchmarkWorld(worldName, modelOptions);
+            if (!world)
+            {
+                return false;
+            }
+
+            suite.runBatch(name, {{"actuators", std::to_string(nrOfActuators)}, {"fmu", "ReferenceIdentity"}}, stepsPerSample,
+                           [&](size_t iterations)
+            {
+                gazebo::runWorld(world, iterations);
+            });
+
+            gazebo::physics::remove_worlds();
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkSuiteOptions options;
+    if (!BenchmarkSuite::parseCommandLine(argc, argv, options))
+    {
+        return EXIT_FAILURE;
+    }
+    options.context["gazebo_fmi_version"] = GAZEBO_FMI_VERSION;
+    options.context["gazebo_version"] = GAZEBO_VERSION_FULL;
+    options.context["build_type"] = GAZEBO_FMI_BUILD_TYPE;
+
+    BenchmarkSuite suite(options);
+
+    bool ok = benchmarkLoad(suite) &&
+              benchmarkResetInstance(suite) &&
+              benchmarkSetGet(suite) &&
+              benchmarkDoStep(suite);
+
+    // Benchmarks that need a headless Gazebo server
+    if (ok)
+    {
+        gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+        gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+        if (!gazebo::setupServer())
+        {
+            std::cerr << "gazebo-fmi-benchmarks: impossible to setup the Gazebo server." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        ok = benchmarkComputeJointAcceleration(suite) &&
+             benchmarkActuatorPluginStep(suite);
+
+        gazebo::shutdown();
+    }
+
+    if (!suite.writeJSON() || !ok)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
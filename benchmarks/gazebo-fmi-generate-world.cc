@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "BenchmarkWorlds.hh"
+
+/// Generate a SDF world with N robots, each with M joints actuated by the FMI actuator plugin
+/// and K links subject to the forces of the FMI single body fluid dynamics plugin.
+/// See the README for the description of the options.
+
+using namespace gazebo_fmi;
+
+static void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--robots <N>] [--actuators <M>] [--fluid-links <K>]\n"
+              << "         [--actuator-fmus <fmu,fmu,...>] [--fluid-fmus <fmu,fmu,...>]\n"
+              << "         [--physics <engine>] [--step-size <seconds>] [--real-time-update-rate <Hz>]\n"
+              << "         [--mode <serial|threads|scheduler>] [--threads <n>]\n"
+              << "         [--output <world file>]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkWorldOptions worldOptions;
+    ActuatedModelOptions robotOptions;
+    robotOptions.name = "robot";
+    robotOptions.actuatorFMUs = {"ReferenceIdentity.fmu"};
+    robotOptions.fluidFMUs = {"ReferenceQuadraticDrag.fmu"};
+    size_t nrOfRobots = 1;
+    std::string outputPath;
+
+    for (int i=1; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (i+1 >= argc)
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+
+        bool ok = true;
+        if (option == "--robots")
+        {
+            ok = parseCount(value, nrOfRobots);
+        }
+        else if (option == "--actuators")
+        {
+            ok = parseCount(value, robotOptions.nrOfJoints);
+        }
+        else if (option == "--fluid-links")
+        {
+            ok = parseCount(value, robotOptions.nrOfFluidLinks);
+        }
+        else if (option == "--output")
+        {
+            outputPath = value;
+        }
+        else
+        {
+            ok = parseWorldGeneratorOption(option, value, worldOptions, robotOptions);
+        }
+
+        if (!ok)
+        {
+            printInvalidOptionValue(argv[0], option, value);
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::string world = scalingWorldSDF(worldOptions, nrOfRobots, robotOptions);
+    if (outputPath.empty())
+    {
+        std::cout << world;
+        return EXIT_SUCCESS;
+    }
+
+    return writeStringToFile(outputPath, world) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,660 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/gazebo_config.h>
+#include <gazebo/common/Events.hh>
+#include <gazebo/common/SystemPaths.hh>
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo_fmi/FMUCallObserver.hh>
+
+#include "BenchmarkSuite.hh"
+#include "BenchmarkWorlds.hh"
+
+/// Measure the distribution of the latency of the FMI plugin callbacks at each physics step (tick),
+/// under a fixed physics step and optionally with CPU isolation and background load, and attribute
+/// the outliers to the FMU calls, to page faults or to allocations.
+///
+/// The latency of a tick is the wall-clock time between the beginning of the worldUpdateBegin event and the end
+/// of the beforePhysicsUpdate event, that is the time in which the callbacks of the FMI plugins are executed.
+/// It is measured by connecting a callback to worldUpdateBegin before the world is loaded (so that it is called
+/// before the callbacks of the plugins) and a callback to beforePhysicsUpdate after the world is loaded (so that
+/// it is called after them). The FMUs can be stepped in the physics thread or, with the threads of the fluid dynamics
+/// plugin or with the FMIScheduler plugin, in worker threads, so the FMU calls, the allocations and the page faults are
+/// accounted for all the threads of the process. See the README for the description of the options and of the output.
+
+using namespace gazebo_fmi;
+
+// Allocations performed with operator new by all the threads, counted by the replacements of operator new below,
+// so that the allocations of the worker threads that step the FMUs are counted as well
+static std::atomic<uint64_t> s_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+struct JitterOptions
+{
+    std::string worldPath;
+    size_t nrOfRobots{1};
+    BenchmarkWorldOptions worldOptions;
+    ActuatedModelOptions robotOptions;
+    std::string workDirectory{"."};
+
+    size_t warmupSteps{1000};
+    size_t steps{10000};
+
+    int cpu{-1};
+    int fifoPriority{0};
+    size_t backgroundLoadThreads{0};
+
+    size_t nrOfOutliers{20};
+    double outlierThresholdInMicroseconds{-1.0};
+
+    std::string samplesPath;
+    std::string outputPath;
+};
+
+/// \brief Measurements of a single tick
+struct TickSample
+{
+    double wallTimeInSeconds{0.0};
+    double simulatedTimeInSeconds{0.0};
+    int64_t latencyInNanoseconds{0};
+    int64_t fmuTimeInNanoseconds{0};
+    uint32_t fmuCalls{0};
+    int64_t slowestFMUCallInNanoseconds{0};
+    const std::string* slowestFMU{nullptr};
+    long minorPageFaults{0};
+    long majorPageFaults{0};
+    uint64_t allocations{0};
+};
+
+/// \brief Callbacks measuring each tick.
+///
+/// The tick callbacks are called in the physics thread, while onFMUCall is called in the thread that performed
+/// the call, that is a worker thread if the FMUs are stepped in parallel: the FMU calls of the tick are then
+/// accumulated in atomic variables, that are read at the end of the tick, after all the FMUs have been stepped.
+class JitterProbe : public FMUCallObserver
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<TickSample> m_samples;
+    bool m_recording{false};
+    Clock::time_point m_recordingStart;
+
+    TickSample m_current;
+    Clock::time_point m_tickStart;
+    struct rusage m_usageAtTickStart;
+    uint64_t m_allocationsAtTickStart{0};
+
+    // FMU calls of the current tick, updated concurrently by the threads stepping the FMUs
+    std::atomic<int64_t> m_fmuTimeInNanoseconds{0};
+    std::atomic<uint32_t> m_fmuCalls{0};
+    std::atomic<int64_t> m_slowestFMUCallInNanoseconds{0};
+    std::atomic_flag m_slowestFMULock = ATOMIC_FLAG_INIT;
+    const std::string* m_slowestFMU{nullptr};
+
+public:
+    std::vector<gazebo::event::ConnectionPtr> connections;
+
+    explicit JitterProbe(const size_t capacity)
+    {
+        m_samples.reserve(capacity);
+    }
+
+    void startRecording()
+    {
+        m_recording = true;
+        m_recordingStart = Clock::now();
+    }
+
+    void stopRecording()
+    {
+        m_recording = false;
+    }
+
+    const std::vector<TickSample>& getSamples() const
+    {
+        return m_samples;
+    }
+
+    void onTickBegin(const gazebo::common::UpdateInfo& info)
+    {
+        m_current = TickSample();
+        m_current.simulatedTimeInSeconds = info.simTime.Double();
+        m_fmuTimeInNanoseconds.store(0, std::memory_order_relaxed);
+        m_fmuCalls.store(0, std::memory_order_relaxed);
+        m_slowestFMUCallInNanoseconds.store(0, std::memory_order_relaxed);
+        m_slowestFMU = nullptr;
+        getrusage(RUSAGE_SELF, &m_usageAtTickStart);
+        m_allocationsAtTickStart = s_allocations.load(std::memory_order_relaxed);
+        m_tickStart = Clock::now();
+    }
+
+    void onFMUCall(const FMUCall /*call*/,
+                   const std::string& instanceName,
+                   const std::chrono::steady_clock::duration duration) override
+    {
+        const int64_t durationInNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        m_fmuTimeInNanoseconds.fetch_add(durationInNanoseconds, std::memory_order_relaxed);
+        m_fmuCalls.fetch_add(1, std::memory_order_relaxed);
+
+        // The lock is taken only by the calls slower than the slowest one so far, so the duration and the name stay consistent
+        if (durationInNanoseconds > m_slowestFMUCallInNanoseconds.load(std::memory_order_relaxed))
+        {
+            while (m_slowestFMULock.test_and_set(std::memory_order_acquire))
+            {
+            }
+            if (durationInNanoseconds > m_slowestFMUCallInNanoseconds.load(std::memory_order_relaxed))
+            {
+                m_slowestFMUCallInNanoseconds.store(durationInNanoseconds, std::memory_order_relaxed);
+                m_slowestFMU = &instanceName;
+            }
+            m_slowestFMULock.clear(std::memory_order_release);
+        }
+    }
+
+    void onTickEnd(const gazebo::common::UpdateInfo& /*info*/)
+    {
+        const Clock::time_point tickEnd = Clock::now();
+        const uint64_t allocations = s_allocations.load(std::memory_order_relaxed);
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        if (!m_recording || m_samples.size() == m_samples.capacity())
+        {
+            return;
+        }
+
+        // The worker threads have completed the steps of this tick before the plugins returned from their callbacks
+        while (m_slowestFMULock.test_and_set(std::memory_order_acquire))
+        {
+        }
+        m_current.fmuTimeInNanoseconds = m_fmuTimeInNanoseconds.load(std::memory_order_relaxed);
+        m_current.fmuCalls = m_fmuCalls.load(std::memory_order_relaxed);
+        m_current.slowestFMUCallInNanoseconds = m_slowestFMUCallInNanoseconds.load(std::memory_order_relaxed);
+        m_current.slowestFMU = m_slowestFMU;
+        m_slowestFMULock.clear(std::memory_order_release);
+
+        m_current.wallTimeInSeconds = std::chrono::duration<double>(m_tickStart - m_recordingStart).count();
+        m_current.latencyInNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(tickEnd - m_tickStart).count();
+        m_current.minorPageFaults = usage.ru_minflt - m_usageAtTickStart.ru_minflt;
+        m_current.majorPageFaults = usage.ru_majflt - m_usageAtTickStart.ru_majflt;
+        m_current.allocations = allocations - m_allocationsAtTickStart;
+        m_samples.push_back(m_current);
+    }
+};
+
+static void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--world <world file> | [--robots <N>] [--actuators <M>] [--fluid-links <K>]\n"
+              << "         [--actuator-fmus <fmu,fmu,...>] [--fluid-fmus <fmu,fmu,...>] [--physics <engine>] [--work-dir <directory>]]\n"
+              << "         [--mode <serial|threads|scheduler>] [--threads <n>]\n"
+              << "         [--step-size <seconds>] [--real-time-update-rate <Hz>] [--steps <n>] [--warmup-steps <n>]\n"
+              << "         [--cpu <index>] [--fifo-priority <priority>] [--background-load <threads>]\n"
+              << "         [--outliers <n>] [--outlier-threshold-us <microseconds>]\n"
+              << "         [--samples <csv file>] [--output <json file>]" << std::endl;
+}
+
+static bool parseCommandLine(int argc, char** argv, JitterOptions& options)
+{
+    options.robotOptions.name = "robot";
+    options.robotOptions.nrOfJoints = 10;
+    options.robotOptions.nrOfFluidLinks = 1;
+    options.robotOptions.actuatorFMUs = {"ReferenceIdentity.fmu"};
+    options.robotOptions.fluidFMUs = {"ReferenceQuadraticDrag.fmu"};
+    bool realTimeUpdateRateSpecified = false;
+
+    for (int i=1; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (i+1 >= argc)
+        {
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        bool ok = true;
+        size_t count = 0;
+        if (option == "--world")
+        {
+            options.worldPath = value;
+        }
+        else if (option == "--robots")
+        {
+            ok = parseCount(value, options.nrOfRobots);
+        }
+        else if (option == "--actuators")
+        {
+            ok = parseCount(value, options.robotOptions.nrOfJoints);
+        }
+        else if (option == "--fluid-links")
+        {
+            ok = parseCount(value, options.robotOptions.nrOfFluidLinks);
+        }
+        else if (option == "--work-dir")
+        {
+            options.workDirectory = value;
+        }
+        else if (option == "--steps")
+        {
+            ok = parseCount(value, options.steps) && options.steps > 0;
+        }
+        else if (option == "--warmup-steps")
+        {
+            ok = parseCount(value, options.warmupSteps);
+        }
+        else if (option == "--cpu")
+        {
+            ok = parseCount(value, count);
+            options.cpu = static_cast<int>(count);
+        }
+        else if (option == "--fifo-priority")
+        {
+            ok = parseCount(value, count) && count > 0;
+            options.fifoPriority = static_cast<int>(count);
+        }
+        else if (option == "--background-load")
+        {
+            ok = parseCount(value, options.backgroundLoadThreads);
+        }
+        else if (option == "--outliers")
+        {
+            ok = parseCount(value, options.nrOfOutliers);
+        }
+        else if (option == "--outlier-threshold-us")
+        {
+            char* end = nullptr;
+            options.outlierThresholdInMicroseconds = std::strtod(value.c_str(), &end);
+            ok = *end == '\0' && options.outlierThresholdInMicroseconds > 0.0;
+        }
+        else if (option == "--samples")
+        {
+            options.samplesPath = value;
+        }
+        else if (option == "--output")
+        {
+            options.outputPath = value;
+        }
+        else
+        {
+            ok = parseWorldGeneratorOption(option, value, options.worldOptions, options.robotOptions);
+            realTimeUpdateRateSpecified = realTimeUpdateRateSpecified || (option == "--real-time-update-rate");
+        }
+
+        if (!ok)
+        {
+            printInvalidOptionValue(argv[0], option, value);
+            return false;
+        }
+    }
+
+    // Run in real time by default, as in a hardware-in-the-loop setup
+    if (!realTimeUpdateRateSpecified)
+    {
+        options.worldOptions.realTimeUpdateRate = 1.0/options.worldOptions.stepSizeInSeconds;
+    }
+    return true;
+}
+
+static void busyLoop(const std::atomic<bool>* stop)
+{
+    volatile double accumulator = 0.0;
+    while (!stop->load(std::memory_order_relaxed))
+    {
+        for (int i=0; i < 10000; i++)
+        {
+            accumulator = accumulator + std::sqrt(static_cast<double>(i));
+        }
+    }
+}
+
+/// \brief Pin the calling thread (and the threads it creates afterwards) and set its scheduling policy
+static void isolateCurrentThread(const JitterOptions& options)
+{
+    if (options.cpu >= 0)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(options.cpu, &cpuSet);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+        {
+            std::cerr << "gazebo-fmi-jitter-harness: warning: impossible to pin the physics thread to CPU " << options.cpu << std::endl;
+        }
+    }
+
+    if (options.fifoPriority > 0)
+    {
+        struct sched_param parameters;
+        parameters.sched_priority = options.fifoPriority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters) != 0)
+        {
+            std::cerr << "gazebo-fmi-jitter-harness: warning: impossible to set the SCHED_FIFO policy with priority "
+                      << options.fifoPriority << " (this usually requires CAP_SYS_NICE)" << std::endl;
+        }
+    }
+}
+
+static double percentile(const std::vector<int64_t>& sorted, const double fraction)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(std::ceil(fraction*sorted.size())) - (fraction > 0.0 ? 1 : 0));
+    return static_cast<double>(sorted[index]);
+}
+
+static std::string outlierCause(const TickSample& sample, const double medianLatency, const double medianFMUTime)
+{
+    const double excess = sample.latencyInNanoseconds - medianLatency;
+    const double fmuExcess = sample.fmuTimeInNanoseconds - medianFMUTime;
+    if (excess > 0.0 && fmuExcess >= 0.5*excess)
+    {
+        return "fmu";
+    }
+    if (sample.majorPageFaults > 0 || sample.minorPageFaults > 0)
+    {
+        return "page_faults";
+    }
+    if (sample.allocations > 0)
+    {
+        return "allocations";
+    }
+    return "unattributed";
+}
+
+static bool writeSamples(const std::string& filePath, const std::vector<TickSample>& samples)
+{
+    std::ostringstream csv;
+    csv.precision(std::numeric_limits<double>::max_digits10);
+    csv << "wall_time,simulated_time,latency_ns,fmu_time_ns,fmu_calls,slowest_fmu,slowest_fmu_call_ns,minor_page_faults,major_page_faults,allocations\n";
+    for (const TickSample& sample : samples)
+    {
+        csv << sample.wallTimeInSeconds << "," << sample.simulatedTimeInSeconds << ","
+            << sample.latencyInNanoseconds << "," << sample.fmuTimeInNanoseconds << "," << sample.fmuCalls << ","
+            << (sample.slowestFMU ? *sample.slowestFMU : "") << "," << sample.slowestFMUCallInNanoseconds << ","
+            << sample.minorPageFaults << "," << sample.majorPageFaults << "," << sample.allocations << "\n";
+    }
+    return writeStringToFile(filePath, csv.str());
+}
+
+static std::string resultsJSON(const JitterOptions& options, const std::vector<TickSample>& samples)
+{
+    std::vector<int64_t> latencies, fmuTimes;
+    for (const TickSample& sample : samples)
+    {
+        latencies.push_back(sample.latencyInNanoseconds);
+        fmuTimes.push_back(sample.fmuTimeInNanoseconds);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(fmuTimes.begin(), fmuTimes.end());
+
+    double mean = 0.0;
+    for (const int64_t latency : latencies)
+    {
+        mean += static_cast<double>(latency)/latencies.size();
+    }
+
+    const double medianLatency = percentile(latencies, 0.5);
+    const double medianFMUTime = percentile(fmuTimes, 0.5);
+    const double threshold = options.outlierThresholdInMicroseconds > 0.0 ?
+                             1000.0*options.outlierThresholdInMicroseconds : percentile(latencies, 0.999);
+
+    // Outliers, sorted by decreasing latency
+    std::vector<const TickSample*> outliers;
+    for (const TickSample& sample : samples)
+    {
+        if (sample.latencyInNanoseconds >= threshold)
+        {
+            outliers.push_back(&sample);
+        }
+    }
+    std::sort(outliers.begin(), outliers.end(), [](const TickSample* a, const TickSample* b)
+    {
+        return a->latencyInNanoseconds > b->latencyInNanoseconds;
+    });
+
+    BenchmarkParameters attribution = {{"fmu", "0"}, {"page_faults", "0"}, {"allocations", "0"}, {"unattributed", "0"}};
+    for (const TickSample* outlier : outliers)
+    {
+        std::string& count = attribution[outlierCause(*outlier, medianLatency, medianFMUTime)];
+        count = std::to_string(std::stoul(count) + 1);
+    }
+
+    BenchmarkParameters configuration = {
+        {"gazebo_fmi_version", GAZEBO_FMI_VERSION},
+        {"gazebo_version", GAZEBO_VERSION_FULL},
+        {"build_type", GAZEBO_FMI_BUILD_TYPE},
+        {"step_size", std::to_string(options.worldOptions.stepSizeInSeconds)},
+        {"real_time_update_rate", std::to_string(options.worldOptions.realTimeUpdateRate)},
+        {"cpu", options.cpu >= 0 ? std::to_string(options.cpu) : "none"},
+        {"fifo_priority", options.fifoPriority > 0 ? std::to_string(options.fifoPriority) : "none"},
+        {"background_load_threads", std::to_string(options.backgroundLoadThreads)}};
+    if (options.worldPath.empty())
+    {
+        configuration["robots"] = std::to_string(options.nrOfRobots);
+        configuration["actuators"] = std::to_string(options.robotOptions.nrOfJoints);
+        configuration["fluid_links"] = std::to_string(options.robotOptions.nrOfFluidLinks);
+        configuration["physics"] = options.worldOptions.physicsEngine;
+        configuration["mode"] = benchmarkModeToString(options.worldOptions.mode);
+        configuration["threads"] = std::to_string(options.worldOptions.nrOfThreads);
+    }
+    else
+    {
+        configuration["world"] = options.worldPath;
+    }
+
+    std::ostringstream json;
+    json.precision(std::numeric_limits<double>::max_digits10);
+    json << "{\n  \"context\": ";
+    writeJSONObject(json, benchmarkContext(configuration));
+    json << ",\n  \"latency_us\": { \"ticks\": " << latencies.size()
+         << ", \"mean\": " << mean/1000.0
+         << ", \"p50\": " << percentile(latencies, 0.5)/1000.0
+         << ", \"p90\": " << percentile(latencies, 0.9)/1000.0
+         << ", \"p99\": " << percentile(latencies, 0.99)/1000.0
+         << ", \"p99.9\": " << percentile(latencies, 0.999)/1000.0
+         << ", \"p99.99\": " << percentile(latencies, 0.9999)/1000.0
+         << ", \"max\": " << (latencies.empty() ? 0.0 : latencies.back()/1000.0) << " },\n";
+
+    json << "  \"fmu_time_us\": { \"p50\": " << medianFMUTime/1000.0
+         << ", \"p99.9\": " << percentile(fmuTimes, 0.999)/1000.0
+         << ", \"max\": " << (fmuTimes.empty() ? 0.0 : fmuTimes.back()/1000.0) << " },\n";
+
+    // Histogram with logarithmic bins, the upper bound of each bin is in microseconds
+    const double binUpperBounds[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000};
+    json << "  \"histogram\": [";
+    size_t index = 0;
+    bool first = true;
+    for (const double upperBound : binUpperBounds)
+    {
+        size_t count = 0;
+        while (index < latencies.size() && latencies[index] < 1000.0*upperBound)
+        {
+            count++;
+            index++;
+        }
+        json << (first ? " " : ", ") << "{ \"below_us\": " << upperBound << ", \"ticks\": " << count << " }";
+        first = false;
+    }
+    json << ", { \"below_us\": null, \"ticks\": " << latencies.size() - index << " } ],\n";
+
+    json << "  \"outlier_threshold_us\": " << threshold/1000.0 << ",\n"
+         << "  \"outliers\": " << outliers.size() << ",\n"
+         << "  \"outlier_attribution\": ";
+    writeJSONObject(json, attribution);
+    json << ",\n  \"worst_outliers\": [";
+    for (size_t i=0; i < outliers.size() && i < options.nrOfOutliers; i++)
+    {
+        const TickSample& outlier = *outliers[i];
+        json << (i == 0 ? "\n" : ",\n")
+             << "    { \"wall_time\": " << outlier.wallTimeInSeconds
+             << ", \"simulated_time\": " << outlier.simulatedTimeInSeconds
+             << ", \"latency_us\": " << outlier.latencyInNanoseconds/1000.0
+             << ", \"fmu_time_us\": " << outlier.fmuTimeInNanoseconds/1000.0
+             << ", \"fmu_calls\": " << outlier.fmuCalls
+             << ", \"slowest_fmu\": \"" << (outlier.slowestFMU ? escapeJSON(*outlier.slowestFMU) : "") << "\""
+             << ", \"slowest_fmu_call_us\": " << outlier.slowestFMUCallInNanoseconds/1000.0
+             << ", \"minor_page_faults\": " << outlier.minorPageFaults
+             << ", \"major_page_faults\": " << outlier.majorPageFaults
+             << ", \"allocations\": " << outlier.allocations
+             << ", \"cause\": \"" << outlierCause(outlier, medianLatency, medianFMUTime) << "\" }";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+int main(int argc, char** argv)
+{
+    JitterOptions options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // If no world is specified, a world is generated and its configuration is reported in the context
+    std::string worldPath = options.worldPath;
+    if (worldPath.empty())
+    {
+        worldPath = options.workDirectory + "/jitter.world";
+        if (!writeStringToFile(worldPath, scalingWorldSDF(options.worldOptions, options.nrOfRobots, options.robotOptions)))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The background threads are created before pinning this thread, so that they can run on any CPU
+    std::atomic<bool> stopBackgroundLoad{false};
+    std::vector<std::thread> backgroundLoad;
+    for (size_t i=0; i < options.backgroundLoadThreads; i++)
+    {
+        backgroundLoad.emplace_back(busyLoop, &stopBackgroundLoad);
+    }
+
+    // gazebo::runWorld runs the physics loop in the calling thread
+    isolateCurrentThread(options);
+
+    gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+    gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_SINGLE_BODY_FLUID_DYNAMICS_PLUGIN_BUILD_DIR);
+    gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_SCHEDULER_PLUGIN_BUILD_DIR);
+    gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+
+    int exitCode = EXIT_FAILURE;
+    JitterProbe probe(options.steps);
+    if (gazebo::setupServer())
+    {
+        // Connected before the plugins are loaded, so that it is called before their callbacks
+        probe.connections.push_back(gazebo::event::Events::ConnectWorldUpdateBegin(
+            std::bind(&JitterProbe::onTickBegin, &probe, std::placeholders::_1)));
+
+        gazebo::physics::WorldPtr world = gazebo::loadWorld(worldPath);
+        if (world)
+        {
+            // Connected after the plugins are loaded, so that it is called after their callbacks
+            probe.connections.push_back(gazebo::event::Events::ConnectBeforePhysicsUpdate(
+                std::bind(&JitterProbe::onTickEnd, &probe, std::placeholders::_1)));
+
+            if (options.warmupSteps > 0)
+            {
+                gazebo::runWorld(world, options.warmupSteps);
+            }
+
+            setFMUCallObserver(&probe);
+            probe.startRecording();
+            gazebo::runWorld(world, options.steps);
+            probe.stopRecording();
+            setFMUCallObserver(nullptr);
+
+            exitCode = EXIT_SUCCESS;
+        }
+        else
+        {
+            std::cerr << "gazebo-fmi-jitter-harness: impossible to load the world " << worldPath << std::endl;
+        }
+
+        probe.connections.clear();
+        gazebo::physics::remove_worlds();
+        gazebo::shutdown();
+    }
+    else
+    {
+        std::cerr << "gazebo-fmi-jitter-harness: impossible to setup the Gazebo server." << std::endl;
+    }
+
+    stopBackgroundLoad = true;
+    for (std::thread& thread : backgroundLoad)
+    {
+        thread.join();
+    }
+
+    if (exitCode != EXIT_SUCCESS)
+    {
+        return exitCode;
+    }
+
+    if (!options.samplesPath.empty() && !writeSamples(options.samplesPath, probe.getSamples()))
+    {
+        return EXIT_FAILURE;
+    }
+
+    const std::string json = resultsJSON(options, probe.getSamples());
+    if (options.outputPath.empty())
+    {
+        std::cout << json;
+        return EXIT_SUCCESS;
+    }
+    return writeStringToFile(options.outputPath, json) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,440 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/gazebo_config.h>
+#include <gazebo/common/SystemPaths.hh>
+#include <gazebo/physics/physics.hh>
+
+#include <sdf/sdf.hh>
+
+#include "BenchmarkSuite.hh"
+#include "BenchmarkWorlds.hh"
+
+/// Run worlds headless and report steps per second, real time factor and memory.
+///
+/// With --world, the specified world is run in this process and the result is printed on the standard output,
+/// in a single line starting with s_resultPrefix. Otherwise, a world is generated for each combination of the
+/// --robots, --actuators, --fluid-links, --mode and --threads lists, and each world is run in a separate process (by running
+/// this executable with --world), so that the memory measurements of each world are independent.
+/// See the README for the description of the options and of the output.
+
+using namespace gazebo_fmi;
+
+static const std::string s_resultPrefix = "GAZEBO_FMI_SCALING_RESULT ";
+
+struct HarnessOptions
+{
+    std::string worldPath;
+    size_t warmupSteps{100};
+    size_t steps{1000};
+
+    std::vector<size_t> robots{1};
+    std::vector<size_t> actuators{1};
+    std::vector<size_t> fluidLinks{0};
+    std::vector<BenchmarkMode> modes{BenchmarkMode::serial};
+    std::vector<size_t> threads{1};
+    BenchmarkWorldOptions worldOptions;
+    ActuatedModelOptions robotOptions;
+
+    std::string workDirectory{"."};
+    std::string outputPath;
+};
+
+static void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " --world <world file> [--steps <n>] [--warmup-steps <n>]\n"
+              << "   or: " << name << " [--robots <N,N,...>] [--actuators <M,M,...>] [--fluid-links <K,K,...>]\n"
+              << "         [--actuator-fmus <fmu,fmu,...>] [--fluid-fmus <fmu,fmu,...>]\n"
+              << "         [--physics <engine>] [--step-size <seconds>]\n"
+              << "         [--mode <serial|threads|scheduler,...>] [--threads <n,n,...>]\n"
+              << "         [--steps <n>] [--warmup-steps <n>] [--work-dir <directory>] [--output <json file>]" << std::endl;
+}
+
+static bool parseCommandLine(int argc, char** argv, HarnessOptions& options)
+{
+    options.robotOptions.name = "robot";
+    options.robotOptions.actuatorFMUs = {"ReferenceIdentity.fmu"};
+    options.robotOptions.fluidFMUs = {"ReferenceQuadraticDrag.fmu"};
+
+    for (int i=1; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (i+1 >= argc)
+        {
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        bool ok = true;
+        if (option == "--world")
+        {
+            options.worldPath = value;
+        }
+        else if (option == "--steps")
+        {
+            ok = parseCount(value, options.steps) && options.steps > 0;
+        }
+        else if (option == "--warmup-steps")
+        {
+            ok = parseCount(value, options.warmupSteps);
+        }
+        else if (option == "--robots")
+        {
+            ok = parseCountList(value, options.robots);
+        }
+        else if (option == "--actuators")
+        {
+            ok = parseCountList(value, options.actuators);
+        }
+        else if (option == "--fluid-links")
+        {
+            ok = parseCountList(value, options.fluidLinks);
+        }
+        else if (option == "--mode")
+        {
+            options.modes.clear();
+            for (const std::string& modeString : splitCommaSeparatedList(value))
+            {
+                BenchmarkMode mode;
+                ok = ok && parseBenchmarkMode(modeString, mode);
+                options.modes.push_back(mode);
+            }
+            ok = ok && !options.modes.empty();
+        }
+        else if (option == "--threads")
+        {
+            ok = parseCountList(value, options.threads) &&
+                 std::find(options.threads.begin(), options.threads.end(), 0u) == options.threads.end();
+        }
+        else if (option == "--work-dir")
+        {
+            options.workDirectory = value;
+        }
+        else if (option == "--output")
+        {
+            options.outputPath = value;
+        }
+        else
+        {
+            ok = parseWorldGeneratorOption(option, value, options.worldOptions, options.robotOptions);
+        }
+
+        if (!ok)
+        {
+            printInvalidOptionValue(argv[0], option, value);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \brief Resident set size of the process, in MB
+static double residentSetSizeInMB()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    statm >> totalPages >> residentPages;
+    return residentPages*static_cast<double>(sysconf(_SC_PAGESIZE))/(1024.0*1024.0);
+}
+
+/// \brief Peak resident set size of the process, in MB
+static double peakResidentSetSizeInMB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in kilobytes on Linux
+    return usage.ru_maxrss/1024.0;
+}
+
+/// \brief Mode in which the plugins of a world step their FMUs, found from the FMI plugins in its SDF
+/// @param[out] nrOfThreads number of threads of the scheduler, or largest number of threads of the fluid dynamics plugins
+static BenchmarkMode worldMode(const std::string& worldPath, size_t& nrOfThreads)
+{
+    BenchmarkMode mode = BenchmarkMode::serial;
+    nrOfThreads = 1;
+
+    sdf::SDFPtr worldSDF(new sdf::SDF());
+    sdf::init(worldSDF);
+    if (!sdf::readFile(worldPath, worldSDF) || !worldSDF->Root()->HasElement("world"))
+    {
+        return mode;
+    }
+    sdf::ElementPtr world = worldSDF->Root()->GetElement("world");
+
+    // GetElement would add a missing element, so the first element of each kind is taken only if present
+    for (sdf::ElementPtr plugin = world->HasElement("plugin") ? world->GetElement("plugin") : nullptr;
+         plugin; plugin = plugin->GetNextElement("plugin"))
+    {
+        if (plugin->Get<std::string>("filename").find("FMISchedulerPlugin") != std::string::npos)
+        {
+            nrOfThreads = plugin->HasElement("threads") ? static_cast<size_t>(plugin->Get<int>("threads")) : 1;
+            return BenchmarkMode::scheduler;
+        }
+    }
+
+    for (sdf::ElementPtr model = world->HasElement("model") ? world->GetElement("model") : nullptr;
+         model; model = model->GetNextElement("model"))
+    {
+        for (sdf::ElementPtr plugin = model->HasElement("plugin") ? model->GetElement("plugin") : nullptr;
+             plugin; plugin = plugin->GetNextElement("plugin"))
+        {
+            if (plugin->Get<std::string>("filename").find("FMISingleBodyFluidDynamicsPlugin") != std::string::npos &&
+                plugin->HasElement("threads") && plugin->Get<int>("threads") > 1)
+            {
+                mode = BenchmarkMode::threads;
+                nrOfThreads = std::max(nrOfThreads, static_cast<size_t>(plugin->Get<int>("threads")));
+            }
+        }
+    }
+    return mode;
+}
+
+static double simulatedTimeInSeconds(gazebo::physics::WorldPtr world)
+{
+#if GAZEBO_MAJOR_VERSION >= 8
+    return world->SimTime().Double();
+#else
+    return world->GetSimTime().Double();
+#endif
+}
+
+/// \brief Run a world in this process, and print the result
+static int runWorld(const HarnessOptions& options)
+{
+    gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+    gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_SINGLE_BODY_FLUID_DYNAMICS_PLUGIN_BUILD_DIR);
+    gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_SCHEDULER_PLUGIN_BUILD_DIR);
+    gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+    if (!gazebo::setupServer())
+    {
+        std::cerr << "gazebo-fmi-scaling-harness: impossible to setup the Gazebo server." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto loadStart = std::chrono::steady_clock::now();
+    gazebo::physics::WorldPtr world = gazebo::loadWorld(options.worldPath);
+    const auto loadEnd = std::chrono::steady_clock::now();
+    if (!world)
+    {
+        std::cerr << "gazebo-fmi-scaling-harness: impossible to load the world " << options.worldPath << std::endl;
+        gazebo::shutdown();
+        return EXIT_FAILURE;
+    }
+    const double rssAfterLoad = residentSetSizeInMB();
+
+    size_t nrOfThreads = 1;
+    const BenchmarkMode mode = worldMode(options.worldPath, nrOfThreads);
+
+    if (options.warmupSteps > 0)
+    {
+        gazebo::runWorld(world, options.warmupSteps);
+    }
+
+    const double simulatedTimeStart = simulatedTimeInSeconds(world);
+    const auto start = std::chrono::steady_clock::now();
+    gazebo::runWorld(world, options.steps);
+    const auto end = std::chrono::steady_clock::now();
+    const double simulatedTime = simulatedTimeInSeconds(world) - simulatedTimeStart;
+    const double wallTime = std::chrono::duration<double>(end - start).count();
+
+    std::ostringstream result;
+    result.precision(std::numeric_limits<double>::max_digits10);
+    result << "{ \"world\": \"" << escapeJSON(options.worldPath) << "\""
+           << ", \"mode\": \"" << benchmarkModeToString(mode) << "\""
+           << ", \"threads\": " << nrOfThreads
+           << ", \"steps\": " << options.steps
+           << ", \"load_time\": " << std::chrono::duration<double>(loadEnd - loadStart).count()
+           << ", \"wall_time\": " << wallTime
+           << ", \"simulated_time\": " << simulatedTime
+           << ", \"steps_per_second\": " << options.steps/wallTime
+           << ", \"real_time_factor\": " << simulatedTime/wallTime
+           << ", \"rss_mb_after_load\": " << rssAfterLoad
+           << ", \"rss_mb_after_run\": " << residentSetSizeInMB()
+           << ", \"peak_rss_mb\": " << peakResidentSetSizeInMB() << " }";
+
+    gazebo::physics::remove_worlds();
+    gazebo::shutdown();
+
+    std::cout << s_resultPrefix << result.str() << std::endl;
+    return EXIT_SUCCESS;
+}
+
+/// \brief Run a world in a child process, and return the result printed by it
+static bool runWorldInChildProcess(const HarnessOptions& options, const std::string& worldPath, std::string& result)
+{
+    std::ostringstream command;
+    command << "\"/proc/" << getpid() << "/exe\" --world \"" << worldPath << "\""
+            << " --steps " << options.steps << " --warmup-steps " << options.warmupSteps;
+
+    FILE* child = popen(command.str().c_str(), "r");
+    if (!child)
+    {
+        std::cerr << "gazebo-fmi-scaling-harness: impossible to run " << command.str() << std::endl;
+        return false;
+    }
+
+    // The Gazebo messages are printed on the standard output as well, so only the line with the prefix is considered
+    result.clear();
+    std::string line;
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), child))
+    {
+        line += buffer;
+        if (line.back() != '\n')
+        {
+            continue;
+        }
+        if (line.compare(0, s_resultPrefix.size(), s_resultPrefix) == 0)
+        {
+            result = line.substr(s_resultPrefix.size(), line.size() - s_resultPrefix.size() - 1);
+        }
+        line.clear();
+    }
+
+    const int status = pclose(child);
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && !result.empty();
+}
+
+/// \brief Generate and run a world for each combination of robots, actuators and fluid links, and append the results to json
+/// @return true if all the runs succeeded, false otherwise
+static bool runConfigurations(const HarnessOptions& options,
+                              const BenchmarkWorldOptions& worldOptions,
+                              std::ostringstream& json,
+                              bool& first)
+{
+    bool ok = true;
+    for (const size_t nrOfRobots : options.robots)
+    {
+        for (const size_t nrOfActuators : options.actuators)
+        {
+            for (const size_t nrOfFluidLinks : options.fluidLinks)
+            {
+                ActuatedModelOptions robotOptions = options.robotOptions;
+                robotOptions.nrOfJoints = nrOfActuators;
+                robotOptions.nrOfFluidLinks = nrOfFluidLinks;
+
+                const std::string worldName = "scaling_" + std::to_string(nrOfRobots) + "_robots_"
+                                              + std::to_string(nrOfActuators) + "_actuators_"
+                                              + std::to_string(nrOfFluidLinks) + "_fluid_links_"
+                                              + benchmarkModeToString(worldOptions.mode) + "_"
+                                              + std::to_string(worldOptions.nrOfThreads) + "_threads";
+                const std::string worldPath = options.workDirectory + "/" + worldName + ".world";
+                if (!writeStringToFile(worldPath, scalingWorldSDF(worldOptions, nrOfRobots, robotOptions)))
+                {
+                    return false;
+                }
+
+                std::cerr << "gazebo-fmi-scaling-harness: running " << worldName << std::endl;
+                std::string result;
+                if (!runWorldInChildProcess(options, worldPath, result))
+                {
+                    std::cerr << "gazebo-fmi-scaling-harness: the run of " << worldPath << " failed." << std::endl;
+                    ok = false;
+                    continue;
+                }
+
+                std::string actuatorFMUs, fluidFMUs;
+                for (const std::string& fmu : robotOptions.actuatorFMUs)
+                {
+                    actuatorFMUs += (actuatorFMUs.empty() ? "" : ",") + fmu;
+                }
+                for (const std::string& fmu : robotOptions.fluidFMUs)
+                {
+                    fluidFMUs += (fluidFMUs.empty() ? "" : ",") + fmu;
+                }
+
+                json << (first ? "\n" : ",\n") << "    { \"parameters\": ";
+                writeJSONObject(json, {{"robots", std::to_string(nrOfRobots)},
+                                       {"actuators", std::to_string(nrOfActuators)},
+                                       {"fluid_links", std::to_string(nrOfFluidLinks)},
+                                       {"actuator_fmus", actuatorFMUs},
+                                       {"fluid_fmus", fluidFMUs},
+                                       {"physics", worldOptions.physicsEngine},
+                                       {"step_size", std::to_string(worldOptions.stepSizeInSeconds)},
+                                       {"mode", benchmarkModeToString(worldOptions.mode)},
+                                       {"threads", std::to_string(worldOptions.nrOfThreads)}});
+                json << ", \"result\": " << result << " }";
+                first = false;
+            }
+        }
+    }
+    return ok;
+}
+
+/// \brief Generate and run a world for each configuration, and write the results
+static int runSweep(const HarnessOptions& options)
+{
+    std::ostringstream json;
+    json << "{\n  \"context\": ";
+    writeJSONObject(json, benchmarkContext({{"gazebo_fmi_version", GAZEBO_FMI_VERSION},
+                                            {"gazebo_version", GAZEBO_VERSION_FULL},
+                                            {"build_type", GAZEBO_FMI_BUILD_TYPE}}));
+    json << ",\n  \"runs\": [";
+
+    bool ok = true;
+    bool first = true;
+    for (const BenchmarkMode mode : options.modes)
+    {
+        // In serial mode the number of threads has no effect, so a single world is run
+        const std::vector<size_t> threads = mode == BenchmarkMode::serial ? std::vector<size_t>{1} : options.threads;
+        for (const size_t nrOfThreads : threads)
+        {
+            BenchmarkWorldOptions worldOptions = options.worldOptions;
+            worldOptions.mode = mode;
+            worldOptions.nrOfThreads = nrOfThreads;
+            ok = runConfigurations(options, worldOptions, json, first) && ok;
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if (options.outputPath.empty())
+    {
+        std::cout << json.str();
+    }
+    else if (!writeStringToFile(options.outputPath, json.str()))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+    HarnessOptions options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!options.worldPath.empty())
+    {
+        return runWorld(options);
+    }
+
+    return runSweep(options);
+}
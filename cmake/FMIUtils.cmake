@@ -73,3 +73,82 @@ getErrorString();
                      DEPENDS ${_OCM_INPUT_MO})
 
 endmacro()
+
+################################################################################
+#.rst:
+# .. command:: add_reference_fmu()
+#
+# Create a FMI 2.0 Co-Simulation FMU from C sources
+#
+#   add_reference_fmu(MODEL_NAME <model identifier>
+#                     SOURCES <C sources>
+#                     MODEL_DESCRIPTION <modelDescription.xml template>
+#                     OUTPUT_DIRECTORY <output directory>
+#                     [INCLUDE_DIRECTORIES <include directories>]
+#                     [DEFINITIONS <NAME=VALUE> ...])
+#
+# This function compiles the sources in a shared library named as the model identifier,
+# configures the modelDescription.xml template (in which @FMU_MODEL_IDENTIFIER@ and the
+# @NAME@ of each definition are replaced) and zips them in OUTPUT_DIRECTORY/MODEL_NAME.fmu .
+# Each definition is also passed to the compiler as a preprocessor definition, so that it
+# can be used to set the start values of the parameters of the model.
+# The FMI 2.0 headers are taken from the include directories of FMILibrary::FMILibrary .
+function(ADD_REFERENCE_FMU)
+  set(_options "")
+  set(_oneValueArgs MODEL_NAME MODEL_DESCRIPTION OUTPUT_DIRECTORY)
+  set(_multiValueArgs SOURCES INCLUDE_DIRECTORIES DEFINITIONS)
+  cmake_parse_arguments(_ARF "${_options}" "${_oneValueArgs}" "${_multiValueArgs}" ${ARGN} )
+
+  foreach(_arg MODEL_NAME SOURCES MODEL_DESCRIPTION OUTPUT_DIRECTORY)
+    if(NOT DEFINED _ARF_${_arg})
+      message(SEND_ERROR "Missing ${_arg} option.")
+      return()
+    endif()
+  endforeach()
+
+  # Platform directory, see section 2.1 of the FMI 2.0 specification
+  if(WIN32)
+    set(_fmu_platform win)
+  elseif(APPLE)
+    set(_fmu_platform darwin)
+  else()
+    set(_fmu_platform linux)
+  endif()
+  if(CMAKE_SIZEOF_VOID_P EQUAL 8)
+    set(_fmu_platform ${_fmu_platform}64)
+  else()
+    set(_fmu_platform ${_fmu_platform}32)
+  endif()
+
+  set(_fmu_directory ${CMAKE_CURRENT_BINARY_DIR}/${_ARF_MODEL_NAME}_fmu)
+
+  add_library(${_ARF_MODEL_NAME} MODULE ${_ARF_SOURCES})
+  target_include_directories(${_ARF_MODEL_NAME} PRIVATE ${_ARF_INCLUDE_DIRECTORIES}
+                             $<TARGET_PROPERTY:FMILibrary::FMILibrary,INTERFACE_INCLUDE_DIRECTORIES>)
+  target_compile_definitions(${_ARF_MODEL_NAME} PRIVATE ${_ARF_DEFINITIONS})
+  if(NOT MSVC)
+    target_link_libraries(${_ARF_MODEL_NAME} PRIVATE m)
+  endif()
+  # The $<1:...> generator expression avoids the per-configuration subdirectory of multi-config generators
+  set_target_properties(${_ARF_MODEL_NAME} PROPERTIES
+                        PREFIX ""
+                        LIBRARY_OUTPUT_DIRECTORY "$<1:${_fmu_directory}/binaries/${_fmu_platform}>"
+                        RUNTIME_OUTPUT_DIRECTORY "$<1:${_fmu_directory}/binaries/${_fmu_platform}>")
+
+  set(FMU_MODEL_IDENTIFIER ${_ARF_MODEL_NAME})
+  foreach(_definition ${_ARF_DEFINITIONS})
+    if(_definition MATCHES "^([^=]+)=(.*)$")
+      set(${CMAKE_MATCH_1} "${CMAKE_MATCH_2}")
+    endif()
+  endforeach()
+  configure_file(${_ARF_MODEL_DESCRIPTION} ${_fmu_directory}/modelDescription.xml @ONLY)
+
+  add_custom_command(OUTPUT ${_ARF_OUTPUT_DIRECTORY}/${_ARF_MODEL_NAME}.fmu
+                     COMMAND ${CMAKE_COMMAND} -E make_directory ${_ARF_OUTPUT_DIRECTORY}
+                     COMMAND ${CMAKE_COMMAND} -E tar cf ${_ARF_OUTPUT_DIRECTORY}/${_ARF_MODEL_NAME}.fmu --format=zip
+                             modelDescription.xml binaries
+                     COMMENT "Generating FMU for model ${_ARF_MODEL_NAME}"
+                     WORKING_DIRECTORY ${_fmu_directory}
+                     DEPENDS ${_ARF_MODEL_NAME} ${_fmu_directory}/modelDescription.xml)
+  add_custom_target(${_ARF_MODEL_NAME}_fmu ALL DEPENDS ${_ARF_OUTPUT_DIRECTORY}/${_ARF_MODEL_NAME}.fmu)
+endfunction()
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/AsyncLogger.hh>
+
+#include <cstdio>
+#include <ctime>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+bool parseLogLevel(const std::string& levelString, LogLevel& level)
+{
+    for (int i=static_cast<int>(LogLevel::nothing); i <= static_cast<int>(LogLevel::debug); i++)
+    {
+        if (levelString == logLevelToString(static_cast<LogLevel>(i)))
+        {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* logLevelToString(const LogLevel level)
+{
+    switch (level)
+    {
+        case LogLevel::nothing:
+            return "nothing";
+        case LogLevel::fatal:
+            return "fatal";
+        case LogLevel::error:
+            return "error";
+        case LogLevel::warning:
+            return "warning";
+        case LogLevel::info:
+            return "info";
+        case LogLevel::verbose:
+            return "verbose";
+        case LogLevel::debug:
+            return "debug";
+    }
+    return "unknown";
+}
+
+AsyncLogger::AsyncLogger(): m_records(s_capacity)
+{
+    for (size_t i=0; i < s_capacity; i++)
+    {
+        m_records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    m_thread = std::thread(&AsyncLogger::run, this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+}
+
+std::shared_ptr<AsyncLogger> AsyncLogger::getInstance()
+{
+    static std::mutex instanceMutex;
+    static std::weak_ptr<AsyncLogger> instance;
+
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    std::shared_ptr<AsyncLogger> logger = instance.lock();
+    if (!logger)
+    {
+        logger.reset(new AsyncLogger());
+        instance = logger;
+    }
+    return logger;
+}
+
+bool AsyncLogger::setFileSink(const std::string& filePath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_file.is_open())
+    {
+        if (filePath == m_filePath)
+        {
+            return true;
+        }
+        gzwarn << "gazebo_fmi: FMU log file changed from " << m_filePath << " to " << filePath << std::endl;
+        m_file.close();
+    }
+
+    m_file.open(filePath, std::ios::out | std::ios::app);
+    if (!m_file.is_open())
+    {
+        gzerr << "gazebo_fmi: impossible to open FMU log file " << filePath << std::endl;
+        return false;
+    }
+    m_filePath = filePath;
+    return true;
+}
+
+AsyncLogger::Record* AsyncLogger::beginRecord()
+{
+    // Bounded multi-producer queue, see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+    size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Record& record = m_records[position % s_capacity];
+        size_t sequence = record.sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0)
+        {
+            if (m_enqueuePosition.compare_exchange_weak(position, position+1, std::memory_order_relaxed))
+            {
+                return &record;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The buffer is full
+            m_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else
+        {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogger::commitRecord(Record* record)
+{
+    size_t sequence = record->sequence.load(std::memory_order_relaxed);
+    record->sequence.store(sequence+1, std::memory_order_release);
+}
+
+bool AsyncLogger::log(const LogLevel level, const char* source, const char* message)
+{
+    Record* record = beginRecord();
+    if (!record)
+    {
+        return false;
+    }
+
+    record->time = std::chrono::system_clock::now();
+    record->level = level;
+    std::snprintf(record->source, s_maxSourceLength, "%s", source ? source : "");
+    std::snprintf(record->message, s_maxMessageLength, "%s", message ? message : "");
+    commitRecord(record);
+    return true;
+}
+
+bool AsyncLogger::logv(const LogLevel level, const char* source, const char* format, va_list args)
+{
+    Record* record = beginRecord();
+    if (!record)
+    {
+        return false;
+    }
+
+    // The arguments need to be consumed here, as they are not guaranteed
+    // to be valid after the return of the function
+    record->time = std::chrono::system_clock::now();
+    record->level = level;
+    std::snprintf(record->source, s_maxSourceLength, "%s", source ? source : "");
+    std::vsnprintf(record->message, s_maxMessageLength, format ? format : "", args);
+    commitRecord(record);
+    return true;
+}
+
+void AsyncLogger::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->drain();
+}
+
+uint64_t AsyncLogger::getDroppedRecords() const
+{
+    return m_droppedRecords.load(std::memory_order_relaxed);
+}
+
+void AsyncLogger::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop)
+    {
+        this->drain();
+        m_wakeUp.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    this->drain();
+}
+
+void AsyncLogger::drain()
+{
+    // Must be called with m_mutex locked, as there is a single consumer
+    for (;;)
+    {
+        Record& record = m_records[m_dequeuePosition % s_capacity];
+        size_t sequence = record.sequence.load(std::memory_order_acquire);
+        if (sequence != m_dequeuePosition+1)
+        {
+            break;
+        }
+
+        this->write(record);
+        record.sequence.store(m_dequeuePosition+s_capacity, std::memory_order_release);
+        m_dequeuePosition++;
+    }
+
+    uint64_t droppedRecords = m_droppedRecords.load(std::memory_order_relaxed);
+    if (droppedRecords != m_reportedDroppedRecords)
+    {
+        gzwarn << "gazebo_fmi: " << droppedRecords-m_reportedDroppedRecords
+               << " FMU log messages dropped because the log buffer was full." << std::endl;
+        m_reportedDroppedRecords = droppedRecords;
+    }
+}
+
+void AsyncLogger::write(const Record& record)
+{
+    if (m_file.is_open())
+    {
+        std::time_t time = std::chrono::system_clock::to_time_t(record.time);
+        char timeString[32];
+        std::strftime(timeString, sizeof(timeString), "%Y-%m-%d %H:%M:%S", std::localtime(&time));
+        m_file << "[" << timeString << "] [" << logLevelToString(record.level) << "] "
+               << record.source << ": " << record.message << std::endl;
+        return;
+    }
+
+    switch (record.level)
+    {
+        case LogLevel::fatal:
+        case LogLevel::error:
+            gzerr << "gazebo_fmi: " << record.source << ": " << record.message << std::endl;
+            break;
+        case LogLevel::warning:
+            gzwarn << "gazebo_fmi: " << record.source << ": " << record.message << std::endl;
+            break;
+        case LogLevel::info:
+            gzmsg << "gazebo_fmi: " << record.source << ": " << record.message << std::endl;
+            break;
+        default:
+            gzdbg << "gazebo_fmi: " << record.source << ": " << record.message << std::endl;
+            break;
+    }
+}
+
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/DeterminismDigest.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+static const uint64_t s_fnvOffsetBasis = 14695981039346656037ULL;
+static const uint64_t s_fnvPrime = 1099511628211ULL;
+
+static inline uint64_t fnv1a(uint64_t hash, const uint64_t value)
+{
+    for (int byte=0; byte < 8; byte++)
+    {
+        hash ^= (value >> (8*byte)) & 0xff;
+        hash *= s_fnvPrime;
+    }
+    return hash;
+}
+
+static inline uint64_t bitPattern(const double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static std::string toHex(const uint64_t value)
+{
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016" PRIx64, value);
+    return buffer;
+}
+
+DeterminismDigest::DeterminismDigest(): m_digest(s_fnvOffsetBasis)
+{
+}
+
+void DeterminismDigest::configure(const DeterminismDigestOptions& options,
+                                  const std::string& ownerName,
+                                  const std::vector<std::string>& fmuNames)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+    m_fmuNames = fmuNames;
+
+    m_step = 0;
+    m_simulatedTimeInSeconds = 0.0;
+    m_digest = s_fnvOffsetBasis;
+    m_fmuDigests.assign(fmuNames.size(), s_fnvOffsetBasis);
+    m_hasPublished = false;
+
+    // Reserve the memory of the checkpoints, so that addCheckpoint does not allocate in the physics thread
+    m_checkpoints.clear();
+    m_checkpoints.reserve(m_options.maxCheckpoints);
+    m_freeFMUDigests.assign(m_options.maxCheckpoints, std::vector<uint64_t>(fmuNames.size()));
+    m_droppedCheckpoints = 0;
+}
+
+bool DeterminismDigest::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+void DeterminismDigest::beginStep(const double simulatedTimeInSeconds)
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    m_simulatedTimeInSeconds = simulatedTimeInSeconds;
+}
+
+void DeterminismDigest::update(const size_t fmuIndex, const std::vector<double>& values)
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    uint64_t& fmuDigest = m_fmuDigests[fmuIndex];
+    for (const double value : values)
+    {
+        fmuDigest = fnv1a(fmuDigest, bitPattern(value));
+    }
+}
+
+void DeterminismDigest::endStep()
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    m_digest = fnv1a(m_digest, bitPattern(m_simulatedTimeInSeconds));
+    for (const uint64_t fmuDigest : m_fmuDigests)
+    {
+        m_digest = fnv1a(m_digest, fmuDigest);
+    }
+    m_step++;
+
+    if (m_step % m_options.checkpointPeriod == 0)
+    {
+        this->addCheckpoint();
+    }
+
+    if (m_options.publishPeriodInSeconds > 0.0 &&
+        (!m_hasPublished || m_simulatedTimeInSeconds - m_lastPublishTimeInSeconds >= m_options.publishPeriodInSeconds))
+    {
+        logFromCallback(LogLevel::info, m_ownerName.c_str(), "determinism digest at step %" PRIu64 " (time %g): %016" PRIx64,
+                        m_step, m_simulatedTimeInSeconds, m_digest);
+        m_lastPublishTimeInSeconds = m_simulatedTimeInSeconds;
+        m_hasPublished = true;
+    }
+}
+
+void DeterminismDigest::addCheckpoint()
+{
+    if (m_freeFMUDigests.empty())
+    {
+        if (m_droppedCheckpoints == 0)
+        {
+            logFromCallback(LogLevel::warning, m_ownerName.c_str(),
+                            "the %zu checkpoints of the determinism digest are full, the following checkpoints are dropped.",
+                            m_options.maxCheckpoints);
+        }
+        m_droppedCheckpoints++;
+        return;
+    }
+
+    // The storage of the checkpoint was reserved in configure
+    DeterminismCheckpoint checkpoint;
+    checkpoint.step = m_step;
+    checkpoint.simulatedTimeInSeconds = m_simulatedTimeInSeconds;
+    checkpoint.digest = m_digest;
+    checkpoint.fmuDigests.swap(m_freeFMUDigests.back());
+    m_freeFMUDigests.pop_back();
+    std::copy(m_fmuDigests.begin(), m_fmuDigests.end(), checkpoint.fmuDigests.begin());
+    m_checkpoints.push_back(std::move(checkpoint));
+}
+
+uint64_t DeterminismDigest::getDigest() const
+{
+    return m_digest;
+}
+
+uint64_t DeterminismDigest::getFMUDigest(const size_t fmuIndex) const
+{
+    return m_fmuDigests[fmuIndex];
+}
+
+const std::vector<DeterminismCheckpoint>& DeterminismDigest::getCheckpoints() const
+{
+    return m_checkpoints;
+}
+
+uint64_t DeterminismDigest::getDroppedCheckpoints() const
+{
+    return m_droppedCheckpoints;
+}
+
+bool DeterminismDigest::dump()
+{
+    if (!m_options.enabled)
+    {
+        return true;
+    }
+
+    // Store the last steps, if they are not already in a checkpoint (dump is not called in the physics thread,
+    // so the final checkpoint is stored even if the reserved ones are full)
+    if (m_step > 0 && (m_checkpoints.empty() || m_checkpoints.back().step != m_step))
+    {
+        if (m_freeFMUDigests.empty())
+        {
+            m_freeFMUDigests.emplace_back(m_fmuDigests.size());
+        }
+        this->addCheckpoint();
+    }
+
+    if (m_droppedCheckpoints > 0)
+    {
+        gzwarn << m_ownerName << ": " << m_droppedCheckpoints << " checkpoints of the determinism digest were dropped, "
+               << "increase max_checkpoints or checkpoint_period to store all of them." << std::endl;
+    }
+
+    gzmsg << m_ownerName << ": final determinism digest after " << m_step << " steps: " << toHex(m_digest) << std::endl;
+
+    if (m_options.filePath.empty())
+    {
+        return true;
+    }
+
+    std::ofstream file(m_options.filePath);
+    if (!file.is_open())
+    {
+        gzerr << m_ownerName << ": impossible to create the determinism digest file " << m_options.filePath << std::endl;
+        return false;
+    }
+
+    file << "# gazebo-fmi determinism digest 1\n";
+    file << "# owner " << m_ownerName << "\n";
+    file << "# fmus";
+    for (const std::string& fmuName : m_fmuNames)
+    {
+        file << " " << fmuName;
+    }
+    file << "\n";
+
+    file.precision(17);
+    for (const DeterminismCheckpoint& checkpoint : m_checkpoints)
+    {
+        file << checkpoint.step << " " << checkpoint.simulatedTimeInSeconds << " " << toHex(checkpoint.digest);
+        for (const uint64_t fmuDigest : checkpoint.fmuDigests)
+        {
+            file << " " << toHex(fmuDigest);
+        }
+        file << "\n";
+    }
+
+    file.close();
+    if (file.fail())
+    {
+        gzerr << m_ownerName << ": error in writing the determinism digest file " << m_options.filePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool readDeterminismDigestFile(const std::string& filePath,
+                               std::string& ownerName,
+                               std::vector<std::string>& fmuNames,
+                               std::vector<DeterminismCheckpoint>& checkpoints)
+{
+    std::ifstream file(filePath);
+    if (!file.is_open())
+    {
+        gzerr << "gazebo_fmi: impossible to open the determinism digest file " << filePath << std::endl;
+        return false;
+    }
+
+    ownerName.clear();
+    fmuNames.clear();
+    checkpoints.clear();
+
+    std::string line;
+    if (!std::getline(file, line) || line != "# gazebo-fmi determinism digest 1")
+    {
+        gzerr << "gazebo_fmi: " << filePath << " is not a determinism digest file." << std::endl;
+        return false;
+    }
+
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+
+        std::istringstream stream(line);
+        if (line[0] == '#')
+        {
+            std::string hash, key;
+            stream >> hash >> key;
+            if (key == "owner")
+            {
+                std::getline(stream >> std::ws, ownerName);
+            }
+            else if (key == "fmus")
+            {
+                std::string fmuName;
+                while (stream >> fmuName)
+                {
+                    fmuNames.push_back(fmuName);
+                }
+            }
+            continue;
+        }
+
+        DeterminismCheckpoint checkpoint;
+        std::string digest;
+        stream >> checkpoint.step >> checkpoint.simulatedTimeInSeconds >> digest;
+        checkpoint.digest = std::strtoull(digest.c_str(), nullptr, 16);
+        while (stream >> digest)
+        {
+            checkpoint.fmuDigests.push_back(std::strtoull(digest.c_str(), nullptr, 16));
+        }
+
+        if (stream.bad() || checkpoint.fmuDigests.size() != fmuNames.size())
+        {
+            gzerr << "gazebo_fmi: malformed line in determinism digest file " << filePath << ": " << line << std::endl;
+            return false;
+        }
+        checkpoints.push_back(checkpoint);
+    }
+
+    return true;
+}
+
+}
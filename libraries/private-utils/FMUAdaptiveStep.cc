@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUAdaptiveStep.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+#include <cmath>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+bool parseStepErrorEstimator(const std::string& estimatorString, StepErrorEstimator& estimator)
+{
+    if (estimatorString == "step_doubling")
+    {
+        estimator = StepErrorEstimator::stepDoubling;
+        return true;
+    }
+
+    if (estimatorString == "extrapolation")
+    {
+        estimator = StepErrorEstimator::extrapolation;
+        return true;
+    }
+
+    return false;
+}
+
+bool FMUAdaptiveStepper::isSupportedBy(FMUCoSimulation& fmu, const std::string& ownerName)
+{
+    if (!fmu.canHandleVariableStepSize())
+    {
+        gzwarn << ownerName << ": the FMU does not handle a variable step size, its communication step is not adaptive." << std::endl;
+        return false;
+    }
+
+    if (!fmu.canGetAndSetFMUState())
+    {
+        gzwarn << ownerName << ": the FMU can not save and restore its state, its communication step is not adaptive." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool FMUAdaptiveStepper::configure(const FMUAdaptiveStepOptions& options, const size_t nrOfInputs,
+                                   const size_t nrOfOutputs, const std::string& ownerName)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+    m_nrOfInputs = nrOfInputs;
+    m_nrOfOutputs = nrOfOutputs;
+
+    if (m_options.enabled && m_options.maxStepMultiple == 0)
+    {
+        gzerr << ownerName << ": the maximum macro step of the adaptive communication step should be at least one physics step." << std::endl;
+        m_options.enabled = false;
+        return false;
+    }
+
+    if (m_options.enabled && !(m_options.safetyFactor > 0.0 && m_options.safetyFactor <= 1.0))
+    {
+        gzerr << ownerName << ": the safety factor of the adaptive communication step is " << m_options.safetyFactor
+              << ", but it should be in (0, 1]." << std::endl;
+        m_options.enabled = false;
+        return false;
+    }
+
+    m_stepMultiple = 1;
+    m_currentStepMultiple = 0;
+    m_stepsInCurrentMacroStep = 0;
+    m_startOutputs.assign(nrOfOutputs, 0.0);
+    m_endOutputs.assign(nrOfOutputs, 0.0);
+    m_olderOutputs.assign(nrOfOutputs, 0.0);
+    m_estimateOutputs.assign(nrOfOutputs, 0.0);
+    m_startInputs.assign(nrOfInputs, 0.0);
+    m_olderInputs.assign(nrOfInputs, 0.0);
+    m_extrapolatedInputs.assign(nrOfInputs, 0.0);
+    m_startTimeInSeconds = 0.0;
+    m_olderTimeInSeconds = 0.0;
+    m_nrOfCommunicationPoints = 0;
+
+    m_nrOfPhysicsSteps = 0;
+    m_nrOfMacroSteps = 0;
+    m_nrOfRejectedSteps = 0;
+    m_maxStepMultipleTaken = 0;
+    m_maxError = 0.0;
+
+    return true;
+}
+
+bool FMUAdaptiveStepper::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+size_t FMUAdaptiveStepper::proposeStepMultiple(const size_t stepMultiple, const double error) const
+{
+    // The local error of holding the inputs over the macro step grows with the square of its size
+    double factor = 2.0;
+    if (error > 0.0)
+    {
+        factor = std::min(2.0, std::max(0.2, m_options.safetyFactor*std::sqrt(m_options.tolerance/error)));
+    }
+
+    size_t nextStepMultiple = static_cast<size_t>(std::floor(stepMultiple*factor));
+    if (error > m_options.tolerance)
+    {
+        nextStepMultiple = std::min(nextStepMultiple, stepMultiple - 1);
+    }
+    else if (factor > 1.0)
+    {
+        nextStepMultiple = std::max(nextStepMultiple, stepMultiple + 1);
+    }
+
+    return std::max<size_t>(1, std::min(nextStepMultiple, m_options.maxStepMultiple));
+}
+
+bool FMUAdaptiveStepper::simulateMacroStep(FMUCoSimulation& fmu,
+                                           const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                                           const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                                           const double currentTimeInSeconds, const double macroStepSizeInSeconds,
+                                           double& error)
+{
+    bool ok = true;
+    bool hasEstimate = false;
+    const double previousStepSizeInSeconds = m_startTimeInSeconds - m_olderTimeInSeconds;
+    const bool hasHistory = m_nrOfCommunicationPoints >= 2 && previousStepSizeInSeconds > 0.0;
+
+    if (m_options.estimator == StepErrorEstimator::stepDoubling)
+    {
+        // Inputs at the middle of the macro step, linearly extrapolated from the last two communication points
+        const double ratio = hasHistory ? 0.5*macroStepSizeInSeconds/previousStepSizeInSeconds : 0.0;
+        for (size_t i=0; i < m_nrOfInputs; i++)
+        {
+            m_extrapolatedInputs[i] = m_startInputs[i] + ratio*(m_startInputs[i] - m_olderInputs[i]);
+        }
+
+        // One macro step with the inputs held, then two half macro steps from the same state
+        const double halfStepSizeInSeconds = macroStepSizeInSeconds/2.0;
+        ok = ok && fmu.setInputVariables(inputVariableReferences, m_startInputs);
+        ok = ok && fmu.doStep(currentTimeInSeconds, macroStepSizeInSeconds);
+        ok = ok && fmu.getOutputVariables(outputVariableReferences, m_estimateOutputs);
+        ok = ok && fmu.restoreState();
+        ok = ok && fmu.setInputVariables(inputVariableReferences, m_startInputs);
+        ok = ok && fmu.doStep(currentTimeInSeconds, halfStepSizeInSeconds);
+        ok = ok && fmu.setInputVariables(inputVariableReferences, m_extrapolatedInputs);
+        ok = ok && fmu.doStep(currentTimeInSeconds + halfStepSizeInSeconds, halfStepSizeInSeconds);
+        ok = ok && fmu.getOutputVariables(outputVariableReferences, m_endOutputs);
+        hasEstimate = true;
+    }
+    else
+    {
+        ok = ok && fmu.setInputVariables(inputVariableReferences, m_startInputs);
+        ok = ok && fmu.doStep(currentTimeInSeconds, macroStepSizeInSeconds);
+        ok = ok && fmu.getOutputVariables(outputVariableReferences, m_endOutputs);
+
+        // Linear extrapolation of the outputs of the last two communication points
+        if (hasHistory)
+        {
+            const double ratio = macroStepSizeInSeconds/previousStepSizeInSeconds;
+            for (size_t o=0; o < m_nrOfOutputs; o++)
+            {
+                m_estimateOutputs[o] = m_startOutputs[o] + ratio*(m_startOutputs[o] - m_olderOutputs[o]);
+            }
+            hasEstimate = true;
+        }
+    }
+
+    error = 0.0;
+    if (ok && hasEstimate)
+    {
+        for (size_t o=0; o < m_nrOfOutputs; o++)
+        {
+            // Written so that a NaN output is never accepted
+            const double outputError = std::abs(m_endOutputs[o] - m_estimateOutputs[o]);
+            error = std::isnan(outputError) ? HUGE_VAL : std::max(error, outputError);
+        }
+    }
+
+    return ok;
+}
+
+bool FMUAdaptiveStepper::communicate(FMUCoSimulation& fmu,
+                                     const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                                     const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                                     const double currentTimeInSeconds, const double physicsStepSizeInSeconds,
+                                     const std::vector<double>& inputs)
+{
+    // The outputs of the first communication point are the ones after the initialization
+    if (m_nrOfCommunicationPoints == 0 && !fmu.getOutputVariables(outputVariableReferences, m_endOutputs))
+    {
+        return false;
+    }
+
+    // The end of the previous macro step is the beginning of the next one
+    std::swap(m_olderOutputs, m_startOutputs);
+    std::copy(m_endOutputs.begin(), m_endOutputs.end(), m_startOutputs.begin());
+    std::swap(m_olderInputs, m_startInputs);
+    std::copy(inputs.begin(), inputs.end(), m_startInputs.begin());
+    m_olderTimeInSeconds = m_startTimeInSeconds;
+    m_startTimeInSeconds = currentTimeInSeconds;
+    m_nrOfCommunicationPoints++;
+
+    if (!fmu.saveState())
+    {
+        return false;
+    }
+
+    size_t stepMultiple = m_stepMultiple;
+    while (true)
+    {
+        double error = 0.0;
+        if (!this->simulateMacroStep(fmu, inputVariableReferences, outputVariableReferences,
+                                     currentTimeInSeconds, stepMultiple*physicsStepSizeInSeconds, error))
+        {
+            return false;
+        }
+
+        const size_t nextStepMultiple = this->proposeStepMultiple(stepMultiple, error);
+        if (error > m_options.tolerance && stepMultiple > 1)
+        {
+            // Roll back to the communication point and refine the macro step
+            m_nrOfRejectedSteps++;
+            if (!fmu.restoreState())
+            {
+                return false;
+            }
+            stepMultiple = nextStepMultiple;
+            continue;
+        }
+
+        m_stepMultiple = nextStepMultiple;
+        m_currentStepMultiple = stepMultiple;
+        m_stepsInCurrentMacroStep = 0;
+        m_nrOfMacroSteps++;
+        m_maxStepMultipleTaken = std::max(m_maxStepMultipleTaken, stepMultiple);
+        m_maxError = std::max(m_maxError, error);
+        return true;
+    }
+}
+
+bool FMUAdaptiveStepper::step(FMUCoSimulation& fmu,
+                              const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                              const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                              const double currentTimeInSeconds, const double physicsStepSizeInSeconds,
+                              const std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    if (inputs.size() != m_nrOfInputs || outputs.size() != m_nrOfOutputs)
+    {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "%s: adaptive step buffer size mismatch.", m_ownerName.c_str());
+        return false;
+    }
+
+    if (m_stepsInCurrentMacroStep >= m_currentStepMultiple &&
+        !this->communicate(fmu, inputVariableReferences, outputVariableReferences,
+                           currentTimeInSeconds, physicsStepSizeInSeconds, inputs))
+    {
+        return false;
+    }
+
+    // Linear interpolation of the outputs at the end of the physics step
+    m_stepsInCurrentMacroStep++;
+    const double weight = static_cast<double>(m_stepsInCurrentMacroStep)/m_currentStepMultiple;
+    for (size_t o=0; o < m_nrOfOutputs; o++)
+    {
+        outputs[o] = m_startOutputs[o] + weight*(m_endOutputs[o] - m_startOutputs[o]);
+    }
+    m_nrOfPhysicsSteps++;
+
+    return true;
+}
+
+size_t FMUAdaptiveStepper::getNrOfPhysicsSteps() const
+{
+    return m_nrOfPhysicsSteps;
+}
+
+size_t FMUAdaptiveStepper::getNrOfMacroSteps() const
+{
+    return m_nrOfMacroSteps;
+}
+
+size_t FMUAdaptiveStepper::getNrOfRejectedSteps() const
+{
+    return m_nrOfRejectedSteps;
+}
+
+void FMUAdaptiveStepper::printReport() const
+{
+    if (!m_options.enabled || m_nrOfMacroSteps == 0)
+    {
+        return;
+    }
+
+    gzmsg << m_ownerName << ": adaptive step report, " << m_nrOfMacroSteps << " macro steps for " << m_nrOfPhysicsSteps
+          << " physics steps (mean " << static_cast<double>(m_nrOfPhysicsSteps)/m_nrOfMacroSteps << ", max "
+          << m_maxStepMultipleTaken << " physics steps), " << m_nrOfRejectedSteps << " rejected steps, max local error "
+          << m_maxError << "." << std::endl;
+}
+
+}
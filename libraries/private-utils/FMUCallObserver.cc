@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUCallObserver.hh>
+
+#include <atomic>
+
+namespace gazebo_fmi
+{
+
+static std::atomic<FMUCallObserver*> s_observer{nullptr};
+
+void setFMUCallObserver(FMUCallObserver* observer)
+{
+    s_observer.store(observer, std::memory_order_release);
+}
+
+FMUCallObserver* getFMUCallObserver()
+{
+    return s_observer.load(std::memory_order_acquire);
+}
+
+}
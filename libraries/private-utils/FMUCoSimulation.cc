@@ -9,8 +9,12 @@
  */
 
 #include <gazebo_fmi/FMUCoSimulation.hh>
+#include <gazebo_fmi/FMUCallObserver.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
 
+#include <algorithm>
 #include <experimental/filesystem>
+#include <functional>
 
 #include <fmilib.h>
 
@@ -19,13 +23,6 @@
 namespace gazebo_fmi
 {
 
-void GazeboFMI_importlogger(jm_callbacks* c, jm_string module, jm_log_level_enu_t log_level, jm_string message)
-{
-    gzdbg << "gazebo_fmi : module = " << module << ", log level = "
-          << jm_log_level_to_string(log_level) << ": " << message << std::endl;
-}
-
-
 class FMUCoSimulationPrivate
 {
 public:
@@ -34,8 +31,43 @@ public:
     fmi_import_context_t* context{nullptr};
     fmi_version_enu_t version;
     fmi2_import_t* fmuHandle{nullptr};
+    fmi2_FMU_state_t savedState{nullptr};
     std::string instanceName;
     bool isLoaded{false};
+    bool useMemoryPool{false};
+    LogLevel logLevel{LogLevel::error};
+    std::shared_ptr<AsyncLogger> logger{AsyncLogger::getInstance()};
+
+    /// Inputs with a bound reference, allocated by getInputVariableRefs and filled by compactBoundInputs
+    std::vector<fmi2_value_reference_t> boundReferences;
+    std::vector<double> boundValues;
+
+    /// Copy the elements of the inputs with a bound reference, return false if all the references are bound
+    bool compactBoundInputs(const std::vector<fmi2_value_reference_t>& references, const std::vector<double>& values)
+    {
+        if (std::find(references.begin(), references.end(), FMUUnboundVariableReference) == references.end())
+        {
+            return false;
+        }
+
+        // The capacity is reserved when the references are obtained, so the buffers are not reallocated
+        boundReferences.clear();
+        boundValues.clear();
+        for (size_t i=0; i < references.size(); i++)
+        {
+            if (references[i] != FMUUnboundVariableReference)
+            {
+                boundReferences.push_back(references[i]);
+                boundValues.push_back(values[i]);
+            }
+        }
+        return true;
+    }
+
+    bool isLoggingOn() const
+    {
+        return logLevel >= LogLevel::info;
+    }
 
     void cleanup()
     {
@@ -59,7 +91,8 @@ public:
         fmi2_status_t fmistatus;
         jm_status_enu_t jmstatus;
 
-        jmstatus = fmi2_import_instantiate(fmuHandle, instanceName.c_str(), fmi2_cosimulation, NULL, fmi2_false);
+        jmstatus = fmi2_import_instantiate(fmuHandle, instanceName.c_str(), fmi2_cosimulation, NULL,
+                                           isLoggingOn() ? fmi2_true : fmi2_false);
         if (jmstatus == jm_status_error) {
             gzerr << "gazebo_fmi: fmi2_import_instantiate failed." << std::endl;
             this->cleanup();
@@ -95,6 +128,13 @@ public:
 
     void deleteInstance()
     {
+        // The saved state belongs to the instance
+        if (savedState)
+        {
+            fmi2_import_free_fmu_state(this->fmuHandle, &savedState);
+            savedState = nullptr;
+        }
+
         // Close instance
         fmi2_import_terminate(this->fmuHandle);
 
@@ -103,6 +143,81 @@ public:
     }
 };
 
+/// \brief Scope guard timing a FMU call and reporting it to the FMUCallObserver, if one is set
+class ObservedFMUCall
+{
+    FMUCallObserver* m_observer;
+    const FMUCall m_call;
+    const std::string& m_instanceName;
+    std::chrono::steady_clock::time_point m_start;
+
+public:
+    ObservedFMUCall(const FMUCall call, const std::string& instanceName):
+        m_observer(getFMUCallObserver()), m_call(call), m_instanceName(instanceName)
+    {
+        if (m_observer)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ObservedFMUCall()
+    {
+        if (m_observer)
+        {
+            m_observer->onFMUCall(m_call, m_instanceName, std::chrono::steady_clock::now() - m_start);
+        }
+    }
+};
+
+void GazeboFMI_importlogger(jm_callbacks* c, jm_string module, jm_log_level_enu_t log_level, jm_string message)
+{
+    FMUCoSimulationPrivate* pimpl = static_cast<FMUCoSimulationPrivate*>(c->context);
+    if (!pimpl || static_cast<int>(log_level) > static_cast<int>(pimpl->logLevel))
+    {
+        return;
+    }
+
+    pimpl->logger->log(static_cast<LogLevel>(log_level), module, message);
+}
+
+void GazeboFMI_fmulogger(fmi2_component_environment_t env, fmi2_string_t instanceName, fmi2_status_t status,
+                         fmi2_string_t category, fmi2_string_t message, ...)
+{
+    FMUCoSimulationPrivate* pimpl = static_cast<FMUCoSimulationPrivate*>(env);
+
+    LogLevel level;
+    switch (status)
+    {
+        case fmi2_status_ok:
+        case fmi2_status_pending:
+            level = LogLevel::info;
+            break;
+        case fmi2_status_warning:
+        case fmi2_status_discard:
+            level = LogLevel::warning;
+            break;
+        case fmi2_status_error:
+            level = LogLevel::error;
+            break;
+        default:
+            level = LogLevel::fatal;
+            break;
+    }
+
+    if (!pimpl || level > pimpl->logLevel)
+    {
+        return;
+    }
+
+    // The message is formatted in the calling thread without allocations,
+    // only the I/O is done by the background thread of the logger
+    va_list args;
+    va_start(args, message);
+    pimpl->logger->logv(level, instanceName, message, args);
+    va_end(args);
+}
+
 FMUCoSimulation::FMUCoSimulation(): m_pimpl(new FMUCoSimulationPrivate)
 {
 }
@@ -113,6 +228,28 @@ FMUCoSimulation::~FMUCoSimulation()
 }
 
 
+void FMUCoSimulation::setLogLevel(const LogLevel level)
+{
+    m_pimpl->logLevel = level;
+    m_pimpl->callbacks.log_level = static_cast<jm_log_level_enu_t>(level);
+
+    if (isLoaded())
+    {
+        fmi2_import_set_debug_logging(m_pimpl->fmuHandle, m_pimpl->isLoggingOn() ? fmi2_true : fmi2_false, 0, NULL);
+    }
+}
+
+void FMUCoSimulation::setUseMemoryPool(const bool useMemoryPool)
+{
+    if (isLoaded())
+    {
+        gzerr << "gazebo_fmi: the FMU memory pool can be enabled only before loading the FMU." << std::endl;
+        return;
+    }
+
+    m_pimpl->useMemoryPool = useMemoryPool;
+}
+
 bool FMUCoSimulation::load(const std::string& fmuAbsolutePath, const std::string& instanceName, const double startTimeInSeconds)
 {
     // Check if an fmu is already loaded
@@ -138,8 +275,8 @@ bool FMUCoSimulation::load(const std::string& fmuAbsolutePath, const std::string
     m_pimpl->callbacks.realloc = realloc;
     m_pimpl->callbacks.free = free;
     m_pimpl->callbacks.logger = GazeboFMI_importlogger;
-    m_pimpl->callbacks.log_level = jm_log_level_error;
-    m_pimpl->callbacks.context = 0;
+    m_pimpl->callbacks.log_level = static_cast<jm_log_level_enu_t>(m_pimpl->logLevel);
+    m_pimpl->callbacks.context = m_pimpl.get();
 
     // Allocate context
     m_pimpl->context = fmi_import_allocate_context(&(m_pimpl->callbacks));
@@ -167,10 +304,10 @@ bool FMUCoSimulation::load(const std::string& fmuAbsolutePath, const std::string
         return false;
     }
 
-    m_pimpl->callBackFunctions.logger = fmi2_log_forwarding;
-    m_pimpl->callBackFunctions.allocateMemory = calloc;
-    m_pimpl->callBackFunctions.freeMemory = free;
-    m_pimpl->callBackFunctions.componentEnvironment = m_pimpl->fmuHandle;
+    m_pimpl->callBackFunctions.logger = GazeboFMI_fmulogger;
+    m_pimpl->callBackFunctions.allocateMemory = m_pimpl->useMemoryPool ? fmuMemoryPoolAllocate : calloc;
+    m_pimpl->callBackFunctions.freeMemory = m_pimpl->useMemoryPool ? fmuMemoryPoolFree : free;
+    m_pimpl->callBackFunctions.componentEnvironment = m_pimpl.get();
 
     jm_status_enu_t status = fmi2_import_create_dllfmu(m_pimpl->fmuHandle, fmi2_fmu_kind_cs, &m_pimpl->callBackFunctions);
     if (status == jm_status_error) {
@@ -224,10 +361,11 @@ bool FMUCoSimulation::doStep(const double currentTimeInSeconds, const double ste
         return false;
     }
 
+    ObservedFMUCall observed(FMUCall::doStep, m_pimpl->instanceName);
     fmi2_status_t fmistatus = fmi2_import_do_step(m_pimpl->fmuHandle, currentTimeInSeconds, stepTimeInSeconds, fmi2_true);
 
     if (fmistatus != fmi2_status_ok) {
-        gzerr << "gazebo_fmi: fmi2_import_do_step failed." << std::endl;
+        logFromCallback(LogLevel::error, "gazebo_fmi", "fmi2_import_do_step failed.");
         return false;
     }
 
@@ -236,12 +374,26 @@ bool FMUCoSimulation::doStep(const double currentTimeInSeconds, const double ste
 
 bool FMUCoSimulation::getInputVariableRefs(const std::vector< std::string >& inputVariableNames,
                                            std::vector< fmi2_value_reference_t >& inputVariableReferences)
+{
+    return getInputVariableRefs(inputVariableNames, std::vector<bool>(inputVariableNames.size(), false), inputVariableReferences);
+}
+
+bool FMUCoSimulation::getInputVariableRefs(const std::vector< std::string >& inputVariableNames,
+                                           const std::vector< bool >& optionalInputs,
+                                           std::vector< fmi2_value_reference_t >& inputVariableReferences)
 {
    inputVariableReferences.resize(inputVariableNames.size());
+   m_pimpl->boundReferences.reserve(inputVariableNames.size());
+   m_pimpl->boundValues.reserve(inputVariableNames.size());
 
    for(size_t i=0; i < inputVariableNames.size(); i++)
    {
        fmi2_import_variable_t* var = fmi2_import_get_variable_by_name(m_pimpl->fmuHandle, inputVariableNames[i].c_str());
+       if (!var && i < optionalInputs.size() && optionalInputs[i]) {
+           gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " has no input " << inputVariableNames[i] << ", it is not set." << std::endl;
+           inputVariableReferences[i] = FMUUnboundVariableReference;
+           continue;
+       }
        if (!var) {
            gzerr << "gazebo_fmi: impossible to find variable of name \"" << inputVariableNames[i] << "\" in FMU." << std::endl;
            return false;
@@ -284,16 +436,362 @@ bool FMUCoSimulation::getOutputVariableRefs(const std::vector< std::string >& ou
    return true;
 }
 
+bool FMUCoSimulation::isStateless(const std::vector< fmi2_value_reference_t >& inputVariableReferences,
+                                  const std::vector< fmi2_value_reference_t >& outputVariableReferences)
+{
+    if (!isLoaded())
+    {
+        return false;
+    }
+
+    fmi2_import_t* fmu = m_pimpl->fmuHandle;
+    if (fmi2_import_get_number_of_continuous_states(fmu) != 0 || fmi2_import_get_number_of_event_indicators(fmu) != 0)
+    {
+        gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " is not stateless, it has continuous states or event indicators." << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<fmi2_import_variable_list_t, void(*)(fmi2_import_variable_list_t*)>
+        discreteStates(fmi2_import_get_discrete_states_list(fmu), fmi2_import_free_variable_list);
+    if (discreteStates && fmi2_import_get_variable_list_size(discreteStates.get()) != 0)
+    {
+        gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " is not stateless, it has discrete states." << std::endl;
+        return false;
+    }
+
+    // The dependencies are 1-based indices of the variables in the order of ModelVariables
+    std::unique_ptr<fmi2_import_variable_list_t, void(*)(fmi2_import_variable_list_t*)>
+        outputs(fmi2_import_get_outputs_list(fmu), fmi2_import_free_variable_list);
+    std::unique_ptr<fmi2_import_variable_list_t, void(*)(fmi2_import_variable_list_t*)>
+        variables(fmi2_import_get_variable_list(fmu, 0), fmi2_import_free_variable_list);
+    size_t* startIndex = nullptr;
+    size_t* dependency = nullptr;
+    char* factorKind = nullptr;
+    fmi2_import_get_outputs_dependencies(fmu, &startIndex, &dependency, &factorKind);
+    if (!outputs || !variables || !startIndex)
+    {
+        gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " does not declare the dependencies of its outputs in ModelStructure." << std::endl;
+        return false;
+    }
+
+    const size_t nrOfVariables = fmi2_import_get_variable_list_size(variables.get());
+    for (size_t i=0; i < fmi2_import_get_variable_list_size(outputs.get()); i++)
+    {
+        fmi2_import_variable_t* output = fmi2_import_get_variable(outputs.get(), i);
+        const fmi2_value_reference_t outputReference = fmi2_import_get_variable_vr(output);
+        if (std::find(outputVariableReferences.begin(), outputVariableReferences.end(), outputReference) == outputVariableReferences.end())
+        {
+            continue;
+        }
+
+        for (size_t d=startIndex[i]; d < startIndex[i+1]; d++)
+        {
+            // An index of 0 means that the output depends on all the knowns
+            const size_t index = dependency[d];
+            fmi2_import_variable_t* known = (index > 0 && index <= nrOfVariables) ?
+                fmi2_import_get_variable(variables.get(), index-1) : nullptr;
+            if (!known || fmi2_import_get_causality(known) != fmi2_causality_enu_input ||
+                std::find(inputVariableReferences.begin(), inputVariableReferences.end(),
+                          fmi2_import_get_variable_vr(known)) == inputVariableReferences.end())
+            {
+                gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " is not stateless, its output "
+                      << fmi2_import_get_variable_name(output) << " depends on variables that are not inputs." << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FMUCoSimulation::getRealVariables(std::vector< std::string >& variableNames,
+                                       std::vector< fmi2_value_reference_t >& variableReferences)
+{
+    variableNames.clear();
+    variableReferences.clear();
+    if (!isLoaded())
+    {
+        return false;
+    }
+
+    std::unique_ptr<fmi2_import_variable_list_t, void(*)(fmi2_import_variable_list_t*)>
+        variables(fmi2_import_get_variable_list(m_pimpl->fmuHandle, 0), fmi2_import_free_variable_list);
+    if (!variables)
+    {
+        return false;
+    }
+
+    for (size_t i=0; i < fmi2_import_get_variable_list_size(variables.get()); i++)
+    {
+        fmi2_import_variable_t* var = fmi2_import_get_variable(variables.get(), i);
+        const fmi2_causality_enu_t causality = fmi2_import_get_causality(var);
+        if (fmi2_import_get_variable_base_type(var) != fmi2_base_type_real ||
+            (causality != fmi2_causality_enu_input && causality != fmi2_causality_enu_output && causality != fmi2_causality_enu_local))
+        {
+            continue;
+        }
+        variableNames.push_back(fmi2_import_get_variable_name(var));
+        variableReferences.push_back(fmi2_import_get_variable_vr(var));
+    }
+    return true;
+}
+
+bool FMUCoSimulation::exposesAllState(const std::vector< fmi2_value_reference_t >& inputVariableReferences,
+                                      const std::vector< fmi2_value_reference_t >& outputVariableReferences)
+{
+    fmi2_import_t* fmu = m_pimpl->fmuHandle;
+    using VariableList = std::unique_ptr<fmi2_import_variable_list_t, void(*)(fmi2_import_variable_list_t*)>;
+    VariableList derivatives(fmi2_import_get_derivatives_list(fmu), fmi2_import_free_variable_list);
+    VariableList discreteStates(fmi2_import_get_discrete_states_list(fmu), fmi2_import_free_variable_list);
+    const size_t nrOfDerivatives = derivatives ? fmi2_import_get_variable_list_size(derivatives.get()) : 0;
+    const size_t nrOfDiscreteStates = discreteStates ? fmi2_import_get_variable_list_size(discreteStates.get()) : 0;
+
+    // The FMU declares its state if all the continuous states have a derivative in ModelStructure, and if the discrete
+    // states are declared when the FMU has events
+    if (nrOfDerivatives > 0 && nrOfDerivatives == fmi2_import_get_number_of_continuous_states(fmu) &&
+        (fmi2_import_get_number_of_event_indicators(fmu) == 0 || nrOfDiscreteStates > 0))
+    {
+        return true;
+    }
+
+    // A stateless FMU has no state to expose, but an output of an FMU without declared states that depends on no input is
+    // computed from a state that the FMU does not declare
+    if (!isStateless(inputVariableReferences, outputVariableReferences))
+    {
+        return false;
+    }
+
+    VariableList outputs(fmi2_import_get_outputs_list(fmu), fmi2_import_free_variable_list);
+    size_t* startIndex = nullptr;
+    size_t* dependency = nullptr;
+    char* factorKind = nullptr;
+    fmi2_import_get_outputs_dependencies(fmu, &startIndex, &dependency, &factorKind);
+    for (size_t i=0; outputs && startIndex && i < fmi2_import_get_variable_list_size(outputs.get()); i++)
+    {
+        const fmi2_value_reference_t outputReference = fmi2_import_get_variable_vr(fmi2_import_get_variable(outputs.get(), i));
+        if (startIndex[i] == startIndex[i+1] &&
+            std::find(outputVariableReferences.begin(), outputVariableReferences.end(), outputReference) != outputVariableReferences.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FMUCoSimulation::getUsedInputs(const std::vector< fmi2_value_reference_t >& inputVariableReferences,
+                                    const std::vector< fmi2_value_reference_t >& outputVariableReferences,
+                                    std::vector< bool >& usedInputs)
+{
+    usedInputs.assign(inputVariableReferences.size(), false);
+    if (!isLoaded())
+    {
+        return false;
+    }
+
+    fmi2_import_t* fmu = m_pimpl->fmuHandle;
+    using VariableList = std::unique_ptr<fmi2_import_variable_list_t, void(*)(fmi2_import_variable_list_t*)>;
+    VariableList variables(fmi2_import_get_variable_list(fmu, 0), fmi2_import_free_variable_list);
+    const size_t nrOfVariables = variables ? fmi2_import_get_variable_list_size(variables.get()) : 0;
+
+    // Mark the inputs in the dependencies of the unknowns for which isRelevant is true, return false if the
+    // dependencies are not declared or if an unknown depends on all the knowns
+    auto markDependencies = [&](fmi2_import_variable_list_t* unknowns, size_t* startIndex, size_t* dependency,
+                                const std::function<bool(fmi2_import_variable_t*)>& isRelevant)
+    {
+        const size_t nrOfUnknowns = unknowns ? fmi2_import_get_variable_list_size(unknowns) : 0;
+        if (nrOfUnknowns > 0 && !startIndex)
+        {
+            return false;
+        }
+
+        for (size_t i=0; i < nrOfUnknowns; i++)
+        {
+            if (!isRelevant(fmi2_import_get_variable(unknowns, i)))
+            {
+                continue;
+            }
+
+            for (size_t d=startIndex[i]; d < startIndex[i+1]; d++)
+            {
+                // The dependencies are 1-based indices of the variables in the order of ModelVariables,
+                // and an index of 0 means that the unknown depends on all the knowns
+                const size_t index = dependency[d];
+                if (index == 0 || index > nrOfVariables)
+                {
+                    return false;
+                }
+
+                const fmi2_value_reference_t known = fmi2_import_get_variable_vr(fmi2_import_get_variable(variables.get(), index-1));
+                for (size_t j=0; j < inputVariableReferences.size(); j++)
+                {
+                    usedInputs[j] = usedInputs[j] || inputVariableReferences[j] == known;
+                }
+            }
+        }
+        return true;
+    };
+
+    auto isRequestedOutput = [&outputVariableReferences](fmi2_import_variable_t* output)
+    {
+        return std::find(outputVariableReferences.begin(), outputVariableReferences.end(),
+                         fmi2_import_get_variable_vr(output)) != outputVariableReferences.end();
+    };
+    auto isState = [](fmi2_import_variable_t*) { return true; };
+
+    VariableList outputs(fmi2_import_get_outputs_list(fmu), fmi2_import_free_variable_list);
+    VariableList derivatives(fmi2_import_get_derivatives_list(fmu), fmi2_import_free_variable_list);
+    VariableList discreteStates(fmi2_import_get_discrete_states_list(fmu), fmi2_import_free_variable_list);
+
+    size_t* startIndex = nullptr;
+    size_t* dependency = nullptr;
+    char* factorKind = nullptr;
+    fmi2_import_get_outputs_dependencies(fmu, &startIndex, &dependency, &factorKind);
+    bool declared = variables && outputs && markDependencies(outputs.get(), startIndex, dependency, isRequestedOutput);
+
+    startIndex = nullptr;
+    fmi2_import_get_derivatives_dependencies(fmu, &startIndex, &dependency, &factorKind);
+    declared = declared && markDependencies(derivatives.get(), startIndex, dependency, isState);
+
+    startIndex = nullptr;
+    fmi2_import_get_discrete_states_dependencies(fmu, &startIndex, &dependency, &factorKind);
+    declared = declared && markDependencies(discreteStates.get(), startIndex, dependency, isState);
+
+    if (!declared)
+    {
+        gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " does not declare on which inputs its outputs and states depend "
+              << "in ModelStructure, all its inputs are set." << std::endl;
+        usedInputs.assign(inputVariableReferences.size(), true);
+    }
+    else if (!exposesAllState(inputVariableReferences, outputVariableReferences))
+    {
+        // The dependencies of the outputs and of the declared states are not enough to know which inputs affect the
+        // outputs through the state that the FMU does not declare, as the one of FirstOrderLag or FixedDelay
+        gzmsg << "gazebo_fmi: FMU " << m_pimpl->instanceName << " may have a state not declared in ModelStructure, "
+              << "all its inputs are set." << std::endl;
+        usedInputs.assign(inputVariableReferences.size(), true);
+    }
+
+    for (size_t j=0; j < inputVariableReferences.size(); j++)
+    {
+        usedInputs[j] = usedInputs[j] && inputVariableReferences[j] != FMUUnboundVariableReference;
+    }
+    return true;
+}
+
+bool FMUCoSimulation::providesDirectionalDerivatives()
+{
+    if (!isLoaded())
+    {
+        return false;
+    }
+
+    return fmi2_import_get_capability(m_pimpl->fmuHandle, fmi2_cs_providesDirectionalDerivatives) != 0;
+}
+
+bool FMUCoSimulation::canGetAndSetFMUState()
+{
+    if (!isLoaded())
+    {
+        return false;
+    }
+
+    return fmi2_import_get_capability(m_pimpl->fmuHandle, fmi2_cs_canGetAndSetFMUstate) != 0;
+}
+
+bool FMUCoSimulation::canHandleVariableStepSize()
+{
+    if (!isLoaded())
+    {
+        return false;
+    }
+
+    return fmi2_import_get_capability(m_pimpl->fmuHandle, fmi2_cs_canHandleVariableCommunicationStepSize) != 0;
+}
+
+bool FMUCoSimulation::getDirectionalDerivative(const std::vector< fmi2_value_reference_t >& outputVariableReferences,
+                                               const std::vector< fmi2_value_reference_t >& inputVariableReferences,
+                                               const std::vector< double >& seed,
+                                               std::vector< double >& derivative)
+{
+    if (seed.size() != inputVariableReferences.size() || derivative.size() != outputVariableReferences.size()) {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "FMUCoSimulation::getDirectionalDerivative argument size mismatch.");
+        return false;
+    }
+
+    // The outputs do not depend on the unbound inputs, so their seed is dropped
+    const bool compacted = m_pimpl->compactBoundInputs(inputVariableReferences, seed);
+    const std::vector< fmi2_value_reference_t >& references = compacted ? m_pimpl->boundReferences : inputVariableReferences;
+    const std::vector< double >& boundSeed = compacted ? m_pimpl->boundValues : seed;
+    if (references.empty()) {
+        std::fill(derivative.begin(), derivative.end(), 0.0);
+        return true;
+    }
+
+    fmi2_status_t fmistatus = fmi2_import_get_directional_derivative(m_pimpl->fmuHandle,
+                                                                     outputVariableReferences.data(), outputVariableReferences.size(),
+                                                                     references.data(), references.size(),
+                                                                     boundSeed.data(), derivative.data());
+
+    if (fmistatus != fmi2_status_ok) {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "fmi2_import_get_directional_derivative failed.");
+        return false;
+    }
+
+    return true;
+}
+
+bool FMUCoSimulation::saveState()
+{
+    if (!isLoaded()) {
+        return false;
+    }
+
+    // If savedState is not null, the FMU overwrites it instead of allocating a new state
+    fmi2_status_t fmistatus = fmi2_import_get_fmu_state(m_pimpl->fmuHandle, &m_pimpl->savedState);
+
+    if (fmistatus != fmi2_status_ok) {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "fmi2_import_get_fmu_state failed.");
+        return false;
+    }
+
+    return true;
+}
+
+bool FMUCoSimulation::restoreState()
+{
+    if (!isLoaded() || !m_pimpl->savedState) {
+        return false;
+    }
+
+    fmi2_status_t fmistatus = fmi2_import_set_fmu_state(m_pimpl->fmuHandle, m_pimpl->savedState);
+
+    if (fmistatus != fmi2_status_ok) {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "fmi2_import_set_fmu_state failed.");
+        return false;
+    }
+
+    return true;
+}
+
 bool FMUCoSimulation::getOutputVariables(const std::vector< fmi2_value_reference_t >& outputVariableReferences,
                                                std::vector< double >& outputVariables)
 {
-    outputVariables.resize(outputVariableReferences.size());
+    // The buffer is expected to be preallocated, so that the step does not allocate memory
+    if (outputVariables.size() != outputVariableReferences.size())
+    {
+        if (!checkRealTimeOperation(RealTimeViolation::allocation))
+        {
+            return false;
+        }
+        outputVariables.resize(outputVariableReferences.size());
+    }
 
+    ObservedFMUCall observed(FMUCall::getOutputVariables, m_pimpl->instanceName);
     fmi2_status_t fmistatus = fmi2_import_get_real(m_pimpl->fmuHandle, outputVariableReferences.data(),
                                                    outputVariables.size(), outputVariables.data());
 
     if (fmistatus != fmi2_status_ok) {
-        gzerr << "gazebo_fmi: fmi2_import_get_real failed." << std::endl;
+        logFromCallback(LogLevel::error, "gazebo_fmi", "fmi2_import_get_real failed.");
         return false;
     }
 
@@ -304,15 +802,23 @@ bool FMUCoSimulation::setInputVariables(const std::vector< fmi2_value_reference_
                                         const std::vector< double >& inputVariables)
 {
     if (inputVariableReferences.size() != inputVariables.size()) {
-         gzerr << "gazebo_fmi: FMUCoSimulation::setInputVariables argument size mismatch." << std::endl;
+        logFromCallback(LogLevel::error, "gazebo_fmi", "FMUCoSimulation::setInputVariables argument size mismatch.");
         return false;
     }
 
-    fmi2_status_t fmistatus = fmi2_import_set_real(m_pimpl->fmuHandle, inputVariableReferences.data(),
-                                                   inputVariables.size(), inputVariables.data());
+    const bool compacted = m_pimpl->compactBoundInputs(inputVariableReferences, inputVariables);
+    const std::vector< fmi2_value_reference_t >& references = compacted ? m_pimpl->boundReferences : inputVariableReferences;
+    const std::vector< double >& values = compacted ? m_pimpl->boundValues : inputVariables;
+    if (references.empty()) {
+        return true;
+    }
+
+    ObservedFMUCall observed(FMUCall::setInputVariables, m_pimpl->instanceName);
+    fmi2_status_t fmistatus = fmi2_import_set_real(m_pimpl->fmuHandle, references.data(),
+                                                   values.size(), values.data());
 
     if (fmistatus != fmi2_status_ok) {
-        gzerr << "gazebo_fmi: fmi2_import_set_real failed." << std::endl;
+        logFromCallback(LogLevel::error, "gazebo_fmi", "fmi2_import_set_real failed.");
         return false;
     }
 
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUOutputPrediction.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+#include <cmath>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+bool FMUOutputPredictor::isSupportedBy(FMUCoSimulation& fmu, const std::string& ownerName)
+{
+    if (!fmu.providesDirectionalDerivatives())
+    {
+        gzwarn << ownerName << ": the FMU does not provide directional derivatives, its outputs are not predicted." << std::endl;
+        return false;
+    }
+
+    if (!fmu.canHandleVariableStepSize())
+    {
+        gzwarn << ownerName << ": the FMU does not handle a variable step size, its outputs are not predicted." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool FMUOutputPredictor::configure(const FMUOutputPredictionOptions& options, const size_t nrOfInputs,
+                                   const size_t nrOfOutputs, const std::string& ownerName)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+    m_nrOfInputs = nrOfInputs;
+    m_nrOfOutputs = nrOfOutputs;
+
+    if (m_options.enabled && m_options.trustRegions.size() != nrOfInputs)
+    {
+        gzerr << ownerName << ": the output prediction has " << m_options.trustRegions.size()
+              << " trust regions, but the FMU has " << nrOfInputs << " inputs." << std::endl;
+        m_options.enabled = false;
+        return false;
+    }
+
+    m_hasModel = false;
+    m_checkpointInputs.assign(nrOfInputs, 0.0);
+    m_checkpointOutputs.assign(nrOfOutputs, 0.0);
+    m_jacobian.assign(nrOfOutputs*nrOfInputs, 0.0);
+    m_newJacobian.assign(nrOfOutputs*nrOfInputs, 0.0);
+    m_seed.assign(nrOfInputs, 0.0);
+    m_derivative.assign(nrOfOutputs, 0.0);
+    m_catchUpInputs.assign(nrOfInputs, 0.0);
+    m_skippedInputsSum.assign(nrOfInputs, 0.0);
+    m_nrOfSkippedSinceCheckpoint = 0;
+
+    m_nrOfSteps = 0;
+    m_nrOfSkippedSteps = 0;
+    m_nrOfRestoredCatchUps = 0;
+    m_nrOfMeasuredErrors = 0;
+    m_accumulatedError = 0.0;
+    m_maxError = 0.0;
+
+    return true;
+}
+
+void FMUOutputPredictor::setFMU(FMUCoSimulation& fmu, const double startTimeInSeconds)
+{
+    m_fmuTimeInSeconds = startTimeInSeconds;
+    m_canRestoreState = fmu.canGetAndSetFMUState();
+}
+
+bool FMUOutputPredictor::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+bool FMUOutputPredictor::canPredict(const std::vector<double>& inputs) const
+{
+    if (!m_options.enabled || !m_hasModel || inputs.size() != m_nrOfInputs ||
+        m_nrOfSkippedSinceCheckpoint >= m_options.maxSkippedSteps)
+    {
+        return false;
+    }
+
+    for (size_t i=0; i < m_nrOfInputs; i++)
+    {
+        // Written so that a NaN input is outside of the trust region
+        if (!(std::abs(inputs[i] - m_checkpointInputs[i]) <= m_options.trustRegions[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FMUOutputPredictor::predict(const std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    for (size_t o=0; o < m_nrOfOutputs; o++)
+    {
+        double output = m_checkpointOutputs[o];
+        const double* jacobianRow = m_jacobian.data() + o*m_nrOfInputs;
+        for (size_t i=0; i < m_nrOfInputs; i++)
+        {
+            output += jacobianRow[i]*(inputs[i] - m_checkpointInputs[i]);
+        }
+        outputs[o] = output;
+    }
+
+    for (size_t i=0; i < m_nrOfInputs; i++)
+    {
+        m_skippedInputsSum[i] += inputs[i];
+    }
+
+    m_nrOfSkippedSinceCheckpoint++;
+    m_nrOfSkippedSteps++;
+    m_nrOfSteps++;
+}
+
+void FMUOutputPredictor::setCheckpoint(const std::vector<double>& inputs, const std::vector<double>& outputs,
+                                       const std::vector<double>& jacobian)
+{
+    if (m_hasModel && m_nrOfSkippedSinceCheckpoint > 0)
+    {
+        double error = 0.0;
+        for (size_t o=0; o < m_nrOfOutputs; o++)
+        {
+            double predictedOutput = m_checkpointOutputs[o];
+            const double* jacobianRow = m_jacobian.data() + o*m_nrOfInputs;
+            for (size_t i=0; i < m_nrOfInputs; i++)
+            {
+                predictedOutput += jacobianRow[i]*(inputs[i] - m_checkpointInputs[i]);
+            }
+            error = std::max(error, std::abs(predictedOutput - outputs[o]));
+        }
+
+        m_accumulatedError += error;
+        m_maxError = std::max(m_maxError, error);
+        m_nrOfMeasuredErrors++;
+    }
+
+    std::copy(inputs.begin(), inputs.end(), m_checkpointInputs.begin());
+    std::copy(outputs.begin(), outputs.end(), m_checkpointOutputs.begin());
+    std::copy(jacobian.begin(), jacobian.end(), m_jacobian.begin());
+    std::fill(m_skippedInputsSum.begin(), m_skippedInputsSum.end(), 0.0);
+    m_nrOfSkippedSinceCheckpoint = 0;
+    m_hasModel = true;
+    m_nrOfSteps++;
+}
+
+bool FMUOutputPredictor::computeJacobian(FMUCoSimulation& fmu,
+                                         const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                                         const std::vector<fmi2_value_reference_t>& outputVariableReferences)
+{
+    for (size_t i=0; i < m_nrOfInputs; i++)
+    {
+        std::fill(m_seed.begin(), m_seed.end(), 0.0);
+        m_seed[i] = 1.0;
+
+        if (!fmu.getDirectionalDerivative(outputVariableReferences, inputVariableReferences, m_seed, m_derivative))
+        {
+            return false;
+        }
+
+        for (size_t o=0; o < m_nrOfOutputs; o++)
+        {
+            m_newJacobian[o*m_nrOfInputs + i] = m_derivative[o];
+        }
+    }
+
+    return true;
+}
+
+bool FMUOutputPredictor::catchUp(FMUCoSimulation& fmu,
+                                 const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                                 const double currentTimeInSeconds)
+{
+    const double skippedTimeInSeconds = currentTimeInSeconds - m_fmuTimeInSeconds;
+    if (m_nrOfSkippedSinceCheckpoint == 0 || !(skippedTimeInSeconds > 0.0))
+    {
+        return true;
+    }
+
+    for (size_t i=0; i < m_nrOfInputs; i++)
+    {
+        m_catchUpInputs[i] = m_skippedInputsSum[i]/m_nrOfSkippedSinceCheckpoint;
+    }
+
+    if (!fmu.setInputVariables(inputVariableReferences, m_catchUpInputs))
+    {
+        return false;
+    }
+
+    const bool stateSaved = m_canRestoreState && fmu.saveState();
+    if (fmu.doStep(m_fmuTimeInSeconds, skippedTimeInSeconds))
+    {
+        return true;
+    }
+
+    if (!stateSaved || !fmu.restoreState())
+    {
+        return false;
+    }
+
+    // The FMU rejected the long step, simulate the skipped steps one by one
+    m_nrOfRestoredCatchUps++;
+    const double stepSizeInSeconds = skippedTimeInSeconds/m_nrOfSkippedSinceCheckpoint;
+    for (size_t k=0; k < m_nrOfSkippedSinceCheckpoint; k++)
+    {
+        if (!fmu.doStep(m_fmuTimeInSeconds + k*stepSizeInSeconds, stepSizeInSeconds))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FMUOutputPredictor::step(FMUCoSimulation& fmu,
+                              const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                              const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                              const double currentTimeInSeconds, const double stepSizeInSeconds,
+                              const std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    if (outputs.size() != m_nrOfOutputs)
+    {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "%s: output prediction buffer size mismatch.", m_ownerName.c_str());
+        return false;
+    }
+
+    if (this->canPredict(inputs))
+    {
+        this->predict(inputs, outputs);
+        return true;
+    }
+
+    // Checkpoint: bring the FMU to the current time, simulate the step and update the linear model
+    bool ok = this->catchUp(fmu, inputVariableReferences, currentTimeInSeconds);
+    ok = ok && fmu.setInputVariables(inputVariableReferences, inputs);
+    ok = ok && fmu.doStep(currentTimeInSeconds, stepSizeInSeconds);
+    ok = ok && fmu.getOutputVariables(outputVariableReferences, outputs);
+    ok = ok && this->computeJacobian(fmu, inputVariableReferences, outputVariableReferences);
+    m_fmuTimeInSeconds = currentTimeInSeconds + stepSizeInSeconds;
+
+    if (!ok)
+    {
+        // Do not predict from a model that is not consistent with the FMU anymore
+        m_hasModel = false;
+        m_nrOfSkippedSinceCheckpoint = 0;
+        std::fill(m_skippedInputsSum.begin(), m_skippedInputsSum.end(), 0.0);
+        return false;
+    }
+
+    this->setCheckpoint(inputs, outputs, m_newJacobian);
+    return true;
+}
+
+size_t FMUOutputPredictor::getNrOfSteps() const
+{
+    return m_nrOfSteps;
+}
+
+size_t FMUOutputPredictor::getNrOfSkippedSteps() const
+{
+    return m_nrOfSkippedSteps;
+}
+
+double FMUOutputPredictor::getAccumulatedPredictionError() const
+{
+    return m_accumulatedError;
+}
+
+double FMUOutputPredictor::getMaxPredictionError() const
+{
+    return m_maxError;
+}
+
+void FMUOutputPredictor::printReport() const
+{
+    if (!m_options.enabled || m_nrOfSteps == 0)
+    {
+        return;
+    }
+
+    double meanError = m_nrOfMeasuredErrors > 0 ? m_accumulatedError/m_nrOfMeasuredErrors : 0.0;
+    gzmsg << m_ownerName << ": output prediction report, the FMU was skipped in " << m_nrOfSkippedSteps
+          << " of " << m_nrOfSteps << " steps (" << (100.0*m_nrOfSkippedSteps)/m_nrOfSteps << " %), prediction error "
+          << "accumulated " << m_accumulatedError << ", mean " << meanError << ", max " << m_maxError
+          << " over " << m_nrOfMeasuredErrors << " checkpoints." << std::endl;
+
+    if (m_nrOfRestoredCatchUps > 0)
+    {
+        gzmsg << m_ownerName << ":   the FMU rejected " << m_nrOfRestoredCatchUps
+              << " catch-up steps, that were simulated again step by step." << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,517 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMURecording.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+namespace
+{
+const char s_fileMagic[8] = {'G', 'Z', 'F', 'M', 'I', 'R', 'E', 'C'};
+const char s_chunkMagic[8] = {'G', 'Z', 'F', 'M', 'I', 'C', 'H', 'K'};
+const uint32_t s_fileVersion = 1;
+const size_t s_alignment = 8;
+}
+
+//////////////////////////////////////////////////
+FMURecordingWriter::FMURecordingWriter()
+{
+}
+
+FMURecordingWriter::~FMURecordingWriter()
+{
+    this->close();
+}
+
+bool FMURecordingWriter::open(const std::string& filePath,
+                              const std::vector<std::string>& channelNames,
+                              const size_t samplesPerChunk)
+{
+    if (isOpen())
+    {
+        gzerr << "gazebo_fmi: impossible to open recording " << filePath << " because a recording is already open." << std::endl;
+        return false;
+    }
+
+    if (samplesPerChunk == 0)
+    {
+        gzerr << "gazebo_fmi: the number of samples per chunk of a recording should be positive." << std::endl;
+        return false;
+    }
+
+    m_file = std::fopen(filePath.c_str(), "wb");
+    if (!m_file)
+    {
+        gzerr << "gazebo_fmi: impossible to create recording file " << filePath << std::endl;
+        return false;
+    }
+
+    // Serialize the channel names, padded to the alignment
+    std::vector<char> names;
+    for (const std::string& channelName : channelNames)
+    {
+        names.insert(names.end(), channelName.begin(), channelName.end());
+        names.push_back('\0');
+    }
+    names.resize(((names.size()+s_alignment-1)/s_alignment)*s_alignment, '\0');
+
+    uint32_t nrOfChannels = static_cast<uint32_t>(channelNames.size());
+    uint64_t headerSize = sizeof(s_fileMagic) + sizeof(s_fileVersion) + sizeof(nrOfChannels) + sizeof(headerSize) + names.size();
+
+    bool ok = std::fwrite(s_fileMagic, sizeof(s_fileMagic), 1, m_file) == 1;
+    ok = ok && std::fwrite(&s_fileVersion, sizeof(s_fileVersion), 1, m_file) == 1;
+    ok = ok && std::fwrite(&nrOfChannels, sizeof(nrOfChannels), 1, m_file) == 1;
+    ok = ok && std::fwrite(&headerSize, sizeof(headerSize), 1, m_file) == 1;
+    ok = ok && (names.empty() || std::fwrite(names.data(), names.size(), 1, m_file) == 1);
+    ok = ok && std::fflush(m_file) == 0;
+
+    if (!ok)
+    {
+        gzerr << "gazebo_fmi: impossible to write the header of recording file " << filePath << std::endl;
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    // Preallocate the chunk buffers
+    m_nrOfChannels = channelNames.size();
+    m_samplesPerChunk = samplesPerChunk;
+    for (ChunkBuffer& buffer : m_buffers)
+    {
+        buffer.data.assign((1+m_nrOfChannels)*m_samplesPerChunk, 0.0);
+        buffer.nrOfSamples = 0;
+    }
+    m_activeBuffer = 0;
+    m_droppingSample = false;
+    m_droppedSamples = 0;
+    m_recordedSamples = 0;
+    m_writerBusy = false;
+    m_pendingBuffer = false;
+    m_stop = false;
+
+    m_thread = std::thread(&FMURecordingWriter::run, this);
+
+    return true;
+}
+
+bool FMURecordingWriter::isOpen() const
+{
+    return m_file != nullptr;
+}
+
+void FMURecordingWriter::beginSample(const double timeInSeconds)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    ChunkBuffer& active = m_buffers[m_activeBuffer];
+    if (active.nrOfSamples == m_samplesPerChunk)
+    {
+        if (m_writerBusy.load(std::memory_order_acquire))
+        {
+            // The other buffer is still being written, drop the sample to keep the memory bounded
+            m_droppingSample = true;
+            return;
+        }
+
+        // Hand the full buffer to the background thread, and continue on the other one.
+        // The background thread holds the mutex only briefly, so waiting for it is a violation only if it is contended.
+        {
+            std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                if (!checkRealTimeOperation(RealTimeViolation::lock))
+                {
+                    m_droppingSample = true;
+                    return;
+                }
+                lock.lock();
+            }
+            m_writerBusy.store(true, std::memory_order_relaxed);
+            m_pendingIndex = m_activeBuffer;
+            m_pendingBuffer = true;
+        }
+        m_wakeUp.notify_one();
+
+        m_activeBuffer = 1-m_activeBuffer;
+        m_buffers[m_activeBuffer].nrOfSamples = 0;
+    }
+
+    m_droppingSample = false;
+    ChunkBuffer& buffer = m_buffers[m_activeBuffer];
+    buffer.data[buffer.nrOfSamples] = timeInSeconds;
+}
+
+void FMURecordingWriter::setChannels(const size_t firstChannel, const std::vector<double>& values)
+{
+    if (!isOpen() || m_droppingSample)
+    {
+        return;
+    }
+
+    ChunkBuffer& buffer = m_buffers[m_activeBuffer];
+    const size_t nrOfValues = std::min(values.size(), m_nrOfChannels-std::min(firstChannel, m_nrOfChannels));
+    for (size_t i=0; i < nrOfValues; i++)
+    {
+        buffer.data[(1+firstChannel+i)*m_samplesPerChunk+buffer.nrOfSamples] = values[i];
+    }
+}
+
+void FMURecordingWriter::setChannel(const size_t channel, const double value)
+{
+    if (!isOpen() || m_droppingSample || channel >= m_nrOfChannels)
+    {
+        return;
+    }
+
+    ChunkBuffer& buffer = m_buffers[m_activeBuffer];
+    buffer.data[(1+channel)*m_samplesPerChunk+buffer.nrOfSamples] = value;
+}
+
+void FMURecordingWriter::endSample()
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    if (m_droppingSample)
+    {
+        m_droppedSamples++;
+        return;
+    }
+
+    m_buffers[m_activeBuffer].nrOfSamples++;
+    m_recordedSamples++;
+}
+
+void FMURecordingWriter::close()
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    // Wait for the background thread to write the pending chunk
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+
+    // Write the last, partially filled, chunk
+    if (m_buffers[m_activeBuffer].nrOfSamples > 0)
+    {
+        this->writeChunk(m_buffers[m_activeBuffer]);
+    }
+
+    std::fclose(m_file);
+    m_file = nullptr;
+
+    if (m_droppedSamples > 0)
+    {
+        gzwarn << "gazebo_fmi: " << m_droppedSamples << " samples of " << m_recordedSamples+m_droppedSamples
+               << " were dropped from the recording because the disk was not fast enough." << std::endl;
+    }
+
+    for (ChunkBuffer& buffer : m_buffers)
+    {
+        buffer.data.clear();
+        buffer.data.shrink_to_fit();
+        buffer.nrOfSamples = 0;
+    }
+}
+
+void FMURecordingWriter::waitForPendingChunk()
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_chunkWritten.wait(lock, [this]
+    {
+        return !m_pendingBuffer && !m_writerBusy.load(std::memory_order_acquire);
+    });
+}
+
+uint64_t FMURecordingWriter::getDroppedSamples() const
+{
+    return m_droppedSamples;
+}
+
+void FMURecordingWriter::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wakeUp.wait(lock, [this] { return m_pendingBuffer || m_stop; });
+
+        if (m_pendingBuffer)
+        {
+            size_t pendingIndex = m_pendingIndex;
+            m_pendingBuffer = false;
+
+            lock.unlock();
+            this->writeChunk(m_buffers[pendingIndex]);
+            m_writerBusy.store(false, std::memory_order_release);
+            lock.lock();
+            m_chunkWritten.notify_all();
+            continue;
+        }
+
+        if (m_stop)
+        {
+            break;
+        }
+    }
+}
+
+bool FMURecordingWriter::writeChunk(const ChunkBuffer& buffer)
+{
+    uint64_t nrOfSamples = buffer.nrOfSamples;
+    bool ok = std::fwrite(s_chunkMagic, sizeof(s_chunkMagic), 1, m_file) == 1;
+    ok = ok && std::fwrite(&nrOfSamples, sizeof(nrOfSamples), 1, m_file) == 1;
+
+    // Time and channels columns
+    for (size_t column=0; column < 1+m_nrOfChannels && ok; column++)
+    {
+        ok = std::fwrite(buffer.data.data()+column*m_samplesPerChunk, sizeof(double), nrOfSamples, m_file) == nrOfSamples;
+    }
+    ok = ok && std::fflush(m_file) == 0;
+
+    if (!ok)
+    {
+        gzerr << "gazebo_fmi: error in writing a chunk of the FMU recording." << std::endl;
+    }
+
+    return ok;
+}
+
+//////////////////////////////////////////////////
+FMURecordingReader::~FMURecordingReader()
+{
+    this->close();
+}
+
+bool FMURecordingReader::open(const std::string& filePath)
+{
+    this->close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        gzerr << "gazebo_fmi: impossible to open recording file " << filePath << std::endl;
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        gzerr << "gazebo_fmi: impossible to read recording file " << filePath << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    m_mappedSize = static_cast<size_t>(fileStat.st_size);
+    m_mappedData = mmap(nullptr, m_mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (m_mappedData == MAP_FAILED)
+    {
+        gzerr << "gazebo_fmi: impossible to map recording file " << filePath << std::endl;
+        m_mappedData = nullptr;
+        m_mappedSize = 0;
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(m_mappedData);
+
+    // Parse the header
+    uint32_t version = 0;
+    uint32_t nrOfChannels = 0;
+    uint64_t headerSize = 0;
+    const size_t fixedHeaderSize = sizeof(s_fileMagic) + sizeof(version) + sizeof(nrOfChannels) + sizeof(headerSize);
+    if (m_mappedSize < fixedHeaderSize || std::memcmp(base, s_fileMagic, sizeof(s_fileMagic)) != 0)
+    {
+        gzerr << "gazebo_fmi: " << filePath << " is not a FMU recording file." << std::endl;
+        this->close();
+        return false;
+    }
+    std::memcpy(&version, base+8, sizeof(version));
+    std::memcpy(&nrOfChannels, base+12, sizeof(nrOfChannels));
+    std::memcpy(&headerSize, base+16, sizeof(headerSize));
+
+    if (version != s_fileVersion || headerSize > m_mappedSize || headerSize % s_alignment != 0)
+    {
+        gzerr << "gazebo_fmi: unsupported version or corrupted header in recording file " << filePath << std::endl;
+        this->close();
+        return false;
+    }
+
+    const char* name = base+fixedHeaderSize;
+    const char* headerEnd = base+headerSize;
+    while (m_channelNames.size() < nrOfChannels && name < headerEnd)
+    {
+        size_t nameLength = strnlen(name, headerEnd-name);
+        m_channelNames.push_back(std::string(name, nameLength));
+        name += nameLength+1;
+    }
+
+    if (m_channelNames.size() != nrOfChannels)
+    {
+        gzerr << "gazebo_fmi: corrupted channel names in recording file " << filePath << std::endl;
+        this->close();
+        return false;
+    }
+
+    // Index the chunks
+    size_t offset = headerSize;
+    const size_t chunkHeaderSize = sizeof(s_chunkMagic) + sizeof(uint64_t);
+    while (offset + chunkHeaderSize <= m_mappedSize)
+    {
+        if (std::memcmp(base+offset, s_chunkMagic, sizeof(s_chunkMagic)) != 0)
+        {
+            gzwarn << "gazebo_fmi: corrupted chunk in recording file " << filePath << ", ignoring the rest of the file." << std::endl;
+            break;
+        }
+
+        uint64_t nrOfSamples = 0;
+        std::memcpy(&nrOfSamples, base+offset+sizeof(s_chunkMagic), sizeof(nrOfSamples));
+        size_t chunkSize = chunkHeaderSize + sizeof(double)*nrOfSamples*(1+nrOfChannels);
+        if (offset + chunkSize > m_mappedSize)
+        {
+            gzwarn << "gazebo_fmi: truncated chunk in recording file " << filePath << ", ignoring it." << std::endl;
+            break;
+        }
+
+        Chunk chunk;
+        chunk.data = reinterpret_cast<const double*>(base+offset+chunkHeaderSize);
+        chunk.nrOfSamples = nrOfSamples;
+        chunk.firstSample = m_nrOfSamples;
+        if (nrOfSamples > 0)
+        {
+            m_chunks.push_back(chunk);
+        }
+        m_nrOfSamples += nrOfSamples;
+        offset += chunkSize;
+    }
+
+    return true;
+}
+
+void FMURecordingReader::close()
+{
+    if (m_mappedData)
+    {
+        munmap(m_mappedData, m_mappedSize);
+    }
+    m_mappedData = nullptr;
+    m_mappedSize = 0;
+    m_channelNames.clear();
+    m_chunks.clear();
+    m_nrOfSamples = 0;
+}
+
+const std::vector<std::string>& FMURecordingReader::getChannelNames() const
+{
+    return m_channelNames;
+}
+
+bool FMURecordingReader::getChannelIndex(const std::string& channelName, size_t& channelIndex) const
+{
+    auto it = std::find(m_channelNames.begin(), m_channelNames.end(), channelName);
+    if (it == m_channelNames.end())
+    {
+        return false;
+    }
+    channelIndex = it - m_channelNames.begin();
+    return true;
+}
+
+size_t FMURecordingReader::getNrOfSamples() const
+{
+    return m_nrOfSamples;
+}
+
+size_t FMURecordingReader::findChunk(const size_t sample) const
+{
+    auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), sample,
+                               [](const size_t s, const Chunk& chunk) { return s < chunk.firstSample; });
+    return (it - m_chunks.begin()) - 1;
+}
+
+double FMURecordingReader::getTime(const size_t sample) const
+{
+    const Chunk& chunk = m_chunks[findChunk(sample)];
+    return chunk.data[sample-chunk.firstSample];
+}
+
+double FMURecordingReader::getValue(const size_t sample, const size_t channel) const
+{
+    const Chunk& chunk = m_chunks[findChunk(sample)];
+    return chunk.data[(1+channel)*chunk.nrOfSamples + sample-chunk.firstSample];
+}
+
+bool FMURecordingReader::findSample(const double timeInSeconds, const double tolerance, size_t hint, size_t& sample) const
+{
+    const double threshold = timeInSeconds+tolerance;
+    if (m_nrOfSamples == 0 || getTime(0) > threshold)
+    {
+        return false;
+    }
+
+    // Fast path for sequential access: check the hint and the sample after it
+    for (size_t candidate=hint; candidate < std::min(hint+2, m_nrOfSamples); candidate++)
+    {
+        if (getTime(candidate) <= threshold &&
+            (candidate+1 == m_nrOfSamples || getTime(candidate+1) > threshold))
+        {
+            sample = candidate;
+            return true;
+        }
+    }
+
+    // Binary search of the last sample with time <= threshold
+    size_t low = 0;
+    size_t high = m_nrOfSamples;
+    while (high-low > 1)
+    {
+        size_t middle = low + (high-low)/2;
+        if (getTime(middle) <= threshold)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    sample = low;
+    return true;
+}
+
+}
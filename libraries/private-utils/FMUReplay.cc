@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUReplay.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <cmath>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+// The recorded time is the simulated time of the step in which the sample was recorded,
+// so it should match the replayed time up to the rounding of the time representation
+static const double s_timeToleranceInSeconds = 1e-9;
+
+bool FMUReplayer::open(const FMUReplayOptions& options, const std::string& ownerName)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+    m_fmus.clear();
+    m_sample = 0;
+    m_validSample = false;
+    m_reportedMissingSample = false;
+    m_reportedEndOfRecording = false;
+    m_divergentSamples = 0;
+    m_maxInputError = 0.0;
+
+    if (!m_reader.open(m_options.filePath))
+    {
+        gzerr << m_ownerName << ": impossible to open the replay recording " << m_options.filePath << std::endl;
+        return false;
+    }
+
+    m_reportedDivergence.assign(m_reader.getChannelNames().size(), false);
+
+    if (m_reader.getNrOfSamples() == 0)
+    {
+        gzwarn << m_ownerName << ": the replay recording " << m_options.filePath << " contains no samples." << std::endl;
+    }
+
+    return true;
+}
+
+bool FMUReplayer::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+bool FMUReplayer::getChannels(const std::vector<std::string>& channelNames, std::vector<size_t>& channels)
+{
+    channels.resize(channelNames.size());
+    for (size_t i=0; i < channelNames.size(); i++)
+    {
+        if (!m_reader.getChannelIndex(channelNames[i], channels[i]))
+        {
+            gzerr << m_ownerName << ": channel " << channelNames[i] << " not found in the replay recording "
+                  << m_options.filePath << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FMUReplayer::addFMU(const std::vector<std::string>& inputChannelNames,
+                         const std::vector<std::string>& outputChannelNames)
+{
+    ReplayedFMU fmu;
+
+    // The input channels are needed only to check the inputs
+    if (m_options.checkInputs && !getChannels(inputChannelNames, fmu.inputChannels))
+    {
+        return false;
+    }
+
+    if (!getChannels(outputChannelNames, fmu.outputChannels))
+    {
+        return false;
+    }
+
+    m_fmus.push_back(fmu);
+    return true;
+}
+
+bool FMUReplayer::seek(const double timeInSeconds)
+{
+    m_validSample = m_reader.findSample(timeInSeconds, s_timeToleranceInSeconds, m_sample, m_sample);
+
+    if (!m_validSample)
+    {
+        if (!m_reportedMissingSample)
+        {
+            logFromCallback(LogLevel::warning, m_ownerName.c_str(),
+                            "no sample in the replay recording for time %g, the outputs are not updated until the recording starts.",
+                            timeInSeconds);
+            m_reportedMissingSample = true;
+        }
+        return false;
+    }
+
+    if (m_sample+1 == m_reader.getNrOfSamples() &&
+        m_reader.getTime(m_sample)+s_timeToleranceInSeconds < timeInSeconds &&
+        !m_reportedEndOfRecording)
+    {
+        logFromCallback(LogLevel::warning, m_ownerName.c_str(),
+                        "the replay recording ended at time %g, the last recorded outputs are held constant.",
+                        m_reader.getTime(m_sample));
+        m_reportedEndOfRecording = true;
+    }
+
+    return true;
+}
+
+void FMUReplayer::getOutputs(const size_t fmuIndex, std::vector<double>& outputs) const
+{
+    if (!m_validSample)
+    {
+        return;
+    }
+
+    const std::vector<size_t>& outputChannels = m_fmus[fmuIndex].outputChannels;
+    for (size_t i=0; i < outputChannels.size() && i < outputs.size(); i++)
+    {
+        outputs[i] = m_reader.getValue(m_sample, outputChannels[i]);
+    }
+}
+
+bool FMUReplayer::checkInputs(const size_t fmuIndex, const std::vector<double>& inputs)
+{
+    if (!m_options.checkInputs || !m_validSample)
+    {
+        return true;
+    }
+
+    bool withinTolerance = true;
+    const std::vector<size_t>& inputChannels = m_fmus[fmuIndex].inputChannels;
+    for (size_t i=0; i < inputChannels.size() && i < inputs.size(); i++)
+    {
+        const double recordedInput = m_reader.getValue(m_sample, inputChannels[i]);
+        const double error = std::abs(inputs[i]-recordedInput);
+        if (error > m_maxInputError)
+        {
+            m_maxInputError = error;
+        }
+
+        if (!(error <= m_options.inputTolerance))
+        {
+            withinTolerance = false;
+
+            // Report only the first divergence of each channel, the following ones are counted
+            if (!m_reportedDivergence[inputChannels[i]])
+            {
+                logFromCallback(LogLevel::warning, m_ownerName.c_str(),
+                                "input %s diverged from the replay recording at time %g (live %g, recorded %g).",
+                                m_reader.getChannelNames()[inputChannels[i]].c_str(), m_reader.getTime(m_sample),
+                                inputs[i], recordedInput);
+                m_reportedDivergence[inputChannels[i]] = true;
+            }
+        }
+    }
+
+    if (!withinTolerance)
+    {
+        m_divergentSamples++;
+    }
+
+    return withinTolerance;
+}
+
+uint64_t FMUReplayer::getNrOfDivergentSamples() const
+{
+    return m_divergentSamples;
+}
+
+void FMUReplayer::printReport() const
+{
+    if (!m_options.enabled || !m_options.checkInputs)
+    {
+        return;
+    }
+
+    if (m_divergentSamples == 0)
+    {
+        gzmsg << m_ownerName << ": replayed inputs matched the recording (max error " << m_maxInputError << ")." << std::endl;
+    }
+    else
+    {
+        gzwarn << m_ownerName << ": replayed inputs diverged from the recording in " << m_divergentSamples
+               << " samples (max error " << m_maxInputError << ")." << std::endl;
+    }
+}
+
+}
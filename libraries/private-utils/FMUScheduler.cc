@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUScheduler.hh>
+
+#include <algorithm>
+#include <chrono>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+namespace
+{
+// Weight of the last step in the moving average of the cost of a task
+const double s_costSmoothing = 0.1;
+}
+
+//////////////////////////////////////////////////
+void FMUTaskPartition::resize(const size_t nrOfTasks, const size_t nrOfBins)
+{
+    m_order.resize(nrOfTasks);
+    m_taskBins.resize(nrOfTasks);
+    m_binTasks.resize(nrOfTasks);
+    m_binOffsets.assign(nrOfBins+1, 0);
+    m_binSizes.assign(nrOfBins, 0);
+    m_binCosts.assign(nrOfBins, 0.0);
+
+    for (size_t task=0; task < nrOfTasks; task++)
+    {
+        m_order[task] = task;
+        m_taskBins[task] = task % nrOfBins;
+        m_binSizes[task % nrOfBins]++;
+    }
+
+    for (size_t bin=0; bin < nrOfBins; bin++)
+    {
+        m_binOffsets[bin+1] = m_binOffsets[bin] + m_binSizes[bin];
+    }
+    for (size_t bin=0; bin < nrOfBins; bin++)
+    {
+        m_binSizes[bin] = 0;
+    }
+    for (size_t task=0; task < nrOfTasks; task++)
+    {
+        const size_t bin = m_taskBins[task];
+        m_binTasks[m_binOffsets[bin] + m_binSizes[bin]++] = task;
+    }
+}
+
+void FMUTaskPartition::compute(const double* costs)
+{
+    const size_t nrOfTasks = m_order.size();
+    const size_t nrOfBins = m_binCosts.size();
+
+    // Longest processing time first, ties broken by index so that the partition is deterministic
+    for (size_t task=0; task < nrOfTasks; task++)
+    {
+        m_order[task] = task;
+    }
+    std::sort(m_order.begin(), m_order.end(), [costs](size_t a, size_t b)
+    {
+        return costs[a] > costs[b] || (costs[a] == costs[b] && a < b);
+    });
+
+    std::fill(m_binSizes.begin(), m_binSizes.end(), 0);
+    std::fill(m_binCosts.begin(), m_binCosts.end(), 0.0);
+    for (size_t task : m_order)
+    {
+        size_t lightestBin = 0;
+        for (size_t bin=1; bin < nrOfBins; bin++)
+        {
+            if (m_binCosts[bin] < m_binCosts[lightestBin] ||
+                (m_binCosts[bin] == m_binCosts[lightestBin] && m_binSizes[bin] < m_binSizes[lightestBin]))
+            {
+                lightestBin = bin;
+            }
+        }
+        m_taskBins[task] = lightestBin;
+        m_binCosts[lightestBin] += costs[task];
+        m_binSizes[lightestBin]++;
+    }
+
+    // Group the tasks by bin, keeping the order of decreasing cost
+    m_binOffsets[0] = 0;
+    for (size_t bin=0; bin < nrOfBins; bin++)
+    {
+        m_binOffsets[bin+1] = m_binOffsets[bin] + m_binSizes[bin];
+        m_binSizes[bin] = 0;
+    }
+    for (size_t task : m_order)
+    {
+        const size_t bin = m_taskBins[task];
+        m_binTasks[m_binOffsets[bin] + m_binSizes[bin]++] = task;
+    }
+}
+
+size_t FMUTaskPartition::getNrOfTasks() const
+{
+    return m_order.size();
+}
+
+size_t FMUTaskPartition::getNrOfBins() const
+{
+    return m_binCosts.size();
+}
+
+size_t FMUTaskPartition::getBinBegin(const size_t bin) const
+{
+    return m_binOffsets[bin];
+}
+
+size_t FMUTaskPartition::getBinEnd(const size_t bin) const
+{
+    return m_binOffsets[bin+1];
+}
+
+const std::vector<size_t>& FMUTaskPartition::getBinTasks() const
+{
+    return m_binTasks;
+}
+
+double FMUTaskPartition::getBinCost(const size_t bin) const
+{
+    return m_binCosts[bin];
+}
+
+//////////////////////////////////////////////////
+FMUScheduler::FMUScheduler()
+{
+    m_runBinTask = [this](size_t bin) { this->runBin(bin); };
+}
+
+FMUScheduler::~FMUScheduler()
+{
+}
+
+std::shared_ptr<FMUScheduler> FMUScheduler::getInstance()
+{
+    static std::mutex instanceMutex;
+    static std::weak_ptr<FMUScheduler> instance;
+
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    std::shared_ptr<FMUScheduler> scheduler = instance.lock();
+    if (!scheduler)
+    {
+        scheduler.reset(new FMUScheduler());
+        instance = scheduler;
+    }
+    return scheduler;
+}
+
+bool FMUScheduler::configure(const FMUSchedulerOptions& options, const std::string& ownerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_enabled)
+    {
+        gzerr << ownerName << ": the FMU scheduler is already configured by " << m_ownerName
+              << ", only one scheduler plugin can be loaded." << std::endl;
+        return false;
+    }
+
+    if (options.nrOfThreads == 0)
+    {
+        gzerr << ownerName << ": the number of threads of the FMU scheduler should be at least one." << std::endl;
+        return false;
+    }
+
+    if (!m_workerPool.configure(options.nrOfThreads, m_realTimeMonitor, ownerName))
+    {
+        return false;
+    }
+
+    m_options = options;
+    m_ownerName = ownerName;
+    m_enabled = true;
+    m_partitionValid = false;
+    this->rebuildTasks();
+    return true;
+}
+
+void FMUScheduler::disable()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_enabled = false;
+    m_clients.clear();
+    this->rebuildTasks();
+}
+
+bool FMUScheduler::isEnabled() const
+{
+    return m_enabled;
+}
+
+uint64_t FMUScheduler::addClient(const FMUSchedulerClient& client)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    RegisteredClient registered;
+    registered.id = m_nextClientId++;
+    registered.client = client;
+    m_clients.push_back(registered);
+    this->rebuildTasks();
+
+    gzmsg << m_ownerName << ": " << client.name << " registered " << client.nrOfTasks << " FMUs." << std::endl;
+    return registered.id;
+}
+
+void FMUScheduler::removeClient(const uint64_t clientId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                   [clientId](const RegisteredClient& registered) { return registered.id == clientId; }),
+                    m_clients.end());
+    this->rebuildTasks();
+}
+
+void FMUScheduler::rebuildTasks()
+{
+    std::vector<Task> tasks;
+    std::vector<double> costs;
+    for (size_t client=0; client < m_clients.size(); client++)
+    {
+        for (size_t index=0; index < m_clients[client].client.nrOfTasks; index++)
+        {
+            Task task;
+            task.clientId = m_clients[client].id;
+            task.client = client;
+            task.index = index;
+            tasks.push_back(task);
+            costs.push_back(-1.0);
+        }
+    }
+
+    // The measured costs of the tasks of the remaining clients are kept, both lists are sorted by client id and index
+    size_t previousTask = 0;
+    for (size_t task=0; task < tasks.size(); task++)
+    {
+        while (previousTask < m_tasks.size() &&
+               (m_tasks[previousTask].clientId < tasks[task].clientId ||
+                (m_tasks[previousTask].clientId == tasks[task].clientId && m_tasks[previousTask].index < tasks[task].index)))
+        {
+            previousTask++;
+        }
+
+        if (previousTask < m_tasks.size() && m_tasks[previousTask].clientId == tasks[task].clientId &&
+            m_tasks[previousTask].index == tasks[task].index)
+        {
+            costs[task] = m_taskCosts[previousTask];
+        }
+    }
+
+    m_tasks.swap(tasks);
+    m_taskCosts.swap(costs);
+    m_partitionCosts.resize(m_tasks.size());
+
+    // The step phase is timed as a whole, as the FMUs of all the clients run concurrently
+    std::vector<std::string> taskNames;
+    for (const Task& task : m_tasks)
+    {
+        const FMUSchedulerClient& client = m_clients[task.client].client;
+        taskNames.push_back(client.name + "/" + (task.index < client.taskNames.size() ? client.taskNames[task.index]
+                                                                                       : std::to_string(task.index)));
+    }
+    m_budgetMonitor.configure(m_options.budget, m_ownerName, taskNames);
+    m_budgetMonitor.setConcurrentFMUs(true);
+
+    const size_t nrOfBins = std::max<size_t>(1, std::min(m_options.nrOfThreads, m_tasks.size()));
+    m_partition.resize(m_tasks.size(), nrOfBins);
+    m_partitionValid = false;
+}
+
+void FMUScheduler::updatePartition()
+{
+    // The tasks that were never measured are assumed to cost as the average of the others
+    double knownCost = 0.0;
+    size_t nrOfKnownCosts = 0;
+    for (double cost : m_taskCosts)
+    {
+        if (cost >= 0.0)
+        {
+            knownCost += cost;
+            nrOfKnownCosts++;
+        }
+    }
+    const double defaultCost = nrOfKnownCosts > 0 ? knownCost/nrOfKnownCosts : 1.0;
+
+    for (size_t task=0; task < m_taskCosts.size(); task++)
+    {
+        m_partitionCosts[task] = m_taskCosts[task] >= 0.0 ? m_taskCosts[task] : defaultCost;
+    }
+
+    m_partition.compute(m_partitionCosts.data());
+    m_partitionValid = true;
+}
+
+size_t FMUScheduler::getNrOfTasks()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+void FMUScheduler::runBin(const size_t bin)
+{
+    const std::vector<size_t>& binTasks = m_partition.getBinTasks();
+    for (size_t k=m_partition.getBinBegin(bin); k < m_partition.getBinEnd(bin); k++)
+    {
+        const size_t taskIndex = binTasks[k];
+        const Task& task = m_tasks[taskIndex];
+
+        m_budgetMonitor.beginFMU(taskIndex);
+        const auto start = std::chrono::steady_clock::now();
+        m_clients[task.client].client.step(task.index);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        m_budgetMonitor.endFMU(taskIndex);
+
+        // Each task is run by a single thread, so its cost can be updated without synchronization
+        double& cost = m_taskCosts[taskIndex];
+        cost = cost < 0.0 ? elapsed : cost + s_costSmoothing*(elapsed - cost);
+    }
+}
+
+void FMUScheduler::runCycle(const double simulatedTimeInSeconds, const double stepSizeInSeconds)
+{
+    // The clients are added and removed in the physics thread as well, so the lock is never contended
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    for (RegisteredClient& registered : m_clients)
+    {
+        registered.client.gather(simulatedTimeInSeconds, stepSizeInSeconds);
+    }
+
+    if (!m_partitionValid || (m_options.rebalancePeriod > 0 && m_cycles % m_options.rebalancePeriod == 0))
+    {
+        this->updatePartition();
+    }
+    m_cycles++;
+
+    if (!m_tasks.empty())
+    {
+        // Only the step phase is compared with the budget, the gather and scatter phases are the same of serial plugins
+        m_budgetMonitor.beginStep();
+        m_workerPool.run(m_partition.getNrOfBins(), m_runBinTask);
+        m_budgetMonitor.endStep(stepSizeInSeconds, simulatedTimeInSeconds);
+    }
+
+    for (RegisteredClient& registered : m_clients)
+    {
+        registered.client.scatter();
+    }
+}
+
+const RealTimeBudgetStatistics& FMUScheduler::getBudgetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budgetMonitor.getStatistics();
+}
+
+void FMUScheduler::printReport()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_budgetMonitor.printReport();
+
+    if (!m_enabled || m_tasks.empty() || !m_partitionValid)
+    {
+        return;
+    }
+
+    double maxCost = 0.0;
+    double totalCost = 0.0;
+    for (size_t bin=0; bin < m_partition.getNrOfBins(); bin++)
+    {
+        maxCost = std::max(maxCost, m_partition.getBinCost(bin));
+        totalCost += m_partition.getBinCost(bin);
+    }
+
+    gzmsg << m_ownerName << ": " << m_tasks.size() << " FMUs of " << m_clients.size() << " plugins stepped in "
+          << m_partition.getNrOfBins() << " threads, estimated step time of the most loaded thread " << maxCost*1e6
+          << " us, of an ideal partition " << totalCost/m_partition.getNrOfBins()*1e6 << " us." << std::endl;
+}
+
+}
@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUStrongCoupling.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+#include <cmath>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+bool parseCouplingAcceleration(const std::string& accelerationString, CouplingAcceleration& acceleration)
+{
+    if (accelerationString == "constant")
+    {
+        acceleration = CouplingAcceleration::constant;
+        return true;
+    }
+
+    if (accelerationString == "aitken")
+    {
+        acceleration = CouplingAcceleration::aitken;
+        return true;
+    }
+
+    if (accelerationString == "iqn-ils")
+    {
+        acceleration = CouplingAcceleration::iqnIls;
+        return true;
+    }
+
+    return false;
+}
+
+bool FMUStrongCoupling::isSupportedBy(FMUCoSimulation& fmu, const std::string& ownerName)
+{
+    if (!fmu.canGetAndSetFMUState())
+    {
+        gzwarn << ownerName << ": the FMU can not save and restore its state, it is not strongly coupled." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool FMUStrongCoupling::configure(const FMUStrongCouplingOptions& options, const size_t nrOfInputs,
+                                  const size_t nrOfOutputs, const std::string& ownerName)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+    m_nrOfInputs = nrOfInputs;
+    m_nrOfOutputs = nrOfOutputs;
+
+    if (m_options.enabled && m_options.maxIterations == 0)
+    {
+        gzerr << ownerName << ": the strong coupling needs at least one iteration." << std::endl;
+        m_options.enabled = false;
+        return false;
+    }
+
+    if (m_options.enabled && !(m_options.relaxation > 0.0 && m_options.relaxation <= 1.0))
+    {
+        gzerr << ownerName << ": the relaxation of the strong coupling is " << m_options.relaxation
+              << ", but it should be in (0, 1]." << std::endl;
+        m_options.enabled = false;
+        return false;
+    }
+
+    m_system.assign(nrOfInputs, 0.0);
+    m_residual.assign(nrOfInputs, 0.0);
+    m_previousSystem.assign(nrOfInputs, 0.0);
+    m_previousResidual.assign(nrOfInputs, 0.0);
+    m_previousOutputs.assign(nrOfOutputs, 0.0);
+    m_aitkenRelaxation = m_options.relaxation;
+
+    // The least-squares problem is over-determined only with less columns than inputs
+    m_maxNrOfColumns = std::min(nrOfInputs, m_options.maxIterations > 0 ? m_options.maxIterations - 1 : 0);
+    m_nrOfColumns = 0;
+    m_residualDifferences.assign(nrOfInputs*m_maxNrOfColumns, 0.0);
+    m_systemDifferences.assign(nrOfInputs*m_maxNrOfColumns, 0.0);
+    m_q.assign(nrOfInputs*m_maxNrOfColumns, 0.0);
+    m_r.assign(m_maxNrOfColumns*m_maxNrOfColumns, 0.0);
+    m_coefficients.assign(m_maxNrOfColumns, 0.0);
+    m_keptColumns.assign(m_maxNrOfColumns, 0);
+
+    m_nrOfSteps = 0;
+    m_nrOfIterations = 0;
+    m_maxIterationsInAStep = 0;
+    m_nrOfNotConvergedSteps = 0;
+    m_accumulatedResidual = 0.0;
+    m_maxResidual = 0.0;
+
+    return true;
+}
+
+bool FMUStrongCoupling::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+void FMUStrongCoupling::computeQuasiNewtonInputs(std::vector<double>& inputs)
+{
+    const size_t n = m_nrOfInputs;
+
+    // Add the newest differences as first columns, dropping the oldest ones
+    if (m_maxNrOfColumns > 0)
+    {
+        m_nrOfColumns = std::min(m_nrOfColumns + 1, m_maxNrOfColumns);
+        std::copy_backward(m_residualDifferences.begin(), m_residualDifferences.begin() + (m_nrOfColumns - 1)*n,
+                           m_residualDifferences.begin() + m_nrOfColumns*n);
+        std::copy_backward(m_systemDifferences.begin(), m_systemDifferences.begin() + (m_nrOfColumns - 1)*n,
+                           m_systemDifferences.begin() + m_nrOfColumns*n);
+        for (size_t i=0; i < n; i++)
+        {
+            m_residualDifferences[i] = m_residual[i] - m_previousResidual[i];
+            m_systemDifferences[i] = m_system[i] - m_previousSystem[i];
+        }
+    }
+
+    // QR decomposition of the residual differences with modified Gram-Schmidt,
+    // skipping the columns that are (numerically) linear combinations of the newer ones
+    size_t nrOfKeptColumns = 0;
+    for (size_t c=0; c < m_nrOfColumns; c++)
+    {
+        double* q = m_q.data() + nrOfKeptColumns*n;
+        const double* v = m_residualDifferences.data() + c*n;
+        double originalNorm = 0.0;
+        for (size_t i=0; i < n; i++)
+        {
+            q[i] = v[i];
+            originalNorm += v[i]*v[i];
+        }
+        originalNorm = std::sqrt(originalNorm);
+
+        for (size_t l=0; l < nrOfKeptColumns; l++)
+        {
+            const double* ql = m_q.data() + l*n;
+            double projection = 0.0;
+            for (size_t i=0; i < n; i++)
+            {
+                projection += ql[i]*q[i];
+            }
+            for (size_t i=0; i < n; i++)
+            {
+                q[i] -= projection*ql[i];
+            }
+            m_r[l*m_maxNrOfColumns + nrOfKeptColumns] = projection;
+        }
+
+        double norm = 0.0;
+        for (size_t i=0; i < n; i++)
+        {
+            norm += q[i]*q[i];
+        }
+        norm = std::sqrt(norm);
+
+        if (!(norm > 1e-10*originalNorm) || !(norm > 0.0))
+        {
+            continue;
+        }
+
+        for (size_t i=0; i < n; i++)
+        {
+            q[i] /= norm;
+        }
+        m_r[nrOfKeptColumns*m_maxNrOfColumns + nrOfKeptColumns] = norm;
+        m_keptColumns[nrOfKeptColumns] = c;
+        nrOfKeptColumns++;
+    }
+
+    // Solve R alpha = -Q^T r by back substitution
+    for (size_t l=nrOfKeptColumns; l-- > 0;)
+    {
+        const double* ql = m_q.data() + l*n;
+        double rhs = 0.0;
+        for (size_t i=0; i < n; i++)
+        {
+            rhs -= ql[i]*m_residual[i];
+        }
+        for (size_t j=l+1; j < nrOfKeptColumns; j++)
+        {
+            rhs -= m_r[l*m_maxNrOfColumns + j]*m_coefficients[j];
+        }
+        m_coefficients[l] = rhs/m_r[l*m_maxNrOfColumns + l];
+    }
+
+    // Next inputs: system response corrected with the inverse Jacobian model
+    std::copy(m_system.begin(), m_system.end(), inputs.begin());
+    for (size_t l=0; l < nrOfKeptColumns; l++)
+    {
+        const double* w = m_systemDifferences.data() + m_keptColumns[l]*n;
+        for (size_t i=0; i < n; i++)
+        {
+            inputs[i] += m_coefficients[l]*w[i];
+        }
+    }
+
+    // Without usable columns fall back to the relaxation of the first iteration
+    if (nrOfKeptColumns == 0)
+    {
+        for (size_t i=0; i < n; i++)
+        {
+            inputs[i] = m_system[i] - (1.0 - m_options.relaxation)*m_residual[i];
+        }
+    }
+}
+
+void FMUStrongCoupling::computeNextInputs(const size_t k, std::vector<double>& inputs)
+{
+    const size_t n = m_nrOfInputs;
+
+    if (k == 0 || m_options.acceleration == CouplingAcceleration::constant)
+    {
+        m_aitkenRelaxation = m_options.relaxation;
+        m_nrOfColumns = 0;
+        for (size_t i=0; i < n; i++)
+        {
+            inputs[i] += m_options.relaxation*m_residual[i];
+        }
+        return;
+    }
+
+    if (m_options.acceleration == CouplingAcceleration::aitken)
+    {
+        double numerator = 0.0;
+        double denominator = 0.0;
+        for (size_t i=0; i < n; i++)
+        {
+            const double residualDifference = m_residual[i] - m_previousResidual[i];
+            numerator += m_previousResidual[i]*residualDifference;
+            denominator += residualDifference*residualDifference;
+        }
+
+        if (denominator > 0.0)
+        {
+            const double relaxation = -m_aitkenRelaxation*numerator/denominator;
+            if (std::isfinite(relaxation))
+            {
+                m_aitkenRelaxation = relaxation;
+            }
+        }
+
+        for (size_t i=0; i < n; i++)
+        {
+            inputs[i] += m_aitkenRelaxation*m_residual[i];
+        }
+        return;
+    }
+
+    this->computeQuasiNewtonInputs(inputs);
+}
+
+template<typename Evaluate>
+bool FMUStrongCoupling::iterateImpl(Evaluate& evaluate, const CouplingPlantFunction& plant,
+                                    std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    if (inputs.size() != m_nrOfInputs || outputs.size() != m_nrOfOutputs)
+    {
+        logFromCallback(LogLevel::error, "gazebo_fmi", "%s: strong coupling buffer size mismatch.", m_ownerName.c_str());
+        return false;
+    }
+
+    bool converged = false;
+    double residual = 0.0;
+    size_t k = 0;
+    while (true)
+    {
+        if (!evaluate(inputs, outputs))
+        {
+            return false;
+        }
+        k++;
+
+        if (k > 1)
+        {
+            residual = 0.0;
+            for (size_t o=0; o < m_nrOfOutputs; o++)
+            {
+                residual = std::max(residual, std::abs(outputs[o] - m_previousOutputs[o]));
+            }
+            converged = residual <= m_options.tolerance;
+        }
+
+        if (converged || k >= m_options.maxIterations)
+        {
+            break;
+        }
+
+        std::copy(outputs.begin(), outputs.end(), m_previousOutputs.begin());
+        std::swap(m_system, m_previousSystem);
+        std::swap(m_residual, m_previousResidual);
+
+        plant(outputs, m_system);
+        for (size_t i=0; i < m_nrOfInputs; i++)
+        {
+            m_residual[i] = m_system[i] - inputs[i];
+        }
+
+        this->computeNextInputs(k - 1, inputs);
+    }
+
+    m_nrOfSteps++;
+    m_nrOfIterations += k;
+    m_maxIterationsInAStep = std::max(m_maxIterationsInAStep, k);
+    m_accumulatedResidual += residual;
+    m_maxResidual = std::max(m_maxResidual, residual);
+    if (!converged && m_options.maxIterations > 1)
+    {
+        m_nrOfNotConvergedSteps++;
+    }
+
+    return true;
+}
+
+bool FMUStrongCoupling::iterate(const CouplingEvaluateFunction& evaluate, const CouplingPlantFunction& plant,
+                                std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    return this->iterateImpl(evaluate, plant, inputs, outputs);
+}
+
+bool FMUStrongCoupling::step(FMUCoSimulation& fmu,
+                             const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                             const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                             const double currentTimeInSeconds, const double stepSizeInSeconds,
+                             const CouplingPlantFunction& plant,
+                             std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    if (!fmu.saveState())
+    {
+        return false;
+    }
+
+    bool firstEvaluation = true;
+    auto evaluate = [&](const std::vector<double>& iterationInputs, std::vector<double>& iterationOutputs)
+    {
+        // Each iteration simulates the same step, from the state saved before the first one
+        if (!firstEvaluation && !fmu.restoreState())
+        {
+            return false;
+        }
+        firstEvaluation = false;
+
+        return fmu.setInputVariables(inputVariableReferences, iterationInputs) &&
+               fmu.doStep(currentTimeInSeconds, stepSizeInSeconds) &&
+               fmu.getOutputVariables(outputVariableReferences, iterationOutputs);
+    };
+
+    return this->iterateImpl(evaluate, plant, inputs, outputs);
+}
+
+size_t FMUStrongCoupling::getNrOfSteps() const
+{
+    return m_nrOfSteps;
+}
+
+size_t FMUStrongCoupling::getNrOfIterations() const
+{
+    return m_nrOfIterations;
+}
+
+size_t FMUStrongCoupling::getNrOfNotConvergedSteps() const
+{
+    return m_nrOfNotConvergedSteps;
+}
+
+double FMUStrongCoupling::getMaxResidual() const
+{
+    return m_maxResidual;
+}
+
+void FMUStrongCoupling::printReport() const
+{
+    if (!m_options.enabled || m_nrOfSteps == 0)
+    {
+        return;
+    }
+
+    gzmsg << m_ownerName << ": strong coupling report, " << m_nrOfIterations << " iterations in " << m_nrOfSteps
+          << " steps (mean " << static_cast<double>(m_nrOfIterations)/m_nrOfSteps << ", max " << m_maxIterationsInAStep
+          << "), " << m_nrOfNotConvergedSteps << " steps did not converge, residual mean "
+          << m_accumulatedResidual/m_nrOfSteps << ", max " << m_maxResidual << "." << std::endl;
+}
+
+}
@@ -0,0 +1,507 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUSurrogate.hh>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <system_error>
+
+#include <experimental/filesystem>
+
+#include <unistd.h>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+static const char s_fileMagic[8] = {'G', 'Z', 'F', 'M', 'I', 'S', 'U', 'R'};
+static const uint32_t s_fileVersion = 1;
+
+// Tables with more values are refused, as sampling them would take too long anyway
+static const size_t s_maxNrOfValues = static_cast<size_t>(1) << 28;
+
+static const uint64_t s_fnvOffsetBasis = 14695981039346656037ULL;
+static const uint64_t s_fnvPrime = 1099511628211ULL;
+
+static inline uint64_t fnv1a(uint64_t hash, const unsigned char* data, const size_t size)
+{
+    for (size_t i=0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= s_fnvPrime;
+    }
+    return hash;
+}
+
+template<typename T>
+static inline uint64_t fnv1aValue(const uint64_t hash, const T& value)
+{
+    return fnv1a(hash, reinterpret_cast<const unsigned char*>(&value), sizeof(value));
+}
+
+static bool sameAxes(const std::vector<SurrogateGridAxis>& a, const std::vector<SurrogateGridAxis>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (size_t i=0; i < a.size(); i++)
+    {
+        if (a[i].min != b[i].min || a[i].max != b[i].max || a[i].points != b[i].points)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseSurrogateInterpolation(const std::string& interpolationString, SurrogateInterpolation& interpolation)
+{
+    if (interpolationString == "linear")
+    {
+        interpolation = SurrogateInterpolation::linear;
+        return true;
+    }
+    if (interpolationString == "cubic")
+    {
+        interpolation = SurrogateInterpolation::cubic;
+        return true;
+    }
+    return false;
+}
+
+std::string getDefaultSurrogateCacheDirectory()
+{
+    std::experimental::filesystem::path cacheDirectory;
+    const char* xdgCacheHome = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (xdgCacheHome && xdgCacheHome[0] != '\0')
+    {
+        cacheDirectory = xdgCacheHome;
+    }
+    else if (home && home[0] != '\0')
+    {
+        cacheDirectory = std::experimental::filesystem::path(home) / ".cache";
+    }
+    else
+    {
+        cacheDirectory = std::experimental::filesystem::temp_directory_path();
+    }
+    return (cacheDirectory / "gazebo-fmi" / "surrogates").string();
+}
+
+bool computeFileHash(const std::string& filePath, uint64_t& hash)
+{
+    std::unique_ptr<FILE, int(*)(FILE*)> file(std::fopen(filePath.c_str(), "rb"), std::fclose);
+    if (!file)
+    {
+        gzerr << "gazebo_fmi: impossible to open " << filePath << " to compute its hash." << std::endl;
+        return false;
+    }
+
+    hash = s_fnvOffsetBasis;
+    unsigned char buffer[65536];
+    size_t readBytes = 0;
+    while ((readBytes = std::fread(buffer, 1, sizeof(buffer), file.get())) > 0)
+    {
+        hash = fnv1a(hash, buffer, readBytes);
+    }
+
+    if (std::ferror(file.get()))
+    {
+        gzerr << "gazebo_fmi: error in reading " << filePath << " to compute its hash." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FMUSurrogateTable::configure(const std::vector<SurrogateGridAxis>& axes, const size_t nrOfOutputs,
+                                  const SurrogateInterpolation interpolation)
+{
+    m_axes = axes;
+    m_nrOfOutputs = nrOfOutputs;
+    m_interpolation = interpolation;
+    m_nrOfClampedEvaluations = 0;
+
+    m_strides.resize(axes.size());
+    size_t stride = nrOfOutputs;
+    for (size_t i=0; i < axes.size(); i++)
+    {
+        m_strides[i] = stride;
+        stride *= axes[i].points;
+    }
+
+    const size_t taps = m_interpolation == SurrogateInterpolation::linear ? 2 : 4;
+    m_tapOffsets.assign(axes.size()*taps, 0);
+    m_tapWeights.assign(axes.size()*taps, 0.0);
+    m_tapCounters.assign(axes.size(), 0);
+}
+
+bool FMUSurrogateTable::build(const std::vector<SurrogateGridAxis>& axes, const size_t nrOfOutputs,
+                              const SurrogateInterpolation interpolation, const SurrogateSampleFunction& sample)
+{
+    m_values.clear();
+
+    size_t nrOfNodes = 1;
+    for (const SurrogateGridAxis& axis : axes)
+    {
+        if (axis.points < 2 || !(axis.max > axis.min))
+        {
+            gzerr << "gazebo_fmi: each input of the surrogate table needs at least 2 points and max greater than min." << std::endl;
+            return false;
+        }
+        if (nrOfNodes > s_maxNrOfValues/axis.points)
+        {
+            gzerr << "gazebo_fmi: the surrogate table grid has too many nodes." << std::endl;
+            return false;
+        }
+        nrOfNodes *= axis.points;
+    }
+
+    if (nrOfOutputs == 0 || nrOfNodes > s_maxNrOfValues/nrOfOutputs)
+    {
+        gzerr << "gazebo_fmi: the surrogate table has no outputs or too many values." << std::endl;
+        return false;
+    }
+
+    configure(axes, nrOfOutputs, interpolation);
+
+    std::vector<double> values(nrOfNodes*nrOfOutputs);
+    std::vector<double> inputs(axes.size());
+    std::vector<double> outputs(nrOfOutputs);
+    std::vector<size_t> nodeIndices(axes.size(), 0);
+    for (size_t node=0; node < nrOfNodes; node++)
+    {
+        for (size_t i=0; i < axes.size(); i++)
+        {
+            const SurrogateGridAxis& axis = axes[i];
+            inputs[i] = nodeIndices[i] + 1 == axis.points ?
+                axis.max : axis.min + nodeIndices[i]*(axis.max - axis.min)/(axis.points - 1);
+        }
+
+        if (!sample(inputs, outputs) || outputs.size() != nrOfOutputs)
+        {
+            gzerr << "gazebo_fmi: failure in sampling the surrogate table at node " << node << "." << std::endl;
+            return false;
+        }
+        std::copy(outputs.begin(), outputs.end(), values.begin() + node*nrOfOutputs);
+
+        // The first input is the fastest varying index
+        for (size_t i=0; i < axes.size(); i++)
+        {
+            if (++nodeIndices[i] < axes[i].points)
+            {
+                break;
+            }
+            nodeIndices[i] = 0;
+        }
+    }
+
+    m_values.swap(values);
+    return true;
+}
+
+bool FMUSurrogateTable::save(const std::string& filePath, const uint64_t key) const
+{
+    if (!isValid())
+    {
+        return false;
+    }
+
+    // The table is written to a temporary file and renamed, so concurrent readers never see a partial table
+    const std::string temporaryFilePath = filePath + ".tmp" + std::to_string(getpid());
+    FILE* file = std::fopen(temporaryFilePath.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    const uint64_t nrOfInputs = m_axes.size();
+    const uint64_t nrOfOutputs = m_nrOfOutputs;
+    bool ok = std::fwrite(s_fileMagic, sizeof(s_fileMagic), 1, file) == 1;
+    ok = ok && std::fwrite(&s_fileVersion, sizeof(s_fileVersion), 1, file) == 1;
+    ok = ok && std::fwrite(&key, sizeof(key), 1, file) == 1;
+    ok = ok && std::fwrite(&nrOfInputs, sizeof(nrOfInputs), 1, file) == 1;
+    ok = ok && std::fwrite(&nrOfOutputs, sizeof(nrOfOutputs), 1, file) == 1;
+    for (const SurrogateGridAxis& axis : m_axes)
+    {
+        const uint64_t points = axis.points;
+        ok = ok && std::fwrite(&axis.min, sizeof(axis.min), 1, file) == 1;
+        ok = ok && std::fwrite(&axis.max, sizeof(axis.max), 1, file) == 1;
+        ok = ok && std::fwrite(&points, sizeof(points), 1, file) == 1;
+    }
+    ok = ok && std::fwrite(m_values.data(), sizeof(double), m_values.size(), file) == m_values.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+    ok = ok && std::rename(temporaryFilePath.c_str(), filePath.c_str()) == 0;
+    if (!ok)
+    {
+        std::remove(temporaryFilePath.c_str());
+    }
+    return ok;
+}
+
+bool FMUSurrogateTable::load(const std::string& filePath, const uint64_t key, const std::vector<SurrogateGridAxis>& axes,
+                             const size_t nrOfOutputs, const SurrogateInterpolation interpolation)
+{
+    m_values.clear();
+
+    std::unique_ptr<FILE, int(*)(FILE*)> file(std::fopen(filePath.c_str(), "rb"), std::fclose);
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[sizeof(s_fileMagic)];
+    uint32_t version = 0;
+    uint64_t fileKey = 0, nrOfInputs = 0, fileNrOfOutputs = 0;
+    bool ok = std::fread(magic, sizeof(magic), 1, file.get()) == 1;
+    ok = ok && std::memcmp(magic, s_fileMagic, sizeof(magic)) == 0;
+    ok = ok && std::fread(&version, sizeof(version), 1, file.get()) == 1 && version == s_fileVersion;
+    ok = ok && std::fread(&fileKey, sizeof(fileKey), 1, file.get()) == 1 && fileKey == key;
+    ok = ok && std::fread(&nrOfInputs, sizeof(nrOfInputs), 1, file.get()) == 1 && nrOfInputs == axes.size();
+    ok = ok && std::fread(&fileNrOfOutputs, sizeof(fileNrOfOutputs), 1, file.get()) == 1 && fileNrOfOutputs == nrOfOutputs;
+    if (!ok)
+    {
+        return false;
+    }
+
+    std::vector<SurrogateGridAxis> fileAxes(axes.size());
+    size_t nrOfValues = nrOfOutputs;
+    for (SurrogateGridAxis& axis : fileAxes)
+    {
+        uint64_t points = 0;
+        ok = ok && std::fread(&axis.min, sizeof(axis.min), 1, file.get()) == 1;
+        ok = ok && std::fread(&axis.max, sizeof(axis.max), 1, file.get()) == 1;
+        ok = ok && std::fread(&points, sizeof(points), 1, file.get()) == 1;
+        axis.points = static_cast<size_t>(points);
+        nrOfValues *= axis.points;
+    }
+    if (!ok || !sameAxes(fileAxes, axes))
+    {
+        return false;
+    }
+
+    std::vector<double> values(nrOfValues);
+    if (std::fread(values.data(), sizeof(double), values.size(), file.get()) != values.size())
+    {
+        return false;
+    }
+
+    configure(axes, nrOfOutputs, interpolation);
+    m_values.swap(values);
+    return true;
+}
+
+bool FMUSurrogateTable::isValid() const
+{
+    return !m_values.empty();
+}
+
+bool FMUSurrogateTable::evaluate(const std::vector<double>& inputs, std::vector<double>& outputs)
+{
+    if (!isValid() || inputs.size() != m_axes.size() || outputs.size() != m_nrOfOutputs)
+    {
+        return false;
+    }
+
+    const size_t taps = m_interpolation == SurrogateInterpolation::linear ? 2 : 4;
+    bool clamped = false;
+
+    // Offsets and weights of the nodes that contribute along each input
+    for (size_t i=0; i < m_axes.size(); i++)
+    {
+        const SurrogateGridAxis& axis = m_axes[i];
+        const double lastNode = static_cast<double>(axis.points - 1);
+        double u = (inputs[i] - axis.min)*lastNode/(axis.max - axis.min);
+        // The negated comparisons also clamp NaN inputs
+        if (!(u >= 0.0))
+        {
+            u = 0.0;
+            clamped = true;
+        }
+        else if (u > lastNode)
+        {
+            u = lastNode;
+            clamped = true;
+        }
+
+        const size_t node = std::min(static_cast<size_t>(u), axis.points - 2);
+        const double t = u - node;
+        size_t* offsets = m_tapOffsets.data() + i*taps;
+        double* weights = m_tapWeights.data() + i*taps;
+        if (m_interpolation == SurrogateInterpolation::linear)
+        {
+            offsets[0] = node*m_strides[i];
+            offsets[1] = (node + 1)*m_strides[i];
+            weights[0] = 1.0 - t;
+            weights[1] = t;
+        }
+        else
+        {
+            // Catmull-Rom spline, the nodes outside of the grid are replaced by the boundary ones
+            const double t2 = t*t;
+            const double t3 = t2*t;
+            offsets[0] = (node == 0 ? 0 : node - 1)*m_strides[i];
+            offsets[1] = node*m_strides[i];
+            offsets[2] = (node + 1)*m_strides[i];
+            offsets[3] = std::min(node + 2, axis.points - 1)*m_strides[i];
+            weights[0] = 0.5*(-t3 + 2.0*t2 - t);
+            weights[1] = 0.5*(3.0*t3 - 5.0*t2 + 2.0);
+            weights[2] = 0.5*(-3.0*t3 + 4.0*t2 + t);
+            weights[3] = 0.5*(t3 - t2);
+        }
+    }
+
+    if (clamped)
+    {
+        m_nrOfClampedEvaluations++;
+    }
+
+    // Accumulate the weighted outputs of all the combinations of taps
+    double* out = outputs.data();
+    const size_t nrOfOutputs = m_nrOfOutputs;
+    for (size_t o=0; o < nrOfOutputs; o++)
+    {
+        out[o] = 0.0;
+    }
+    std::fill(m_tapCounters.begin(), m_tapCounters.end(), 0);
+
+    bool done = false;
+    while (!done)
+    {
+        size_t offset = 0;
+        double weight = 1.0;
+        for (size_t i=0; i < m_axes.size(); i++)
+        {
+            offset += m_tapOffsets[i*taps + m_tapCounters[i]];
+            weight *= m_tapWeights[i*taps + m_tapCounters[i]];
+        }
+
+        const double* nodeValues = m_values.data() + offset;
+        for (size_t o=0; o < nrOfOutputs; o++)
+        {
+            out[o] += weight*nodeValues[o];
+        }
+
+        done = true;
+        for (size_t i=0; i < m_axes.size(); i++)
+        {
+            if (++m_tapCounters[i] < taps)
+            {
+                done = false;
+                break;
+            }
+            m_tapCounters[i] = 0;
+        }
+    }
+
+    return true;
+}
+
+size_t FMUSurrogateTable::getNrOfClampedEvaluations() const
+{
+    return m_nrOfClampedEvaluations;
+}
+
+size_t FMUSurrogateTable::getNrOfNodes() const
+{
+    return m_nrOfOutputs == 0 ? 0 : m_values.size()/m_nrOfOutputs;
+}
+
+bool loadOrBuildFMUSurrogate(FMUSurrogateTable& table,
+                             const FMUSurrogateOptions& options,
+                             const std::string& fmuAbsolutePath,
+                             FMUCoSimulation& fmu,
+                             const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                             const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                             const double startTimeInSeconds,
+                             const double stepSizeInSeconds,
+                             const std::string& ownerName)
+{
+    if (options.axes.size() != inputVariableReferences.size())
+    {
+        gzerr << ownerName << ": the surrogate grid has " << options.axes.size() << " inputs, while the FMU has "
+              << inputVariableReferences.size() << " inputs." << std::endl;
+        return false;
+    }
+
+    // The key depends on the FMU file, on the sampled variables and on the grid
+    uint64_t fmuHash = 0;
+    if (!computeFileHash(fmuAbsolutePath, fmuHash))
+    {
+        return false;
+    }
+
+    uint64_t key = fmuHash;
+    for (const fmi2_value_reference_t reference : inputVariableReferences)
+    {
+        key = fnv1aValue(key, reference);
+    }
+    for (const fmi2_value_reference_t reference : outputVariableReferences)
+    {
+        key = fnv1aValue(key, reference);
+    }
+    for (const SurrogateGridAxis& axis : options.axes)
+    {
+        const uint64_t points = axis.points;
+        key = fnv1aValue(key, axis.min);
+        key = fnv1aValue(key, axis.max);
+        key = fnv1aValue(key, points);
+    }
+
+    const std::string cacheDirectory = options.cacheDirectory.empty() ? getDefaultSurrogateCacheDirectory() : options.cacheDirectory;
+    char fileName[64];
+    std::snprintf(fileName, sizeof(fileName), "%016" PRIx64 "-%016" PRIx64 ".gzfmisur", fmuHash, key);
+    const std::string filePath = (std::experimental::filesystem::path(cacheDirectory) / fileName).string();
+
+    if (table.load(filePath, key, options.axes, outputVariableReferences.size(), options.interpolation))
+    {
+        gzmsg << ownerName << ": loaded the surrogate table of " << fmuAbsolutePath << " from " << filePath << std::endl;
+        return true;
+    }
+
+    double timeInSeconds = startTimeInSeconds;
+    SurrogateSampleFunction sampleFMU = [&](const std::vector<double>& inputs, std::vector<double>& outputs)
+    {
+        bool ok = fmu.setInputVariables(inputVariableReferences, inputs);
+        ok = ok && fmu.doStep(timeInSeconds, stepSizeInSeconds);
+        timeInSeconds += stepSizeInSeconds;
+        return ok && fmu.getOutputVariables(outputVariableReferences, outputs);
+    };
+
+    if (!table.build(options.axes, outputVariableReferences.size(), options.interpolation, sampleFMU))
+    {
+        gzerr << ownerName << ": failure in sampling the surrogate table of " << fmuAbsolutePath << std::endl;
+        return false;
+    }
+    gzmsg << ownerName << ": sampled the surrogate table of " << fmuAbsolutePath << " on "
+          << table.getNrOfNodes() << " nodes" << std::endl;
+
+    // A table that can not be cached is still usable
+    std::error_code error;
+    std::experimental::filesystem::create_directories(cacheDirectory, error);
+    if (error || !table.save(filePath, key))
+    {
+        gzwarn << ownerName << ": impossible to cache the surrogate table in " << filePath << std::endl;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,460 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMUVariableStreaming.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+namespace
+{
+// Maximum time the publishing thread waits for a sample, so that a missed notification only delays the publication
+const std::chrono::milliseconds s_publishingPeriod(10);
+
+bool isValidStreamName(const std::string& streamName)
+{
+    return !streamName.empty() && std::all_of(streamName.begin(), streamName.end(), [](char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    });
+}
+}
+
+//////////////////////////////////////////////////
+FMUVariableStreamer::FMUVariableStreamer()
+{
+}
+
+FMUVariableStreamer::~FMUVariableStreamer()
+{
+    this->close();
+}
+
+bool FMUVariableStreamer::configure(const FMUVariableStreamingOptions& options, const std::string& ownerName,
+                                    const FMUVariableStreamPublishFunction& publish)
+{
+    if (m_enabled)
+    {
+        gzerr << ownerName << ": the streaming of FMU variables is already configured." << std::endl;
+        return false;
+    }
+
+    if (options.maxVariablesPerStream == 0 || options.queueSize == 0)
+    {
+        gzerr << ownerName << ": the maximum number of variables of a stream and the queue size of the streaming should be positive." << std::endl;
+        return false;
+    }
+
+    m_options = options;
+    m_ownerName = ownerName;
+    m_publish = publish;
+
+    m_samples.assign(m_options.queueSize, Sample());
+    m_sampleValues.assign(m_options.queueSize*m_options.maxVariablesPerStream, 0.0);
+    m_queueHead = 0;
+    m_queueTail = 0;
+    m_droppedSamples = 0;
+    m_queuedSamples = 0;
+    m_activeStreams.reset(new std::vector<Stream>());
+
+    m_stop = false;
+    m_thread = std::thread(&FMUVariableStreamer::run, this);
+    m_enabled = true;
+    return true;
+}
+
+bool FMUVariableStreamer::isEnabled() const
+{
+    return m_enabled;
+}
+
+bool FMUVariableStreamer::addFMU(const std::string& fmuName,
+                                 const std::vector<std::string>& variableNames,
+                                 const std::vector<fmi2_value_reference_t>& variableReferences,
+                                 const FMUVariableReadFunction& read)
+{
+    if (variableNames.size() != variableReferences.size())
+    {
+        gzerr << m_ownerName << ": the FMU " << fmuName << " has a different number of variable names and references." << std::endl;
+        return false;
+    }
+
+    CatalogueFMU fmu;
+    fmu.name = fmuName;
+    fmu.read = read;
+    m_fmus.push_back(fmu);
+
+    for (size_t i=0; i < variableNames.size(); i++)
+    {
+        CatalogueVariable variable;
+        variable.fmu = m_fmus.size()-1;
+        variable.reference = variableReferences[i];
+        m_catalogue.push_back(fmuName + "/" + variableNames[i]);
+        m_catalogueVariables.push_back(variable);
+    }
+    return true;
+}
+
+bool FMUVariableStreamer::addFMU(const std::string& fmuName, FMUCoSimulation& fmu)
+{
+    std::vector<std::string> variableNames;
+    std::vector<fmi2_value_reference_t> variableReferences;
+    if (!fmu.getRealVariables(variableNames, variableReferences))
+    {
+        gzerr << m_ownerName << ": impossible to get the variables of the FMU " << fmuName << std::endl;
+        return false;
+    }
+
+    FMUCoSimulation* fmuPtr = &fmu;
+    return this->addFMU(fmuName, variableNames, variableReferences,
+                        [fmuPtr](const std::vector<fmi2_value_reference_t>& references, std::vector<double>& values)
+                        {
+                            return fmuPtr->getOutputVariables(references, values);
+                        });
+}
+
+const std::vector<std::string>& FMUVariableStreamer::getCatalogue() const
+{
+    return m_catalogue;
+}
+
+bool FMUVariableStreamer::requestStream(const std::string& streamName, const std::vector<std::string>& variableNames,
+                                        const size_t decimation)
+{
+    if (!m_enabled)
+    {
+        return false;
+    }
+
+    if (!isValidStreamName(streamName))
+    {
+        gzerr << m_ownerName << ": invalid stream name \"" << streamName << "\", only letters, digits and underscores are allowed." << std::endl;
+        return false;
+    }
+
+    // A request without variables removes the stream, so its decimation is not used
+    if ((!variableNames.empty() && decimation == 0) || variableNames.size() > m_options.maxVariablesPerStream)
+    {
+        gzerr << m_ownerName << ": the stream " << streamName << " should have a positive decimation and at most "
+              << m_options.maxVariablesPerStream << " variables." << std::endl;
+        return false;
+    }
+
+    StreamRequest request;
+    request.name = streamName;
+    request.decimation = decimation;
+    for (const std::string& variableName : variableNames)
+    {
+        auto found = std::find(m_catalogue.begin(), m_catalogue.end(), variableName);
+        if (found == m_catalogue.end())
+        {
+            gzerr << m_ownerName << ": the variable " << variableName << " of the stream " << streamName
+                  << " is not in the catalogue." << std::endl;
+            return false;
+        }
+        request.variables.push_back(found - m_catalogue.begin());
+    }
+
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    auto existing = std::find_if(m_requests.begin(), m_requests.end(),
+                                 [&streamName](const StreamRequest& other) { return other.name == streamName; });
+    if (existing != m_requests.end())
+    {
+        m_requests.erase(existing);
+    }
+    if (!request.variables.empty())
+    {
+        m_requests.push_back(request);
+    }
+
+    // The streams are built here, so that update only swaps them
+    m_pendingStreams = this->buildStreams();
+    m_pendingChange.store(true, std::memory_order_release);
+
+    if (request.variables.empty())
+    {
+        gzmsg << m_ownerName << ": removed stream " << streamName << "." << std::endl;
+    }
+    else
+    {
+        gzmsg << m_ownerName << ": requested stream " << streamName << " of " << request.variables.size()
+              << " variables every " << decimation << " steps." << std::endl;
+    }
+    return true;
+}
+
+std::unique_ptr<std::vector<FMUVariableStreamer::Stream>> FMUVariableStreamer::buildStreams() const
+{
+    std::unique_ptr<std::vector<Stream>> streams(new std::vector<Stream>());
+    for (const StreamRequest& request : m_requests)
+    {
+        Stream stream;
+        stream.name = std::make_shared<const std::string>(request.name);
+        stream.decimation = request.decimation;
+        stream.nrOfValues = request.variables.size();
+
+        // Group the variables by FMU, so that each FMU is read once per sample
+        for (size_t position=0; position < request.variables.size(); position++)
+        {
+            const CatalogueVariable& variable = m_catalogueVariables[request.variables[position]];
+            auto read = std::find_if(stream.reads.begin(), stream.reads.end(),
+                                     [&variable](const StreamRead& other) { return other.fmu == variable.fmu; });
+            if (read == stream.reads.end())
+            {
+                stream.reads.push_back(StreamRead());
+                stream.reads.back().fmu = variable.fmu;
+                read = stream.reads.end()-1;
+            }
+            read->references.push_back(variable.reference);
+            read->values.push_back(0.0);
+            read->positions.push_back(position);
+        }
+        streams->push_back(stream);
+    }
+    return streams;
+}
+
+void FMUVariableStreamer::applyPendingStreams()
+{
+    // The lock is held by requestStream only while building the streams, if it is contended the change is applied at the next step
+    std::unique_lock<std::mutex> lock(m_requestMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+
+    // The previous streams are released by the next request, outside of the physics thread
+    std::swap(m_activeStreams, m_pendingStreams);
+    m_pendingChange.store(false, std::memory_order_relaxed);
+}
+
+void FMUVariableStreamer::update(const double simulatedTimeInSeconds)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    if (m_pendingChange.load(std::memory_order_acquire))
+    {
+        this->applyPendingStreams();
+    }
+
+    for (Stream& stream : *m_activeStreams)
+    {
+        if (stream.calls++ % stream.decimation != 0)
+        {
+            continue;
+        }
+
+        const uint64_t head = m_queueHead.load(std::memory_order_relaxed);
+        if (head - m_queueTail.load(std::memory_order_acquire) == m_samples.size())
+        {
+            m_droppedSamples.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const size_t slot = head % m_samples.size();
+        double* values = m_sampleValues.data() + slot*m_options.maxVariablesPerStream;
+        bool ok = true;
+        for (StreamRead& read : stream.reads)
+        {
+            ok = ok && m_fmus[read.fmu].read(read.references, read.values);
+            for (size_t i=0; ok && i < read.values.size(); i++)
+            {
+                values[read.positions[i]] = read.values[i];
+            }
+        }
+
+        if (!ok)
+        {
+            if (!m_reportedReadFailure)
+            {
+                logFromCallback(LogLevel::error, m_ownerName.c_str(), "failure in reading the variables of stream %s.", stream.name->c_str());
+                m_reportedReadFailure = true;
+            }
+            continue;
+        }
+
+        Sample& sample = m_samples[slot];
+        sample.streamName = stream.name;
+        sample.time = simulatedTimeInSeconds;
+        sample.nrOfValues = stream.nrOfValues;
+        m_queueHead.store(head+1, std::memory_order_release);
+        m_queuedSamples++;
+        m_wakeUp.notify_one();
+    }
+}
+
+size_t FMUVariableStreamer::getNrOfActiveStreams() const
+{
+    return m_activeStreams ? m_activeStreams->size() : 0;
+}
+
+void FMUVariableStreamer::run()
+{
+    std::vector<double> values;
+    while (true)
+    {
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(m_threadMutex);
+            m_wakeUp.wait_for(lock, s_publishingPeriod, [this]()
+            {
+                return m_stop || m_queueHead.load(std::memory_order_acquire) != m_queueTail.load(std::memory_order_relaxed);
+            });
+            stop = m_stop;
+        }
+
+        // Publish all the queued samples, also the ones queued before close
+        uint64_t tail = m_queueTail.load(std::memory_order_relaxed);
+        while (tail != m_queueHead.load(std::memory_order_acquire))
+        {
+            const size_t slot = tail % m_samples.size();
+            Sample& sample = m_samples[slot];
+            const double* sampleValues = m_sampleValues.data() + slot*m_options.maxVariablesPerStream;
+            values.assign(sampleValues, sampleValues + sample.nrOfValues);
+            const double time = sample.time;
+            std::shared_ptr<const std::string> streamName;
+            streamName.swap(sample.streamName);
+
+            // The slot is released before publishing, so that update can reuse it
+            m_queueTail.store(++tail, std::memory_order_release);
+            if (m_publish)
+            {
+                m_publish(*streamName, time, values);
+            }
+        }
+
+        if (stop)
+        {
+            return;
+        }
+    }
+}
+
+void FMUVariableStreamer::close()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+}
+
+uint64_t FMUVariableStreamer::getDroppedSamples() const
+{
+    return m_droppedSamples.load(std::memory_order_relaxed);
+}
+
+void FMUVariableStreamer::printReport()
+{
+    const uint64_t droppedSamples = this->getDroppedSamples();
+    if (droppedSamples > 0)
+    {
+        gzwarn << m_ownerName << ": " << droppedSamples << " samples of FMU variables of " << m_queuedSamples+droppedSamples
+               << " were not streamed because the publishing thread was not fast enough." << std::endl;
+    }
+    else if (m_queuedSamples > 0)
+    {
+        gzmsg << m_ownerName << ": " << m_queuedSamples << " samples of FMU variables streamed." << std::endl;
+    }
+}
+
+//////////////////////////////////////////////////
+bool FMUVariableStreamTopics::advertise(FMUVariableStreamer& streamer, const std::string& worldName, const std::string& topic,
+                                        const std::string& ownerName)
+{
+    m_streamer = &streamer;
+    m_topic = topic;
+    m_ownerName = ownerName;
+
+    m_node = gazebo::transport::NodePtr(new gazebo::transport::Node());
+    m_node->Init(worldName);
+
+    // The catalogue is published once, the clients get it by subscribing with latching
+    m_catalogueMessage.clear_data();
+    for (const std::string& variableName : streamer.getCatalogue())
+    {
+        m_catalogueMessage.add_data(variableName);
+    }
+    m_cataloguePublisher = m_node->Advertise<gazebo::msgs::GzString_V>(m_topic + "/catalogue");
+    m_cataloguePublisher->Publish(m_catalogueMessage);
+
+    m_requestSubscriber = m_node->Subscribe(m_topic + "/request", &FMUVariableStreamTopics::onRequest, this);
+
+    gzmsg << m_ownerName << ": " << streamer.getCatalogue().size() << " FMU variables can be streamed, see the topic "
+          << m_topic << "/catalogue" << std::endl;
+    return true;
+}
+
+void FMUVariableStreamTopics::onRequest(const boost::shared_ptr<gazebo::msgs::GzString_V const>& request)
+{
+    if (request->data_size() < 2)
+    {
+        gzerr << m_ownerName << ": a request of FMU variables should contain at least the stream name and the decimation." << std::endl;
+        return;
+    }
+
+    size_t decimation = 0;
+    try
+    {
+        decimation = std::stoul(request->data(1));
+    }
+    catch (const std::exception&)
+    {
+        gzerr << m_ownerName << ": invalid decimation " << request->data(1) << " in the request of FMU variables." << std::endl;
+        return;
+    }
+
+    std::vector<std::string> variableNames(request->data().begin()+2, request->data().end());
+    if (m_streamer->requestStream(request->data(0), variableNames, decimation))
+    {
+        // The catalogue is published again for the clients that subscribed without latching
+        m_cataloguePublisher->Publish(m_catalogueMessage);
+    }
+}
+
+void FMUVariableStreamTopics::publish(const std::string& streamName, const double simulatedTimeInSeconds, const std::vector<double>& values)
+{
+    gazebo::transport::PublisherPtr& publisher = m_streamPublishers[streamName];
+    if (!publisher)
+    {
+        publisher = m_node->Advertise<gazebo::msgs::Double_V>(m_topic + "/streams/" + streamName);
+    }
+
+    if (!publisher->HasConnections())
+    {
+        return;
+    }
+
+    m_sampleMessage.clear_data();
+    m_sampleMessage.add_data(simulatedTimeInSeconds);
+    for (double value : values)
+    {
+        m_sampleMessage.add_data(value);
+    }
+    publisher->Publish(m_sampleMessage);
+}
+
+}
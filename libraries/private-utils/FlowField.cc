@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FlowField.hh>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+
+#include <experimental/filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+namespace
+{
+const char s_fileMagic[8] = {'G', 'Z', 'F', 'M', 'I', 'F', 'L', 'D'};
+const uint32_t s_fileVersion = 1;
+const uint32_t s_padding = 0;
+const size_t s_headerSize = sizeof(s_fileMagic) + sizeof(s_fileVersion) + sizeof(s_padding)
+                            + 4*sizeof(uint64_t) + 4*sizeof(double) + 4*sizeof(double);
+
+bool isValidGrid(const FlowFieldGrid& grid)
+{
+    uint64_t nrOfNodes = 1;
+    for (size_t axis=0; axis < 4; axis++)
+    {
+        const uint64_t points = grid.points[axis];
+        if (points == 0 || nrOfNodes > std::numeric_limits<uint64_t>::max()/(3*sizeof(double)*points))
+        {
+            return false;
+        }
+        nrOfNodes *= points;
+
+        if (!std::isfinite(grid.origin[axis]) || (points > 1 && !(grid.spacing[axis] > 0.0 && std::isfinite(grid.spacing[axis]))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+//////////////////////////////////////////////////
+uint64_t FlowFieldGrid::getNrOfNodes() const
+{
+    return points[0]*points[1]*points[2]*points[3];
+}
+
+//////////////////////////////////////////////////
+bool writeFlowFieldFile(const std::string& filePath, const FlowFieldGrid& grid, const std::vector<double>& velocities)
+{
+    if (!isValidGrid(grid) || velocities.size() != 3*grid.getNrOfNodes())
+    {
+        gzerr << "gazebo_fmi: invalid grid or wrong number of velocities for flow field file " << filePath << std::endl;
+        return false;
+    }
+
+    FILE* file = std::fopen(filePath.c_str(), "wb");
+    if (!file)
+    {
+        gzerr << "gazebo_fmi: impossible to create flow field file " << filePath << std::endl;
+        return false;
+    }
+
+    bool ok = std::fwrite(s_fileMagic, sizeof(s_fileMagic), 1, file) == 1;
+    ok = ok && std::fwrite(&s_fileVersion, sizeof(s_fileVersion), 1, file) == 1;
+    ok = ok && std::fwrite(&s_padding, sizeof(s_padding), 1, file) == 1;
+    ok = ok && std::fwrite(grid.points.data(), sizeof(uint64_t), 4, file) == 4;
+    ok = ok && std::fwrite(grid.origin.data(), sizeof(double), 4, file) == 4;
+    ok = ok && std::fwrite(grid.spacing.data(), sizeof(double), 4, file) == 4;
+    ok = ok && std::fwrite(velocities.data(), sizeof(double), velocities.size(), file) == velocities.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok)
+    {
+        gzerr << "gazebo_fmi: impossible to write flow field file " << filePath << std::endl;
+    }
+    return ok;
+}
+
+//////////////////////////////////////////////////
+FlowField::~FlowField()
+{
+    this->close();
+}
+
+std::shared_ptr<const FlowField> FlowField::getShared(const std::string& filePath)
+{
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<const FlowField>> registry;
+
+    // Different paths of the same file share the same mapping
+    std::error_code error;
+    std::string key = std::experimental::filesystem::canonical(filePath, error).string();
+    if (error)
+    {
+        key = filePath;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<const FlowField> field = registry[key].lock();
+    if (!field)
+    {
+        std::shared_ptr<FlowField> newField(new FlowField());
+        if (!newField->open(key))
+        {
+            registry.erase(key);
+            return nullptr;
+        }
+        field = newField;
+        registry[key] = field;
+    }
+    return field;
+}
+
+bool FlowField::open(const std::string& filePath)
+{
+    this->close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        gzerr << "gazebo_fmi: impossible to open flow field file " << filePath << std::endl;
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < s_headerSize)
+    {
+        gzerr << "gazebo_fmi: " << filePath << " is not a flow field file." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    m_mappedSize = static_cast<size_t>(fileStat.st_size);
+    m_mappedData = mmap(nullptr, m_mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (m_mappedData == MAP_FAILED)
+    {
+        gzerr << "gazebo_fmi: impossible to map flow field file " << filePath << std::endl;
+        m_mappedData = nullptr;
+        m_mappedSize = 0;
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(m_mappedData);
+
+    // Parse the header
+    uint32_t version = 0;
+    if (std::memcmp(base, s_fileMagic, sizeof(s_fileMagic)) != 0)
+    {
+        gzerr << "gazebo_fmi: " << filePath << " is not a flow field file." << std::endl;
+        this->close();
+        return false;
+    }
+    std::memcpy(&version, base+8, sizeof(version));
+    std::memcpy(m_grid.points.data(), base+16, 4*sizeof(uint64_t));
+    std::memcpy(m_grid.origin.data(), base+48, 4*sizeof(double));
+    std::memcpy(m_grid.spacing.data(), base+80, 4*sizeof(double));
+
+    if (version != s_fileVersion || !isValidGrid(m_grid)
+        || m_mappedSize != s_headerSize + 3*sizeof(double)*m_grid.getNrOfNodes())
+    {
+        gzerr << "gazebo_fmi: unsupported version, invalid grid or wrong size of flow field file " << filePath << std::endl;
+        this->close();
+        return false;
+    }
+
+    m_velocities = reinterpret_cast<const double*>(base+s_headerSize);
+    return true;
+}
+
+void FlowField::close()
+{
+    if (m_mappedData)
+    {
+        munmap(m_mappedData, m_mappedSize);
+    }
+    m_mappedData = nullptr;
+    m_mappedSize = 0;
+    m_velocities = nullptr;
+    m_grid = FlowFieldGrid();
+}
+
+const FlowFieldGrid& FlowField::getGrid() const
+{
+    return m_grid;
+}
+
+bool FlowField::sample(const double x, const double y, const double z, const double timeInSeconds,
+                       double& velocity_x, double& velocity_y, double& velocity_z) const
+{
+    velocity_x = velocity_y = velocity_z = 0.0;
+    if (!m_velocities)
+    {
+        return false;
+    }
+
+    // Cell of the grid that contains the point, and position of the point in the cell along each axis
+    const double coordinates[4] = {x, y, z, timeInSeconds};
+    uint64_t firstNode = 0;
+    uint64_t stride = 1;
+    uint64_t nextNodeOffset[4];
+    double fraction[4];
+    bool inside = true;
+    for (size_t axis=0; axis < 4; axis++)
+    {
+        const uint64_t points = m_grid.points[axis];
+        uint64_t index = 0;
+        fraction[axis] = 0.0;
+        nextNodeOffset[axis] = 0;
+        if (points > 1)
+        {
+            double position = (coordinates[axis] - m_grid.origin[axis])/m_grid.spacing[axis];
+            const double lastNode = static_cast<double>(points - 1);
+            if (!(position >= 0.0))
+            {
+                position = 0.0;
+                inside = false;
+            }
+            else if (position > lastNode)
+            {
+                position = lastNode;
+                inside = false;
+            }
+            index = std::min(static_cast<uint64_t>(position), points - 2);
+            fraction[axis] = position - static_cast<double>(index);
+            nextNodeOffset[axis] = 3*stride;
+        }
+        firstNode += 3*index*stride;
+        stride *= points;
+    }
+
+    // Linear interpolation between the 16 corners of the cell, the ones with zero weight are skipped
+    for (unsigned corner=0; corner < 16; corner++)
+    {
+        double weight = 1.0;
+        uint64_t node = firstNode;
+        for (size_t axis=0; axis < 4; axis++)
+        {
+            if (corner & (1u << axis))
+            {
+                weight *= fraction[axis];
+                node += nextNodeOffset[axis];
+            }
+            else
+            {
+                weight *= 1.0 - fraction[axis];
+            }
+        }
+
+        if (weight != 0.0)
+        {
+            velocity_x += weight*m_velocities[node];
+            velocity_y += weight*m_velocities[node+1];
+            velocity_z += weight*m_velocities[node+2];
+        }
+    }
+
+    return inside;
+}
+
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/NativeFluidDynamics.hh>
+
+#include <cmath>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+bool parseNativeFluidDynamicsModelType(const std::string& typeString, NativeFluidDynamicsModelType& type)
+{
+    if (typeString == "linear_drag")
+    {
+        type = NativeFluidDynamicsModelType::linearDrag;
+        return true;
+    }
+
+    if (typeString == "quadratic_drag")
+    {
+        type = NativeFluidDynamicsModelType::quadraticDrag;
+        return true;
+    }
+
+    if (typeString == "lift_drag")
+    {
+        type = NativeFluidDynamicsModelType::liftDrag;
+        return true;
+    }
+
+    return false;
+}
+
+void NativeFluidDynamicsModels::clear()
+{
+    m_nrOfBodies = 0;
+    for (std::vector<double>* parameter : {&m_linear_x, &m_linear_y, &m_linear_z,
+                                           &m_quadratic_x, &m_quadratic_y, &m_quadratic_z,
+                                           &m_forward_x, &m_forward_y, &m_forward_z,
+                                           &m_upward_x, &m_upward_y, &m_upward_z,
+                                           &m_pressure_x, &m_pressure_y, &m_pressure_z,
+                                           &m_halfDensityArea, &m_alpha0, &m_alphaStall,
+                                           &m_cla, &m_cda, &m_claStall, &m_cdaStall})
+    {
+        parameter->clear();
+    }
+    m_liftDragBodies.clear();
+}
+
+bool NativeFluidDynamicsModels::addBody(const NativeFluidDynamicsModelOptions& options, const std::string& ownerName)
+{
+    const bool isDrag = options.enabled && options.type != NativeFluidDynamicsModelType::liftDrag;
+    const bool isLiftDrag = options.enabled && options.type == NativeFluidDynamicsModelType::liftDrag;
+
+    if (isDrag)
+    {
+        for (double coefficient : options.coefficients)
+        {
+            if (!std::isfinite(coefficient))
+            {
+                gzerr << ownerName << ": the drag coefficients of the native model should be finite." << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Orthonormal forward and upward directions
+    double forward[3] = {options.forward[0], options.forward[1], options.forward[2]};
+    double upward[3] = {options.upward[0], options.upward[1], options.upward[2]};
+    if (isLiftDrag)
+    {
+        if (!(options.fluidDensity > 0.0 && options.area > 0.0 && options.alphaStall > 0.0))
+        {
+            gzerr << ownerName << ": the fluid density, area and stall angle of the lift_drag native model should be positive." << std::endl;
+            return false;
+        }
+
+        const double forwardNorm = std::sqrt(forward[0]*forward[0] + forward[1]*forward[1] + forward[2]*forward[2]);
+        if (!(forwardNorm > 0.0))
+        {
+            gzerr << ownerName << ": the forward direction of the lift_drag native model should not be zero." << std::endl;
+            return false;
+        }
+        for (double& component : forward)
+        {
+            component /= forwardNorm;
+        }
+
+        const double upwardForward = upward[0]*forward[0] + upward[1]*forward[1] + upward[2]*forward[2];
+        for (size_t i=0; i < 3; i++)
+        {
+            upward[i] -= upwardForward*forward[i];
+        }
+        const double upwardNorm = std::sqrt(upward[0]*upward[0] + upward[1]*upward[1] + upward[2]*upward[2]);
+        if (!(upwardNorm > 1e-9))
+        {
+            gzerr << ownerName << ": the upward direction of the lift_drag native model should not be parallel to the forward one." << std::endl;
+            return false;
+        }
+        for (double& component : upward)
+        {
+            component /= upwardNorm;
+        }
+    }
+
+    const bool isLinear = isDrag && options.type == NativeFluidDynamicsModelType::linearDrag;
+    const bool isQuadratic = isDrag && options.type == NativeFluidDynamicsModelType::quadraticDrag;
+    m_linear_x.push_back(isLinear ? options.coefficients[0] : 0.0);
+    m_linear_y.push_back(isLinear ? options.coefficients[1] : 0.0);
+    m_linear_z.push_back(isLinear ? options.coefficients[2] : 0.0);
+    m_quadratic_x.push_back(isQuadratic ? options.coefficients[0] : 0.0);
+    m_quadratic_y.push_back(isQuadratic ? options.coefficients[1] : 0.0);
+    m_quadratic_z.push_back(isQuadratic ? options.coefficients[2] : 0.0);
+
+    if (isLiftDrag)
+    {
+        m_liftDragBodies.push_back(m_nrOfBodies);
+        m_forward_x.push_back(forward[0]);
+        m_forward_y.push_back(forward[1]);
+        m_forward_z.push_back(forward[2]);
+        m_upward_x.push_back(upward[0]);
+        m_upward_y.push_back(upward[1]);
+        m_upward_z.push_back(upward[2]);
+        m_pressure_x.push_back(options.centerOfPressure[0]);
+        m_pressure_y.push_back(options.centerOfPressure[1]);
+        m_pressure_z.push_back(options.centerOfPressure[2]);
+        m_halfDensityArea.push_back(0.5*options.fluidDensity*options.area);
+        m_alpha0.push_back(options.alpha0);
+        m_alphaStall.push_back(options.alphaStall);
+        m_cla.push_back(options.cla);
+        m_cda.push_back(options.cda);
+        m_claStall.push_back(options.claStall);
+        m_cdaStall.push_back(options.cdaStall);
+    }
+
+    m_nrOfBodies++;
+    return true;
+}
+
+size_t NativeFluidDynamicsModels::getNrOfBodies() const
+{
+    return m_nrOfBodies;
+}
+
+void NativeFluidDynamicsModels::evaluate(const double* velocity_x, const double* velocity_y, const double* velocity_z,
+                                         double* __restrict force_x, double* __restrict force_y, double* __restrict force_z,
+                                         double* __restrict moment_x, double* __restrict moment_y, double* __restrict moment_z) const
+{
+    // Linear and quadratic drag of all the bodies, the force is applied in the body origin
+    for (size_t i=0; i < m_nrOfBodies; i++)
+    {
+        force_x[i] = -(m_linear_x[i] + m_quadratic_x[i]*std::abs(velocity_x[i]))*velocity_x[i];
+        force_y[i] = -(m_linear_y[i] + m_quadratic_y[i]*std::abs(velocity_y[i]))*velocity_y[i];
+        force_z[i] = -(m_linear_z[i] + m_quadratic_z[i]*std::abs(velocity_z[i]))*velocity_z[i];
+        moment_x[i] = 0.0;
+        moment_y[i] = 0.0;
+        moment_z[i] = 0.0;
+    }
+
+    // Lift and drag of the surfaces. The velocity is projected on the plane spanned by the forward and upward
+    // directions f and u, in which the angle of attack is measured. The drag is opposite to the projected
+    // velocity, and the lift is orthogonal to it in the same plane, along s x v with the span s = f x u.
+    for (size_t k=0; k < m_liftDragBodies.size(); k++)
+    {
+        const size_t i = m_liftDragBodies[k];
+        const double v_f = velocity_x[i]*m_forward_x[k] + velocity_y[i]*m_forward_y[k] + velocity_z[i]*m_forward_z[k];
+        const double v_u = velocity_x[i]*m_upward_x[k] + velocity_y[i]*m_upward_y[k] + velocity_z[i]*m_upward_z[k];
+        const double speed2 = v_f*v_f + v_u*v_u;
+        if (!(speed2 > 0.0))
+        {
+            continue;
+        }
+
+        // Angle of attack, positive if the fluid comes from below the surface
+        const double alpha = m_alpha0[k] + std::atan2(-v_u, v_f);
+        const double absAlpha = std::abs(alpha);
+        const double signAlpha = alpha < 0.0 ? -1.0 : 1.0;
+        const bool stalled = absAlpha > m_alphaStall[k];
+        const double cl = stalled ? signAlpha*(m_cla[k]*m_alphaStall[k] + m_claStall[k]*(absAlpha - m_alphaStall[k]))
+                                  : m_cla[k]*alpha;
+        const double cd = stalled ? m_cda[k]*m_alphaStall[k] + m_cdaStall[k]*(absAlpha - m_alphaStall[k])
+                                  : m_cda[k]*absAlpha;
+
+        // In the (f, u) basis the direction of the velocity is (c, s), and the one of the lift is s x (c, s) = (-s, c)
+        const double speed = std::sqrt(speed2);
+        const double dir_f = v_f/speed;
+        const double dir_u = v_u/speed;
+        const double q = m_halfDensityArea[k]*speed2;
+        const double f_f = q*(-cl*dir_u - cd*dir_f);
+        const double f_u = q*(cl*dir_f - cd*dir_u);
+
+        const double f_x = f_f*m_forward_x[k] + f_u*m_upward_x[k];
+        const double f_y = f_f*m_forward_y[k] + f_u*m_upward_y[k];
+        const double f_z = f_f*m_forward_z[k] + f_u*m_upward_z[k];
+        force_x[i] += f_x;
+        force_y[i] += f_y;
+        force_z[i] += f_z;
+        moment_x[i] += m_pressure_y[k]*f_z - m_pressure_z[k]*f_y;
+        moment_y[i] += m_pressure_z[k]*f_x - m_pressure_x[k]*f_z;
+        moment_z[i] += m_pressure_x[k]*f_y - m_pressure_y[k]*f_x;
+    }
+}
+
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/RealTimeBudgetMonitor.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <algorithm>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+void RealTimeBudgetMonitor::configure(const RealTimeBudgetOptions& options,
+                                      const std::string& ownerName,
+                                      const std::vector<std::string>& fmuNames)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+
+    m_statistics = RealTimeBudgetStatistics();
+    m_statistics.fmus.resize(fmuNames.size());
+    for (size_t i=0; i < fmuNames.size(); i++)
+    {
+        m_statistics.fmus[i].name = fmuNames[i];
+    }
+
+    m_fmuStartTimes.resize(fmuNames.size());
+    m_fmuStepTimes.assign(fmuNames.size(), 0.0);
+    m_hasLogged = false;
+    m_missesSinceLastLog = 0;
+}
+
+bool RealTimeBudgetMonitor::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+void RealTimeBudgetMonitor::setConcurrentFMUs(const bool concurrent)
+{
+    m_concurrentFMUs = concurrent;
+}
+
+void RealTimeBudgetMonitor::setCheckBudget(const bool check)
+{
+    m_checkBudget = check;
+}
+
+void RealTimeBudgetMonitor::beginStep()
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    std::fill(m_fmuStepTimes.begin(), m_fmuStepTimes.end(), 0.0);
+    m_stepStartTime = Clock::now();
+}
+
+void RealTimeBudgetMonitor::beginFMU(const size_t fmuIndex)
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    m_fmuStartTimes[fmuIndex] = Clock::now();
+}
+
+void RealTimeBudgetMonitor::endFMU(const size_t fmuIndex)
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - m_fmuStartTimes[fmuIndex];
+    m_fmuStepTimes[fmuIndex] += elapsed.count();
+}
+
+void RealTimeBudgetMonitor::endStep(const double stepSizeInSeconds, const double simulatedTimeInSeconds)
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    double budget = m_options.budgetInSeconds > 0.0 ? m_options.budgetInSeconds
+                                                    : m_options.budgetFraction*stepSizeInSeconds;
+
+    // Accumulate per-FMU statistics and find the most expensive FMU of the step
+    double totalFMUTime = 0.0;
+    size_t slowestFMU = 0;
+    for (size_t i=0; i < m_fmuStepTimes.size(); i++)
+    {
+        FMUBudgetStatistics& fmuStats = m_statistics.fmus[i];
+        const double fmuTime = m_fmuStepTimes[i];
+        fmuStats.calls++;
+        fmuStats.totalTimeInSeconds += fmuTime;
+        fmuStats.maxTimeInSeconds = std::max(fmuStats.maxTimeInSeconds, fmuTime);
+        totalFMUTime += fmuTime;
+        if (fmuTime > m_fmuStepTimes[slowestFMU])
+        {
+            slowestFMU = i;
+        }
+    }
+    m_statistics.steps++;
+
+    if (!m_checkBudget)
+    {
+        return;
+    }
+
+    // If the FMUs run concurrently their times overlap, so the wall-clock time of the update is used
+    double stepTime = totalFMUTime;
+    if (m_concurrentFMUs)
+    {
+        std::chrono::duration<double> elapsed = Clock::now() - m_stepStartTime;
+        stepTime = elapsed.count();
+    }
+
+    if (stepTime <= budget || m_fmuStepTimes.empty())
+    {
+        return;
+    }
+
+    // Deadline miss
+    const double overrun = stepTime - budget;
+    m_statistics.deadlineMisses++;
+    m_statistics.totalOverrunInSeconds += overrun;
+    m_statistics.maxOverrunInSeconds = std::max(m_statistics.maxOverrunInSeconds, overrun);
+    m_statistics.fmus[slowestFMU].deadlineMisses++;
+    m_missesSinceLastLog++;
+
+    // Rate-limited logging
+    Clock::time_point now = Clock::now();
+    std::chrono::duration<double> sinceLastLog = now - m_lastLogTime;
+    if (m_hasLogged && sinceLastLog.count() < m_options.logPeriodInSeconds)
+    {
+        return;
+    }
+
+    // Find the second most expensive FMU, if any
+    size_t secondSlowestFMU = m_fmuStepTimes.size();
+    for (size_t i=0; i < m_fmuStepTimes.size(); i++)
+    {
+        if (i != slowestFMU &&
+            (secondSlowestFMU == m_fmuStepTimes.size() || m_fmuStepTimes[i] > m_fmuStepTimes[secondSlowestFMU]))
+        {
+            secondSlowestFMU = i;
+        }
+    }
+
+    logFromCallback(LogLevel::warning, m_ownerName.c_str(),
+                    "%s time of %g ms exceeded the budget of %g ms at sim time %g s (%llu deadline misses since last message, %llu in total).",
+                    m_concurrentFMUs ? "Step" : "FMU", 1e3*stepTime, 1e3*budget, simulatedTimeInSeconds,
+                    static_cast<unsigned long long>(m_missesSinceLastLog),
+                    static_cast<unsigned long long>(m_statistics.deadlineMisses));
+    if (secondSlowestFMU != m_fmuStepTimes.size())
+    {
+        logFromCallback(LogLevel::warning, m_ownerName.c_str(), "most expensive FMUs: %s (%g ms), %s (%g ms)",
+                        m_statistics.fmus[slowestFMU].name.c_str(), 1e3*m_fmuStepTimes[slowestFMU],
+                        m_statistics.fmus[secondSlowestFMU].name.c_str(), 1e3*m_fmuStepTimes[secondSlowestFMU]);
+    }
+    else
+    {
+        logFromCallback(LogLevel::warning, m_ownerName.c_str(), "most expensive FMUs: %s (%g ms)",
+                        m_statistics.fmus[slowestFMU].name.c_str(), 1e3*m_fmuStepTimes[slowestFMU]);
+    }
+
+    m_lastLogTime = now;
+    m_hasLogged = true;
+    m_missesSinceLastLog = 0;
+}
+
+const RealTimeBudgetStatistics& RealTimeBudgetMonitor::getStatistics() const
+{
+    return m_statistics;
+}
+
+void RealTimeBudgetMonitor::printReport() const
+{
+    if (!m_options.enabled || m_statistics.steps == 0)
+    {
+        return;
+    }
+
+    if (!m_checkBudget)
+    {
+        gzmsg << m_ownerName << ": real-time budget report over " << m_statistics.steps
+              << " steps, the deadlines are checked by the FMU scheduler." << std::endl;
+    }
+    else
+    {
+        gzmsg << m_ownerName << ": real-time budget report, " << m_statistics.deadlineMisses << " deadline misses over "
+              << m_statistics.steps << " steps, total overrun " << 1e3*m_statistics.totalOverrunInSeconds
+              << " ms, max overrun " << 1e3*m_statistics.maxOverrunInSeconds << " ms." << std::endl;
+    }
+
+    for (const FMUBudgetStatistics& fmuStats : m_statistics.fmus)
+    {
+        double meanTime = fmuStats.calls > 0 ? fmuStats.totalTimeInSeconds/fmuStats.calls : 0.0;
+        gzmsg << m_ownerName << ":   " << fmuStats.name << ": mean " << 1e3*meanTime
+              << " ms, max " << 1e3*fmuStats.maxTimeInSeconds << " ms";
+        if (m_checkBudget)
+        {
+            gzmsg << ", responsible for " << fmuStats.deadlineMisses << " deadline misses";
+        }
+        gzmsg << "." << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+// Monitor of the RealTimeSection in which the thread is running, if any
+static thread_local RealTimeSafetyMonitor* t_activeMonitor = nullptr;
+
+/// \brief Process-wide pool of memory for the FMU allocations
+///
+/// The blocks have sizes that are powers of two (including a 16 bytes header that stores the size class),
+/// the freed blocks are kept in per-size free lists and new blocks are taken from the reserved chunks
+/// with a bump pointer. A spinlock protects the pool, as the FMU memory callbacks have no context.
+/// The reserved size is the largest size requested by the plugins, as all the plugins of the process
+/// share the same pool, and the chunks are never unmapped.
+class FMUMemoryPool
+{
+private:
+    static const size_t s_minBlockSizeLog2 = 4;
+    static const size_t s_nrOfSizeClasses = 20;
+    static const uint32_t s_heapBlock = std::numeric_limits<uint32_t>::max();
+
+    struct BlockHeader
+    {
+        uint32_t sizeClass;
+        uint32_t reserved;
+        uint64_t padding;
+    };
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct Chunk
+    {
+        char* begin;
+        size_t size;
+    };
+
+    std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+    std::vector<Chunk> m_chunks;
+    size_t m_currentChunk{0};
+    size_t m_currentOffset{0};
+    size_t m_usage{0};
+    FreeBlock* m_freeLists[s_nrOfSizeClasses] = {};
+
+    std::mutex m_reserveMutex;
+    size_t m_reservedSize{0};
+    bool m_locked{false};
+
+    static void lockChunk(char* begin, const size_t size)
+    {
+        if (mlock(begin, size) != 0)
+        {
+            gzwarn << "gazebo_fmi: impossible to lock the FMU memory pool in RAM (" << std::strerror(errno)
+                   << "), check the RLIMIT_MEMLOCK limit of the process." << std::endl;
+        }
+    }
+
+    void lock()
+    {
+        while (m_lock.test_and_set(std::memory_order_acquire))
+        {
+        }
+    }
+
+    void unlock()
+    {
+        m_lock.clear(std::memory_order_release);
+    }
+
+    static size_t blockSize(const size_t sizeClass)
+    {
+        return static_cast<size_t>(1) << (sizeClass + s_minBlockSizeLog2);
+    }
+
+    // Take a block of the specified class from the free list or from the chunks, nullptr if the pool is exhausted
+    char* takeBlock(const size_t sizeClass, bool& fromFreeList)
+    {
+        fromFreeList = false;
+        if (m_freeLists[sizeClass])
+        {
+            FreeBlock* block = m_freeLists[sizeClass];
+            m_freeLists[sizeClass] = block->next;
+            fromFreeList = true;
+            return reinterpret_cast<char*>(block);
+        }
+
+        const size_t size = blockSize(sizeClass);
+        for (; m_currentChunk < m_chunks.size(); m_currentChunk++, m_currentOffset = 0)
+        {
+            if (m_currentOffset + size <= m_chunks[m_currentChunk].size)
+            {
+                char* block = m_chunks[m_currentChunk].begin + m_currentOffset;
+                m_currentOffset += size;
+                m_usage += size;
+                return block;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    bool reserve(const size_t sizeInBytes, const bool lockMemory)
+    {
+        // Serialize the reservations, that are done in Load and never in the callbacks
+        std::lock_guard<std::mutex> reserveLock(m_reserveMutex);
+
+        // The pool is shared by all the plugins, so it grows to the largest request instead of their sum
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t requestedSize = ((sizeInBytes + pageSize - 1)/pageSize)*pageSize;
+        const size_t size = requestedSize > m_reservedSize ? requestedSize - m_reservedSize : 0;
+
+        if (lockMemory && !m_locked)
+        {
+            // Lock the chunks reserved by previous requests that did not ask for locking
+            for (const Chunk& chunk : m_chunks)
+            {
+                lockChunk(chunk.begin, chunk.size);
+            }
+            m_locked = true;
+        }
+
+        if (size == 0)
+        {
+            return true;
+        }
+
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            gzerr << "gazebo_fmi: impossible to reserve " << size << " bytes for the FMU memory pool: "
+                  << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // Prefault the pages, so that the first allocations do not cause page faults
+        for (size_t offset = 0; offset < size; offset += pageSize)
+        {
+            static_cast<volatile char*>(memory)[offset] = 0;
+        }
+
+        if (m_locked)
+        {
+            lockChunk(static_cast<char*>(memory), size);
+        }
+
+        lock();
+        m_chunks.push_back({static_cast<char*>(memory), size});
+        unlock();
+        m_reservedSize += size;
+        return true;
+    }
+
+    size_t getReservedSize()
+    {
+        std::lock_guard<std::mutex> reserveLock(m_reserveMutex);
+        return m_reservedSize;
+    }
+
+    void* allocate(size_t nobj, size_t size)
+    {
+        if (nobj != 0 && size > (std::numeric_limits<size_t>::max() - sizeof(BlockHeader))/nobj)
+        {
+            return nullptr;
+        }
+        const size_t payloadSize = nobj*size;
+        const size_t totalSize = payloadSize + sizeof(BlockHeader);
+
+        size_t sizeClass = 0;
+        while (sizeClass < s_nrOfSizeClasses && blockSize(sizeClass) < totalSize)
+        {
+            sizeClass++;
+        }
+
+        char* block = nullptr;
+        bool fromFreeList = false;
+        if (sizeClass < s_nrOfSizeClasses)
+        {
+            lock();
+            block = takeBlock(sizeClass, fromFreeList);
+            unlock();
+        }
+
+        if (block)
+        {
+            // Fresh blocks are already zeroed, reused ones contain the free list pointer and old data
+            if (fromFreeList)
+            {
+                std::memset(block + sizeof(BlockHeader), 0, payloadSize);
+            }
+            BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+            header->sizeClass = static_cast<uint32_t>(sizeClass);
+            return block + sizeof(BlockHeader);
+        }
+
+        // The allocation does not fit in the pool
+        if (!checkRealTimeOperation(RealTimeViolation::allocation))
+        {
+            return nullptr;
+        }
+
+        block = static_cast<char*>(std::calloc(1, totalSize));
+        if (!block)
+        {
+            return nullptr;
+        }
+        reinterpret_cast<BlockHeader*>(block)->sizeClass = s_heapBlock;
+        return block + sizeof(BlockHeader);
+    }
+
+    void free(void* obj)
+    {
+        if (!obj)
+        {
+            return;
+        }
+
+        char* block = static_cast<char*>(obj) - sizeof(BlockHeader);
+        const uint32_t sizeClass = reinterpret_cast<BlockHeader*>(block)->sizeClass;
+        if (sizeClass == s_heapBlock)
+        {
+            std::free(block);
+            return;
+        }
+
+        FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>(block);
+        lock();
+        freeBlock->next = m_freeLists[sizeClass];
+        m_freeLists[sizeClass] = freeBlock;
+        unlock();
+    }
+
+    size_t getUsage()
+    {
+        lock();
+        const size_t usage = m_usage;
+        unlock();
+        return usage;
+    }
+};
+
+// The pool is never destroyed, as FMUs could be freed during the destruction of static objects
+static FMUMemoryPool& fmuMemoryPool()
+{
+    static FMUMemoryPool* pool = new FMUMemoryPool;
+    return *pool;
+}
+
+bool parseRealTimeViolationPolicy(const std::string& policyString, RealTimeViolationPolicy& policy)
+{
+    if (policyString == "report")
+    {
+        policy = RealTimeViolationPolicy::report;
+        return true;
+    }
+    if (policyString == "refuse")
+    {
+        policy = RealTimeViolationPolicy::refuse;
+        return true;
+    }
+    return false;
+}
+
+bool reserveFMUMemoryPool(const size_t sizeInBytes, const bool lockMemory)
+{
+    return fmuMemoryPool().reserve(sizeInBytes, lockMemory);
+}
+
+void* fmuMemoryPoolAllocate(size_t nobj, size_t size)
+{
+    return fmuMemoryPool().allocate(nobj, size);
+}
+
+void fmuMemoryPoolFree(void* obj)
+{
+    fmuMemoryPool().free(obj);
+}
+
+size_t getFMUMemoryPoolUsage()
+{
+    return fmuMemoryPool().getUsage();
+}
+
+size_t getFMUMemoryPoolReservedSize()
+{
+    return fmuMemoryPool().getReservedSize();
+}
+
+RealTimeSafetyMonitor::RealTimeSafetyMonitor()
+{
+    for (std::atomic<uint64_t>& violations : m_violations)
+    {
+        violations = 0;
+    }
+}
+
+bool RealTimeSafetyMonitor::configure(const RealTimeOptions& options, const std::string& ownerName)
+{
+    m_options = options;
+    m_ownerName = ownerName;
+
+    if (!m_options.enabled)
+    {
+        return true;
+    }
+
+    m_logger = AsyncLogger::getInstance();
+    return reserveFMUMemoryPool(m_options.fmuMemoryPoolSize, m_options.lockMemory);
+}
+
+bool RealTimeSafetyMonitor::isEnabled() const
+{
+    return m_options.enabled;
+}
+
+const RealTimeOptions& RealTimeSafetyMonitor::getOptions() const
+{
+    return m_options;
+}
+
+void RealTimeSafetyMonitor::lockMemory()
+{
+    if (!m_options.enabled || !m_options.lockMemory)
+    {
+        return;
+    }
+
+    // Lock all the memory mapped so far, including the code and the data of the FMUs loaded by the plugin
+    if (mlockall(MCL_CURRENT) != 0)
+    {
+        gzwarn << m_ownerName << ": impossible to lock the memory of the process in RAM (" << std::strerror(errno)
+               << "), check the RLIMIT_MEMLOCK limit of the process." << std::endl;
+    }
+}
+
+bool RealTimeSafetyMonitor::reportViolation(const RealTimeViolation violation)
+{
+    if (!m_options.enabled)
+    {
+        return true;
+    }
+
+    const bool refuse = m_options.onViolation == RealTimeViolationPolicy::refuse;
+    if (m_violations[static_cast<size_t>(violation)].fetch_add(1, std::memory_order_relaxed) == 0)
+    {
+        // Only the first violation of each kind is logged, the following ones are counted
+        m_logger->log(LogLevel::warning, m_ownerName.c_str(),
+                      violation == RealTimeViolation::allocation ?
+                          (refuse ? "refused a memory allocation in the physics-thread callback" :
+                                    "memory allocation in the physics-thread callback") :
+                          (refuse ? "refused a blocking lock in the physics-thread callback" :
+                                    "blocking lock in the physics-thread callback"));
+    }
+    return !refuse;
+}
+
+uint64_t RealTimeSafetyMonitor::getViolations(const RealTimeViolation violation) const
+{
+    return m_violations[static_cast<size_t>(violation)].load(std::memory_order_relaxed);
+}
+
+AsyncLogger& RealTimeSafetyMonitor::getLogger()
+{
+    return *m_logger;
+}
+
+void RealTimeSafetyMonitor::printReport() const
+{
+    if (!m_options.enabled)
+    {
+        return;
+    }
+
+    gzmsg << m_ownerName << ": real-time report, " << getViolations(RealTimeViolation::allocation)
+          << " memory allocations and " << getViolations(RealTimeViolation::lock)
+          << " blocking locks " << (m_options.onViolation == RealTimeViolationPolicy::refuse ? "refused" : "performed")
+          << " in the physics-thread callback, " << getFMUMemoryPoolUsage() << " bytes of the FMU memory pool used." << std::endl;
+}
+
+RealTimeSection::RealTimeSection(RealTimeSafetyMonitor& monitor): m_previous(t_activeMonitor)
+{
+    if (monitor.isEnabled())
+    {
+        t_activeMonitor = &monitor;
+    }
+}
+
+RealTimeSection::~RealTimeSection()
+{
+    t_activeMonitor = m_previous;
+}
+
+bool isInRealTimeSection()
+{
+    return t_activeMonitor != nullptr;
+}
+
+bool checkRealTimeOperation(const RealTimeViolation violation)
+{
+    if (!t_activeMonitor)
+    {
+        return true;
+    }
+    return t_activeMonitor->reportViolation(violation);
+}
+
+void logFromCallback(const LogLevel level, const char* source, const char* format, ...)
+{
+    char message[440];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (t_activeMonitor)
+    {
+        t_activeMonitor->getLogger().log(level, source, message);
+        return;
+    }
+
+    switch (level)
+    {
+        case LogLevel::nothing:
+            break;
+        case LogLevel::fatal:
+        case LogLevel::error:
+            gzerr << source << ": " << message << std::endl;
+            break;
+        case LogLevel::warning:
+            gzwarn << source << ": " << message << std::endl;
+            break;
+        case LogLevel::info:
+            gzmsg << source << ": " << message << std::endl;
+            break;
+        default:
+            gzdbg << source << ": " << message << std::endl;
+            break;
+    }
+}
+
+}
@@ -10,6 +10,10 @@
 
 #include <gazebo_fmi/SDFConfigurationParsing.hh>
 
+#include <algorithm>
+#include <array>
+#include <utility>
+
 #include <gazebo/common/Console.hh>
 
 namespace gazebo_fmi
@@ -67,4 +71,679 @@ bool parseVariableNamesSDFElement(sdf::ElementPtr sdf_elem,
   return ok;
 }
 
+bool parseRealTimeBudgetSDFElement(sdf::ElementPtr sdf_elem,
+                                   RealTimeBudgetOptions& options)
+{
+  options = RealTimeBudgetOptions();
+
+  if (!sdf_elem->HasElement("realtime_budget"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr budget_elem = sdf_elem->GetElement("realtime_budget");
+  options.enabled = true;
+
+  if (budget_elem->HasElement("budget_fraction"))
+  {
+    options.budgetFraction = budget_elem->Get<double>("budget_fraction");
+    if (options.budgetFraction <= 0.0)
+    {
+      gzerr << "gazebo_fmi: realtime_budget budget_fraction should be positive." << std::endl;
+      return false;
+    }
+  }
+
+  if (budget_elem->HasElement("budget"))
+  {
+    options.budgetInSeconds = budget_elem->Get<double>("budget");
+    if (options.budgetInSeconds <= 0.0)
+    {
+      gzerr << "gazebo_fmi: realtime_budget budget should be positive." << std::endl;
+      return false;
+    }
+  }
+
+  if (budget_elem->HasElement("log_period"))
+  {
+    options.logPeriodInSeconds = budget_elem->Get<double>("log_period");
+  }
+
+  return true;
+}
+
+bool parseFMULogLevelSDFElement(sdf::ElementPtr sdf_elem,
+                                LogLevel& level)
+{
+  level = LogLevel::error;
+
+  if (!sdf_elem->HasElement("fmu_log_level"))
+  {
+    return true;
+  }
+
+  std::string levelString = sdf_elem->Get<std::string>("fmu_log_level");
+  if (!parseLogLevel(levelString, level))
+  {
+    gzerr << "gazebo_fmi: unknown fmu_log_level " << levelString
+          << ", valid values are nothing, fatal, error, warning, info, verbose and debug." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool parseRecorderSDFElement(sdf::ElementPtr sdf_elem,
+                             FMURecorderOptions& options)
+{
+  options = FMURecorderOptions();
+
+  if (!sdf_elem->HasElement("recorder"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr recorder_elem = sdf_elem->GetElement("recorder");
+  options.enabled = true;
+
+  if (!recorder_elem->HasElement("file"))
+  {
+    gzerr << "gazebo_fmi: recorder tag has no required file element." << std::endl;
+    return false;
+  }
+  options.filePath = recorder_elem->Get<std::string>("file");
+
+  if (recorder_elem->HasElement("chunk_size"))
+  {
+    int samplesPerChunk = recorder_elem->Get<int>("chunk_size");
+    if (samplesPerChunk <= 0)
+    {
+      gzerr << "gazebo_fmi: recorder chunk_size should be positive." << std::endl;
+      return false;
+    }
+    options.samplesPerChunk = static_cast<size_t>(samplesPerChunk);
+  }
+
+  return true;
+}
+
+bool parseReplaySDFElement(sdf::ElementPtr sdf_elem,
+                           FMUReplayOptions& options)
+{
+  options = FMUReplayOptions();
+
+  if (!sdf_elem->HasElement("replay"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr replay_elem = sdf_elem->GetElement("replay");
+  options.enabled = true;
+
+  if (!replay_elem->HasElement("file"))
+  {
+    gzerr << "gazebo_fmi: replay tag has no required file element." << std::endl;
+    return false;
+  }
+  options.filePath = replay_elem->Get<std::string>("file");
+
+  if (replay_elem->HasElement("check_inputs"))
+  {
+    options.checkInputs = replay_elem->Get<bool>("check_inputs");
+  }
+
+  if (replay_elem->HasElement("tolerance"))
+  {
+    options.inputTolerance = replay_elem->Get<double>("tolerance");
+    if (options.inputTolerance < 0.0)
+    {
+      gzerr << "gazebo_fmi: replay tolerance should be non-negative." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool parseDeterminismDigestSDFElement(sdf::ElementPtr sdf_elem,
+                                      DeterminismDigestOptions& options)
+{
+  options = DeterminismDigestOptions();
+
+  if (!sdf_elem->HasElement("determinism_digest"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr digest_elem = sdf_elem->GetElement("determinism_digest");
+  options.enabled = true;
+
+  if (digest_elem->HasElement("file"))
+  {
+    options.filePath = digest_elem->Get<std::string>("file");
+  }
+
+  if (digest_elem->HasElement("checkpoint_period"))
+  {
+    int checkpointPeriod = digest_elem->Get<int>("checkpoint_period");
+    if (checkpointPeriod <= 0)
+    {
+      gzerr << "gazebo_fmi: determinism_digest checkpoint_period should be positive." << std::endl;
+      return false;
+    }
+    options.checkpointPeriod = static_cast<size_t>(checkpointPeriod);
+  }
+
+  if (digest_elem->HasElement("max_checkpoints"))
+  {
+    int maxCheckpoints = digest_elem->Get<int>("max_checkpoints");
+    if (maxCheckpoints <= 0)
+    {
+      gzerr << "gazebo_fmi: determinism_digest max_checkpoints should be positive." << std::endl;
+      return false;
+    }
+    options.maxCheckpoints = static_cast<size_t>(maxCheckpoints);
+  }
+
+  if (digest_elem->HasElement("publish_period"))
+  {
+    options.publishPeriodInSeconds = digest_elem->Get<double>("publish_period");
+  }
+
+  return true;
+}
+
+bool parseRealTimeSDFElement(sdf::ElementPtr sdf_elem,
+                             RealTimeOptions& options)
+{
+  options = RealTimeOptions();
+
+  if (!sdf_elem->HasElement("realtime"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr realtime_elem = sdf_elem->GetElement("realtime");
+  options.enabled = true;
+
+  if (realtime_elem->HasElement("fmu_memory_pool_size"))
+  {
+    double poolSize = realtime_elem->Get<double>("fmu_memory_pool_size");
+    if (poolSize < 0.0)
+    {
+      gzerr << "gazebo_fmi: realtime fmu_memory_pool_size should be non-negative." << std::endl;
+      return false;
+    }
+    options.fmuMemoryPoolSize = static_cast<size_t>(poolSize);
+  }
+
+  if (realtime_elem->HasElement("lock_memory"))
+  {
+    options.lockMemory = realtime_elem->Get<bool>("lock_memory");
+  }
+
+  if (realtime_elem->HasElement("on_violation"))
+  {
+    std::string policyString = realtime_elem->Get<std::string>("on_violation");
+    if (!parseRealTimeViolationPolicy(policyString, options.onViolation))
+    {
+      gzerr << "gazebo_fmi: unknown realtime on_violation " << policyString << ", valid values are report and refuse." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool parseSurrogateGridAxis(sdf::ElementPtr axis_elem,
+                                   SurrogateGridAxis& axis)
+{
+  if (axis_elem->HasElement("min"))
+  {
+    axis.min = axis_elem->Get<double>("min");
+  }
+
+  if (axis_elem->HasElement("max"))
+  {
+    axis.max = axis_elem->Get<double>("max");
+  }
+
+  if (axis_elem->HasElement("points"))
+  {
+    int points = axis_elem->Get<int>("points");
+    if (points < 2)
+    {
+      gzerr << "gazebo_fmi: surrogate points should be at least 2." << std::endl;
+      return false;
+    }
+    axis.points = static_cast<size_t>(points);
+  }
+
+  if (!(axis.max > axis.min))
+  {
+    gzerr << "gazebo_fmi: surrogate max should be greater than min." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool parseSurrogateSDFElement(sdf::ElementPtr sdf_elem,
+                              const std::vector<std::string>& defaultInputVariableNames,
+                              FMUSurrogateOptions& options)
+{
+  options = FMUSurrogateOptions();
+
+  if (!sdf_elem->HasElement("surrogate"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr surrogate_elem = sdf_elem->GetElement("surrogate");
+  options.enabled = true;
+
+  if (surrogate_elem->HasElement("interpolation"))
+  {
+    std::string interpolationString = surrogate_elem->Get<std::string>("interpolation");
+    if (!parseSurrogateInterpolation(interpolationString, options.interpolation))
+    {
+      gzerr << "gazebo_fmi: unknown surrogate interpolation " << interpolationString << ", valid values are linear and cubic." << std::endl;
+      return false;
+    }
+  }
+
+  // Grid shared by all the inputs
+  SurrogateGridAxis defaultAxis;
+  if (!parseSurrogateGridAxis(surrogate_elem, defaultAxis))
+  {
+    return false;
+  }
+  options.axes.assign(defaultInputVariableNames.size(), defaultAxis);
+
+  // Grids of specific inputs
+  if (surrogate_elem->HasElement("input"))
+  {
+    sdf::ElementPtr input_elem = surrogate_elem->GetElement("input");
+    while (input_elem)
+    {
+      std::string inputName = input_elem->HasElement("name") ? input_elem->Get<std::string>("name") : "";
+      auto it = std::find(defaultInputVariableNames.begin(), defaultInputVariableNames.end(), inputName);
+      if (it == defaultInputVariableNames.end())
+      {
+        gzerr << "gazebo_fmi: surrogate input \"" << inputName << "\" is not a default input variable name." << std::endl;
+        return false;
+      }
+
+      if (!parseSurrogateGridAxis(input_elem, options.axes[it - defaultInputVariableNames.begin()]))
+      {
+        return false;
+      }
+
+      input_elem = input_elem->GetNextElement("input");
+    }
+  }
+
+  if (surrogate_elem->HasElement("cache_directory"))
+  {
+    options.cacheDirectory = surrogate_elem->Get<std::string>("cache_directory");
+  }
+
+  return true;
+}
+
+static bool parseTrustRegion(sdf::ElementPtr elem,
+                             double& trustRegion)
+{
+  if (elem->HasElement("trust_region"))
+  {
+    trustRegion = elem->Get<double>("trust_region");
+    if (!(trustRegion >= 0.0))
+    {
+      gzerr << "gazebo_fmi: output_prediction trust_region should be non-negative." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool parseOutputPredictionSDFElement(sdf::ElementPtr sdf_elem,
+                                     const std::vector<std::string>& defaultInputVariableNames,
+                                     FMUOutputPredictionOptions& options)
+{
+  options = FMUOutputPredictionOptions();
+
+  if (!sdf_elem->HasElement("output_prediction"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr prediction_elem = sdf_elem->GetElement("output_prediction");
+  options.enabled = true;
+
+  // Trust region shared by all the inputs
+  double defaultTrustRegion = 1e-3;
+  if (!parseTrustRegion(prediction_elem, defaultTrustRegion))
+  {
+    return false;
+  }
+  options.trustRegions.assign(defaultInputVariableNames.size(), defaultTrustRegion);
+
+  if (prediction_elem->HasElement("max_skipped_steps"))
+  {
+    int maxSkippedSteps = prediction_elem->Get<int>("max_skipped_steps");
+    if (maxSkippedSteps < 0)
+    {
+      gzerr << "gazebo_fmi: output_prediction max_skipped_steps should be non-negative." << std::endl;
+      return false;
+    }
+    options.maxSkippedSteps = static_cast<size_t>(maxSkippedSteps);
+  }
+
+  // Trust regions of specific inputs
+  if (prediction_elem->HasElement("input"))
+  {
+    sdf::ElementPtr input_elem = prediction_elem->GetElement("input");
+    while (input_elem)
+    {
+      std::string inputName = input_elem->HasElement("name") ? input_elem->Get<std::string>("name") : "";
+      auto it = std::find(defaultInputVariableNames.begin(), defaultInputVariableNames.end(), inputName);
+      if (it == defaultInputVariableNames.end())
+      {
+        gzerr << "gazebo_fmi: output_prediction input \"" << inputName << "\" is not a default input variable name." << std::endl;
+        return false;
+      }
+
+      if (!parseTrustRegion(input_elem, options.trustRegions[it - defaultInputVariableNames.begin()]))
+      {
+        return false;
+      }
+
+      input_elem = input_elem->GetNextElement("input");
+    }
+  }
+
+  return true;
+}
+
+
+bool parseStrongCouplingSDFElement(sdf::ElementPtr sdf_elem,
+                                   FMUStrongCouplingOptions& options)
+{
+  options = FMUStrongCouplingOptions();
+
+  if (!sdf_elem->HasElement("strong_coupling"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr coupling_elem = sdf_elem->GetElement("strong_coupling");
+  options.enabled = true;
+
+  if (coupling_elem->HasElement("acceleration"))
+  {
+    std::string accelerationString = coupling_elem->Get<std::string>("acceleration");
+    if (!parseCouplingAcceleration(accelerationString, options.acceleration))
+    {
+      gzerr << "gazebo_fmi: unknown strong_coupling acceleration " << accelerationString << ", valid values are constant, aitken and iqn-ils." << std::endl;
+      return false;
+    }
+  }
+
+  if (coupling_elem->HasElement("max_iterations"))
+  {
+    int maxIterations = coupling_elem->Get<int>("max_iterations");
+    if (maxIterations < 1)
+    {
+      gzerr << "gazebo_fmi: strong_coupling max_iterations should be positive." << std::endl;
+      return false;
+    }
+    options.maxIterations = static_cast<size_t>(maxIterations);
+  }
+
+  if (coupling_elem->HasElement("tolerance"))
+  {
+    options.tolerance = coupling_elem->Get<double>("tolerance");
+    if (!(options.tolerance >= 0.0))
+    {
+      gzerr << "gazebo_fmi: strong_coupling tolerance should be non-negative." << std::endl;
+      return false;
+    }
+  }
+
+  if (coupling_elem->HasElement("relaxation"))
+  {
+    options.relaxation = coupling_elem->Get<double>("relaxation");
+    if (!(options.relaxation > 0.0 && options.relaxation <= 1.0))
+    {
+      gzerr << "gazebo_fmi: strong_coupling relaxation should be in (0, 1]." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool parseAdaptiveStepSDFElement(sdf::ElementPtr sdf_elem,
+                                 FMUAdaptiveStepOptions& options)
+{
+  options = FMUAdaptiveStepOptions();
+
+  if (!sdf_elem->HasElement("adaptive_step"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr adaptive_elem = sdf_elem->GetElement("adaptive_step");
+  options.enabled = true;
+
+  if (adaptive_elem->HasElement("estimator"))
+  {
+    std::string estimatorString = adaptive_elem->Get<std::string>("estimator");
+    if (!parseStepErrorEstimator(estimatorString, options.estimator))
+    {
+      gzerr << "gazebo_fmi: unknown adaptive_step estimator " << estimatorString << ", valid values are step_doubling and extrapolation." << std::endl;
+      return false;
+    }
+  }
+
+  if (adaptive_elem->HasElement("tolerance"))
+  {
+    options.tolerance = adaptive_elem->Get<double>("tolerance");
+    if (!(options.tolerance >= 0.0))
+    {
+      gzerr << "gazebo_fmi: adaptive_step tolerance should be non-negative." << std::endl;
+      return false;
+    }
+  }
+
+  if (adaptive_elem->HasElement("max_step_multiple"))
+  {
+    int maxStepMultiple = adaptive_elem->Get<int>("max_step_multiple");
+    if (maxStepMultiple < 1)
+    {
+      gzerr << "gazebo_fmi: adaptive_step max_step_multiple should be positive." << std::endl;
+      return false;
+    }
+    options.maxStepMultiple = static_cast<size_t>(maxStepMultiple);
+  }
+
+  if (adaptive_elem->HasElement("safety_factor"))
+  {
+    options.safetyFactor = adaptive_elem->Get<double>("safety_factor");
+    if (!(options.safetyFactor > 0.0 && options.safetyFactor <= 1.0))
+    {
+      gzerr << "gazebo_fmi: adaptive_step safety_factor should be in (0, 1]." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+// Parse an optional vector child element, in the form <name>x y z</name>
+static void parseVector3ChildSDFElement(sdf::ElementPtr sdf_elem, const std::string& name, std::array<double, 3>& vector)
+{
+  if (sdf_elem->HasElement(name))
+  {
+    ignition::math::Vector3d parsed = sdf_elem->Get<ignition::math::Vector3d>(name);
+    vector = {{parsed.X(), parsed.Y(), parsed.Z()}};
+  }
+}
+
+bool parseNativeModelSDFElement(sdf::ElementPtr sdf_elem,
+                                NativeFluidDynamicsModelOptions& options)
+{
+  options = NativeFluidDynamicsModelOptions();
+
+  if (!sdf_elem->HasElement("native_model"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr native_elem = sdf_elem->GetElement("native_model");
+  options.enabled = true;
+
+  if (!native_elem->HasElement("type"))
+  {
+    gzerr << "gazebo_fmi: native_model without type, valid values are linear_drag, quadratic_drag and lift_drag." << std::endl;
+    return false;
+  }
+
+  std::string typeString = native_elem->Get<std::string>("type");
+  if (!parseNativeFluidDynamicsModelType(typeString, options.type))
+  {
+    gzerr << "gazebo_fmi: unknown native_model type " << typeString << ", valid values are linear_drag, quadratic_drag and lift_drag." << std::endl;
+    return false;
+  }
+
+  parseVector3ChildSDFElement(native_elem, "coefficients", options.coefficients);
+  parseVector3ChildSDFElement(native_elem, "forward", options.forward);
+  parseVector3ChildSDFElement(native_elem, "upward", options.upward);
+  parseVector3ChildSDFElement(native_elem, "cp", options.centerOfPressure);
+
+  const std::vector<std::pair<std::string, double*>> scalars = {
+    {"fluid_density", &options.fluidDensity}, {"area", &options.area},
+    {"a0", &options.alpha0}, {"alpha_stall", &options.alphaStall},
+    {"cla", &options.cla}, {"cda", &options.cda},
+    {"cla_stall", &options.claStall}, {"cda_stall", &options.cdaStall}};
+  for (const std::pair<std::string, double*>& scalar : scalars)
+  {
+    if (native_elem->HasElement(scalar.first))
+    {
+      *(scalar.second) = native_elem->Get<double>(scalar.first);
+    }
+  }
+
+  return true;
+}
+
+bool parseFlowFieldSDFElement(sdf::ElementPtr sdf_elem,
+                              FlowFieldOptions& options)
+{
+  options = FlowFieldOptions();
+
+  if (!sdf_elem->HasElement("flow_field"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr field_elem = sdf_elem->GetElement("flow_field");
+  options.enabled = true;
+
+  if (!field_elem->HasElement("file"))
+  {
+    gzerr << "gazebo_fmi: flow_field tag has no required file element." << std::endl;
+    return false;
+  }
+  options.filePath = field_elem->Get<std::string>("file");
+
+  if (field_elem->HasElement("time_offset"))
+  {
+    options.timeOffset = field_elem->Get<double>("time_offset");
+  }
+
+  return true;
+}
+
+bool parseSchedulerSDFElement(sdf::ElementPtr sdf_elem,
+                              FMUSchedulerOptions& options)
+{
+  options = FMUSchedulerOptions();
+
+  if (sdf_elem->HasElement("threads"))
+  {
+    int nrOfThreads = sdf_elem->Get<int>("threads");
+    if (nrOfThreads < 1)
+    {
+      gzerr << "gazebo_fmi: scheduler threads is " << nrOfThreads << ", but it should be at least 1." << std::endl;
+      return false;
+    }
+    options.nrOfThreads = static_cast<size_t>(nrOfThreads);
+  }
+
+  if (sdf_elem->HasElement("rebalance_period"))
+  {
+    int rebalancePeriod = sdf_elem->Get<int>("rebalance_period");
+    if (rebalancePeriod < 0)
+    {
+      gzerr << "gazebo_fmi: scheduler rebalance_period should be non-negative." << std::endl;
+      return false;
+    }
+    options.rebalancePeriod = static_cast<size_t>(rebalancePeriod);
+  }
+
+  if (!parseRealTimeBudgetSDFElement(sdf_elem, options.budget))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+bool parseVariableStreamingSDFElement(sdf::ElementPtr sdf_elem,
+                                      FMUVariableStreamingOptions& options)
+{
+  options = FMUVariableStreamingOptions();
+
+  if (!sdf_elem->HasElement("variable_streaming"))
+  {
+    return true;
+  }
+
+  sdf::ElementPtr streaming_elem = sdf_elem->GetElement("variable_streaming");
+  options.enabled = true;
+
+  if (streaming_elem->HasElement("topic"))
+  {
+    options.topic = streaming_elem->Get<std::string>("topic");
+  }
+
+  if (streaming_elem->HasElement("max_variables"))
+  {
+    int maxVariables = streaming_elem->Get<int>("max_variables");
+    if (maxVariables <= 0)
+    {
+      gzerr << "gazebo_fmi: variable_streaming max_variables should be positive." << std::endl;
+      return false;
+    }
+    options.maxVariablesPerStream = static_cast<size_t>(maxVariables);
+  }
+
+  if (streaming_elem->HasElement("queue_size"))
+  {
+    int queueSize = streaming_elem->Get<int>("queue_size");
+    if (queueSize <= 0)
+    {
+      gzerr << "gazebo_fmi: variable_streaming queue_size should be positive." << std::endl;
+      return false;
+    }
+    options.queueSize = static_cast<size_t>(queueSize);
+  }
+
+  return true;
+}
+
 }
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/WorkerPool.hh>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo_fmi
+{
+
+// The scope of WorkerThreadStatePropagation that is currently active, if any
+static std::atomic<const WorkerThreadState*> s_threadState{nullptr};
+
+WorkerThreadStatePropagation::WorkerThreadStatePropagation(const WorkerThreadState& state): m_state(state)
+{
+    m_previous = s_threadState.exchange(&m_state);
+}
+
+WorkerThreadStatePropagation::~WorkerThreadStatePropagation()
+{
+    s_threadState.store(m_previous);
+}
+
+WorkerPool::~WorkerPool()
+{
+    this->stop();
+}
+
+bool WorkerPool::configure(const size_t nrOfThreads, RealTimeSafetyMonitor& monitor, const std::string& ownerName)
+{
+    this->stop();
+
+    if (nrOfThreads == 0)
+    {
+        gzerr << ownerName << ": the number of threads should be at least one." << std::endl;
+        return false;
+    }
+
+    m_monitor = &monitor;
+    for (size_t i=1; i < nrOfThreads; i++)
+    {
+        m_workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+
+    return true;
+}
+
+size_t WorkerPool::getNrOfThreads() const
+{
+    return m_workers.size() + 1;
+}
+
+void WorkerPool::runTasks(const uint32_t generation, const std::function<void(size_t)>& task, const size_t nrOfTasks)
+{
+    while (true)
+    {
+        // Claim the next task, only if it belongs to the batch of this generation
+        uint64_t claimed = m_nextTask.load(std::memory_order_acquire);
+        do
+        {
+            if ((claimed >> 32) != generation || (claimed & 0xFFFFFFFFu) >= nrOfTasks)
+            {
+                return;
+            }
+        }
+        while (!m_nextTask.compare_exchange_weak(claimed, claimed + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+
+        task(static_cast<size_t>(claimed & 0xFFFFFFFFu));
+        m_completedTasks.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void WorkerPool::workerLoop()
+{
+    uint32_t lastGeneration;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        lastGeneration = m_generation;
+    }
+
+    while (true)
+    {
+        const std::function<void(size_t)>* task;
+        size_t nrOfTasks;
+        WorkerThreadState threadState;
+        uint64_t callerState;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [&]{ return m_stop || m_generation != lastGeneration; });
+            if (m_stop)
+            {
+                return;
+            }
+            lastGeneration = m_generation;
+            task = m_task;
+            nrOfTasks = m_nrOfTasks;
+            threadState = m_threadState;
+            callerState = m_callerState;
+        }
+
+        uint64_t workerState = 0;
+        if (threadState.exchange)
+        {
+            workerState = threadState.exchange(callerState);
+        }
+
+        {
+            RealTimeSection realTimeSection(*m_monitor);
+            this->runTasks(lastGeneration, *task, nrOfTasks);
+        }
+
+        if (threadState.exchange)
+        {
+            threadState.exchange(workerState);
+        }
+    }
+}
+
+void WorkerPool::run(const size_t nrOfTasks, const std::function<void(size_t)>& task)
+{
+    if (m_workers.empty() || nrOfTasks <= 1)
+    {
+        for (size_t i=0; i < nrOfTasks; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    // The workers hold the mutex only briefly, so waiting for it is a violation only if it is contended
+    uint32_t generation;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            if (!checkRealTimeOperation(RealTimeViolation::lock))
+            {
+                for (size_t i=0; i < nrOfTasks; i++)
+                {
+                    task(i);
+                }
+                return;
+            }
+            lock.lock();
+        }
+
+        generation = ++m_generation;
+        m_task = &task;
+        m_nrOfTasks = nrOfTasks;
+        const WorkerThreadState* threadState = s_threadState.load();
+        if (threadState)
+        {
+            m_threadState = *threadState;
+            m_callerState = threadState->capture();
+        }
+        else
+        {
+            m_threadState = WorkerThreadState{nullptr, nullptr};
+            m_callerState = 0;
+        }
+        m_completedTasks.store(0, std::memory_order_relaxed);
+        m_nextTask.store(static_cast<uint64_t>(generation) << 32, std::memory_order_release);
+    }
+    m_wakeUp.notify_all();
+
+    // The calling thread runs tasks as well, and then waits for the ones claimed by the workers
+    this->runTasks(generation, task, nrOfTasks);
+    while (m_completedTasks.load(std::memory_order_acquire) < nrOfTasks)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+    m_stop = false;
+}
+
+}
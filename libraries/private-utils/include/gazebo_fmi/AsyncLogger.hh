@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_ASYNC_LOGGER_HH
+#define GAZEBO_FMI_ASYNC_LOGGER_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gazebo_fmi
+{
+    /// \brief Verbosity levels of log messages, with the same ordering of FMILibrary's jm_log_level_enu_t
+    enum class LogLevel
+    {
+        nothing = 0,
+        fatal,
+        error,
+        warning,
+        info,
+        verbose,
+        debug
+    };
+
+    /// \brief Convert a string (nothing, fatal, error, warning, info, verbose, debug) to a LogLevel
+    /// @return true if the string is a valid level, false otherwise
+    bool parseLogLevel(const std::string& levelString, LogLevel& level);
+
+    /// \brief Convert a LogLevel to a string
+    const char* logLevelToString(const LogLevel level);
+
+    /// \brief Process-wide logger that moves the I/O of log messages out of the thread that produces them.
+    ///
+    /// The printf-style messages are formatted by the thread that produces them, in the fixed-size
+    /// buffer of the record, as the arguments are not valid after the return of logv.
+    /// Only the formatting of the timestamp and the writing to the console or to the file are deferred.
+    ///
+    /// Log records are copied in a fixed-size lock-free ring buffer, that can be written by
+    /// several threads concurrently without locks nor memory allocations. A background thread
+    /// drains the buffer and writes the messages to the Gazebo console or, if setFileSink was called,
+    /// to a file. If the ring buffer is full, the record is dropped and counted.
+    ///
+    /// A single instance is shared by all the users, and it is destroyed (after the pending
+    /// records have been written) when the last std::shared_ptr returned by getInstance is released.
+    class AsyncLogger
+    {
+    private:
+        static const size_t s_capacity = 1024;
+        static const size_t s_maxSourceLength = 64;
+        static const size_t s_maxMessageLength = 440;
+
+        struct Record
+        {
+            std::atomic<size_t> sequence;
+            std::chrono::system_clock::time_point time;
+            LogLevel level;
+            char source[s_maxSourceLength];
+            char message[s_maxMessageLength];
+        };
+
+        std::vector<Record> m_records;
+        std::atomic<size_t> m_enqueuePosition{0};
+        size_t m_dequeuePosition{0};
+        std::atomic<uint64_t> m_droppedRecords{0};
+        uint64_t m_reportedDroppedRecords{0};
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        bool m_stop{false};
+        std::ofstream m_file;
+        std::string m_filePath;
+
+        void run();
+        void drain();
+        void write(const Record& record);
+        Record* beginRecord();
+        void commitRecord(Record* record);
+
+        AsyncLogger();
+
+    public:
+        ~AsyncLogger();
+
+        AsyncLogger(const AsyncLogger&) = delete;
+        AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+        /// \brief Get the process-wide logger, creating it if necessary
+        static std::shared_ptr<AsyncLogger> getInstance();
+
+        /// \brief Write all the following messages to the specified file instead of the Gazebo console
+        /// @return true if the file was opened correctly, false otherwise
+        bool setFileSink(const std::string& filePath);
+
+        /// \brief Push an already formatted message, never blocks nor allocates memory
+        /// @return true if the message was queued, false if it was dropped because the buffer was full
+        bool log(const LogLevel level, const char* source, const char* message);
+
+        /// \brief Format a printf-style message in the calling thread and push it, never blocks nor allocates memory
+        /// @return true if the message was queued, false if it was dropped because the buffer was full
+        bool logv(const LogLevel level, const char* source, const char* format, va_list args);
+
+        /// \brief Block until all the messages queued before this call have been written
+        void flush();
+
+        /// \brief Number of records dropped since the creation of the logger
+        uint64_t getDroppedRecords() const;
+    };
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_DETERMINISM_DIGEST_HH
+#define GAZEBO_FMI_DETERMINISM_DIGEST_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// The digest file written by DeterminismDigest::dump is a text file in the form:
+///
+///   # gazebo-fmi determinism digest 1
+///   # owner <name of the plugin instance>
+///   # fmus <name of FMU 0> <name of FMU 1> ...
+///   <step> <simulated time> <digest> <digest of FMU 0> <digest of FMU 1> ...
+///   ...
+///
+/// with one line for each checkpoint, and the digests written as 16 hexadecimal digits.
+/// As the digests are rolling, two files match up to a checkpoint if and only if (up to hash collisions)
+/// all the steps up to that checkpoint matched, so the first divergent step is located between the
+/// last matching checkpoint and the first divergent one, and the divergent FMUs are the ones whose digests differ.
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the determinism digest, see parseDeterminismDigestSDFElement
+    struct DeterminismDigestOptions
+    {
+        /// \brief True if the digest is enabled
+        bool enabled{false};
+
+        /// \brief Path of the file in which the checkpoints are dumped at shutdown, if empty nothing is dumped
+        std::string filePath;
+
+        /// \brief Number of steps between two checkpoints
+        size_t checkpointPeriod{100};
+
+        /// \brief Maximum number of checkpoints stored in memory, their storage is reserved in configure
+        size_t maxCheckpoints{10000};
+
+        /// \brief Simulated time between two digest messages on the Gazebo console, if not positive nothing is published
+        double publishPeriodInSeconds{10.0};
+    };
+
+    /// \brief A checkpoint of a DeterminismDigest
+    struct DeterminismCheckpoint
+    {
+        uint64_t step{0};
+        double simulatedTimeInSeconds{0.0};
+        uint64_t digest{0};
+        std::vector<uint64_t> fmuDigests;
+    };
+
+    /// \brief Rolling hash of the inputs and outputs of a set of FMUs, used to verify that two runs
+    ///        (for example a serial and a parallel one, or the same simulation on two machines) are bitwise identical.
+    ///
+    /// Each FMU has a FNV-1a digest that is updated with the bit patterns of its inputs and outputs at each step,
+    /// and the plugin digest is updated with the simulated time and the FMU digests at the end of each step.
+    /// Every checkpointPeriod steps the digests are stored in memory, and they are written to file by dump.
+    /// The memory of maxCheckpoints checkpoints is reserved in configure, so that storing a checkpoint in the
+    /// physics thread never allocates: once the reserved checkpoints are used, the following ones are dropped
+    /// (and counted), while the final checkpoint stored by dump is always present.
+    ///
+    /// The expected usage in a plugin update callback is:
+    /// ~~~
+    /// digest.beginStep(simulatedTimeInSeconds);
+    /// for (size_t i=0; i < nrOfFMUs; i++)
+    /// {
+    ///     digest.update(i, inputBuffers);
+    ///     digest.update(i, outputBuffers);
+    /// }
+    /// digest.endStep();
+    /// ~~~
+    /// If the digest is not enabled, all the methods return immediately.
+    class DeterminismDigest
+    {
+    private:
+        DeterminismDigestOptions m_options;
+        std::string m_ownerName;
+        std::vector<std::string> m_fmuNames;
+
+        uint64_t m_step{0};
+        double m_simulatedTimeInSeconds{0.0};
+        uint64_t m_digest;
+        std::vector<uint64_t> m_fmuDigests;
+        std::vector<DeterminismCheckpoint> m_checkpoints;
+        std::vector<std::vector<uint64_t>> m_freeFMUDigests;
+        uint64_t m_droppedCheckpoints{0};
+        double m_lastPublishTimeInSeconds{0.0};
+        bool m_hasPublished{false};
+
+        void addCheckpoint();
+
+    public:
+        DeterminismDigest();
+
+        /// \brief Configure the digest
+        /// @param[in] options options of the digest
+        /// @param[in] ownerName name of the plugin instance, used in the messages and in the file
+        /// @param[in] fmuNames names of the FMUs, in the order used in update
+        void configure(const DeterminismDigestOptions& options,
+                       const std::string& ownerName,
+                       const std::vector<std::string>& fmuNames);
+
+        /// \brief return true if the digest is enabled
+        bool isEnabled() const;
+
+        /// \brief Signal the begin of a step
+        void beginStep(const double simulatedTimeInSeconds);
+
+        /// \brief Update the digest of the fmuIndex-th FMU with the bit patterns of values
+        void update(const size_t fmuIndex, const std::vector<double>& values);
+
+        /// \brief Signal the end of a step, storing a checkpoint and publishing the digest if necessary
+        void endStep();
+
+        /// \brief Current digest of all the FMUs
+        uint64_t getDigest() const;
+
+        /// \brief Current digest of the fmuIndex-th FMU
+        uint64_t getFMUDigest(const size_t fmuIndex) const;
+
+        /// \brief Checkpoints stored so far
+        const std::vector<DeterminismCheckpoint>& getCheckpoints() const;
+
+        /// \brief Number of checkpoints dropped because maxCheckpoints checkpoints were already stored
+        uint64_t getDroppedCheckpoints() const;
+
+        /// \brief Store a final checkpoint, print the final digest and write the checkpoints to file (if a file was specified)
+        /// @return true if the file was written correctly (or if no file was specified), false otherwise
+        bool dump();
+    };
+
+    /// \brief Read a digest file written by DeterminismDigest::dump
+    /// @return true if the file was read correctly, false otherwise
+    bool readDeterminismDigestFile(const std::string& filePath,
+                                   std::string& ownerName,
+                                   std::vector<std::string>& fmuNames,
+                                   std::vector<DeterminismCheckpoint>& checkpoints);
+}
+
+#endif
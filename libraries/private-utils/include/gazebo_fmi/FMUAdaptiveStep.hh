@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_ADAPTIVE_STEP_HH
+#define GAZEBO_FMI_FMU_ADAPTIVE_STEP_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// For fmi2ValueReference
+#include <FMI2/fmi2_types.h>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Estimator of the local error of a macro step of FMUAdaptiveStepper
+    enum class StepErrorEstimator
+    {
+        /// \brief Difference between the outputs of one macro step with the inputs held, and of two half macro steps
+        ///        in which the inputs of the second one are extrapolated from the previous communication points
+        stepDoubling,
+        /// \brief Difference between the outputs of the macro step and their linear extrapolation from the previous communication points
+        extrapolation
+    };
+
+    /// \brief Convert a string (step_doubling, extrapolation) to a StepErrorEstimator
+    /// @return true if the string is a valid estimator, false otherwise
+    bool parseStepErrorEstimator(const std::string& estimatorString, StepErrorEstimator& estimator);
+
+    /// \brief Options of the adaptive communication step of a FMU, see parseAdaptiveStepSDFElement
+    struct FMUAdaptiveStepOptions
+    {
+        /// \brief True if the adaptive communication step is enabled
+        bool enabled{false};
+
+        /// \brief Estimator of the local error of the macro steps
+        StepErrorEstimator estimator{StepErrorEstimator::extrapolation};
+
+        /// \brief Maximum absolute local error of the outputs for which a macro step is accepted
+        double tolerance{1e-3};
+
+        /// \brief Maximum macro step, as a multiple of the physics step
+        size_t maxStepMultiple{16};
+
+        /// \brief Safety factor of the step size controller, in (0, 1]
+        double safetyFactor{0.9};
+    };
+
+    /// \brief Adaptive communication step of a FMU, that is stepped over macro steps spanning several physics steps
+    ///
+    /// At each communication point the inputs are sampled and held over the next macro step, that is a multiple
+    /// of the physics step. The state of the FMU is saved, the FMU is advanced over the macro step and the local
+    /// error of its outputs is estimated. If the error is larger than the tolerance, the state is restored and the
+    /// macro step is simulated again with a smaller size (rollback), otherwise the step is accepted and the size of
+    /// the next one is grown or shrunk by the controller. In the physics steps of a macro step the outputs are
+    /// linearly interpolated between the ones of its two communication points. The steps do not allocate memory.
+    class FMUAdaptiveStepper
+    {
+    private:
+        FMUAdaptiveStepOptions m_options;
+        std::string m_ownerName;
+        size_t m_nrOfInputs{0};
+        size_t m_nrOfOutputs{0};
+
+        /// \brief Size of the next macro step, and position in the current one, in physics steps
+        size_t m_stepMultiple{1};
+        size_t m_currentStepMultiple{0};
+        size_t m_stepsInCurrentMacroStep{0};
+
+        /// \brief Outputs at the communication points: beginning and end of the current macro step, and the one before
+        std::vector<double> m_startOutputs;
+        std::vector<double> m_endOutputs;
+        std::vector<double> m_olderOutputs;
+        std::vector<double> m_estimateOutputs;
+
+        /// \brief Inputs at the beginning of the current macro step and at the communication point before, and their extrapolation
+        std::vector<double> m_startInputs;
+        std::vector<double> m_olderInputs;
+        std::vector<double> m_extrapolatedInputs;
+        double m_startTimeInSeconds{0.0};
+        double m_olderTimeInSeconds{0.0};
+        size_t m_nrOfCommunicationPoints{0};
+
+        size_t m_nrOfPhysicsSteps{0};
+        size_t m_nrOfMacroSteps{0};
+        size_t m_nrOfRejectedSteps{0};
+        size_t m_maxStepMultipleTaken{0};
+        double m_maxError{0.0};
+
+        /// \brief Simulate the next macro step from the communication point at currentTimeInSeconds, with rollbacks
+        bool communicate(FMUCoSimulation& fmu,
+                         const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                         const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                         const double currentTimeInSeconds, const double physicsStepSizeInSeconds,
+                         const std::vector<double>& inputs);
+
+        /// \brief Simulate a macro step from the saved state and estimate its local error
+        bool simulateMacroStep(FMUCoSimulation& fmu,
+                               const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                               const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                               const double currentTimeInSeconds, const double macroStepSizeInSeconds,
+                               double& error);
+
+    public:
+        /// \brief return true if the FMU supports the adaptive communication step, otherwise print a warning
+        ///
+        /// The FMU should accept a variable step size and be able to save and restore its state.
+        static bool isSupportedBy(FMUCoSimulation& fmu, const std::string& ownerName);
+
+        /// \brief Allocate the buffers and reset the statistics
+        /// @return true if the options are valid, false otherwise
+        bool configure(const FMUAdaptiveStepOptions& options, const size_t nrOfInputs,
+                       const size_t nrOfOutputs, const std::string& ownerName);
+
+        /// \brief return true if the adaptive communication step is enabled and configured
+        bool isEnabled() const;
+
+        /// \brief Size of the macro step that follows one with the given multiple and local error
+        ///
+        /// The size is multiplied by safetyFactor*sqrt(tolerance/error), limited to [0.2, 2], and it is
+        /// in [1, maxStepMultiple]. After a rejected step the size is always smaller than the rejected one.
+        size_t proposeStepMultiple(const size_t stepMultiple, const double error) const;
+
+        /// \brief Compute the outputs of the physics step beginning at currentTimeInSeconds
+        ///
+        /// At the communication points the FMU is advanced over the next macro step with the inputs,
+        /// in the other steps the inputs are ignored.
+        /// @return true if all went well, false otherwise
+        bool step(FMUCoSimulation& fmu,
+                  const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                  const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                  const double currentTimeInSeconds, const double physicsStepSizeInSeconds,
+                  const std::vector<double>& inputs, std::vector<double>& outputs);
+
+        /// \brief Number of physics steps computed by step
+        size_t getNrOfPhysicsSteps() const;
+
+        /// \brief Number of accepted macro steps
+        size_t getNrOfMacroSteps() const;
+
+        /// \brief Number of macro steps rejected and simulated again with a smaller size
+        size_t getNrOfRejectedSteps() const;
+
+        /// \brief Print the macro steps taken and rejected, if enabled
+        void printReport() const;
+    };
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_CALL_OBSERVER_HH
+#define GAZEBO_FMI_FMU_CALL_OBSERVER_HH
+
+#include <chrono>
+#include <string>
+
+namespace gazebo_fmi
+{
+    /// \brief FMU calls on the hot path of the plugins, reported to the FMUCallObserver
+    enum class FMUCall
+    {
+        setInputVariables,
+        doStep,
+        getOutputVariables
+    };
+
+    /// \brief Observer of the hot path calls of all the FMUCoSimulation instances of the process,
+    ///        used by the benchmarking tools to attribute the latency of a physics step to the FMUs.
+    class FMUCallObserver
+    {
+    public:
+        virtual ~FMUCallObserver() = default;
+
+        /// \brief Called at the end of each call, in the thread that performed it
+        /// @param[in] call the FMUCoSimulation method that was called
+        /// @param[in] instanceName name of the FMU instance, valid as long as the FMU is loaded
+        /// @param[in] duration wall-clock duration of the call
+        virtual void onFMUCall(const FMUCall call,
+                               const std::string& instanceName,
+                               const std::chrono::steady_clock::duration duration) = 0;
+    };
+
+    /// \brief Set the observer of the FMU calls of the process, or remove it if observer is nullptr
+    ///
+    /// The observer is not owned, and it needs to be removed before being destroyed.
+    /// When no observer is set, the overhead on each FMU call is a single atomic load.
+    void setFMUCallObserver(FMUCallObserver* observer);
+
+    /// \brief Observer of the FMU calls of the process, nullptr if no observer is set
+    FMUCallObserver* getFMUCallObserver();
+}
+
+#endif
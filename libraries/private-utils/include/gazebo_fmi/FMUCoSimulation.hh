@@ -17,21 +17,45 @@
 // For fmi2ValueReference
 #include <FMI2/fmi2_types.h>
 
+#include <gazebo_fmi/AsyncLogger.hh>
+
 
 namespace gazebo_fmi
 {
     class FMUCoSimulationPrivate;
 
+    /// \brief Reference of an input that is not set in the FMU, because the FMU does not have it or none of its outputs depends on it
+    ///
+    /// The elements of the inputs with this reference are skipped by FMUCoSimulation::setInputVariables and
+    /// FMUCoSimulation::getDirectionalDerivative.
+    const fmi2_value_reference_t FMUUnboundVariableReference = static_cast<fmi2_value_reference_t>(-1);
+
     /// \brief Class wrapping
     class FMUCoSimulation
     {
     private:
         std::unique_ptr<FMUCoSimulationPrivate> m_pimpl;
 
+        /// \brief return true if the ModelStructure declares all the state on which the specified outputs depend
+        bool exposesAllState(const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                             const std::vector<fmi2_value_reference_t>& outputVariableReferences);
+
     public:
         FMUCoSimulation();
         ~FMUCoSimulation();
 
+        /// \brief Set the verbosity of the messages of the FMU and of FMILibrary for this instance
+        ///
+        /// Messages are written asynchronously by the AsyncLogger. If the level is info or higher,
+        /// the FMU is instantiated with logging on.
+        /// The default level is LogLevel::error.
+        void setLogLevel(const LogLevel level);
+
+        /// \brief Serve the memory allocations of the FMU from the process-wide FMU memory pool
+        ///
+        /// It should be called before load, see reserveFMUMemoryPool.
+        void setUseMemoryPool(const bool useMemoryPool);
+
         /// \brief Load specified FMU
         /// @return true if the FMU was loaded correctly, false otherwise
         bool load(const std::string& fmuAbsolutePath, const std::string& instanceName, const double startTimeInSeconds);
@@ -50,11 +74,68 @@ namespace gazebo_fmi
         bool getInputVariableRefs(const std::vector<std::string>& inputVariableNames,
                                   std::vector<fmi2_value_reference_t>& inputVariableReferences);
 
+        /// \brief Get input variables references, where the optional inputs that the FMU does not have are unbound
+        ///
+        /// The reference of a missing input is FMUUnboundVariableReference if the corresponding element of optionalInputs
+        /// is true, otherwise the method fails as the one without optionalInputs.
+        bool getInputVariableRefs(const std::vector<std::string>& inputVariableNames,
+                                  const std::vector<bool>& optionalInputs,
+                                  std::vector<fmi2_value_reference_t>& inputVariableReferences);
+
         /// \brief Get output variable references
         bool getOutputVariableRefs(const std::vector<std::string>& outputVariableNames,
                                   std::vector<fmi2_value_reference_t>& outputVariableReferences);
 
-        /// \brief Set input variables
+        /// \brief return true if the outputs are pure functions of the inputs, so the FMU can be replaced by a table
+        ///
+        /// The FMU is stateless if it has no continuous states, discrete states and event indicators, and if its ModelStructure
+        /// declares that each of the specified outputs depends only on the specified inputs (not on time or on other variables).
+        /// If the FMU is not stateless, the reason is printed as a message.
+        bool isStateless(const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                         const std::vector<fmi2_value_reference_t>& outputVariableReferences);
+
+        /// \brief Get the names and references of the Real inputs, outputs and local variables, that can be read after each step
+        bool getRealVariables(std::vector<std::string>& variableNames,
+                              std::vector<fmi2_value_reference_t>& variableReferences);
+
+        /// \brief Find the inputs on which the specified outputs depend, according to the ModelStructure of the FMU
+        ///
+        /// An input is used if one of the specified outputs, the derivative of a continuous state or a discrete state depends
+        /// on it, so that also the inputs that affect the outputs only through the states of the FMU are used. If the FMU does
+        /// not declare the dependencies, or if it may have a state that is not declared (as an FMU without Derivatives whose
+        /// outputs depend on no input), all the inputs are used. The unbound inputs are never used.
+        bool getUsedInputs(const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                           const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                           std::vector<bool>& usedInputs);
+
+        /// \brief return true if the FMU can compute the partial derivatives of its outputs with respect to its inputs
+        bool providesDirectionalDerivatives();
+
+        /// \brief return true if the FMU can save and restore its state, see saveState and restoreState
+        bool canGetAndSetFMUState();
+
+        /// \brief return true if the FMU accepts a different step size at each call of doStep
+        bool canHandleVariableStepSize();
+
+        /// \brief Get the directional derivative of the outputs with respect to the inputs at the current communication point
+        ///
+        /// The derivative is the product of the Jacobian of the outputs with respect to the inputs and the seed, whose
+        /// size is the number of inputs. The derivative buffer is expected to have the size of the outputs. The derivatives
+        /// with respect to the unbound inputs are not computed, as the outputs do not depend on them.
+        bool getDirectionalDerivative(const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                                      const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                                      const std::vector<double>& seed,
+                                      std::vector<double>& derivative);
+
+        /// \brief Save the state of the FMU, overwriting the one saved by a previous call
+        ///
+        /// Only the first call allocates the memory of the saved state, the following ones reuse it.
+        bool saveState();
+
+        /// \brief Restore the state saved by the last call of saveState
+        bool restoreState();
+
+        /// \brief Set input variables, the unbound ones are skipped
         bool setInputVariables(const std::vector<fmi2_value_reference_t>& inputVariableReferences,
                                const std::vector<double>& inputVariableS);
 
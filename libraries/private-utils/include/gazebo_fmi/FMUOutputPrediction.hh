@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_OUTPUT_PREDICTION_HH
+#define GAZEBO_FMI_FMU_OUTPUT_PREDICTION_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// For fmi2ValueReference
+#include <FMI2/fmi2_types.h>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the prediction of the FMU outputs from a local linear model, see parseOutputPredictionSDFElement
+    struct FMUOutputPredictionOptions
+    {
+        /// \brief True if the prediction is enabled
+        bool enabled{false};
+
+        /// \brief Maximum absolute difference of each input from its value at the last checkpoint
+        ///        for which the outputs are predicted, in the order of the input variables
+        std::vector<double> trustRegions;
+
+        /// \brief Maximum number of consecutive steps in which the FMU is not simulated
+        size_t maxSkippedSteps{10};
+    };
+
+    /// \brief Prediction of the outputs of a FMU whose inputs change little from a step to the next one
+    ///
+    /// At each checkpoint the FMU is simulated, and the Jacobian of its outputs with respect to its inputs
+    /// is obtained with fmi2GetDirectionalDerivative. In the following steps, as long as each input stays in
+    /// its trust region around the value of the checkpoint, the outputs are predicted with the linear model
+    /// and the FMU is not simulated. At the next checkpoint the FMU is first advanced over the skipped steps
+    /// with a single step, with the mean of the skipped inputs. The state of the FMU is saved before this
+    /// catch-up step, so if the FMU rejects it the state is restored and the skipped steps are simulated one by one.
+    /// The prediction error is measured at the checkpoints that follow skipped steps. The steps do not allocate memory.
+    class FMUOutputPredictor
+    {
+    private:
+        FMUOutputPredictionOptions m_options;
+        std::string m_ownerName;
+        size_t m_nrOfInputs{0};
+        size_t m_nrOfOutputs{0};
+
+        /// \brief Linear model of the last checkpoint, the Jacobian is row-major with a row for each output
+        bool m_hasModel{false};
+        std::vector<double> m_checkpointInputs;
+        std::vector<double> m_checkpointOutputs;
+        std::vector<double> m_jacobian;
+
+        /// \brief Scratch buffers of step, allocated by configure
+        std::vector<double> m_newJacobian;
+        std::vector<double> m_seed;
+        std::vector<double> m_derivative;
+        std::vector<double> m_catchUpInputs;
+
+        /// \brief Sum of the inputs of the steps skipped since the last checkpoint, used by the catch-up step
+        std::vector<double> m_skippedInputsSum;
+        size_t m_nrOfSkippedSinceCheckpoint{0};
+
+        /// \brief Time of the FMU, that is behind the simulation time when steps are skipped
+        double m_fmuTimeInSeconds{0.0};
+        bool m_canRestoreState{false};
+
+        size_t m_nrOfSteps{0};
+        size_t m_nrOfSkippedSteps{0};
+        size_t m_nrOfRestoredCatchUps{0};
+        size_t m_nrOfMeasuredErrors{0};
+        double m_accumulatedError{0.0};
+        double m_maxError{0.0};
+
+        /// \brief Compute the Jacobian in m_newJacobian, one directional derivative for each input
+        bool computeJacobian(FMUCoSimulation& fmu,
+                             const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                             const std::vector<fmi2_value_reference_t>& outputVariableReferences);
+
+        /// \brief Advance the FMU from its time to currentTimeInSeconds over the skipped steps
+        bool catchUp(FMUCoSimulation& fmu,
+                     const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                     const double currentTimeInSeconds);
+
+    public:
+        /// \brief return true if the FMU supports the prediction, otherwise print a warning
+        ///
+        /// The FMU should provide the directional derivatives and accept a variable step size.
+        static bool isSupportedBy(FMUCoSimulation& fmu, const std::string& ownerName);
+
+        /// \brief Allocate the buffers and reset the statistics
+        /// @return true if the options are consistent with the number of inputs, false otherwise
+        bool configure(const FMUOutputPredictionOptions& options, const size_t nrOfInputs,
+                       const size_t nrOfOutputs, const std::string& ownerName);
+
+        /// \brief Set the time of the FMU and, if it can save and restore its state, enable the restore of the catch-up steps
+        void setFMU(FMUCoSimulation& fmu, const double startTimeInSeconds);
+
+        /// \brief return true if the prediction is enabled and configured
+        bool isEnabled() const;
+
+        /// \brief return true if the outputs corresponding to the inputs can be predicted without simulating the FMU
+        bool canPredict(const std::vector<double>& inputs) const;
+
+        /// \brief Predict the outputs corresponding to the inputs with the linear model of the last checkpoint
+        ///
+        /// The step is counted as skipped, and its inputs are accumulated for the next catch-up step.
+        void predict(const std::vector<double>& inputs, std::vector<double>& outputs);
+
+        /// \brief Replace the linear model with the one of a simulated step
+        ///
+        /// If steps were skipped since the last checkpoint, the prediction error (the maximum absolute difference
+        /// between the outputs predicted by the previous model and the simulated ones) is measured first.
+        void setCheckpoint(const std::vector<double>& inputs, const std::vector<double>& outputs,
+                           const std::vector<double>& jacobian);
+
+        /// \brief Compute the outputs of a step, predicting them or simulating the FMU at a checkpoint
+        /// @return true if all went well, false otherwise
+        bool step(FMUCoSimulation& fmu,
+                  const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                  const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                  const double currentTimeInSeconds, const double stepSizeInSeconds,
+                  const std::vector<double>& inputs, std::vector<double>& outputs);
+
+        /// \brief Number of steps computed by predict or setCheckpoint
+        size_t getNrOfSteps() const;
+
+        /// \brief Number of steps in which the FMU was not simulated
+        size_t getNrOfSkippedSteps() const;
+
+        /// \brief Sum of the prediction errors measured at the checkpoints
+        double getAccumulatedPredictionError() const;
+
+        /// \brief Maximum prediction error measured at the checkpoints
+        double getMaxPredictionError() const;
+
+        /// \brief Print how many steps were skipped and the prediction error, if enabled
+        void printReport() const;
+    };
+}
+
+#endif
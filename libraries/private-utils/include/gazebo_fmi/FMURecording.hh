@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_RECORDING_HH
+#define GAZEBO_FMI_FMU_RECORDING_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// The recording file format is append-only, chunked and columnar. All the fields are
+/// stored in the native (little endian) byte order and are aligned to 8 bytes, so that
+/// the file can be memory mapped and each column accessed as a double array.
+///
+/// File header:
+///   char     magic[8]         "GZFMIREC"
+///   uint32   version          1
+///   uint32   nrOfChannels     number of channels, excluding the time
+///   uint64   headerSize       size in bytes of the header, including the channel names
+///   char     channelNames[]   null-terminated channel names, zero padded to a multiple of 8 bytes
+///
+/// Followed by any number of chunks:
+///   char     magic[8]         "GZFMICHK"
+///   uint64   nrOfSamples
+///   double   time[nrOfSamples]
+///   double   channel_0[nrOfSamples]
+///   ...
+///   double   channel_{nrOfChannels-1}[nrOfSamples]
+///
+/// A chunk that is truncated (for example because the simulation crashed while writing it) is ignored by the reader.
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the FMU recorder, see parseRecorderSDFElement
+    struct FMURecorderOptions
+    {
+        /// \brief True if the recorder is enabled
+        bool enabled{false};
+
+        /// \brief Path of the recording file
+        std::string filePath;
+
+        /// \brief Number of samples in each chunk
+        size_t samplesPerChunk{1000};
+    };
+
+    /// \brief Writer of FMU recording files.
+    ///
+    /// Samples are stored in one of two preallocated chunk buffers. When the active buffer is full
+    /// it is handed to a background thread that appends it to the file, while the samples are stored
+    /// in the other one. If the background thread is still writing the other buffer when the active
+    /// one is full, the new samples are dropped (and counted) so that the used memory stays bounded.
+    ///
+    /// The expected usage in a plugin update callback is:
+    /// ~~~
+    /// writer.beginSample(simulatedTimeInSeconds);
+    /// writer.setChannels(0, inputBuffers);
+    /// writer.setChannels(inputBuffers.size(), outputBuffers);
+    /// writer.endSample();
+    /// ~~~
+    class FMURecordingWriter
+    {
+    private:
+        struct ChunkBuffer
+        {
+            std::vector<double> data;
+            size_t nrOfSamples{0};
+        };
+
+        std::FILE* m_file{nullptr};
+        size_t m_nrOfChannels{0};
+        size_t m_samplesPerChunk{0};
+        ChunkBuffer m_buffers[2];
+        size_t m_activeBuffer{0};
+        bool m_droppingSample{false};
+        uint64_t m_droppedSamples{0};
+        uint64_t m_recordedSamples{0};
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        std::condition_variable m_chunkWritten;
+        std::atomic<bool> m_writerBusy{false};
+        bool m_pendingBuffer{false};
+        size_t m_pendingIndex{0};
+        bool m_stop{false};
+
+        void run();
+        bool writeChunk(const ChunkBuffer& buffer);
+
+    public:
+        FMURecordingWriter();
+        ~FMURecordingWriter();
+
+        FMURecordingWriter(const FMURecordingWriter&) = delete;
+        FMURecordingWriter& operator=(const FMURecordingWriter&) = delete;
+
+        /// \brief Create the recording file and write its header
+        /// @return true if the file was created correctly, false otherwise
+        bool open(const std::string& filePath,
+                  const std::vector<std::string>& channelNames,
+                  const size_t samplesPerChunk);
+
+        /// \brief return true if a recording file is open
+        bool isOpen() const;
+
+        /// \brief Start a new sample at the given time
+        void beginSample(const double timeInSeconds);
+
+        /// \brief Set the values of the channels [firstChannel, firstChannel+values.size()) of the current sample
+        void setChannels(const size_t firstChannel, const std::vector<double>& values);
+
+        /// \brief Set the value of a channel of the current sample
+        void setChannel(const size_t channel, const double value);
+
+        /// \brief Complete the current sample
+        void endSample();
+
+        /// \brief Block until the background thread has written the full chunk handed to it, if any
+        ///
+        /// The samples of the active chunk are not written. This blocks on the disk, so it should not be called in the physics-thread callback.
+        void waitForPendingChunk();
+
+        /// \brief Write the pending samples and close the file
+        void close();
+
+        /// \brief Number of samples dropped because the background thread was not fast enough
+        uint64_t getDroppedSamples() const;
+    };
+
+    /// \brief Reader of FMU recording files, that are memory mapped.
+    class FMURecordingReader
+    {
+    private:
+        struct Chunk
+        {
+            const double* data;
+            size_t nrOfSamples;
+            size_t firstSample;
+        };
+
+        void* m_mappedData{nullptr};
+        size_t m_mappedSize{0};
+        std::vector<std::string> m_channelNames;
+        std::vector<Chunk> m_chunks;
+        size_t m_nrOfSamples{0};
+
+        size_t findChunk(const size_t sample) const;
+
+    public:
+        FMURecordingReader() = default;
+        ~FMURecordingReader();
+
+        FMURecordingReader(const FMURecordingReader&) = delete;
+        FMURecordingReader& operator=(const FMURecordingReader&) = delete;
+
+        /// \brief Map a recording file in memory
+        /// @return true if the file was read correctly, false otherwise
+        bool open(const std::string& filePath);
+
+        /// \brief Unmap the file
+        void close();
+
+        /// \brief Names of the channels, excluding the time
+        const std::vector<std::string>& getChannelNames() const;
+
+        /// \brief Get the index of a channel given its name
+        /// @return true if the channel was found, false otherwise
+        bool getChannelIndex(const std::string& channelName, size_t& channelIndex) const;
+
+        /// \brief Total number of samples in the file
+        size_t getNrOfSamples() const;
+
+        /// \brief Time of the specified sample
+        double getTime(const size_t sample) const;
+
+        /// \brief Value of the specified channel in the specified sample
+        double getValue(const size_t sample, const size_t channel) const;
+
+        /// \brief Find the last sample whose time is smaller or equal than timeInSeconds+tolerance
+        /// @param[in] hint index of a sample from which the search starts, useful for sequential access
+        /// @return true if such a sample exists, false otherwise
+        bool findSample(const double timeInSeconds, const double tolerance, size_t hint, size_t& sample) const;
+    };
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_REPLAY_HH
+#define GAZEBO_FMI_FMU_REPLAY_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gazebo_fmi/FMURecording.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the FMU replay, see parseReplaySDFElement
+    struct FMUReplayOptions
+    {
+        /// \brief True if the replay is enabled
+        bool enabled{false};
+
+        /// \brief Path of the recording file to replay
+        std::string filePath;
+
+        /// \brief True if the live inputs should be compared with the recorded ones
+        bool checkInputs{false};
+
+        /// \brief Maximum absolute difference between a live and a recorded input
+        double inputTolerance{1e-6};
+    };
+
+    /// \brief Replay of the outputs of a set of FMUs from a recording written by FMURecordingWriter.
+    ///
+    /// Each FMU is registered with the names of the channels of its inputs and outputs, that need to
+    /// be present in the recording. At each step, seek selects the last recorded sample whose time is not
+    /// greater than the current simulated time (i.e. the recorded outputs are held constant between samples),
+    /// then getOutputs copies the recorded outputs in the output buffers of the FMU, and checkInputs (if enabled)
+    /// compares the live inputs with the recorded ones, to detect when the simulation diverged from the recording.
+    ///
+    /// The expected usage in a plugin update callback is:
+    /// ~~~
+    /// replayer.seek(simulatedTimeInSeconds);
+    /// replayer.checkInputs(i, inputBuffers);
+    /// replayer.getOutputs(i, outputBuffers);
+    /// ~~~
+    class FMUReplayer
+    {
+    private:
+        struct ReplayedFMU
+        {
+            std::vector<size_t> inputChannels;
+            std::vector<size_t> outputChannels;
+        };
+
+        FMUReplayOptions m_options;
+        std::string m_ownerName;
+        FMURecordingReader m_reader;
+        std::vector<ReplayedFMU> m_fmus;
+        size_t m_sample{0};
+        bool m_validSample{false};
+        bool m_reportedMissingSample{false};
+        bool m_reportedEndOfRecording{false};
+        std::vector<bool> m_reportedDivergence;
+        uint64_t m_divergentSamples{0};
+        double m_maxInputError{0.0};
+
+        bool getChannels(const std::vector<std::string>& channelNames, std::vector<size_t>& channels);
+
+    public:
+        /// \brief Open the recording
+        /// @param[in] ownerName name used to identify the owner (i.e. the plugin) in the messages
+        /// @return true if the recording was opened correctly, false otherwise
+        bool open(const FMUReplayOptions& options, const std::string& ownerName);
+
+        /// \brief return true if a recording was opened
+        bool isEnabled() const;
+
+        /// \brief Register a FMU, whose index is the number of FMUs registered before it
+        /// @return true if all the channels were found in the recording, false otherwise
+        bool addFMU(const std::vector<std::string>& inputChannelNames,
+                    const std::vector<std::string>& outputChannelNames);
+
+        /// \brief Select the recorded sample corresponding to the specified simulated time
+        /// @return true if a sample was found, false if the time is before the beginning of the recording
+        bool seek(const double timeInSeconds);
+
+        /// \brief Copy the recorded outputs of the i-th FMU in outputs, that is not modified if seek failed
+        void getOutputs(const size_t fmuIndex, std::vector<double>& outputs) const;
+
+        /// \brief Compare the live inputs of the i-th FMU with the recorded ones, if the check_inputs option is enabled
+        /// @return true if the inputs are within tolerance (or the check is disabled), false otherwise
+        bool checkInputs(const size_t fmuIndex, const std::vector<double>& inputs);
+
+        /// \brief Number of (FMU, sample) pairs in which the live inputs diverged from the recorded ones
+        uint64_t getNrOfDivergentSamples() const;
+
+        /// \brief Print a summary of the input check on the Gazebo console
+        void printReport() const;
+    };
+}
+
+#endif
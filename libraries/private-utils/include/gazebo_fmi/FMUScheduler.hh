@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_SCHEDULER_HH
+#define GAZEBO_FMI_FMU_SCHEDULER_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gazebo_fmi/RealTimeBudgetMonitor.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+#include <gazebo_fmi/WorkerPool.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the world scheduler of the FMUs, see parseSchedulerSDFElement
+    struct FMUSchedulerOptions
+    {
+        /// \brief Number of threads in which the FMUs of all the plugins are stepped
+        size_t nrOfThreads{1};
+
+        /// \brief Number of physics steps between two partitions of the FMUs over the threads
+        size_t rebalancePeriod{100};
+
+        /// \brief Budget of the step phase, in which the FMUs of all the plugins are stepped
+        RealTimeBudgetOptions budget;
+    };
+
+    /// \brief Plugin instance whose FMUs are stepped by the FMUScheduler
+    struct FMUSchedulerClient
+    {
+        /// \brief Name of the plugin instance, used in the log messages
+        std::string name;
+
+        /// \brief Number of FMU steps of the plugin, that can run concurrently with each other and with the ones of the other plugins
+        size_t nrOfTasks{0};
+
+        /// \brief Names of the FMUs of the tasks, used in the messages of the real-time budget monitor
+        ///
+        /// If it has less than nrOfTasks elements, the missing tasks are named by their index.
+        std::vector<std::string> taskNames;
+
+        /// \brief Read the state of the simulation and set the FMU inputs, called in the physics thread
+        std::function<void(double simulatedTimeInSeconds, double stepSizeInSeconds)> gather;
+
+        /// \brief Step the task-th FMU, called in any of the threads of the scheduler
+        std::function<void(size_t task)> step;
+
+        /// \brief Apply the FMU outputs to the simulation, called in the physics thread
+        std::function<void()> scatter;
+    };
+
+    /// \brief Partition of tasks of known cost over a set of bins, with the Longest Processing Time first rule
+    ///
+    /// The tasks are sorted by decreasing cost, and each task is assigned to the bin with the smallest total cost
+    /// (or with the fewest tasks among the ones with the same cost), so the largest total cost of a bin is at most
+    /// 4/3 of the optimal one. In each bin the tasks are sorted by decreasing cost.
+    class FMUTaskPartition
+    {
+    private:
+        std::vector<size_t> m_order;
+        std::vector<size_t> m_taskBins;
+        std::vector<size_t> m_binTasks;
+        std::vector<size_t> m_binOffsets;
+        std::vector<size_t> m_binSizes;
+        std::vector<double> m_binCosts;
+
+    public:
+        /// \brief Allocate the partition of nrOfTasks tasks over nrOfBins bins, initially assigned round robin
+        void resize(const size_t nrOfTasks, const size_t nrOfBins);
+
+        /// \brief Partition the tasks given their costs, an array of getNrOfTasks elements
+        ///
+        /// The method does not allocate memory.
+        void compute(const double* costs);
+
+        size_t getNrOfTasks() const;
+        size_t getNrOfBins() const;
+
+        /// \brief Tasks of a bin, i.e. the elements [getBinBegin(bin), getBinEnd(bin)) of getBinTasks
+        size_t getBinBegin(const size_t bin) const;
+        size_t getBinEnd(const size_t bin) const;
+        const std::vector<size_t>& getBinTasks() const;
+
+        /// \brief Total cost of the tasks of a bin, with the costs of the last call of compute
+        double getBinCost(const size_t bin) const;
+    };
+
+    /// \brief Scheduler that steps the FMUs of all the FMI plugins of the world in a single cycle per physics step.
+    ///
+    /// Each plugin registers a FMUSchedulerClient, and at each physics step runCycle calls the gather function of all
+    /// the clients, then steps all their FMUs in parallel over a WorkerPool, and finally calls the scatter function
+    /// of all the clients. The FMUs are partitioned over the threads with FMUTaskPartition, using as cost of each FMU
+    /// an exponential moving average of the wall-clock time of its steps, and the partition is updated every
+    /// rebalancePeriod physics steps.
+    ///
+    /// If the budget option is enabled, the wall-clock time of the step phase of each cycle, i.e. of the FMUs of all
+    /// the clients, is compared with the budget by a RealTimeBudgetMonitor, and the deadline misses are attributed
+    /// to the most expensive FMU of the world. The monitor is configured again, and its statistics reset, when a client
+    /// is added or removed.
+    ///
+    /// A single instance is shared by all the plugins of the process: it is configured by the FMISchedulerPlugin
+    /// world plugin, and the model plugins register with it only if it is enabled. When the world plugin is unloaded
+    /// it calls disable, that removes all the clients: each model plugin should then check isEnabled in its own
+    /// physics update callback, and step its FMUs again when it returns false. runCycle does not allocate memory,
+    /// while addClient and removeClient do, and should be called when loading and unloading the plugins.
+    class FMUScheduler
+    {
+    private:
+        struct Task
+        {
+            uint64_t clientId;
+            size_t client;
+            size_t index;
+        };
+
+        struct RegisteredClient
+        {
+            uint64_t id;
+            FMUSchedulerClient client;
+        };
+
+        std::atomic<bool> m_enabled{false};
+        FMUSchedulerOptions m_options;
+        std::string m_ownerName;
+
+        /// \brief Clients and their tasks, protected by m_mutex
+        std::mutex m_mutex;
+        std::vector<RegisteredClient> m_clients;
+        uint64_t m_nextClientId{1};
+        std::vector<Task> m_tasks;
+
+        /// \brief Average wall-clock time of the step of each task, negative if it was never measured
+        std::vector<double> m_taskCosts;
+        std::vector<double> m_partitionCosts;
+        FMUTaskPartition m_partition;
+        bool m_partitionValid{false};
+        uint64_t m_cycles{0};
+
+        RealTimeSafetyMonitor m_realTimeMonitor;
+        RealTimeBudgetMonitor m_budgetMonitor;
+        WorkerPool m_workerPool;
+        std::function<void(size_t)> m_runBinTask;
+
+        FMUScheduler();
+
+        /// \brief Rebuild the tasks after a change of the clients, with m_mutex locked
+        void rebuildTasks();
+
+        void updatePartition();
+
+        void runBin(const size_t bin);
+
+    public:
+        ~FMUScheduler();
+
+        FMUScheduler(const FMUScheduler&) = delete;
+        FMUScheduler& operator=(const FMUScheduler&) = delete;
+
+        /// \brief Get the instance shared by all the plugins of the process
+        static std::shared_ptr<FMUScheduler> getInstance();
+
+        /// \brief Enable the scheduler and spawn its threads
+        /// @return true if the scheduler was configured correctly, false otherwise
+        bool configure(const FMUSchedulerOptions& options, const std::string& ownerName);
+
+        /// \brief Disable the scheduler and remove all its clients, so that it can be configured again
+        void disable();
+
+        /// \brief return true if the scheduler is configured and not disabled, i.e. if it steps the FMUs of its clients
+        bool isEnabled() const;
+
+        /// \brief Register a plugin, whose FMUs are stepped by runCycle until removeClient is called
+        /// @return an identifier of the client, to pass to removeClient
+        uint64_t addClient(const FMUSchedulerClient& client);
+
+        /// \brief Unregister a plugin
+        void removeClient(const uint64_t clientId);
+
+        /// \brief Number of FMU steps of all the clients
+        size_t getNrOfTasks();
+
+        /// \brief Gather the inputs, step the FMUs and scatter the outputs of all the clients
+        void runCycle(const double simulatedTimeInSeconds, const double stepSizeInSeconds);
+
+        /// \brief Statistics of the real-time budget of the step phase
+        const RealTimeBudgetStatistics& getBudgetStatistics();
+
+        /// \brief Print the estimated load of the threads, and the report of the real-time budget
+        void printReport();
+    };
+}
+
+#endif
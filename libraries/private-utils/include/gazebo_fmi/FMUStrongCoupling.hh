@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_STRONG_COUPLING_HH
+#define GAZEBO_FMI_FMU_STRONG_COUPLING_HH
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// For fmi2ValueReference
+#include <FMI2/fmi2_types.h>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Acceleration of the fixed-point iterations of FMUStrongCoupling
+    enum class CouplingAcceleration
+    {
+        /// \brief Constant under-relaxation of the residual
+        constant,
+        /// \brief Dynamic relaxation computed with the Aitken delta-squared method
+        aitken,
+        /// \brief Interface quasi-Newton with an inverse Jacobian from a least-squares model (IQN-ILS)
+        iqnIls
+    };
+
+    /// \brief Options of the strong coupling of a FMU, see parseStrongCouplingSDFElement
+    struct FMUStrongCouplingOptions
+    {
+        /// \brief True if the strong coupling is enabled
+        bool enabled{false};
+
+        /// \brief Acceleration of the iterations
+        CouplingAcceleration acceleration{CouplingAcceleration::iqnIls};
+
+        /// \brief Maximum number of FMU steps in a physics step
+        size_t maxIterations{10};
+
+        /// \brief Maximum absolute change of the outputs between two iterations for which the iterations converged
+        double tolerance{1e-6};
+
+        /// \brief Relaxation of the first iteration (and of all the iterations with CouplingAcceleration::constant)
+        double relaxation{0.5};
+    };
+
+    /// \brief Convert a string (constant, aitken, iqn-ils) to a CouplingAcceleration
+    /// @return true if the string is a valid acceleration, false otherwise
+    bool parseCouplingAcceleration(const std::string& accelerationString, CouplingAcceleration& acceleration);
+
+    /// \brief Function evaluating the system coupled with the FMU: it fills the FMU inputs consistent with the FMU outputs
+    typedef std::function<void(const std::vector<double>& outputs, std::vector<double>& inputs)> CouplingPlantFunction;
+
+    /// \brief Function evaluating the FMU: it fills the FMU outputs corresponding to the FMU inputs
+    /// @return true if the outputs were computed correctly, false otherwise
+    typedef std::function<bool(const std::vector<double>& inputs, std::vector<double>& outputs)> CouplingEvaluateFunction;
+
+    /// \brief Strong coupling of a FMU with the system that computes its inputs from its outputs
+    ///
+    /// In each step the FMU step is run again from the same saved state with corrected inputs, until its outputs
+    /// converge or the maximum number of iterations is reached. The inputs of each iteration are computed from
+    /// the residual between the inputs given by the system and the ones of the previous iteration, with a
+    /// constant relaxation, the Aitken relaxation or the IQN-ILS quasi-Newton method. The steps do not allocate memory.
+    class FMUStrongCoupling
+    {
+    private:
+        FMUStrongCouplingOptions m_options;
+        std::string m_ownerName;
+        size_t m_nrOfInputs{0};
+        size_t m_nrOfOutputs{0};
+
+        /// \brief Iterate, system response and residual of the current and of the previous iteration
+        std::vector<double> m_system;
+        std::vector<double> m_residual;
+        std::vector<double> m_previousSystem;
+        std::vector<double> m_previousResidual;
+        std::vector<double> m_previousOutputs;
+        double m_aitkenRelaxation{0.0};
+
+        /// \brief Differences of the residuals (V) and of the system responses (W) of IQN-ILS, newest column first
+        size_t m_maxNrOfColumns{0};
+        size_t m_nrOfColumns{0};
+        std::vector<double> m_residualDifferences;
+        std::vector<double> m_systemDifferences;
+
+        /// \brief Scratch buffers of the least-squares problem of IQN-ILS, solved with a QR decomposition
+        std::vector<double> m_q;
+        std::vector<double> m_r;
+        std::vector<double> m_coefficients;
+        std::vector<size_t> m_keptColumns;
+
+        size_t m_nrOfSteps{0};
+        size_t m_nrOfIterations{0};
+        size_t m_maxIterationsInAStep{0};
+        size_t m_nrOfNotConvergedSteps{0};
+        double m_accumulatedResidual{0.0};
+        double m_maxResidual{0.0};
+
+        /// \brief Compute the inputs of the next iteration, k is the index of the current one
+        void computeNextInputs(const size_t k, std::vector<double>& inputs);
+
+        /// \brief Add the differences with the previous iteration to the IQN-ILS model and compute its inputs
+        void computeQuasiNewtonInputs(std::vector<double>& inputs);
+
+        template<typename Evaluate>
+        bool iterateImpl(Evaluate& evaluate, const CouplingPlantFunction& plant,
+                         std::vector<double>& inputs, std::vector<double>& outputs);
+
+    public:
+        /// \brief return true if the FMU supports the strong coupling, otherwise print a warning
+        ///
+        /// The FMU should be able to save and restore its state.
+        static bool isSupportedBy(FMUCoSimulation& fmu, const std::string& ownerName);
+
+        /// \brief Allocate the buffers and reset the statistics
+        /// @return true if the options are valid, false otherwise
+        bool configure(const FMUStrongCouplingOptions& options, const size_t nrOfInputs,
+                       const size_t nrOfOutputs, const std::string& ownerName);
+
+        /// \brief return true if the strong coupling is enabled and configured
+        bool isEnabled() const;
+
+        /// \brief Iterate the evaluation of the FMU and of the system until the outputs converge
+        ///
+        /// @param[in,out] inputs initial guess of the inputs, on return the inputs of the last evaluation
+        /// @param[out] outputs the outputs of the last evaluation
+        /// @return true if all the evaluations went well (even if the iterations did not converge), false otherwise
+        bool iterate(const CouplingEvaluateFunction& evaluate, const CouplingPlantFunction& plant,
+                     std::vector<double>& inputs, std::vector<double>& outputs);
+
+        /// \brief Iterate the step of the FMU from the same state until its outputs converge
+        ///
+        /// On return the FMU is in the state reached with the inputs of the last iteration.
+        /// @param[in,out] inputs initial guess of the inputs, on return the inputs of the last iteration
+        /// @return true if all went well (even if the iterations did not converge), false otherwise
+        bool step(FMUCoSimulation& fmu,
+                  const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                  const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                  const double currentTimeInSeconds, const double stepSizeInSeconds,
+                  const CouplingPlantFunction& plant,
+                  std::vector<double>& inputs, std::vector<double>& outputs);
+
+        /// \brief Number of steps computed by iterate or step
+        size_t getNrOfSteps() const;
+
+        /// \brief Total number of iterations (FMU evaluations) of all the steps
+        size_t getNrOfIterations() const;
+
+        /// \brief Number of steps in which the maximum number of iterations was reached without convergence
+        size_t getNrOfNotConvergedSteps() const;
+
+        /// \brief Maximum change of the outputs in the last iteration of a step
+        double getMaxResidual() const;
+
+        /// \brief Print the iteration counts and the residuals, if enabled
+        void printReport() const;
+    };
+}
+
+#endif
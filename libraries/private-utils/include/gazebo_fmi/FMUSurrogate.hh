@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_SURROGATE_HH
+#define GAZEBO_FMI_FMU_SURROGATE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// For fmi2ValueReference
+#include <FMI2/fmi2_types.h>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Interpolation of the values of a FMUSurrogateTable between the grid nodes
+    enum class SurrogateInterpolation
+    {
+        /// \brief Multilinear interpolation (trilinear for three inputs), using 2 nodes per input
+        linear,
+        /// \brief Tensor product of Catmull-Rom cubic splines, using 4 nodes per input
+        cubic
+    };
+
+    /// \brief Uniform sampling of an input of the surrogate table
+    struct SurrogateGridAxis
+    {
+        /// \brief Value of the input on the first node
+        double min{-10.0};
+
+        /// \brief Value of the input on the last node
+        double max{10.0};
+
+        /// \brief Number of nodes, at least 2
+        size_t points{41};
+    };
+
+    /// \brief Options of the tabulated surrogate of a stateless FMU, see parseSurrogateSDFElement
+    struct FMUSurrogateOptions
+    {
+        /// \brief True if the surrogate is enabled
+        bool enabled{false};
+
+        /// \brief Interpolation between the grid nodes
+        SurrogateInterpolation interpolation{SurrogateInterpolation::linear};
+
+        /// \brief Grid of each input, in the order of the input variables
+        std::vector<SurrogateGridAxis> axes;
+
+        /// \brief Directory of the cached tables, if empty getDefaultSurrogateCacheDirectory is used
+        std::string cacheDirectory;
+    };
+
+    /// \brief Convert a string (linear, cubic) to a SurrogateInterpolation
+    /// @return true if the string is a valid interpolation, false otherwise
+    bool parseSurrogateInterpolation(const std::string& interpolationString, SurrogateInterpolation& interpolation);
+
+    /// \brief Directory of the cached surrogate tables used if no cache directory is specified,
+    ///        i.e. $XDG_CACHE_HOME/gazebo-fmi/surrogates, $HOME/.cache/gazebo-fmi/surrogates or a temporary directory
+    std::string getDefaultSurrogateCacheDirectory();
+
+    /// \brief FNV-1a hash of the content of a file
+    /// @return true if the file was read correctly, false otherwise
+    bool computeFileHash(const std::string& filePath, uint64_t& hash);
+
+    /// \brief Function sampled to build a FMUSurrogateTable, it fills the outputs corresponding to the inputs
+    /// @return true if the outputs were computed correctly, false otherwise
+    typedef std::function<bool(const std::vector<double>& inputs, std::vector<double>& outputs)> SurrogateSampleFunction;
+
+    /// \brief Table of the outputs of a function of its inputs, sampled on a uniform grid and interpolated between the nodes
+    ///
+    /// The outputs of each node are contiguous in memory, so the interpolation accumulates the weighted
+    /// outputs of each node with a loop that the compiler can vectorize. The evaluation does not allocate
+    /// memory, and the inputs outside of the grid are clamped to its boundary.
+    class FMUSurrogateTable
+    {
+    private:
+        std::vector<SurrogateGridAxis> m_axes;
+        size_t m_nrOfOutputs{0};
+        SurrogateInterpolation m_interpolation{SurrogateInterpolation::linear};
+
+        /// \brief Outputs of the nodes, the first input is the fastest varying index of the nodes
+        std::vector<double> m_values;
+
+        /// \brief Distance in the values between two consecutive nodes of each input
+        std::vector<size_t> m_strides;
+
+        /// \brief Scratch buffers of evaluate, allocated by build and load
+        std::vector<size_t> m_tapOffsets;
+        std::vector<double> m_tapWeights;
+        std::vector<size_t> m_tapCounters;
+
+        size_t m_nrOfClampedEvaluations{0};
+
+        void configure(const std::vector<SurrogateGridAxis>& axes, const size_t nrOfOutputs,
+                       const SurrogateInterpolation interpolation);
+
+    public:
+        /// \brief Sample a function on the nodes of the grid
+        /// @return true if the table was built correctly, false otherwise
+        bool build(const std::vector<SurrogateGridAxis>& axes, const size_t nrOfOutputs,
+                   const SurrogateInterpolation interpolation, const SurrogateSampleFunction& sample);
+
+        /// \brief Write the table to a file, tagged with a key
+        /// @return true if the file was written correctly, false otherwise
+        bool save(const std::string& filePath, const uint64_t key) const;
+
+        /// \brief Read a table written by save
+        /// @return true if the file exists, is tagged with the same key and has the same grid and number of outputs,
+        ///         false otherwise
+        bool load(const std::string& filePath, const uint64_t key, const std::vector<SurrogateGridAxis>& axes,
+                  const size_t nrOfOutputs, const SurrogateInterpolation interpolation);
+
+        /// \brief return true if the table was built or loaded
+        bool isValid() const;
+
+        /// \brief Interpolate the outputs corresponding to the inputs
+        /// @return true if the inputs and outputs have the sizes of the table, false otherwise
+        bool evaluate(const std::vector<double>& inputs, std::vector<double>& outputs);
+
+        /// \brief Number of evaluations in which at least an input was outside of the grid
+        size_t getNrOfClampedEvaluations() const;
+
+        /// \brief Number of nodes of the grid
+        size_t getNrOfNodes() const;
+    };
+
+    /// \brief Load the surrogate table of a stateless FMU from the cache, or sample the FMU and store the table in the cache
+    ///
+    /// The cached tables are named after the hash of the FMU file and of the sampled variables and grid, so
+    /// a table is sampled again when the FMU changes. The FMU is sampled by setting the inputs and advancing it
+    /// by stepSizeInSeconds from startTimeInSeconds (the start time used to load it), so it should be stateless,
+    /// see FMUCoSimulation::isStateless.
+    /// @return true if the table was loaded or built correctly, false otherwise
+    bool loadOrBuildFMUSurrogate(FMUSurrogateTable& table,
+                                 const FMUSurrogateOptions& options,
+                                 const std::string& fmuAbsolutePath,
+                                 FMUCoSimulation& fmu,
+                                 const std::vector<fmi2_value_reference_t>& inputVariableReferences,
+                                 const std::vector<fmi2_value_reference_t>& outputVariableReferences,
+                                 const double startTimeInSeconds,
+                                 const double stepSizeInSeconds,
+                                 const std::string& ownerName);
+}
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FMU_VARIABLE_STREAMING_HH
+#define GAZEBO_FMI_FMU_VARIABLE_STREAMING_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gazebo/msgs/msgs.hh>
+#include <gazebo/transport/transport.hh>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the streaming of FMU variables, see parseVariableStreamingSDFElement
+    struct FMUVariableStreamingOptions
+    {
+        /// \brief True if the streaming is enabled
+        bool enabled{false};
+
+        /// \brief Namespace of the topics, if empty the plugin uses ~/<scoped model name>/fmu_variables
+        std::string topic;
+
+        /// \brief Maximum number of variables of a stream
+        size_t maxVariablesPerStream{64};
+
+        /// \brief Number of samples that can wait to be published, the following ones are dropped
+        size_t queueSize{64};
+    };
+
+    /// \brief Read the values of some variables of a FMU, e.g. with FMUCoSimulation::getOutputVariables
+    using FMUVariableReadFunction = std::function<bool(const std::vector<fmi2_value_reference_t>& variableReferences,
+                                                       std::vector<double>& values)>;
+
+    /// \brief Publish a sample of a stream, called in the publishing thread of the FMUVariableStreamer
+    using FMUVariableStreamPublishFunction = std::function<void(const std::string& streamName, const double simulatedTimeInSeconds,
+                                                                const std::vector<double>& values)>;
+
+    /// \brief Streams of arbitrary FMU variables requested by clients, read in the physics thread and published by a background thread.
+    ///
+    /// The variables of the FMUs added with addFMU form a catalogue, in which each variable is named fmuName/variableName.
+    /// A client requests a stream of some variables of the catalogue with requestStream, and at every decimation-th call
+    /// of update the variables of each stream are read with a single batched read per FMU, and the sample is queued to
+    /// the publishing thread. Until a stream is requested update only checks an atomic flag, so the streaming costs
+    /// nothing without clients.
+    ///
+    /// The expected usage is:
+    /// ~~~
+    /// // In Load, after loading the FMUs
+    /// streamer.configure(options, ownerName, publish);
+    /// streamer.addFMU(fmuName, fmu);
+    /// // In any thread, e.g. in the callback of a Gazebo transport subscriber
+    /// streamer.requestStream(streamName, variableNames, decimation);
+    /// // In the physics thread, after stepping all the FMUs
+    /// streamer.update(simulatedTimeInSeconds);
+    /// ~~~
+    /// A new set of streams is picked up by update without blocking it, and update does not allocate memory.
+    /// If the publishing thread falls behind, the samples that do not fit in the queue are dropped and counted.
+    class FMUVariableStreamer
+    {
+    private:
+        struct CatalogueFMU
+        {
+            std::string name;
+            FMUVariableReadFunction read;
+        };
+
+        struct CatalogueVariable
+        {
+            size_t fmu;
+            fmi2_value_reference_t reference;
+        };
+
+        struct StreamRequest
+        {
+            std::string name;
+            std::vector<size_t> variables;
+            size_t decimation;
+        };
+
+        /// \brief Batched read of the variables of a stream that belong to the same FMU
+        struct StreamRead
+        {
+            size_t fmu;
+            std::vector<fmi2_value_reference_t> references;
+            std::vector<double> values;
+
+            /// \brief Position of each value in the sample of the stream
+            std::vector<size_t> positions;
+        };
+
+        struct Stream
+        {
+            std::shared_ptr<const std::string> name;
+            size_t decimation;
+            size_t nrOfValues;
+            std::vector<StreamRead> reads;
+            uint64_t calls{0};
+        };
+
+        struct Sample
+        {
+            std::shared_ptr<const std::string> streamName;
+            double time{0.0};
+            size_t nrOfValues{0};
+        };
+
+        bool m_enabled{false};
+        FMUVariableStreamingOptions m_options;
+        std::string m_ownerName;
+        FMUVariableStreamPublishFunction m_publish;
+
+        std::vector<CatalogueFMU> m_fmus;
+        std::vector<std::string> m_catalogue;
+        std::vector<CatalogueVariable> m_catalogueVariables;
+
+        /// \brief Requested streams, and the streams built from them that update has not picked up yet, protected by m_requestMutex
+        std::mutex m_requestMutex;
+        std::vector<StreamRequest> m_requests;
+        std::unique_ptr<std::vector<Stream>> m_pendingStreams;
+        std::atomic<bool> m_pendingChange{false};
+
+        /// \brief Streams read by update, used only in the physics thread
+        std::unique_ptr<std::vector<Stream>> m_activeStreams;
+        bool m_reportedReadFailure{false};
+
+        /// \brief Single producer single consumer queue of samples, with preallocated values
+        std::vector<Sample> m_samples;
+        std::vector<double> m_sampleValues;
+        std::atomic<uint64_t> m_queueHead{0};
+        std::atomic<uint64_t> m_queueTail{0};
+        std::atomic<uint64_t> m_droppedSamples{0};
+        uint64_t m_queuedSamples{0};
+
+        std::thread m_thread;
+        std::mutex m_threadMutex;
+        std::condition_variable m_wakeUp;
+        bool m_stop{false};
+
+        void run();
+        void applyPendingStreams();
+        std::unique_ptr<std::vector<Stream>> buildStreams() const;
+
+    public:
+        FMUVariableStreamer();
+        ~FMUVariableStreamer();
+
+        FMUVariableStreamer(const FMUVariableStreamer&) = delete;
+        FMUVariableStreamer& operator=(const FMUVariableStreamer&) = delete;
+
+        /// \brief Allocate the queue of the samples and start the publishing thread
+        /// @return true if the streamer was configured correctly, false otherwise
+        bool configure(const FMUVariableStreamingOptions& options, const std::string& ownerName,
+                       const FMUVariableStreamPublishFunction& publish);
+
+        /// \brief return true if the streamer was configured
+        bool isEnabled() const;
+
+        /// \brief Add the variables of a FMU to the catalogue, should be called before any call of requestStream
+        /// @return true if the variables were added correctly, false otherwise
+        bool addFMU(const std::string& fmuName,
+                    const std::vector<std::string>& variableNames,
+                    const std::vector<fmi2_value_reference_t>& variableReferences,
+                    const FMUVariableReadFunction& read);
+
+        /// \brief Add the Real inputs, outputs and local variables of a loaded FMU to the catalogue
+        bool addFMU(const std::string& fmuName, FMUCoSimulation& fmu);
+
+        /// \brief Names of the variables that can be streamed, in the form fmuName/variableName
+        const std::vector<std::string>& getCatalogue() const;
+
+        /// \brief Request a stream of some variables of the catalogue, sampled every decimation calls of update
+        ///
+        /// A request with the name of an existing stream replaces it, and a request with no variables removes it,
+        /// whatever its decimation (that should be positive in the other requests).
+        /// The stream name can contain only letters, digits and underscores, so that it can be used in a topic name.
+        /// @return true if the request is valid, false otherwise
+        bool requestStream(const std::string& streamName, const std::vector<std::string>& variableNames, const size_t decimation);
+
+        /// \brief Read the variables of the streams that are due and queue the samples to the publishing thread
+        ///
+        /// Should be called in the physics thread when none of the FMUs is being stepped.
+        void update(const double simulatedTimeInSeconds);
+
+        /// \brief Number of streams read by update
+        size_t getNrOfActiveStreams() const;
+
+        /// \brief Publish the queued samples and stop the publishing thread
+        void close();
+
+        /// \brief Number of samples dropped because the publishing thread was not fast enough
+        uint64_t getDroppedSamples() const;
+
+        /// \brief Print the number of published and dropped samples
+        void printReport();
+    };
+
+    /// \brief Gazebo transport interface of a FMUVariableStreamer
+    ///
+    /// The topics are in the namespace passed to advertise:
+    /// - catalogue: the catalogue of the streamer, as a gazebo::msgs::GzString_V, to be subscribed with latching;
+    /// - request: the requests of the clients, as a gazebo::msgs::GzString_V whose elements are the stream name,
+    ///   the decimation and then the names of the variables;
+    /// - streams/<stream name>: the samples of a stream, as a gazebo::msgs::Double_V whose first element is the
+    ///   simulated time and the following ones are the values of the variables, in the order of the request.
+    /// A sample is serialized only if the topic of its stream has subscribers.
+    class FMUVariableStreamTopics
+    {
+    private:
+        FMUVariableStreamer* m_streamer{nullptr};
+        std::string m_topic;
+        std::string m_ownerName;
+
+        gazebo::transport::NodePtr m_node;
+        gazebo::transport::PublisherPtr m_cataloguePublisher;
+        gazebo::transport::SubscriberPtr m_requestSubscriber;
+        gazebo::msgs::GzString_V m_catalogueMessage;
+
+        /// \brief Publishers of the streams, used only in the publishing thread of the streamer
+        std::map<std::string, gazebo::transport::PublisherPtr> m_streamPublishers;
+        gazebo::msgs::Double_V m_sampleMessage;
+
+        void onRequest(const boost::shared_ptr<gazebo::msgs::GzString_V const>& request);
+
+    public:
+        /// \brief Advertise the catalogue of the streamer and subscribe to the requests
+        /// @return true if the topics were advertised correctly, false otherwise
+        bool advertise(FMUVariableStreamer& streamer, const std::string& worldName, const std::string& topic,
+                       const std::string& ownerName);
+
+        /// \brief Publish a sample, to be used as FMUVariableStreamPublishFunction of the streamer
+        void publish(const std::string& streamName, const double simulatedTimeInSeconds, const std::vector<double>& values);
+    };
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_FLOW_FIELD_HH
+#define GAZEBO_FMI_FLOW_FIELD_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the wind/current field, see parseFlowFieldSDFElement
+    struct FlowFieldOptions
+    {
+        /// \brief True if the flow field is enabled
+        bool enabled{false};
+
+        /// \brief Path of the flow field file
+        std::string filePath;
+
+        /// \brief Offset in seconds added to the simulated time before sampling the field
+        double timeOffset{0.0};
+    };
+
+    /// \brief Uniform grid of a flow field, with nt=1 for a field that does not depend on time
+    struct FlowFieldGrid
+    {
+        /// \brief Number of nodes along x, y, z and time
+        std::array<uint64_t, 4> points{{1, 1, 1, 1}};
+
+        /// \brief Coordinates of the first node in the world frame, and time of the first sample, in m and s
+        std::array<double, 4> origin{{0.0, 0.0, 0.0, 0.0}};
+
+        /// \brief Distance between two consecutive nodes along x, y, z and time, in m and s
+        std::array<double, 4> spacing{{1.0, 1.0, 1.0, 1.0}};
+
+        /// \brief Total number of nodes
+        uint64_t getNrOfNodes() const;
+    };
+
+    /// \brief Write a flow field file
+    ///
+    /// velocities contains the three components of the velocity of each node, with the x index varying fastest
+    /// and then y, z and time, i.e. the velocity of the node (i, j, k, l) starts at 3*(((l*nz + k)*ny + j)*nx + i).
+    /// @return true if the file was written correctly, false otherwise
+    bool writeFlowFieldFile(const std::string& filePath, const FlowFieldGrid& grid, const std::vector<double>& velocities);
+
+    /// \brief Velocity of a fluid (wind or current) in the world, read from a memory-mapped grid file.
+    ///
+    /// The velocity is sampled with a linear interpolation along each of the axes of the grid (trilinear in space,
+    /// and linear in time if the grid has more than one time sample). Outside the grid the field is clamped to
+    /// its boundary. The file is mapped read-only and never modified, so sample can be called concurrently by
+    /// several threads, and instances obtained with getShared are shared by all the users in the process.
+    class FlowField
+    {
+    private:
+        void* m_mappedData{nullptr};
+        size_t m_mappedSize{0};
+        FlowFieldGrid m_grid;
+        const double* m_velocities{nullptr};
+
+    public:
+        FlowField() = default;
+        ~FlowField();
+
+        FlowField(const FlowField&) = delete;
+        FlowField& operator=(const FlowField&) = delete;
+
+        /// \brief Get the flow field of a file, shared with all the other users of the same file in the process
+        ///
+        /// The file is mapped when it is first requested, and unmapped when the last std::shared_ptr is released.
+        /// @return the flow field, or an empty pointer if the file could not be read
+        static std::shared_ptr<const FlowField> getShared(const std::string& filePath);
+
+        /// \brief Map a flow field file in memory
+        /// @return true if the file was read correctly, false otherwise
+        bool open(const std::string& filePath);
+
+        /// \brief Unmap the file
+        void close();
+
+        /// \brief Grid of the field
+        const FlowFieldGrid& getGrid() const;
+
+        /// \brief Velocity of the fluid at the specified point of the world and time
+        ///
+        /// The method does not allocate memory.
+        /// @return true if the point and time are inside the grid, false if the field was clamped to its boundary
+        bool sample(const double x, const double y, const double z, const double timeInSeconds,
+                    double& velocity_x, double& velocity_y, double& velocity_z) const;
+    };
+}
+
+#endif
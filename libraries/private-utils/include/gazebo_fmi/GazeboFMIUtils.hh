@@ -11,52 +11,308 @@
 #ifndef GAZEBO_FMI_UTILS
 #define GAZEBO_FMI_UTILS
 
+#include <algorithm>
+#include <vector>
+
+#include <gazebo/physics/Inertial.hh>
 #include <gazebo/physics/Joint.hh>
+#include <gazebo/physics/Link.hh>
 
 namespace gazebo_fmi
 {
 
-inline double ComputeJointAcceleration(gazebo::physics::JointPtr jointPtr)
+/// Kinematic quantities of a link in the world frame, used to compute the accelerations of the joints attached to it.
+/// Only the quantities needed by the joints are read, see GetLinkKinematicsNeeds, the others are left to zero.
+struct LinkKinematics
+{
+    ignition::math::Vector3d angularVelocity;
+    ignition::math::Vector3d angularAcceleration;
+
+    /// Position and linear acceleration of the center of mass
+    ignition::math::Vector3d position;
+    ignition::math::Vector3d linearAcceleration;
+};
+
+/// Return true if the acceleration of the joint can be computed by ComputeJointAcceleration, i.e. if it is
+/// a revolute (hinge), prismatic (slider), universal or screw joint
+inline bool IsJointAccelerationSupported(gazebo::physics::JointPtr jointPtr)
+{
+    return jointPtr->GetType() & (gazebo::physics::Base::HINGE_JOINT | gazebo::physics::Base::SLIDER_JOINT |
+                                  gazebo::physics::Base::UNIVERSAL_JOINT | gazebo::physics::Base::SCREW_JOINT);
+}
+
+/// Select the quantities of the parent and child links of a joint that are read to compute its acceleration,
+/// the angular acceleration is always needed
+inline void GetLinkKinematicsNeeds(gazebo::physics::JointPtr jointPtr, bool& angularVelocity, bool& linearAcceleration)
+{
+    const bool slider = jointPtr->GetType() & gazebo::physics::Base::SLIDER_JOINT;
+    angularVelocity = slider || (jointPtr->GetType() & gazebo::physics::Base::UNIVERSAL_JOINT);
+    linearAcceleration = slider;
+}
+
+/// Read the kinematics of a link, a null link being the world
+inline void ReadLinkKinematics(gazebo::physics::LinkPtr link, const bool angularVelocity, const bool linearAcceleration,
+                               LinkKinematics& kinematics)
 {
-    if (jointPtr->GetType() & gazebo::physics::Base::HINGE_JOINT)
+    kinematics = LinkKinematics();
+    if (!link)
     {
-        // Compute joint acceleration
-        // For a link `L`, the method ignition::math::Vector3d WorldAngularAccel () const
-        // returns the angular acceleration \$ {}^A \omega_{A,L} \$.
-        // Given a hinge/revolute joint ${P, C}$ connecting the links $P$ (parent) and $C$ (child), the method
-        // virtual ignition::math::Vector3d GlobalAxis( unsigned int  _index) const
-        // returns the angular part of the joint motion subspace \$  ^A s_{P,C} \in \mathbb{R}^6  \$
-        // that we indicate with \$ {}^A a_{P, C} \in \mathbb{R}^3 \$ (axis in the code for readability).
-        //
-        // The joint acceleration \$\ddot{\theta} \in \mathbb{R}\$ can then be computed as:
-        // \$
-        // \ddot{\theta} =  \left( ^C s_{P,C} \right)^T  {}^C \dot{\omega}\_{P,C} =  \left( ^C s_{P,C} \right)^T  ( {}^C \dot{\omega}\_{A,C} - {}^C \dot{\omega}\_{A,P} )  =
-        // \left( ^A s_{P,C} \right)^T ( {}^A \dot{\omega}\_{A,C} - {}^A \dot{\omega}\_{A,P} )
-        // \$
+        return;
+    }
 
-        gazebo::physics::LinkPtr parent = jointPtr->GetParent();
-        gazebo::physics::LinkPtr child = jointPtr->GetChild();
 #if GAZEBO_MAJOR_VERSION >=8
-        ignition::math::Vector3d A_axis_P_C = jointPtr->GlobalAxis(0u);
-        ignition::math::Vector3d A_domega_A_P = parent ? parent->WorldAngularAccel() : ignition::math::Vector3d::Zero;
-        ignition::math::Vector3d A_domega_A_C = child ? child->WorldAngularAccel() : ignition::math::Vector3d::Zero;
+    kinematics.angularAcceleration = link->WorldAngularAccel();
+    if (angularVelocity)
+    {
+        kinematics.angularVelocity = link->WorldAngularVel();
+    }
+    if (linearAcceleration)
+    {
+        kinematics.position = link->WorldCoGPose().Pos();
+        kinematics.linearAcceleration = link->WorldLinearAccel();
+    }
 #else
-        gazebo::math::Vector3 A_axis_P_C = jointPtr->GetGlobalAxis(0u);
-        gazebo::math::Vector3 A_domega_A_P = parent ? parent->GetWorldAngularAccel() : gazebo::math::Vector3::Zero;
-        gazebo::math::Vector3 A_domega_A_C = child ? child->GetWorldAngularAccel() : gazebo::math::Vector3::Zero;
-#endif
-        return A_axis_P_C.Dot(A_domega_A_C-A_domega_A_P);
+    kinematics.angularAcceleration = link->GetWorldAngularAccel().Ign();
+    if (angularVelocity)
+    {
+        kinematics.angularVelocity = link->GetWorldAngularVel().Ign();
+    }
+    if (linearAcceleration)
+    {
+        kinematics.position = link->GetWorldCoGPose().pos.Ign();
+        kinematics.linearAcceleration = link->GetWorldLinearAccel().Ign();
     }
-    else
+#endif
+}
+
+/// Compute the acceleration of the index-th axis of a joint, given the kinematics of its parent link P and child link C
+inline double ComputeJointAcceleration(gazebo::physics::JointPtr jointPtr, const LinkKinematics& parent, const LinkKinematics& child,
+                                       const unsigned int index = 0u)
+{
+    if (!IsJointAccelerationSupported(jointPtr))
     {
         // For other joints, just return 0 as acceleration
         // Appropriate warning are printed during the load, and this ensures that
         // the models that do not use acceleration (such as compliant models) still work fine
         return 0.0;
     }
+
+#if GAZEBO_MAJOR_VERSION >=8
+    const ignition::math::Vector3d A_axis_P_C = jointPtr->GlobalAxis(index);
+#else
+    const ignition::math::Vector3d A_axis_P_C = jointPtr->GetGlobalAxis(index).Ign();
+#endif
+
+    if (jointPtr->GetType() & gazebo::physics::Base::SLIDER_JOINT)
+    {
+        // The axis a is fixed in the parent link, and the relative position of the centers of mass is p = c_C - c_P = r + a d,
+        // with r fixed in the parent link. Differentiating twice in the world frame, with the angular velocity \omega_P of the parent:
+        // \ddot{p} = \dot{\omega}_P x p + \omega_P x (\omega_P x p) + 2 \omega_P x a \dot{d} + a \ddot{d}
+        // and since a^T (\omega_P x a) = 0, the joint acceleration is
+        // \ddot{d} = a^T ( \ddot{c}_C - \ddot{c}_P - \dot{\omega}_P x p - \omega_P x (\omega_P x p) )
+        const ignition::math::Vector3d p = child.position - parent.position;
+        const ignition::math::Vector3d relativeAcceleration = child.linearAcceleration - parent.linearAcceleration
+            - parent.angularAcceleration.Cross(p) - parent.angularVelocity.Cross(parent.angularVelocity.Cross(p));
+        return A_axis_P_C.Dot(relativeAcceleration);
+    }
+
+    // Compute joint acceleration
+    // For a link `L`, the method ignition::math::Vector3d WorldAngularAccel () const
+    // returns the angular acceleration \$ {}^A \omega_{A,L} \$.
+    // Given a hinge/revolute joint ${P, C}$ connecting the links $P$ (parent) and $C$ (child), the method
+    // virtual ignition::math::Vector3d GlobalAxis( unsigned int  _index) const
+    // returns the angular part of the joint motion subspace \$  ^A s_{P,C} \in \mathbb{R}^6  \$
+    // that we indicate with \$ {}^A a_{P, C} \in \mathbb{R}^3 \$ (axis in the code for readability).
+    //
+    // The joint acceleration \$\ddot{\theta} \in \mathbb{R}\$ can then be computed as:
+    // \$
+    // \ddot{\theta} =  \left( ^C s_{P,C} \right)^T  {}^C \dot{\omega}\_{P,C} =  \left( ^C s_{P,C} \right)^T  ( {}^C \dot{\omega}\_{A,C} - {}^C \dot{\omega}\_{A,P} )  =
+    // \left( ^A s_{P,C} \right)^T ( {}^A \dot{\omega}\_{A,C} - {}^A \dot{\omega}\_{A,P} )
+    // \$
+    // The same holds for the rotation of a screw joint.
+    double acceleration = A_axis_P_C.Dot(child.angularAcceleration - parent.angularAcceleration);
+
+    if (jointPtr->GetType() & gazebo::physics::Base::UNIVERSAL_JOINT)
+    {
+        // The relative angular velocity is a_0 \dot{\theta}_0 + a_1 \dot{\theta}_1, with orthogonal axes each fixed in one of
+        // the two links, so its derivative contains the term \omega x a_1 \dot{\theta}_1 (for the index 0) where \omega is the
+        // angular velocity of the link of a_1. Its projection on a_0 is the same for \omega_P and \omega_C, as their difference
+        // is the relative angular velocity, so it is removed using \omega_P regardless of the link of each axis.
+        const unsigned int other = 1u - index;
+#if GAZEBO_MAJOR_VERSION >=8
+        const ignition::math::Vector3d A_otherAxis = jointPtr->GlobalAxis(other);
+#else
+        const ignition::math::Vector3d A_otherAxis = jointPtr->GetGlobalAxis(other).Ign();
+#endif
+        const ignition::math::Vector3d transport = parent.angularVelocity.Cross(A_otherAxis);
+        acceleration -= jointPtr->GetVelocity(other)*A_axis_P_C.Dot(transport);
+    }
+
+    return acceleration;
 }
 
+/// Compute the acceleration of the index-th axis of a revolute, prismatic, universal or screw joint, 0 for other joints
+inline double ComputeJointAcceleration(gazebo::physics::JointPtr jointPtr, const unsigned int index = 0u)
+{
+    bool angularVelocity = false;
+    bool linearAcceleration = false;
+    GetLinkKinematicsNeeds(jointPtr, angularVelocity, linearAcceleration);
+
+    LinkKinematics parent, child;
+    ReadLinkKinematics(jointPtr->GetParent(), angularVelocity, linearAcceleration, parent);
+    ReadLinkKinematics(jointPtr->GetChild(), angularVelocity, linearAcceleration, child);
+    return ComputeJointAcceleration(jointPtr, parent, child, index);
 }
 
+/// Accelerations of the first axis of a set of joints, in which the kinematics of each link is read once per step,
+/// even if the link is shared by several joints (e.g. in a serial chain)
+class JointAccelerationCache
+{
+    private:
+        std::vector<gazebo::physics::JointPtr> m_joints;
+        std::vector<size_t> m_jointIndices;
+        std::vector<gazebo::physics::LinkPtr> m_links;
+        std::vector<bool> m_angularVelocityNeeded;
+        std::vector<bool> m_linearAccelerationNeeded;
+        std::vector<LinkKinematics> m_kinematics;
+
+        /// Index in m_links of the parent and child links of each joint
+        std::vector<size_t> m_parentLinks;
+        std::vector<size_t> m_childLinks;
+
+        size_t addLink(gazebo::physics::LinkPtr link, const bool angularVelocity, const bool linearAcceleration)
+        {
+            // The world (null link) has always index 0
+            const size_t index = link ? std::find(m_links.begin(), m_links.end(), link) - m_links.begin() : 0;
+            if (index == m_links.size())
+            {
+                m_links.push_back(link);
+                m_angularVelocityNeeded.push_back(false);
+                m_linearAccelerationNeeded.push_back(false);
+            }
+            m_angularVelocityNeeded[index] = m_angularVelocityNeeded[index] || angularVelocity;
+            m_linearAccelerationNeeded[index] = m_linearAccelerationNeeded[index] || linearAcceleration;
+            return index;
+        }
+
+    public:
+        /// Allocate the cache for a set of joints, of which only the ones with a true element in needed are computed
+        /// (all of them if needed is empty), so that the links of the other joints are not read at all
+        void configure(const std::vector<gazebo::physics::JointPtr>& joints, const std::vector<bool>& needed = std::vector<bool>())
+        {
+            m_joints.clear();
+            m_jointIndices.clear();
+            m_links.assign(1, nullptr);
+            m_angularVelocityNeeded.assign(1, false);
+            m_linearAccelerationNeeded.assign(1, false);
+            m_parentLinks.clear();
+            m_childLinks.clear();
+
+            for (size_t k=0; k < joints.size(); k++)
+            {
+                if (!needed.empty() && !needed[k])
+                {
+                    continue;
+                }
+
+                const gazebo::physics::JointPtr& joint = joints[k];
+                m_joints.push_back(joint);
+                m_jointIndices.push_back(k);
+
+                bool angularVelocity = false;
+                bool linearAcceleration = false;
+                GetLinkKinematicsNeeds(joint, angularVelocity, linearAcceleration);
+                m_parentLinks.push_back(this->addLink(joint->GetParent(), angularVelocity, linearAcceleration));
+                m_childLinks.push_back(this->addLink(joint->GetChild(), angularVelocity, linearAcceleration));
+            }
+            m_kinematics.assign(m_links.size(), LinkKinematics());
+        }
+
+        /// Compute the accelerations of the joints, an array with one element for each joint passed to configure,
+        /// in which the elements of the joints that are not needed are left untouched
+        void compute(double* accelerations)
+        {
+            for (size_t l=0; l < m_links.size(); l++)
+            {
+                ReadLinkKinematics(m_links[l], m_angularVelocityNeeded[l], m_linearAccelerationNeeded[l], m_kinematics[l]);
+            }
+
+            for (size_t k=0; k < m_joints.size(); k++)
+            {
+                accelerations[m_jointIndices[k]] = ComputeJointAcceleration(m_joints[k], m_kinematics[m_parentLinks[k]], m_kinematics[m_childLinks[k]]);
+            }
+        }
+
+        /// Number of joints whose acceleration is computed at each step
+        size_t getNrOfJoints() const
+        {
+            return m_joints.size();
+        }
+
+        /// Number of distinct links read at each step, including the world
+        size_t getNrOfLinks() const
+        {
+            return m_links.size();
+        }
+};
+
+/// Collect the child link of a joint and all the links that follow it in the kinematic tree
+inline void CollectJointSubtreeLinks(gazebo::physics::JointPtr jointPtr, std::vector<gazebo::physics::LinkPtr>& links)
+{
+    links.clear();
+    gazebo::physics::LinkPtr child = jointPtr->GetChild();
+    if (child)
+    {
+        links.push_back(child);
+    }
+
+    // Breadth-first visit, the links already visited are skipped to handle the closed chains
+    for (size_t l=0; l < links.size(); l++)
+    {
+        for (gazebo::physics::LinkPtr next : links[l]->GetChildJointsLinks())
+        {
+            if (next && std::find(links.begin(), links.end(), next) == links.end())
+            {
+                links.push_back(next);
+            }
+        }
+    }
+}
+
+/// Compute the inertia about the axis of a hinge joint of the links that follow it (see CollectJointSubtreeLinks)
+/// moving as a single rigid body, that is the inertia seen by the joint torque when the parent link
+/// is fixed and the other joints of the subtree do not move. For other joints, 0 is returned.
+inline double ComputeJointEffectiveInertia(gazebo::physics::JointPtr jointPtr,
+                                           const std::vector<gazebo::physics::LinkPtr>& subtreeLinks)
+{
+    if (!(jointPtr->GetType() & gazebo::physics::Base::HINGE_JOINT))
+    {
+        return 0.0;
+    }
+
+    // For each link L of mass m, with the rotational inertia {}^A I_L about its center of mass c,
+    // the inertia about the axis a through the anchor p is a^T {}^A I_L a + m |a x (c - p)|^2
+    double effectiveInertia = 0.0;
+#if GAZEBO_MAJOR_VERSION >=8
+    ignition::math::Vector3d A_axis = jointPtr->GlobalAxis(0u);
+    ignition::math::Vector3d A_anchor = jointPtr->Anchor(0u);
+    for (const gazebo::physics::LinkPtr& link : subtreeLinks)
+    {
+        ignition::math::Vector3d A_arm = A_axis.Cross(link->WorldCoGPose().Pos() - A_anchor);
+        effectiveInertia += A_axis.Dot(link->WorldInertiaMatrix()*A_axis) + link->GetInertial()->Mass()*A_arm.Dot(A_arm);
+    }
+#else
+    gazebo::math::Vector3 A_axis = jointPtr->GetGlobalAxis(0u);
+    gazebo::math::Vector3 A_anchor = jointPtr->GetAnchor(0u);
+    for (const gazebo::physics::LinkPtr& link : subtreeLinks)
+    {
+        gazebo::math::Vector3 A_arm = A_axis.Cross(link->GetWorldCoGPose().pos - A_anchor);
+        effectiveInertia += A_axis.Dot(link->GetWorldInertiaMatrix()*A_axis) + link->GetInertial()->GetMass()*A_arm.Dot(A_arm);
+    }
 #endif
+    return effectiveInertia;
+}
+
+}
 
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_NATIVE_FLUID_DYNAMICS_HH
+#define GAZEBO_FMI_NATIVE_FLUID_DYNAMICS_HH
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace gazebo_fmi
+{
+    /// \brief Fluid dynamics model of a single body evaluated by NativeFluidDynamicsModels
+    enum class NativeFluidDynamicsModelType
+    {
+        /// \brief Force -c_i v_i along each axis i of the body frame
+        linearDrag,
+        /// \brief Force -c_i v_i |v_i| along each axis i of the body frame
+        quadraticDrag,
+        /// \brief Lift and drag of a surface, with coefficients that are piecewise linear in the angle of attack
+        liftDrag
+    };
+
+    /// \brief Convert a string (linear_drag, quadratic_drag, lift_drag) to a NativeFluidDynamicsModelType
+    /// @return true if the string is a valid model type, false otherwise
+    bool parseNativeFluidDynamicsModelType(const std::string& typeString, NativeFluidDynamicsModelType& type);
+
+    /// \brief Options of a native fluid dynamics model, see parseNativeModelSDFElement
+    ///
+    /// All the vectors are expressed in the body frame, and the parameters of the lift_drag model
+    /// have the same meaning of the ones of the Gazebo LiftDragPlugin.
+    struct NativeFluidDynamicsModelOptions
+    {
+        /// \brief True if the body uses the native model in place of a FMU
+        bool enabled{false};
+
+        NativeFluidDynamicsModelType type{NativeFluidDynamicsModelType::quadraticDrag};
+
+        /// \brief Drag coefficients along the axes, in N s/m for linear_drag and in N s^2/m^2 for quadratic_drag
+        std::array<double, 3> coefficients{{0.0, 0.0, 0.0}};
+
+        /// \brief Density of the fluid in kg/m^3, and area of the surface in m^2
+        double fluidDensity{1.2041};
+        double area{1.0};
+
+        /// \brief Forward and upward directions of the surface, that span the plane of the angle of attack
+        std::array<double, 3> forward{{1.0, 0.0, 0.0}};
+        std::array<double, 3> upward{{0.0, 0.0, 1.0}};
+
+        /// \brief Point in which the force is applied, the moment is the one of the force with respect to the body origin
+        std::array<double, 3> centerOfPressure{{0.0, 0.0, 0.0}};
+
+        /// \brief Angle of attack when the relative velocity is along the forward direction, and stall angle of attack, in radians
+        double alpha0{0.0};
+        double alphaStall{1.5707963267948966};
+
+        /// \brief Slopes of the lift and drag coefficients with respect to the angle of attack, before and after the stall
+        double cla{1.0};
+        double cda{0.01};
+        double claStall{0.0};
+        double cdaStall{1.0};
+    };
+
+    /// \brief Native fluid dynamics models of a set of bodies, evaluated for all the bodies in loops over arrays
+    ///
+    /// The inputs and outputs have the semantics of the variables of the FMUs of the single body fluid dynamics plugin:
+    /// the relative velocity of the body with respect to the fluid, and the force and moment of the fluid, all
+    /// expressed in the body frame. The parameters are stored with one array per component, so that evaluate
+    /// is made of loops that the compiler can vectorize. Bodies added without a native model get a zero wrench.
+    class NativeFluidDynamicsModels
+    {
+    private:
+        size_t m_nrOfBodies{0};
+
+        /// \brief Linear and quadratic drag coefficients of all the bodies, zero for the ones without a drag model
+        std::vector<double> m_linear_x, m_linear_y, m_linear_z;
+        std::vector<double> m_quadratic_x, m_quadratic_y, m_quadratic_z;
+
+        /// \brief Parameters of the bodies with a lift_drag model, and their indices among all the bodies
+        std::vector<size_t> m_liftDragBodies;
+        std::vector<double> m_forward_x, m_forward_y, m_forward_z;
+        std::vector<double> m_upward_x, m_upward_y, m_upward_z;
+        std::vector<double> m_pressure_x, m_pressure_y, m_pressure_z;
+        std::vector<double> m_halfDensityArea;
+        std::vector<double> m_alpha0, m_alphaStall, m_cla, m_cda, m_claStall, m_cdaStall;
+
+    public:
+        /// \brief Remove all the bodies
+        void clear();
+
+        /// \brief Add a body, with the native model of the options if options.enabled is true, otherwise with a zero wrench
+        /// @return true if the options are valid, false otherwise (the body is not added)
+        bool addBody(const NativeFluidDynamicsModelOptions& options, const std::string& ownerName);
+
+        /// \brief Number of bodies added
+        size_t getNrOfBodies() const;
+
+        /// \brief Compute the force and moment of the fluid on all the bodies, from their relative velocity
+        ///
+        /// Each array has one element for each body, in the order in which the bodies were added.
+        /// The output arrays should not overlap each other nor the inputs. The method does not allocate memory.
+        void evaluate(const double* velocity_x, const double* velocity_y, const double* velocity_z,
+                      double* __restrict force_x, double* __restrict force_y, double* __restrict force_z,
+                      double* __restrict moment_x, double* __restrict moment_y, double* __restrict moment_z) const;
+    };
+}
+
+#endif
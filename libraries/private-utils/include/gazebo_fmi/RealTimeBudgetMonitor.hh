@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_REAL_TIME_BUDGET_MONITOR_HH
+#define GAZEBO_FMI_REAL_TIME_BUDGET_MONITOR_HH
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gazebo_fmi
+{
+    /// \brief Options of the real-time budget monitor, see parseRealTimeBudgetSDFElement
+    struct RealTimeBudgetOptions
+    {
+        /// \brief True if the monitor is enabled
+        bool enabled{false};
+
+        /// \brief Budget expressed as a fraction of the physics step size
+        double budgetFraction{1.0};
+
+        /// \brief Budget expressed in seconds, if positive it takes precedence over budgetFraction
+        double budgetInSeconds{-1.0};
+
+        /// \brief Minimum wall-clock time between two deadline miss messages
+        double logPeriodInSeconds{5.0};
+    };
+
+    /// \brief Cumulative statistics of a single FMU monitored by RealTimeBudgetMonitor
+    struct FMUBudgetStatistics
+    {
+        std::string name;
+        uint64_t calls{0};
+        double totalTimeInSeconds{0.0};
+        double maxTimeInSeconds{0.0};
+
+        /// \brief Number of deadline misses in which this FMU was the most expensive one
+        uint64_t deadlineMisses{0};
+    };
+
+    /// \brief Cumulative statistics of a RealTimeBudgetMonitor
+    struct RealTimeBudgetStatistics
+    {
+        uint64_t steps{0};
+        uint64_t deadlineMisses{0};
+        double totalOverrunInSeconds{0.0};
+        double maxOverrunInSeconds{0.0};
+        std::vector<FMUBudgetStatistics> fmus;
+    };
+
+    /// \brief Class measuring the wall-clock time spent in FMU calls in each update,
+    ///        and comparing it with a per-step budget.
+    ///
+    /// The expected usage in a plugin update callback is:
+    /// ~~~
+    /// monitor.beginStep();
+    /// for (size_t i=0; i < nrOfFMUs; i++)
+    /// {
+    ///     monitor.beginFMU(i);
+    ///     // set inputs, doStep, get outputs
+    ///     monitor.endFMU(i);
+    /// }
+    /// monitor.endStep(stepSizeInSeconds, simulatedTimeInSeconds);
+    /// ~~~
+    /// If the monitor is not enabled, all the methods return immediately.
+    /// By default the sum of the times of the FMUs is compared with the budget. If the FMUs
+    /// are stepped concurrently (see setConcurrentFMUs), the sum overestimates the time
+    /// taken by the step, and the wall-clock time from beginStep to endStep is compared instead.
+    /// If the FMUs are stepped by the FMUScheduler together with the ones of the other plugins, the
+    /// time of the step is not known by the plugin: in this case setCheckBudget(false) disables the
+    /// deadline check, that is done by the scheduler, and only the per-FMU statistics are accumulated.
+    /// Deadline misses are logged with the names of the most expensive FMUs of the step,
+    /// at most once every logPeriodInSeconds seconds.
+    class RealTimeBudgetMonitor
+    {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        RealTimeBudgetOptions m_options;
+        std::string m_ownerName;
+        RealTimeBudgetStatistics m_statistics;
+        bool m_concurrentFMUs{false};
+        bool m_checkBudget{true};
+
+        // Per-step buffers, preallocated in configure
+        std::vector<Clock::time_point> m_fmuStartTimes;
+        std::vector<double> m_fmuStepTimes;
+        Clock::time_point m_stepStartTime;
+
+        // State for rate-limited logging
+        Clock::time_point m_lastLogTime;
+        bool m_hasLogged{false};
+        uint64_t m_missesSinceLastLog{0};
+
+    public:
+        /// \brief Configure the monitor
+        /// @param[in] options options of the monitor
+        /// @param[in] ownerName name of the plugin instance, used in the log messages
+        /// @param[in] fmuNames names of the monitored FMUs, in the order used in beginFMU/endFMU
+        void configure(const RealTimeBudgetOptions& options,
+                       const std::string& ownerName,
+                       const std::vector<std::string>& fmuNames);
+
+        /// \brief return true if the monitor is enabled
+        bool isEnabled() const;
+
+        /// \brief Set if the FMUs are stepped concurrently, for example by a WorkerPool
+        ///
+        /// In this case the wall-clock time between beginStep and endStep (i.e. gather, step
+        /// and scatter of the update) is compared with the budget, while the per-FMU times are
+        /// still used for the statistics and to find the most expensive FMUs of a deadline miss.
+        void setConcurrentFMUs(const bool concurrent);
+
+        /// \brief Set if the time of the step is compared with the budget in endStep, true by default
+        ///
+        /// The plugins whose FMUs are stepped by the FMUScheduler disable the check, as the span from their
+        /// gather to their scatter includes the phases and the FMUs of all the other plugins of the world:
+        /// the scheduler compares the time of its step phase with its own budget instead.
+        void setCheckBudget(const bool check);
+
+        /// \brief Signal the begin of an update
+        void beginStep();
+
+        /// \brief Signal the begin of the calls to the fmuIndex-th FMU
+        void beginFMU(const size_t fmuIndex);
+
+        /// \brief Signal the end of the calls to the fmuIndex-th FMU
+        void endFMU(const size_t fmuIndex);
+
+        /// \brief Signal the end of an update, and check the FMU time (or the wall-clock time
+        ///        of the update, if the FMUs are concurrent) against the budget, unless the check is disabled
+        void endStep(const double stepSizeInSeconds, const double simulatedTimeInSeconds);
+
+        /// \brief Get the cumulative statistics
+        const RealTimeBudgetStatistics& getStatistics() const;
+
+        /// \brief Print a per-FMU report of the cumulative statistics
+        void printReport() const;
+    };
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_REAL_TIME_SAFETY_HH
+#define GAZEBO_FMI_REAL_TIME_SAFETY_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gazebo_fmi/AsyncLogger.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief What to do when an operation that is not real-time safe is attempted in a RealTimeSection
+    enum class RealTimeViolationPolicy
+    {
+        /// \brief Perform the operation, and report it
+        report,
+        /// \brief Do not perform the operation (for example return nullptr from an allocation), and report it
+        refuse
+    };
+
+    /// \brief Operations that are not real-time safe
+    enum class RealTimeViolation
+    {
+        allocation = 0,
+        lock,
+        TotalViolations
+    };
+
+    /// \brief Options of the real-time mode, see parseRealTimeSDFElement
+    struct RealTimeOptions
+    {
+        /// \brief True if the real-time mode is enabled
+        bool enabled{false};
+
+        /// \brief Minimum size in bytes of the process-wide memory pool reserved for the allocations of the FMUs
+        size_t fmuMemoryPoolSize{16*1024*1024};
+
+        /// \brief Lock the memory of the process (and of the FMU memory pool) in RAM
+        bool lockMemory{true};
+
+        /// \brief Policy for the operations that are not real-time safe
+        RealTimeViolationPolicy onViolation{RealTimeViolationPolicy::report};
+    };
+
+    /// \brief Convert a string (report, refuse) to a RealTimeViolationPolicy
+    /// @return true if the string is a valid policy, false otherwise
+    bool parseRealTimeViolationPolicy(const std::string& policyString, RealTimeViolationPolicy& policy);
+
+    /// \brief Grow the process-wide pool used by the FMUs that call setUseMemoryPool(true) to at least sizeInBytes
+    ///
+    /// The pool is shared by all the plugins of the process, so its size is the largest size requested so far
+    /// and not the sum of the requests: a request that is not larger than the current size reserves no memory.
+    /// The memory is reserved with mmap and prefaulted and, if lockMemory is true in any request, locked in RAM with mlock.
+    /// The pool serves the allocations of the FMUs from per-size free lists, without system calls, and it is
+    /// never released to the system. Allocations that do not fit in the pool are served by calloc,
+    /// and reported as violations if they happen in a RealTimeSection.
+    /// @return true if the memory was reserved, false otherwise
+    bool reserveFMUMemoryPool(const size_t sizeInBytes, const bool lockMemory);
+
+    /// \brief fmi2CallbackAllocateMemory serving the allocations from the FMU memory pool
+    void* fmuMemoryPoolAllocate(size_t nobj, size_t size);
+
+    /// \brief fmi2CallbackFreeMemory for the memory returned by fmuMemoryPoolAllocate
+    void fmuMemoryPoolFree(void* obj);
+
+    /// \brief Number of bytes of the FMU memory pool currently used, including the free lists
+    size_t getFMUMemoryPoolUsage();
+
+    /// \brief Number of bytes reserved for the FMU memory pool
+    size_t getFMUMemoryPoolReservedSize();
+
+    /// \brief Monitor of the real-time constraints of the callbacks of a plugin
+    ///
+    /// The expected usage is:
+    /// ~~~
+    /// // In Load, before loading the FMUs
+    /// monitor.configure(options, ownerName);
+    /// // In Load, after all the buffers have been allocated
+    /// monitor.lockMemory();
+    /// // In the physics-thread callback
+    /// RealTimeSection section(monitor);
+    /// ~~~
+    /// In a RealTimeSection, the operations that are not real-time safe in the gazebo_fmi code and in the FMU allocations
+    /// are checked with checkRealTimeOperation, and the log messages written with logFromCallback are routed to the AsyncLogger.
+    /// Allocations and locks performed by other code (for example Gazebo) are not detected.
+    /// If the monitor is not enabled, all the methods return immediately.
+    class RealTimeSafetyMonitor
+    {
+    private:
+        RealTimeOptions m_options;
+        std::string m_ownerName;
+        std::shared_ptr<AsyncLogger> m_logger;
+        std::atomic<uint64_t> m_violations[static_cast<size_t>(RealTimeViolation::TotalViolations)];
+
+    public:
+        RealTimeSafetyMonitor();
+
+        /// \brief Configure the monitor, and reserve the FMU memory pool
+        /// @return true if the monitor was configured correctly, false otherwise
+        bool configure(const RealTimeOptions& options, const std::string& ownerName);
+
+        /// \brief return true if the monitor is enabled
+        bool isEnabled() const;
+
+        /// \brief Options of the monitor
+        const RealTimeOptions& getOptions() const;
+
+        /// \brief Lock the current memory of the process in RAM, if the lockMemory option is enabled
+        void lockMemory();
+
+        /// \brief Account a violation, and log it the first time it happens
+        /// @return true if the operation should be performed, false if it should be refused
+        bool reportViolation(const RealTimeViolation violation);
+
+        /// \brief Number of violations of the specified kind
+        uint64_t getViolations(const RealTimeViolation violation) const;
+
+        /// \brief Logger used in the RealTimeSection
+        AsyncLogger& getLogger();
+
+        /// \brief Print the number of violations
+        void printReport() const;
+    };
+
+    /// \brief Scope in which the calling thread runs under the real-time constraints of a RealTimeSafetyMonitor
+    ///
+    /// If the monitor is not enabled, the section has no effect.
+    class RealTimeSection
+    {
+    private:
+        RealTimeSafetyMonitor* m_previous;
+
+    public:
+        explicit RealTimeSection(RealTimeSafetyMonitor& monitor);
+        ~RealTimeSection();
+
+        RealTimeSection(const RealTimeSection&) = delete;
+        RealTimeSection& operator=(const RealTimeSection&) = delete;
+    };
+
+    /// \brief return true if the calling thread is in a RealTimeSection
+    bool isInRealTimeSection();
+
+    /// \brief Check an operation that is not real-time safe
+    /// @return true if the operation should be performed, i.e. if the calling thread is not in a RealTimeSection
+    ///         or the policy of the monitor is report, false if it should be refused
+    bool checkRealTimeOperation(const RealTimeViolation violation);
+
+    /// \brief Write a printf-style log message from a callback
+    ///
+    /// In a RealTimeSection the message is queued in the AsyncLogger, that never blocks nor allocates memory,
+    /// otherwise it is written directly on the Gazebo console.
+    void logFromCallback(const LogLevel level, const char* source, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 3, 4)))
+#endif
+        ;
+}
+
+#endif
@@ -16,6 +16,21 @@
 
 #include <sdf/Element.hh>
 
+#include <gazebo_fmi/AsyncLogger.hh>
+#include <gazebo_fmi/DeterminismDigest.hh>
+#include <gazebo_fmi/FMUAdaptiveStep.hh>
+#include <gazebo_fmi/FMURecording.hh>
+#include <gazebo_fmi/FMUReplay.hh>
+#include <gazebo_fmi/FMUScheduler.hh>
+#include <gazebo_fmi/FMUOutputPrediction.hh>
+#include <gazebo_fmi/FMUStrongCoupling.hh>
+#include <gazebo_fmi/FMUSurrogate.hh>
+#include <gazebo_fmi/FMUVariableStreaming.hh>
+#include <gazebo_fmi/FlowField.hh>
+#include <gazebo_fmi/NativeFluidDynamics.hh>
+#include <gazebo_fmi/RealTimeBudgetMonitor.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
 namespace gazebo_fmi
 {
 
@@ -45,6 +60,336 @@ bool parseVariableNamesSDFElement(sdf::ElementPtr sdf,
                                   const std::vector<std::string>& defaulOutputVariableNames,
                                   std::vector<std::string>& ouputVariableNames);
 
+/**
+ * \brief Parse the options of the real-time budget monitor from the realtime_budget SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <realtime_budget>
+ *   <budget_fraction>0.5</budget_fraction>
+ *   <budget>0.0005</budget>
+ *   <log_period>5.0</log_period>
+ * </realtime_budget>
+ *
+ * All the child elements are optional. budget_fraction is the budget expressed as a fraction
+ * of the physics step size, while budget is the budget in seconds and takes precedence over
+ * budget_fraction. log_period is the minimum wall-clock time in seconds between two deadline miss messages.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the realtime_budget element
+ * @param[out] options the parsed options, options.enabled is true only if the realtime_budget element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseRealTimeBudgetSDFElement(sdf::ElementPtr sdf,
+                                   RealTimeBudgetOptions& options);
+
+/**
+ * \brief Parse the verbosity of the FMU log messages from the fmu_log_level SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <fmu_log_level>warning</fmu_log_level>
+ *
+ * where the valid values are nothing, fatal, error, warning, info, verbose and debug.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the fmu_log_level element
+ * @param[out] level the parsed level, LogLevel::error if the fmu_log_level element is not present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseFMULogLevelSDFElement(sdf::ElementPtr sdf,
+                                LogLevel& level);
+/**
+ * \brief Parse the options of the FMU recorder from the recorder SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <recorder>
+ *   <file>/tmp/actuators.gzfmirec</file>
+ *   <chunk_size>1000</chunk_size>
+ * </recorder>
+ *
+ * The file element is required, while chunk_size (the number of samples in each chunk of the file) is optional.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the recorder element
+ * @param[out] options the parsed options, options.enabled is true only if the recorder element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseRecorderSDFElement(sdf::ElementPtr sdf,
+                             FMURecorderOptions& options);
+
+/**
+ * \brief Parse the options of the FMU replay from the replay SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <replay>
+ *   <file>/tmp/actuators.gzfmirec</file>
+ *   <check_inputs>true</check_inputs>
+ *   <tolerance>1e-6</tolerance>
+ * </replay>
+ *
+ * The file element is required, while check_inputs (compare the live inputs with the recorded ones)
+ * and tolerance (the maximum absolute difference between a live and a recorded input) are optional.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the replay element
+ * @param[out] options the parsed options, options.enabled is true only if the replay element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseReplaySDFElement(sdf::ElementPtr sdf,
+                           FMUReplayOptions& options);
+
+/**
+ * \brief Parse the options of the determinism digest from the determinism_digest SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <determinism_digest>
+ *   <file>/tmp/actuators_digest.txt</file>
+ *   <checkpoint_period>100</checkpoint_period>
+ *   <max_checkpoints>10000</max_checkpoints>
+ *   <publish_period>10.0</publish_period>
+ * </determinism_digest>
+ *
+ * All the child elements are optional. file is the file in which the checkpoints are written at shutdown,
+ * checkpoint_period is the number of steps between two checkpoints, max_checkpoints is the number of checkpoints
+ * whose memory is reserved when the plugin is loaded and publish_period is the simulated time
+ * in seconds between two digest messages on the console (a non-positive value disables the messages).
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the determinism_digest element
+ * @param[out] options the parsed options, options.enabled is true only if the determinism_digest element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseDeterminismDigestSDFElement(sdf::ElementPtr sdf,
+                                      DeterminismDigestOptions& options);
+
+/**
+ * \brief Parse the options of the real-time mode from the realtime SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <realtime>
+ *   <fmu_memory_pool_size>16777216</fmu_memory_pool_size>
+ *   <lock_memory>true</lock_memory>
+ *   <on_violation>report</on_violation>
+ * </realtime>
+ *
+ * All the child elements are optional. fmu_memory_pool_size is the minimum size in bytes of the process-wide memory
+ * reserved for the allocations of the FMUs, lock_memory enables the locking of the memory of the process in RAM, and on_violation
+ * (report or refuse) selects what to do when an allocation or a blocking lock is attempted in the physics-thread callback.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the realtime element
+ * @param[out] options the parsed options, options.enabled is true only if the realtime element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseRealTimeSDFElement(sdf::ElementPtr sdf,
+                             RealTimeOptions& options);
+
+/**
+ * \brief Parse the options of the tabulated surrogate of a stateless FMU from the surrogate SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <surrogate>
+ *   <interpolation>cubic</interpolation>
+ *   <min>-5.0</min>
+ *   <max>5.0</max>
+ *   <points>41</points>
+ *   <input>
+ *     <name>relativeVelocity_z</name>
+ *     <min>-1.0</min>
+ *     <max>1.0</max>
+ *     <points>21</points>
+ *   </input>
+ *   <cache_directory>/tmp/surrogates</cache_directory>
+ * </surrogate>
+ *
+ * All the child elements are optional. interpolation (linear or cubic) selects the interpolation between the nodes,
+ * min, max and points define the uniform grid of all the inputs, and each input element overrides the grid of the
+ * input with the specified default variable name. cache_directory is the directory of the cached tables.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the surrogate element
+ * @param[in] defaultInputVariableNames default names of the input variables, in the order of the grid axes
+ * @param[out] options the parsed options, options.enabled is true only if the surrogate element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseSurrogateSDFElement(sdf::ElementPtr sdf,
+                              const std::vector<std::string>& defaultInputVariableNames,
+                              FMUSurrogateOptions& options);
+
+/**
+ * \brief Parse the options of the prediction of the FMU outputs from the output_prediction SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <output_prediction>
+ *   <trust_region>0.001</trust_region>
+ *   <max_skipped_steps>10</max_skipped_steps>
+ *   <input>
+ *     <name>jointAcceleration</name>
+ *     <trust_region>0.5</trust_region>
+ *   </input>
+ * </output_prediction>
+ *
+ * All the child elements are optional. trust_region is the maximum absolute difference of all the inputs from
+ * their values at the last checkpoint for which the outputs are predicted, and each input element overrides the
+ * trust region of the input with the specified default variable name. max_skipped_steps is the maximum number
+ * of consecutive steps in which the FMU is not simulated.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the output_prediction element
+ * @param[in] defaultInputVariableNames default names of the input variables, in the order of the trust regions
+ * @param[out] options the parsed options, options.enabled is true only if the output_prediction element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseOutputPredictionSDFElement(sdf::ElementPtr sdf,
+                                     const std::vector<std::string>& defaultInputVariableNames,
+                                     FMUOutputPredictionOptions& options);
+
+
+/**
+ * \brief Parse the options of the strong coupling of a FMU from the strong_coupling SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <strong_coupling>
+ *   <acceleration>iqn-ils</acceleration>
+ *   <max_iterations>10</max_iterations>
+ *   <tolerance>1e-6</tolerance>
+ *   <relaxation>0.5</relaxation>
+ * </strong_coupling>
+ *
+ * All the child elements are optional. acceleration (constant, aitken or iqn-ils) selects how the inputs of
+ * each iteration are computed, max_iterations is the maximum number of FMU steps in a physics step, tolerance
+ * is the maximum absolute change of the outputs between two iterations for which the iterations converged, and
+ * relaxation, in (0, 1], is the relaxation of the first iteration.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the strong_coupling element
+ * @param[out] options the parsed options, options.enabled is true only if the strong_coupling element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseStrongCouplingSDFElement(sdf::ElementPtr sdf,
+                                   FMUStrongCouplingOptions& options);
+
+
+/**
+ * \brief Parse the options of the adaptive communication step of a FMU from the adaptive_step SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <adaptive_step>
+ *   <estimator>extrapolation</estimator>
+ *   <tolerance>0.001</tolerance>
+ *   <max_step_multiple>16</max_step_multiple>
+ *   <safety_factor>0.9</safety_factor>
+ * </adaptive_step>
+ *
+ * All the child elements are optional. estimator (step_doubling or extrapolation) selects how the local error of
+ * the macro steps is estimated, tolerance is the maximum absolute local error of the outputs for which a macro step
+ * is accepted, max_step_multiple is the maximum macro step as a multiple of the physics step, and safety_factor,
+ * in (0, 1], scales the macro step proposed by the step size controller.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the adaptive_step element
+ * @param[out] options the parsed options, options.enabled is true only if the adaptive_step element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseAdaptiveStepSDFElement(sdf::ElementPtr sdf,
+                                 FMUAdaptiveStepOptions& options);
+
+
+
+/**
+ * \brief Parse the native fluid dynamics model of a body from the native_model SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <native_model>
+ *   <type>lift_drag</type>
+ *   <coefficients>0.5 0.5 2.0</coefficients>
+ *   <fluid_density>1.2041</fluid_density>
+ *   <area>0.3</area>
+ *   <forward>1 0 0</forward>
+ *   <upward>0 0 1</upward>
+ *   <cp>0 0 0</cp>
+ *   <a0>0.0</a0>
+ *   <alpha_stall>0.35</alpha_stall>
+ *   <cla>4.75</cla>
+ *   <cda>0.6</cda>
+ *   <cla_stall>-3.85</cla_stall>
+ *   <cda_stall>-0.92</cda_stall>
+ * </native_model>
+ *
+ * type (linear_drag, quadratic_drag or lift_drag) is required. coefficients are the drag coefficients along the axes
+ * of the body frame used by linear_drag and quadratic_drag, the other elements are used by lift_drag and have the
+ * same meaning of the ones of the Gazebo LiftDragPlugin. All the vectors are expressed in the body frame.
+ * The values are checked by NativeFluidDynamicsModels::addBody.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the native_model element
+ * @param[out] options the parsed options, options.enabled is true only if the native_model element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseNativeModelSDFElement(sdf::ElementPtr sdf,
+                                NativeFluidDynamicsModelOptions& options);
+
+/**
+ * \brief Parse the options of the wind/current field from the flow_field SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <flow_field>
+ *   <file>/data/harbour_currents.gzfmifld</file>
+ *   <time_offset>3600.0</time_offset>
+ * </flow_field>
+ *
+ * The file element (a grid written by writeFlowFieldFile) is required, while time_offset (the time of the
+ * field, in seconds, at the start of the simulation) is optional.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the flow_field element
+ * @param[out] options the parsed options, options.enabled is true only if the flow_field element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseFlowFieldSDFElement(sdf::ElementPtr sdf,
+                              FlowFieldOptions& options);
+
+/**
+ * \brief Parse the options of the world scheduler of the FMUs from the SDF of the FMIScheduler plugin.
+ *
+ * This method searches for elements in the form:
+ *
+ * <threads>4</threads>
+ * <rebalance_period>100</rebalance_period>
+ * <realtime_budget>...</realtime_budget>
+ *
+ * All the elements are optional. threads is the number of threads in which the FMUs of all the plugins are stepped,
+ * and rebalance_period the number of physics steps between two partitions of the FMUs over the threads
+ * (0 to partition them only when a plugin is loaded or unloaded). realtime_budget is parsed by
+ * parseRealTimeBudgetSDFElement, and it is the budget of the step phase of the FMUs of all the plugins.
+ *
+ * @param[in] sdf sdf::ElementPtr of the plugin
+ * @param[out] options the parsed options
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseSchedulerSDFElement(sdf::ElementPtr sdf,
+                              FMUSchedulerOptions& options);
+
+/**
+ * \brief Parse the options of the streaming of FMU variables from the variable_streaming SDF element.
+ *
+ * This method searches for an element in the form:
+ *
+ * <variable_streaming>
+ *   <topic>~/actuators/fmu_variables</topic>
+ *   <max_variables>64</max_variables>
+ *   <queue_size>64</queue_size>
+ * </variable_streaming>
+ *
+ * All the child elements are optional. topic is the namespace of the catalogue, request and stream topics
+ * (by default ~/<scoped model name>/fmu_variables), max_variables is the maximum number of variables of a stream
+ * and queue_size the number of samples that can wait to be published before the following ones are dropped.
+ *
+ * @param[in] sdf sdf::ElementPtr of the parent of the variable_streaming element
+ * @param[out] options the parsed options, options.enabled is true only if the variable_streaming element is present
+ * @return true if all went well, false if there was some error in parsing.
+ */
+bool parseVariableStreamingSDFElement(sdf::ElementPtr sdf,
+                                      FMUVariableStreamingOptions& options);
 
 }
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_WORKER_POOL_HH
+#define GAZEBO_FMI_WORKER_POOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Per-thread state copied from the calling thread of WorkerPool::run to the workers, see WorkerThreadStatePropagation
+    struct WorkerThreadState
+    {
+        /// \brief Return the state of the calling thread
+        uint64_t (*capture)();
+        /// \brief Set the state of the calling thread, and return the previous one
+        uint64_t (*exchange)(const uint64_t state);
+    };
+
+    /// \brief Scope in which the workers of all the WorkerPools run the tasks of a batch with the state of the calling thread of run
+    ///
+    /// For example a test can copy its per-thread allocation counting flag in the workers, so that the allocations
+    /// of the tasks are counted and the ones of the unrelated threads are not. The state is captured when the batch
+    /// is started, and the workers restore their previous state when they completed the tasks of the batch.
+    /// A scope replaces the one that was active when it was created, and restores it when it is destroyed.
+    class WorkerThreadStatePropagation
+    {
+    private:
+        WorkerThreadState m_state;
+        const WorkerThreadState* m_previous;
+
+    public:
+        explicit WorkerThreadStatePropagation(const WorkerThreadState& state);
+        ~WorkerThreadStatePropagation();
+
+        WorkerThreadStatePropagation(const WorkerThreadStatePropagation&) = delete;
+        WorkerThreadStatePropagation& operator=(const WorkerThreadStatePropagation&) = delete;
+    };
+
+    /// \brief Pool of threads that run the independent tasks of a batch in parallel, for example the steps of several FMUs
+    ///
+    /// The expected usage is:
+    /// ~~~
+    /// // In Load
+    /// pool.configure(nrOfThreads, realTimeMonitor, ownerName);
+    /// std::function<void(size_t)> task = ...; // kept alive while the pool is used
+    /// // In the physics-thread callback
+    /// pool.run(nrOfTasks, task);
+    /// ~~~
+    /// The calling thread runs tasks as well, so nrOfThreads-1 threads are spawned. The tasks are claimed one at a time,
+    /// so their order is not specified, but run returns only when all of them are completed. The workers run the tasks
+    /// in a RealTimeSection of the monitor, so the FMU allocations are served by the FMU memory pool as in the calling thread,
+    /// and with the state of the calling thread of the active WorkerThreadStatePropagation, if any.
+    /// run does not allocate memory, and it takes a lock that is held only briefly by the workers: if the lock is contended
+    /// and the real-time policy refuses it, the tasks are run in the calling thread.
+    class WorkerPool
+    {
+    private:
+        RealTimeSafetyMonitor* m_monitor{nullptr};
+        std::vector<std::thread> m_workers;
+
+        /// \brief Batch being run, protected by m_mutex
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        const std::function<void(size_t)>* m_task{nullptr};
+        size_t m_nrOfTasks{0};
+        WorkerThreadState m_threadState{nullptr, nullptr};
+        uint64_t m_callerState{0};
+        uint32_t m_generation{0};
+        bool m_stop{false};
+
+        /// \brief Generation of the batch in the 32 most significant bits, and index of the next task to claim in the others
+        std::atomic<uint64_t> m_nextTask{0};
+        std::atomic<size_t> m_completedTasks{0};
+
+        /// \brief Claim and run the tasks of the batch of the specified generation, until there are none left
+        void runTasks(const uint32_t generation, const std::function<void(size_t)>& task, const size_t nrOfTasks);
+
+        void workerLoop();
+
+        void stop();
+
+    public:
+        WorkerPool() = default;
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        /// \brief Spawn the worker threads
+        /// @param[in] nrOfThreads number of threads that run the tasks, including the calling thread of run
+        /// @param[in] monitor real-time monitor of the calling thread, whose RealTimeSection is entered by the workers
+        /// @param[in] ownerName name of the plugin instance, used in the log messages
+        /// @return true if the threads were spawned, false otherwise
+        bool configure(const size_t nrOfThreads, RealTimeSafetyMonitor& monitor, const std::string& ownerName);
+
+        /// \brief Number of threads that run the tasks, including the calling thread
+        size_t getNrOfThreads() const;
+
+        /// \brief Run task(0), ..., task(nrOfTasks-1), and return when all of them are completed
+        void run(const size_t nrOfTasks, const std::function<void(size_t)>& task);
+    };
+}
+
+#endif
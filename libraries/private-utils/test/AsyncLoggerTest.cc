@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/AsyncLogger.hh>
+
+/////////////////////////////////////////////////
+/// Read the messages written by the file sink, stripping the time stamp
+std::vector<std::string> readLogFile(const std::string& filePath)
+{
+  std::vector<std::string> lines;
+  std::ifstream file(filePath);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    size_t endOfTime = line.find("] ");
+    lines.push_back(endOfTime == std::string::npos ? line : line.substr(endOfTime+2));
+  }
+  return lines;
+}
+
+/////////////////////////////////////////////////
+/// The messages of several producers are all written to the file sink, each producer in order
+TEST(AsyncLoggerTest, MultipleProducers)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/AsyncLoggerTestMultipleProducers.log";
+  std::remove(filePath.c_str());
+
+  const size_t nrOfProducers = 4;
+  const size_t nrOfMessages = 5000;
+
+  std::shared_ptr<gazebo_fmi::AsyncLogger> logger = gazebo_fmi::AsyncLogger::getInstance();
+  ASSERT_TRUE(logger->setFileSink(filePath));
+
+  // If the buffer is full the message is pushed again, so that none is lost
+  std::vector<std::thread> producers;
+  for (size_t producer=0; producer < nrOfProducers; producer++)
+  {
+    producers.emplace_back([&logger, producer, nrOfMessages]()
+    {
+      const std::string source = "producer_" + std::to_string(producer);
+      for (size_t i=0; i < nrOfMessages; i++)
+      {
+        const std::string message = std::to_string(i);
+        while (!logger->log(gazebo_fmi::LogLevel::info, source.c_str(), message.c_str()))
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::thread& producer : producers)
+  {
+    producer.join();
+  }
+  logger->flush();
+
+  std::vector<std::string> lines = readLogFile(filePath);
+  ASSERT_EQ(lines.size(), nrOfProducers*nrOfMessages);
+
+  std::vector<size_t> nextMessage(nrOfProducers, 0);
+  for (const std::string& line : lines)
+  {
+    unsigned producer, message;
+    ASSERT_EQ(std::sscanf(line.c_str(), "[info] producer_%u: %u", &producer, &message), 2) << line;
+    ASSERT_LT(producer, nrOfProducers);
+    EXPECT_EQ(message, nextMessage[producer]) << "messages of producer " << producer << " out of order";
+    nextMessage[producer] = message+1;
+  }
+  for (size_t producer=0; producer < nrOfProducers; producer++)
+  {
+    EXPECT_EQ(nextMessage[producer], nrOfMessages);
+  }
+
+  logger.reset();
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// When the buffer is full the messages are dropped and counted, and the other ones are written
+TEST(AsyncLoggerTest, DroppedRecords)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/AsyncLoggerTestDroppedRecords.log";
+  std::remove(filePath.c_str());
+
+  std::shared_ptr<gazebo_fmi::AsyncLogger> logger = gazebo_fmi::AsyncLogger::getInstance();
+  ASSERT_TRUE(logger->setFileSink(filePath));
+  const uint64_t droppedBefore = logger->getDroppedRecords();
+
+  // The producer is faster than the background thread, that writes a line at a time,
+  // so pushing messages in a tight loop eventually fills the buffer
+  const size_t maxMessages = 1000000;
+  size_t queued = 0;
+  size_t dropped = 0;
+  for (size_t i=0; i < maxMessages && (dropped == 0 || i < 10000); i++)
+  {
+    if (logger->log(gazebo_fmi::LogLevel::warning, "AsyncLoggerTest", "message"))
+    {
+      queued++;
+    }
+    else
+    {
+      dropped++;
+    }
+  }
+  logger->flush();
+
+  EXPECT_GT(dropped, 0u);
+  EXPECT_EQ(logger->getDroppedRecords()-droppedBefore, dropped);
+
+  std::vector<std::string> lines = readLogFile(filePath);
+  EXPECT_EQ(lines.size(), queued);
+  ASSERT_FALSE(lines.empty());
+  EXPECT_EQ(lines.front(), "[warning] AsyncLoggerTest: message");
+
+  logger.reset();
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// The file sink writes the level, the source and the formatted message, truncating long ones
+TEST(AsyncLoggerTest, FileSink)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/AsyncLoggerTestFileSink.log";
+  std::remove(filePath.c_str());
+
+  std::shared_ptr<gazebo_fmi::AsyncLogger> logger = gazebo_fmi::AsyncLogger::getInstance();
+  ASSERT_TRUE(logger->setFileSink(filePath));
+  ASSERT_TRUE(logger->setFileSink(filePath));
+  EXPECT_FALSE(logger->setFileSink(CMAKE_CURRENT_BINARY_DIR"/nonexistent_directory/AsyncLoggerTest.log"));
+  ASSERT_TRUE(logger->setFileSink(filePath));
+
+  EXPECT_TRUE(logger->log(gazebo_fmi::LogLevel::error, "actuator", "doStep failed"));
+  EXPECT_TRUE(logger->log(gazebo_fmi::LogLevel::debug, nullptr, nullptr));
+  EXPECT_TRUE(logger->log(gazebo_fmi::LogLevel::info, "actuator", std::string(1000, 'x').c_str()));
+  logger->flush();
+
+  std::vector<std::string> lines = readLogFile(filePath);
+  ASSERT_EQ(lines.size(), 3u);
+  EXPECT_EQ(lines[0], "[error] actuator: doStep failed");
+  EXPECT_EQ(lines[1], "[debug] : ");
+  EXPECT_EQ(lines[2].substr(0, 17), "[info] actuator: ");
+  EXPECT_GT(lines[2].size(), 17u);
+  EXPECT_LT(lines[2].size(), 17u+1000u);
+
+  // The logger is destroyed when the last user releases it, and the pending messages are written
+  EXPECT_TRUE(logger->log(gazebo_fmi::LogLevel::warning, "actuator", "last message"));
+  logger.reset();
+  lines = readLogFile(filePath);
+  ASSERT_EQ(lines.size(), 4u);
+  EXPECT_EQ(lines[3], "[warning] actuator: last message");
+
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/DeterminismDigest.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+/////////////////////////////////////////////////
+/// Run a fake simulation of two FMUs, in which the output of the second FMU is perturbed at perturbedStep
+void runDigest(gazebo_fmi::DeterminismDigest& digest, const std::string& filePath, const size_t perturbedStep)
+{
+  gazebo_fmi::DeterminismDigestOptions options;
+  options.enabled = true;
+  options.filePath = filePath;
+  options.checkpointPeriod = 10;
+  options.publishPeriodInSeconds = -1.0;
+  digest.configure(options, "DeterminismDigestTest", {"actuator_0", "actuator_1"});
+
+  std::vector<double> inputs(2), outputs(1);
+  for (size_t step=0; step < 95; step++)
+  {
+    const double time = step*0.001;
+    digest.beginStep(time);
+    for (size_t fmu=0; fmu < 2; fmu++)
+    {
+      inputs[0] = time;
+      inputs[1] = fmu;
+      outputs[0] = 0.1*step;
+      if (fmu == 1 && step == perturbedStep)
+      {
+        outputs[0] = std::nextafter(outputs[0], 1e10);
+      }
+      digest.update(fmu, inputs);
+      digest.update(fmu, outputs);
+    }
+    digest.endStep();
+  }
+  ASSERT_TRUE(digest.dump());
+}
+
+/////////////////////////////////////////////////
+TEST(DeterminismDigestTest, LocateDivergence)
+{
+  std::string filePathA = CMAKE_CURRENT_BINARY_DIR"/DeterminismDigestTestA.txt";
+  std::string filePathB = CMAKE_CURRENT_BINARY_DIR"/DeterminismDigestTestB.txt";
+  std::string filePathC = CMAKE_CURRENT_BINARY_DIR"/DeterminismDigestTestC.txt";
+
+  gazebo_fmi::DeterminismDigest a, b, c;
+  runDigest(a, filePathA, 1000);
+  runDigest(b, filePathB, 1000);
+  runDigest(c, filePathC, 42);
+
+  EXPECT_EQ(a.getDigest(), b.getDigest());
+  EXPECT_NE(a.getDigest(), c.getDigest());
+  EXPECT_EQ(a.getFMUDigest(0), c.getFMUDigest(0));
+  EXPECT_NE(a.getFMUDigest(1), c.getFMUDigest(1));
+
+  std::string owner;
+  std::vector<std::string> fmuNames;
+  std::vector<gazebo_fmi::DeterminismCheckpoint> checkpointsA, checkpointsC;
+  ASSERT_TRUE(gazebo_fmi::readDeterminismDigestFile(filePathA, owner, fmuNames, checkpointsA));
+  ASSERT_TRUE(gazebo_fmi::readDeterminismDigestFile(filePathC, owner, fmuNames, checkpointsC));
+  EXPECT_EQ(owner, "DeterminismDigestTest");
+  ASSERT_EQ(fmuNames.size(), 2u);
+
+  // 9 periodic checkpoints plus the final one at step 95
+  ASSERT_EQ(checkpointsA.size(), 10u);
+  ASSERT_EQ(checkpointsC.size(), 10u);
+  EXPECT_EQ(checkpointsA.back().step, 95u);
+  EXPECT_EQ(checkpointsA.back().digest, a.getDigest());
+
+  // The step 42 is the 43rd one, so the first divergent checkpoint is the one at step 50
+  for (size_t i=0; i < checkpointsA.size(); i++)
+  {
+    EXPECT_EQ(checkpointsA[i].digest == checkpointsC[i].digest, checkpointsA[i].step < 50);
+    EXPECT_EQ(checkpointsA[i].fmuDigests[0], checkpointsC[i].fmuDigests[0]);
+  }
+
+  std::remove(filePathA.c_str());
+  std::remove(filePathB.c_str());
+  std::remove(filePathC.c_str());
+}
+
+/////////////////////////////////////////////////
+/// In the real-time mode the checkpoints are stored without allocations, and refused allocations do not drop them
+TEST(DeterminismDigestTest, RealTimeCheckpoints)
+{
+  gazebo_fmi::RealTimeOptions realTimeOptions;
+  realTimeOptions.enabled = true;
+  realTimeOptions.fmuMemoryPoolSize = 64*1024;
+  realTimeOptions.lockMemory = false;
+  realTimeOptions.onViolation = gazebo_fmi::RealTimeViolationPolicy::refuse;
+
+  gazebo_fmi::RealTimeSafetyMonitor monitor;
+  ASSERT_TRUE(monitor.configure(realTimeOptions, "DeterminismDigestTest"));
+
+  gazebo_fmi::DeterminismDigestOptions options;
+  options.enabled = true;
+  options.checkpointPeriod = 10;
+  options.maxCheckpoints = 5;
+  options.publishPeriodInSeconds = -1.0;
+
+  gazebo_fmi::DeterminismDigest digest;
+  digest.configure(options, "DeterminismDigestTest", {"actuator_0", "actuator_1"});
+
+  std::vector<double> values(2);
+  for (size_t step=0; step < 95; step++)
+  {
+    gazebo_fmi::RealTimeSection section(monitor);
+    digest.beginStep(step*0.001);
+    for (size_t fmu=0; fmu < 2; fmu++)
+    {
+      values[0] = step*0.001;
+      values[1] = fmu;
+      digest.update(fmu, values);
+    }
+    digest.endStep();
+  }
+
+  // The first 5 of the 9 periodic checkpoints are stored, the other ones are dropped
+  EXPECT_EQ(monitor.getViolations(gazebo_fmi::RealTimeViolation::allocation), 0u);
+  ASSERT_EQ(digest.getCheckpoints().size(), 5u);
+  EXPECT_EQ(digest.getDroppedCheckpoints(), 4u);
+  for (size_t i=0; i < digest.getCheckpoints().size(); i++)
+  {
+    EXPECT_EQ(digest.getCheckpoints()[i].step, 10*(i+1));
+    ASSERT_EQ(digest.getCheckpoints()[i].fmuDigests.size(), 2u);
+  }
+
+  // The final checkpoint is stored by dump, outside the physics thread
+  ASSERT_TRUE(digest.dump());
+  ASSERT_EQ(digest.getCheckpoints().size(), 6u);
+  EXPECT_EQ(digest.getCheckpoints().back().step, 95u);
+  EXPECT_EQ(digest.getCheckpoints().back().digest, digest.getDigest());
+  EXPECT_EQ(digest.getCheckpoints().back().fmuDigests[1], digest.getFMUDigest(1));
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
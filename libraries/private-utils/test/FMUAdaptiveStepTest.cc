@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/FMUAdaptiveStep.hh>
+
+static gazebo_fmi::FMUAdaptiveStepOptions testOptions()
+{
+  gazebo_fmi::FMUAdaptiveStepOptions options;
+  options.enabled = true;
+  options.tolerance = 1e-3;
+  options.maxStepMultiple = 8;
+  options.safetyFactor = 0.9;
+  return options;
+}
+
+/////////////////////////////////////////////////
+/// The macro step grows while the error is small, at most doubling, up to the maximum
+TEST(FMUAdaptiveStepTest, GrowWithSmallError)
+{
+  gazebo_fmi::FMUAdaptiveStepper stepper;
+  ASSERT_TRUE(stepper.configure(testOptions(), 1, 1, "FMUAdaptiveStepTest"));
+  ASSERT_TRUE(stepper.isEnabled());
+
+  EXPECT_EQ(stepper.proposeStepMultiple(1, 0.0), 2u);
+  EXPECT_EQ(stepper.proposeStepMultiple(4, 0.0), 8u);
+  EXPECT_EQ(stepper.proposeStepMultiple(8, 0.0), 8u);
+
+  // Even when the controller asks for less than doubling, the step grows by at least one physics step
+  EXPECT_EQ(stepper.proposeStepMultiple(1, 5e-4), 2u);
+
+  // Close to the tolerance the safety factor shrinks the step
+  EXPECT_EQ(stepper.proposeStepMultiple(4, 1e-3), 3u);
+}
+
+/////////////////////////////////////////////////
+/// After a rejected step the macro step is always smaller, but at least one physics step
+TEST(FMUAdaptiveStepTest, ShrinkAfterRejection)
+{
+  gazebo_fmi::FMUAdaptiveStepper stepper;
+  ASSERT_TRUE(stepper.configure(testOptions(), 1, 1, "FMUAdaptiveStepTest"));
+
+  EXPECT_EQ(stepper.proposeStepMultiple(8, 1.2e-3), 6u);
+  EXPECT_EQ(stepper.proposeStepMultiple(8, 1.0), 1u);
+  EXPECT_EQ(stepper.proposeStepMultiple(1, 1.0), 1u);
+  EXPECT_EQ(stepper.proposeStepMultiple(8, 4e-3), 3u);
+}
+
+/////////////////////////////////////////////////
+/// Invalid options disable the adaptive step
+TEST(FMUAdaptiveStepTest, InvalidOptions)
+{
+  gazebo_fmi::FMUAdaptiveStepOptions options = testOptions();
+  options.maxStepMultiple = 0;
+  gazebo_fmi::FMUAdaptiveStepper stepper;
+  EXPECT_FALSE(stepper.configure(options, 1, 1, "FMUAdaptiveStepTest"));
+  EXPECT_FALSE(stepper.isEnabled());
+
+  options = testOptions();
+  options.safetyFactor = 0.0;
+  EXPECT_FALSE(stepper.configure(options, 1, 1, "FMUAdaptiveStepTest"));
+  EXPECT_FALSE(stepper.isEnabled());
+
+  gazebo_fmi::StepErrorEstimator estimator;
+  EXPECT_TRUE(gazebo_fmi::parseStepErrorEstimator("step_doubling", estimator));
+  EXPECT_EQ(estimator, gazebo_fmi::StepErrorEstimator::stepDoubling);
+  EXPECT_FALSE(gazebo_fmi::parseStepErrorEstimator("richardson", estimator));
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/FMUOutputPrediction.hh>
+
+static gazebo_fmi::FMUOutputPredictionOptions testOptions()
+{
+  gazebo_fmi::FMUOutputPredictionOptions options;
+  options.enabled = true;
+  options.trustRegions = {0.1, 1.0};
+  options.maxSkippedSteps = 3;
+  return options;
+}
+
+/////////////////////////////////////////////////
+/// Inside the trust region the outputs are predicted with the linear model of the checkpoint
+TEST(FMUOutputPredictionTest, PredictInTrustRegion)
+{
+  gazebo_fmi::FMUOutputPredictor predictor;
+  ASSERT_TRUE(predictor.configure(testOptions(), 2, 2, "FMUOutputPredictionTest"));
+  ASSERT_TRUE(predictor.isEnabled());
+
+  // Without a checkpoint nothing can be predicted
+  std::vector<double> inputs = {1.0, 2.0};
+  EXPECT_FALSE(predictor.canPredict(inputs));
+
+  // Row-major Jacobian, a row for each output
+  std::vector<double> outputs = {10.0, -1.0};
+  std::vector<double> jacobian = {2.0, 0.5,
+                                  0.0, -1.0};
+  predictor.setCheckpoint(inputs, outputs, jacobian);
+
+  inputs = {1.05, 2.5};
+  ASSERT_TRUE(predictor.canPredict(inputs));
+  predictor.predict(inputs, outputs);
+  EXPECT_NEAR(outputs[0], 10.0 + 2.0*0.05 + 0.5*0.5, 1e-12);
+  EXPECT_NEAR(outputs[1], -1.0 - 0.5, 1e-12);
+
+  // Each input has its own trust region, and NaN is never in it
+  inputs = {1.2, 2.0};
+  EXPECT_FALSE(predictor.canPredict(inputs));
+  inputs = {1.0, 3.5};
+  EXPECT_FALSE(predictor.canPredict(inputs));
+  inputs = {1.0, std::numeric_limits<double>::quiet_NaN()};
+  EXPECT_FALSE(predictor.canPredict(inputs));
+
+  EXPECT_EQ(predictor.getNrOfSteps(), 2u);
+  EXPECT_EQ(predictor.getNrOfSkippedSteps(), 1u);
+}
+
+/////////////////////////////////////////////////
+/// After maxSkippedSteps consecutive predictions a checkpoint is required
+TEST(FMUOutputPredictionTest, MaxSkippedSteps)
+{
+  gazebo_fmi::FMUOutputPredictor predictor;
+  ASSERT_TRUE(predictor.configure(testOptions(), 2, 2, "FMUOutputPredictionTest"));
+
+  std::vector<double> inputs = {0.0, 0.0};
+  std::vector<double> outputs = {0.0, 0.0};
+  std::vector<double> jacobian(4, 0.0);
+  predictor.setCheckpoint(inputs, outputs, jacobian);
+
+  for (int k=0; k < 3; k++)
+  {
+    ASSERT_TRUE(predictor.canPredict(inputs));
+    predictor.predict(inputs, outputs);
+  }
+  EXPECT_FALSE(predictor.canPredict(inputs));
+
+  predictor.setCheckpoint(inputs, outputs, jacobian);
+  EXPECT_TRUE(predictor.canPredict(inputs));
+  EXPECT_EQ(predictor.getNrOfSkippedSteps(), 3u);
+}
+
+/////////////////////////////////////////////////
+/// The prediction error is measured only at the checkpoints that follow skipped steps
+TEST(FMUOutputPredictionTest, PredictionError)
+{
+  gazebo_fmi::FMUOutputPredictor predictor;
+  ASSERT_TRUE(predictor.configure(testOptions(), 2, 2, "FMUOutputPredictionTest"));
+
+  std::vector<double> inputs = {0.0, 0.0};
+  std::vector<double> outputs = {1.0, 2.0};
+  std::vector<double> jacobian = {1.0, 0.0,
+                                  0.0, 1.0};
+  predictor.setCheckpoint(inputs, outputs, jacobian);
+
+  // No skipped steps, so no error is measured
+  outputs = {5.0, 5.0};
+  predictor.setCheckpoint(inputs, outputs, jacobian);
+  EXPECT_EQ(predictor.getAccumulatedPredictionError(), 0.0);
+
+  predictor.predict(inputs, outputs);
+
+  // The previous model predicts {5.5, 5.2}, the simulated outputs differ by 0.25 and 0.1
+  inputs = {0.5, 0.2};
+  outputs = {5.25, 5.3};
+  predictor.setCheckpoint(inputs, outputs, jacobian);
+  EXPECT_NEAR(predictor.getAccumulatedPredictionError(), 0.25, 1e-12);
+  EXPECT_NEAR(predictor.getMaxPredictionError(), 0.25, 1e-12);
+}
+
+/////////////////////////////////////////////////
+/// The trust regions should match the inputs
+TEST(FMUOutputPredictionTest, WrongNumberOfTrustRegions)
+{
+  gazebo_fmi::FMUOutputPredictor predictor;
+  EXPECT_FALSE(predictor.configure(testOptions(), 3, 1, "FMUOutputPredictionTest"));
+  EXPECT_FALSE(predictor.isEnabled());
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/FMURecording.hh>
+#include <gazebo_fmi/FMUReplay.hh>
+
+/////////////////////////////////////////////////
+TEST(FMURecordingTest, WriteAndReadBack)
+{
+  std::string recordingPath = CMAKE_CURRENT_BINARY_DIR"/FMURecordingTest.gzfmirec";
+  std::vector<std::string> channelNames = {"actuator_0/actuatorInput", "actuator_0/jointTorque", "actuator_1/jointTorque"};
+  const size_t samplesPerChunk = 10;
+  const size_t nrOfSamples = 45;
+  const double stepSize = 0.001;
+
+  {
+    gazebo_fmi::FMURecordingWriter writer;
+    ASSERT_TRUE(writer.open(recordingPath, channelNames, samplesPerChunk));
+
+    std::vector<double> actuator0(2);
+    for (size_t i=0; i < nrOfSamples; i++)
+    {
+      writer.beginSample(i*stepSize);
+      actuator0[0] = i;
+      actuator0[1] = 2.0*i;
+      writer.setChannels(0, actuator0);
+      writer.setChannel(2, -1.0*i);
+      writer.endSample();
+
+      // Wait for the background thread to write the previous chunk before this one is full,
+      // as otherwise the writer is allowed to drop samples
+      if ((i+1) % samplesPerChunk == 0)
+      {
+        writer.waitForPendingChunk();
+      }
+    }
+    writer.close();
+    EXPECT_EQ(writer.getDroppedSamples(), 0u);
+  }
+
+  gazebo_fmi::FMURecordingReader reader;
+  ASSERT_TRUE(reader.open(recordingPath));
+  ASSERT_EQ(reader.getChannelNames(), channelNames);
+  ASSERT_EQ(reader.getNrOfSamples(), nrOfSamples);
+
+  size_t actuator1Channel = 0;
+  ASSERT_TRUE(reader.getChannelIndex("actuator_1/jointTorque", actuator1Channel));
+  EXPECT_EQ(actuator1Channel, 2u);
+  EXPECT_FALSE(reader.getChannelIndex("actuator_2/jointTorque", actuator1Channel));
+
+  size_t sample = 0;
+  for (size_t i=0; i < nrOfSamples; i++)
+  {
+    ASSERT_TRUE(reader.findSample(i*stepSize, 1e-9, sample, sample));
+    EXPECT_EQ(sample, i);
+    EXPECT_DOUBLE_EQ(reader.getTime(sample), i*stepSize);
+    EXPECT_DOUBLE_EQ(reader.getValue(sample, 0), 1.0*i);
+    EXPECT_DOUBLE_EQ(reader.getValue(sample, 1), 2.0*i);
+    EXPECT_DOUBLE_EQ(reader.getValue(sample, 2), -1.0*i);
+  }
+
+  // Random access, and time between two samples
+  ASSERT_TRUE(reader.findSample(22.5*stepSize, 0.0, 0, sample));
+  EXPECT_EQ(sample, 22u);
+
+  // Time before the first sample
+  EXPECT_FALSE(reader.findSample(-1.0, 0.0, 0, sample));
+
+  reader.close();
+  std::remove(recordingPath.c_str());
+}
+
+/////////////////////////////////////////////////
+TEST(FMURecordingTest, Replay)
+{
+  std::string recordingPath = CMAKE_CURRENT_BINARY_DIR"/FMURecordingReplayTest.gzfmirec";
+  const size_t nrOfSamples = 20;
+  const double stepSize = 0.001;
+
+  {
+    gazebo_fmi::FMURecordingWriter writer;
+    ASSERT_TRUE(writer.open(recordingPath, {"actuator_0/actuatorInput", "actuator_0/jointTorque"}, 100));
+    for (size_t i=0; i < nrOfSamples; i++)
+    {
+      writer.beginSample(i*stepSize);
+      writer.setChannel(0, 1.0*i);
+      writer.setChannel(1, 10.0*i);
+      writer.endSample();
+    }
+    writer.close();
+  }
+
+  gazebo_fmi::FMUReplayOptions options;
+  options.enabled = true;
+  options.filePath = recordingPath;
+  options.checkInputs = true;
+  options.inputTolerance = 1e-3;
+
+  gazebo_fmi::FMUReplayer replayer;
+  ASSERT_TRUE(replayer.open(options, "FMURecordingTest"));
+  EXPECT_FALSE(replayer.addFMU({"actuator_1/actuatorInput"}, {"actuator_1/jointTorque"}));
+  ASSERT_TRUE(replayer.addFMU({"actuator_0/actuatorInput"}, {"actuator_0/jointTorque"}));
+
+  std::vector<double> inputs(1), outputs(1);
+  for (size_t i=0; i < nrOfSamples; i++)
+  {
+    ASSERT_TRUE(replayer.seek(i*stepSize));
+    inputs[0] = (i < 15) ? 1.0*i : 1.0*i + 1.0;
+    EXPECT_EQ(replayer.checkInputs(0, inputs), i < 15);
+    replayer.getOutputs(0, outputs);
+    EXPECT_DOUBLE_EQ(outputs[0], 10.0*i);
+  }
+  EXPECT_EQ(replayer.getNrOfDivergentSamples(), 5u);
+
+  // After the end of the recording the last outputs are held
+  ASSERT_TRUE(replayer.seek(1.0));
+  replayer.getOutputs(0, outputs);
+  EXPECT_DOUBLE_EQ(outputs[0], 10.0*(nrOfSamples-1));
+
+  std::remove(recordingPath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <gazebo_fmi/FMUScheduler.hh>
+
+/////////////////////////////////////////////////
+/// The longest processing time first rule balances the costs of the bins
+TEST(FMUSchedulerTest, Partition)
+{
+  gazebo_fmi::FMUTaskPartition partition;
+  partition.resize(7, 3);
+  ASSERT_EQ(partition.getNrOfTasks(), 7u);
+  ASSERT_EQ(partition.getNrOfBins(), 3u);
+
+  // Before compute the tasks are assigned round robin
+  EXPECT_EQ(partition.getBinEnd(0) - partition.getBinBegin(0), 3u);
+  EXPECT_EQ(partition.getBinEnd(2), 7u);
+
+  // 8 7 6 5 4 3 2 -> {8 3 2} {7 4} {6 5}, the optimal partition of a total cost of 35
+  const std::vector<double> costs = {3.0, 8.0, 5.0, 2.0, 7.0, 6.0, 4.0};
+  partition.compute(costs.data());
+
+  std::vector<int> assigned(costs.size(), 0);
+  double maxCost = 0.0;
+  for (size_t bin=0; bin < partition.getNrOfBins(); bin++)
+  {
+    double binCost = 0.0;
+    for (size_t k=partition.getBinBegin(bin); k < partition.getBinEnd(bin); k++)
+    {
+      const size_t task = partition.getBinTasks()[k];
+      assigned[task]++;
+      binCost += costs[task];
+
+      // In each bin the tasks are sorted by decreasing cost
+      if (k > partition.getBinBegin(bin))
+      {
+        EXPECT_GE(costs[partition.getBinTasks()[k-1]], costs[task]);
+      }
+    }
+    EXPECT_DOUBLE_EQ(binCost, partition.getBinCost(bin));
+    maxCost = std::max(maxCost, binCost);
+  }
+  EXPECT_EQ(assigned, std::vector<int>(costs.size(), 1));
+  EXPECT_DOUBLE_EQ(maxCost, 13.0);
+
+  // With equal costs the tasks are spread evenly
+  partition.compute(std::vector<double>(7, 0.0).data());
+  EXPECT_EQ(partition.getBinEnd(0) - partition.getBinBegin(0), 3u);
+  EXPECT_EQ(partition.getBinEnd(1) - partition.getBinBegin(1), 2u);
+}
+
+/////////////////////////////////////////////////
+/// Each cycle gathers the inputs of all the clients, steps each of their tasks once and then scatters the outputs
+TEST(FMUSchedulerTest, Cycle)
+{
+  std::shared_ptr<gazebo_fmi::FMUScheduler> scheduler = gazebo_fmi::FMUScheduler::getInstance();
+  EXPECT_FALSE(scheduler->isEnabled());
+  EXPECT_EQ(scheduler.get(), gazebo_fmi::FMUScheduler::getInstance().get());
+
+  gazebo_fmi::FMUSchedulerOptions options;
+  options.nrOfThreads = 3;
+  options.rebalancePeriod = 5;
+
+  // Each step phase exceeds the budget
+  options.budget.enabled = true;
+  options.budget.budgetInSeconds = 1e-12;
+  options.budget.logPeriodInSeconds = 100.0;
+  ASSERT_TRUE(scheduler->configure(options, "FMUSchedulerTest"));
+  EXPECT_TRUE(scheduler->isEnabled());
+  EXPECT_FALSE(scheduler->configure(options, "FMUSchedulerTest"));
+
+  struct Client
+  {
+    std::vector<double> inputs;
+    std::vector<double> outputs;
+    std::vector<std::atomic<int>> steps;
+    int gathers{0};
+    int scatters{0};
+    bool consistent{true};
+
+    explicit Client(size_t n) : inputs(n), outputs(n), steps(n) {}
+  };
+
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<uint64_t> clientIds;
+  for (size_t nrOfTasks : {5u, 1u, 8u})
+  {
+    clients.emplace_back(new Client(nrOfTasks));
+    Client* state = clients.back().get();
+
+    gazebo_fmi::FMUSchedulerClient client;
+    client.name = "client";
+    client.nrOfTasks = nrOfTasks;
+    client.taskNames = {"first"};
+    client.gather = [state](double time, double)
+    {
+      state->gathers++;
+      std::fill(state->inputs.begin(), state->inputs.end(), time);
+    };
+    client.step = [state](size_t task)
+    {
+      state->steps[task]++;
+      state->outputs[task] = 2.0*state->inputs[task];
+    };
+    client.scatter = [state]()
+    {
+      state->scatters++;
+      for (size_t task=0; task < state->outputs.size(); task++)
+      {
+        state->consistent = state->consistent && state->outputs[task] == 2.0*state->inputs[task];
+      }
+    };
+    clientIds.push_back(scheduler->addClient(client));
+  }
+  EXPECT_EQ(scheduler->getNrOfTasks(), 14u);
+
+  const int nrOfCycles = 50;
+  for (int cycle=0; cycle < nrOfCycles; cycle++)
+  {
+    scheduler->runCycle(0.001*cycle, 0.001);
+  }
+
+  for (const std::unique_ptr<Client>& client : clients)
+  {
+    EXPECT_EQ(client->gathers, nrOfCycles);
+    EXPECT_EQ(client->scatters, nrOfCycles);
+    EXPECT_TRUE(client->consistent);
+    for (const std::atomic<int>& steps : client->steps)
+    {
+      EXPECT_EQ(steps.load(), nrOfCycles);
+    }
+  }
+
+  // The step phase of the whole world is compared with the budget once per cycle
+  const gazebo_fmi::RealTimeBudgetStatistics& statistics = scheduler->getBudgetStatistics();
+  EXPECT_EQ(statistics.steps, static_cast<uint64_t>(nrOfCycles));
+  EXPECT_EQ(statistics.deadlineMisses, static_cast<uint64_t>(nrOfCycles));
+  ASSERT_EQ(statistics.fmus.size(), 14u);
+  EXPECT_EQ(statistics.fmus[0].name, "client/first");
+  EXPECT_EQ(statistics.fmus[1].name, "client/1");
+  uint64_t attributedMisses = 0;
+  for (const gazebo_fmi::FMUBudgetStatistics& fmuStatistics : statistics.fmus)
+  {
+    EXPECT_EQ(fmuStatistics.calls, static_cast<uint64_t>(nrOfCycles));
+    attributedMisses += fmuStatistics.deadlineMisses;
+  }
+  EXPECT_EQ(attributedMisses, static_cast<uint64_t>(nrOfCycles));
+
+  // A removed client is not stepped anymore
+  scheduler->removeClient(clientIds[1]);
+  EXPECT_EQ(scheduler->getNrOfTasks(), 13u);
+  scheduler->runCycle(1.0, 0.001);
+  EXPECT_EQ(clients[1]->gathers, nrOfCycles);
+  EXPECT_EQ(clients[2]->gathers, nrOfCycles+1);
+  EXPECT_EQ(clients[2]->steps[7].load(), nrOfCycles+1);
+  EXPECT_EQ(scheduler->getBudgetStatistics().fmus.size(), 13u);
+  EXPECT_EQ(scheduler->getBudgetStatistics().steps, 1u);
+
+  scheduler->printReport();
+
+  // A disabled scheduler has no clients and does not run its cycle, and it can be configured again
+  scheduler->disable();
+  EXPECT_FALSE(scheduler->isEnabled());
+  EXPECT_EQ(scheduler->getNrOfTasks(), 0u);
+  scheduler->runCycle(1.001, 0.001);
+  EXPECT_EQ(clients[2]->gathers, nrOfCycles+1);
+  EXPECT_TRUE(scheduler->configure(options, "FMUSchedulerTest"));
+  EXPECT_TRUE(scheduler->isEnabled());
+  scheduler->disable();
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/FMUStrongCoupling.hh>
+
+// Linear "FMU" y = A x + b, coupled with the linear system x = C y + d.
+// The fixed point is x = (C A) x + C b + d, and plain fixed-point iterations
+// diverge because the spectral radius of C A is larger than one.
+static bool evaluateLinearFMU(const std::vector<double>& x, std::vector<double>& y)
+{
+  y[0] = 2.0*x[0] + 0.5*x[1] + 1.0;
+  y[1] = -1.0*x[0] + 1.5*x[1];
+  return true;
+}
+
+static void evaluateLinearSystem(const std::vector<double>& y, std::vector<double>& x)
+{
+  x[0] = -0.8*y[0] + 0.1*y[1] + 0.2;
+  x[1] = 0.3*y[0] - 0.9*y[1];
+}
+
+static gazebo_fmi::FMUStrongCouplingOptions testOptions(gazebo_fmi::CouplingAcceleration acceleration)
+{
+  gazebo_fmi::FMUStrongCouplingOptions options;
+  options.enabled = true;
+  options.acceleration = acceleration;
+  options.maxIterations = 20;
+  options.tolerance = 1e-10;
+  options.relaxation = 0.5;
+  return options;
+}
+
+static void expectFixedPoint(const std::vector<double>& x, const std::vector<double>& y)
+{
+  std::vector<double> systemInputs(2);
+  evaluateLinearSystem(y, systemInputs);
+  EXPECT_NEAR(systemInputs[0], x[0], 1e-8);
+  EXPECT_NEAR(systemInputs[1], x[1], 1e-8);
+}
+
+/////////////////////////////////////////////////
+/// On a linear problem IQN-ILS converges after as many iterations as inputs, plus the first and the check
+TEST(FMUStrongCouplingTest, QuasiNewtonConvergesOnLinearProblem)
+{
+  gazebo_fmi::FMUStrongCoupling coupling;
+  ASSERT_TRUE(coupling.configure(testOptions(gazebo_fmi::CouplingAcceleration::iqnIls), 2, 2, "FMUStrongCouplingTest"));
+  ASSERT_TRUE(coupling.isEnabled());
+
+  std::vector<double> x = {0.0, 0.0};
+  std::vector<double> y(2);
+  ASSERT_TRUE(coupling.iterate(evaluateLinearFMU, evaluateLinearSystem, x, y));
+
+  expectFixedPoint(x, y);
+  EXPECT_EQ(coupling.getNrOfSteps(), 1u);
+  EXPECT_LE(coupling.getNrOfIterations(), 5u);
+  EXPECT_EQ(coupling.getNrOfNotConvergedSteps(), 0u);
+  EXPECT_LE(coupling.getMaxResidual(), 1e-10);
+}
+
+// Scalar problem y = 3 x + 1, x = -0.9 y + 0.5, whose fixed point is x = -0.4 / 3.7
+static bool evaluateScalarFMU(const std::vector<double>& x, std::vector<double>& y)
+{
+  y[0] = 3.0*x[0] + 1.0;
+  return true;
+}
+
+static void evaluateScalarSystem(const std::vector<double>& y, std::vector<double>& x)
+{
+  x[0] = -0.9*y[0] + 0.5;
+}
+
+/////////////////////////////////////////////////
+/// Aitken relaxation converges where the constant relaxation does not in the same number of iterations
+TEST(FMUStrongCouplingTest, AitkenConvergesFasterThanConstantRelaxation)
+{
+  gazebo_fmi::FMUStrongCoupling aitken;
+  ASSERT_TRUE(aitken.configure(testOptions(gazebo_fmi::CouplingAcceleration::aitken), 1, 1, "FMUStrongCouplingTest"));
+  std::vector<double> x = {0.0};
+  std::vector<double> y(1);
+  ASSERT_TRUE(aitken.iterate(evaluateScalarFMU, evaluateScalarSystem, x, y));
+  EXPECT_NEAR(x[0], -0.4/3.7, 1e-8);
+  EXPECT_EQ(aitken.getNrOfNotConvergedSteps(), 0u);
+
+  gazebo_fmi::FMUStrongCoupling constant;
+  ASSERT_TRUE(constant.configure(testOptions(gazebo_fmi::CouplingAcceleration::constant), 1, 1, "FMUStrongCouplingTest"));
+  x = {0.0};
+  ASSERT_TRUE(constant.iterate(evaluateScalarFMU, evaluateScalarSystem, x, y));
+  EXPECT_EQ(constant.getNrOfIterations(), 20u);
+  EXPECT_EQ(constant.getNrOfNotConvergedSteps(), 1u);
+  EXPECT_LT(aitken.getNrOfIterations(), constant.getNrOfIterations());
+}
+
+/////////////////////////////////////////////////
+/// With a single iteration the FMU is evaluated once with the initial guess, as with the explicit coupling
+TEST(FMUStrongCouplingTest, SingleIteration)
+{
+  gazebo_fmi::FMUStrongCouplingOptions options = testOptions(gazebo_fmi::CouplingAcceleration::iqnIls);
+  options.maxIterations = 1;
+  gazebo_fmi::FMUStrongCoupling coupling;
+  ASSERT_TRUE(coupling.configure(options, 2, 2, "FMUStrongCouplingTest"));
+
+  std::vector<double> x = {1.0, 2.0};
+  std::vector<double> y(2);
+  ASSERT_TRUE(coupling.iterate(evaluateLinearFMU, evaluateLinearSystem, x, y));
+  EXPECT_EQ(x[0], 1.0);
+  EXPECT_EQ(x[1], 2.0);
+  EXPECT_EQ(y[0], 4.0);
+  EXPECT_EQ(y[1], 2.0);
+  EXPECT_EQ(coupling.getNrOfIterations(), 1u);
+  EXPECT_EQ(coupling.getNrOfNotConvergedSteps(), 0u);
+}
+
+/////////////////////////////////////////////////
+/// Invalid options disable the coupling
+TEST(FMUStrongCouplingTest, InvalidOptions)
+{
+  gazebo_fmi::FMUStrongCouplingOptions options = testOptions(gazebo_fmi::CouplingAcceleration::aitken);
+  options.maxIterations = 0;
+  gazebo_fmi::FMUStrongCoupling coupling;
+  EXPECT_FALSE(coupling.configure(options, 2, 2, "FMUStrongCouplingTest"));
+  EXPECT_FALSE(coupling.isEnabled());
+
+  options.maxIterations = 10;
+  options.relaxation = 1.5;
+  EXPECT_FALSE(coupling.configure(options, 2, 2, "FMUStrongCouplingTest"));
+  EXPECT_FALSE(coupling.isEnabled());
+
+  gazebo_fmi::CouplingAcceleration acceleration;
+  EXPECT_TRUE(gazebo_fmi::parseCouplingAcceleration("iqn-ils", acceleration));
+  EXPECT_EQ(acceleration, gazebo_fmi::CouplingAcceleration::iqnIls);
+  EXPECT_FALSE(gazebo_fmi::parseCouplingAcceleration("newton", acceleration));
+}
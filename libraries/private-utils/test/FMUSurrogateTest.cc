@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/FMUSurrogate.hh>
+
+// Function of three inputs with two outputs, linear in each input (so reproduced exactly by the linear interpolation)
+// and a quadratic drag-like term
+static bool sampleFunction(const std::vector<double>& inputs, std::vector<double>& outputs)
+{
+  outputs.resize(2);
+  outputs[0] = 1.0 + 2.0*inputs[0] - 3.0*inputs[1] + 0.5*inputs[2] + inputs[0]*inputs[1]*inputs[2];
+  outputs[1] = -std::abs(inputs[0])*inputs[0];
+  return true;
+}
+
+static std::vector<gazebo_fmi::SurrogateGridAxis> testAxes()
+{
+  std::vector<gazebo_fmi::SurrogateGridAxis> axes(3);
+  axes[0].min = -2.0; axes[0].max = 2.0; axes[0].points = 41;
+  axes[1].min = -1.0; axes[1].max = 1.0; axes[1].points = 5;
+  axes[2].min = 0.0; axes[2].max = 3.0; axes[2].points = 4;
+  return axes;
+}
+
+/////////////////////////////////////////////////
+/// The multilinear interpolation is exact for multilinear functions, and matches the samples on the nodes
+TEST(FMUSurrogateTest, LinearInterpolation)
+{
+  gazebo_fmi::FMUSurrogateTable table;
+  ASSERT_TRUE(table.build(testAxes(), 2, gazebo_fmi::SurrogateInterpolation::linear, sampleFunction));
+  ASSERT_TRUE(table.isValid());
+  EXPECT_EQ(table.getNrOfNodes(), 41u*5u*4u);
+
+  std::vector<double> inputs = {0.33, -0.71, 2.2};
+  std::vector<double> outputs(2), expected(2);
+  ASSERT_TRUE(table.evaluate(inputs, outputs));
+  sampleFunction(inputs, expected);
+  EXPECT_NEAR(outputs[0], expected[0], 1e-12);
+  EXPECT_NEAR(outputs[1], expected[1], 5e-3);
+
+  inputs = {0.1, 0.5, 1.0};
+  ASSERT_TRUE(table.evaluate(inputs, outputs));
+  sampleFunction(inputs, expected);
+  EXPECT_NEAR(outputs[1], expected[1], 1e-12);
+  EXPECT_EQ(table.getNrOfClampedEvaluations(), 0u);
+
+  // Wrong sizes are refused
+  std::vector<double> wrongInputs(2);
+  EXPECT_FALSE(table.evaluate(wrongInputs, outputs));
+}
+
+/////////////////////////////////////////////////
+/// The cubic interpolation is more accurate than the linear one on smooth functions
+TEST(FMUSurrogateTest, CubicInterpolation)
+{
+  std::vector<gazebo_fmi::SurrogateGridAxis> axes(1);
+  axes[0].min = 0.0; axes[0].max = 3.0; axes[0].points = 16;
+  auto sampleSin = [](const std::vector<double>& inputs, std::vector<double>& outputs)
+  {
+    outputs.assign(1, std::sin(inputs[0]));
+    return true;
+  };
+
+  gazebo_fmi::FMUSurrogateTable linear, cubic;
+  ASSERT_TRUE(linear.build(axes, 1, gazebo_fmi::SurrogateInterpolation::linear, sampleSin));
+  ASSERT_TRUE(cubic.build(axes, 1, gazebo_fmi::SurrogateInterpolation::cubic, sampleSin));
+
+  double linearError = 0.0, cubicError = 0.0;
+  std::vector<double> inputs(1), outputs(1);
+  for (double x = 0.25; x < 2.75; x += 0.0137)
+  {
+    inputs[0] = x;
+    ASSERT_TRUE(linear.evaluate(inputs, outputs));
+    linearError = std::max(linearError, std::abs(outputs[0] - std::sin(x)));
+    ASSERT_TRUE(cubic.evaluate(inputs, outputs));
+    cubicError = std::max(cubicError, std::abs(outputs[0] - std::sin(x)));
+  }
+  EXPECT_LT(cubicError, linearError/4.0);
+}
+
+/////////////////////////////////////////////////
+/// The inputs outside of the grid are clamped to its boundary
+TEST(FMUSurrogateTest, Clamping)
+{
+  gazebo_fmi::FMUSurrogateTable table;
+  ASSERT_TRUE(table.build(testAxes(), 2, gazebo_fmi::SurrogateInterpolation::cubic, sampleFunction));
+
+  std::vector<double> inputs = {10.0, -1.0, NAN};
+  std::vector<double> clampedInputs = {2.0, -1.0, 0.0};
+  std::vector<double> outputs(2), expected(2);
+  ASSERT_TRUE(table.evaluate(inputs, outputs));
+  sampleFunction(clampedInputs, expected);
+  EXPECT_NEAR(outputs[0], expected[0], 1e-12);
+  EXPECT_NEAR(outputs[1], expected[1], 1e-12);
+  EXPECT_EQ(table.getNrOfClampedEvaluations(), 1u);
+}
+
+/////////////////////////////////////////////////
+/// A saved table is loaded only with the same key and grid
+TEST(FMUSurrogateTest, SaveAndLoad)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/FMUSurrogateTest.gzfmisur";
+  const uint64_t key = 0x1234abcdULL;
+
+  gazebo_fmi::FMUSurrogateTable table;
+  ASSERT_TRUE(table.build(testAxes(), 2, gazebo_fmi::SurrogateInterpolation::linear, sampleFunction));
+  ASSERT_TRUE(table.save(filePath, key));
+
+  gazebo_fmi::FMUSurrogateTable loaded;
+  EXPECT_FALSE(loaded.load(filePath, key + 1, testAxes(), 2, gazebo_fmi::SurrogateInterpolation::linear));
+  EXPECT_FALSE(loaded.load(filePath, key, testAxes(), 3, gazebo_fmi::SurrogateInterpolation::linear));
+  std::vector<gazebo_fmi::SurrogateGridAxis> otherAxes = testAxes();
+  otherAxes[1].points = 6;
+  EXPECT_FALSE(loaded.load(filePath, key, otherAxes, 2, gazebo_fmi::SurrogateInterpolation::linear));
+  EXPECT_FALSE(loaded.isValid());
+
+  ASSERT_TRUE(loaded.load(filePath, key, testAxes(), 2, gazebo_fmi::SurrogateInterpolation::linear));
+  std::vector<double> inputs = {-1.23, 0.4, 2.9};
+  std::vector<double> outputs(2), loadedOutputs(2);
+  ASSERT_TRUE(table.evaluate(inputs, outputs));
+  ASSERT_TRUE(loaded.evaluate(inputs, loadedOutputs));
+  EXPECT_EQ(outputs, loadedOutputs);
+
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// The hash of a file depends on its content
+TEST(FMUSurrogateTest, FileHash)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/FMUSurrogateTestHash.bin";
+  uint64_t firstHash = 0, secondHash = 0, thirdHash = 0;
+
+  FILE* file = std::fopen(filePath.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fputs("first content", file);
+  std::fclose(file);
+  ASSERT_TRUE(gazebo_fmi::computeFileHash(filePath, firstHash));
+  ASSERT_TRUE(gazebo_fmi::computeFileHash(filePath, secondHash));
+  EXPECT_EQ(firstHash, secondHash);
+
+  file = std::fopen(filePath.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fputs("second content", file);
+  std::fclose(file);
+  ASSERT_TRUE(gazebo_fmi::computeFileHash(filePath, thirdHash));
+  EXPECT_NE(firstHash, thirdHash);
+
+  std::remove(filePath.c_str());
+  EXPECT_FALSE(gazebo_fmi::computeFileHash(filePath, thirdHash));
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gazebo_fmi/FMUVariableStreaming.hh>
+
+struct PublishedSample
+{
+  std::string streamName;
+  double time;
+  std::vector<double> values;
+};
+
+// Fake FMU whose variables have as value the reference plus an offset, and that counts the batched reads
+struct FakeFMU
+{
+  double offset{0.0};
+  int reads{0};
+
+  gazebo_fmi::FMUVariableReadFunction reader()
+  {
+    return [this](const std::vector<fmi2_value_reference_t>& references, std::vector<double>& values)
+    {
+      reads++;
+      for (size_t i=0; i < references.size(); i++)
+      {
+        values[i] = references[i] + offset;
+      }
+      return true;
+    };
+  }
+};
+
+/////////////////////////////////////////////////
+/// The variables of a stream are read every decimation steps, with one read per FMU, and published in the requested order
+TEST(FMUVariableStreamingTest, Streams)
+{
+  std::mutex publishedMutex;
+  std::vector<PublishedSample> published;
+
+  gazebo_fmi::FMUVariableStreamingOptions options;
+  options.enabled = true;
+  options.maxVariablesPerStream = 3;
+  options.queueSize = 100;
+
+  gazebo_fmi::FMUVariableStreamer streamer;
+  ASSERT_TRUE(streamer.configure(options, "FMUVariableStreamingTest",
+                                 [&](const std::string& streamName, double time, const std::vector<double>& values)
+  {
+    std::lock_guard<std::mutex> lock(publishedMutex);
+    published.push_back(PublishedSample{streamName, time, values});
+  }));
+
+  FakeFMU motor, gearbox;
+  gearbox.offset = 0.5;
+  ASSERT_TRUE(streamer.addFMU("motor", {"current", "temperature"}, {10, 11}, motor.reader()));
+  ASSERT_TRUE(streamer.addFMU("gearbox", {"torque"}, {20}, gearbox.reader()));
+  EXPECT_EQ(streamer.getCatalogue(), std::vector<std::string>({"motor/current", "motor/temperature", "gearbox/torque"}));
+
+  // Without streams the FMUs are not read
+  for (int step=0; step < 10; step++)
+  {
+    streamer.update(0.001*step);
+  }
+  EXPECT_EQ(motor.reads, 0);
+  EXPECT_EQ(streamer.getNrOfActiveStreams(), 0u);
+
+  // Invalid requests are rejected
+  EXPECT_FALSE(streamer.requestStream("dashboard", {"motor/voltage"}, 1));
+  EXPECT_FALSE(streamer.requestStream("dash/board", {"motor/current"}, 1));
+  EXPECT_FALSE(streamer.requestStream("dashboard", {"motor/current"}, 0));
+  EXPECT_FALSE(streamer.requestStream("dashboard", {"motor/current", "motor/current", "motor/current", "gearbox/torque"}, 1));
+
+  ASSERT_TRUE(streamer.requestStream("dashboard", {"gearbox/torque", "motor/temperature", "motor/current"}, 2));
+  for (int step=0; step < 10; step++)
+  {
+    streamer.update(0.001*step);
+  }
+  EXPECT_EQ(streamer.getNrOfActiveStreams(), 1u);
+  EXPECT_EQ(motor.reads, 5);
+  EXPECT_EQ(gearbox.reads, 5);
+
+  // A request with no variables removes the stream, whatever its decimation
+  ASSERT_TRUE(streamer.requestStream("dashboard", {}, 0));
+  streamer.update(1.0);
+  EXPECT_EQ(streamer.getNrOfActiveStreams(), 0u);
+  EXPECT_EQ(motor.reads, 5);
+
+  streamer.close();
+  EXPECT_EQ(streamer.getDroppedSamples(), 0u);
+
+  ASSERT_EQ(published.size(), 5u);
+  for (size_t k=0; k < published.size(); k++)
+  {
+    EXPECT_EQ(published[k].streamName, "dashboard");
+    EXPECT_DOUBLE_EQ(published[k].time, 0.002*k);
+    EXPECT_EQ(published[k].values, std::vector<double>({20.5, 11.0, 10.0}));
+  }
+}
+
+/////////////////////////////////////////////////
+/// The samples that do not fit in the queue are dropped and counted
+TEST(FMUVariableStreamingTest, Overflow)
+{
+  std::mutex blockMutex;
+  std::unique_lock<std::mutex> block(blockMutex);
+
+  gazebo_fmi::FMUVariableStreamingOptions options;
+  options.enabled = true;
+  options.queueSize = 4;
+
+  // The publishing thread is blocked on the first sample until the physics steps are done
+  int published = 0;
+  gazebo_fmi::FMUVariableStreamer streamer;
+  ASSERT_TRUE(streamer.configure(options, "FMUVariableStreamingTest",
+                                 [&](const std::string&, double, const std::vector<double>&)
+  {
+    std::lock_guard<std::mutex> lock(blockMutex);
+    published++;
+  }));
+
+  FakeFMU fmu;
+  ASSERT_TRUE(streamer.addFMU("fmu", {"x"}, {1}, fmu.reader()));
+  ASSERT_TRUE(streamer.requestStream("x", {"fmu/x"}, 1));
+
+  const int nrOfSteps = 20;
+  for (int step=0; step < nrOfSteps; step++)
+  {
+    streamer.update(0.001*step);
+  }
+  block.unlock();
+  streamer.close();
+
+  EXPECT_GE(streamer.getDroppedSamples(), static_cast<uint64_t>(nrOfSteps-options.queueSize-1));
+  EXPECT_EQ(published + static_cast<int>(streamer.getDroppedSamples()), nrOfSteps);
+  streamer.printReport();
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <gazebo_fmi/FlowField.hh>
+
+// Field that is linear in space and time, and is then reproduced exactly by the interpolation
+static void linearField(double x, double y, double z, double t, double& u, double& v, double& w)
+{
+  u = 1.0 + 2.0*x - y;
+  v = 0.5*z + 3.0*t;
+  w = x*0.1 - t;
+}
+
+static gazebo_fmi::FlowFieldGrid writeLinearField(const std::string& filePath, const uint64_t timeSamples)
+{
+  gazebo_fmi::FlowFieldGrid grid;
+  grid.points = {{4, 3, 2, timeSamples}};
+  grid.origin = {{-1.0, 0.0, 2.0, 10.0}};
+  grid.spacing = {{0.5, 1.0, 2.0, 0.1}};
+
+  std::vector<double> velocities;
+  for (uint64_t l=0; l < grid.points[3]; l++)
+  for (uint64_t k=0; k < grid.points[2]; k++)
+  for (uint64_t j=0; j < grid.points[1]; j++)
+  for (uint64_t i=0; i < grid.points[0]; i++)
+  {
+    double u, v, w;
+    linearField(grid.origin[0] + i*grid.spacing[0], grid.origin[1] + j*grid.spacing[1],
+                grid.origin[2] + k*grid.spacing[2], grid.origin[3] + l*grid.spacing[3], u, v, w);
+    velocities.push_back(u);
+    velocities.push_back(v);
+    velocities.push_back(w);
+  }
+
+  EXPECT_TRUE(gazebo_fmi::writeFlowFieldFile(filePath, grid, velocities));
+  return grid;
+}
+
+/////////////////////////////////////////////////
+/// The interpolation of a field linear in space and time is exact inside the grid, and clamped outside
+TEST(FlowFieldTest, Interpolation)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/FlowFieldTest.gzfmifld";
+  writeLinearField(filePath, 3);
+
+  gazebo_fmi::FlowField field;
+  ASSERT_TRUE(field.open(filePath));
+  EXPECT_EQ(field.getGrid().getNrOfNodes(), 72u);
+
+  double u, v, w, u_exp, v_exp, w_exp;
+  EXPECT_TRUE(field.sample(0.3, 1.7, 3.1, 10.15, u, v, w));
+  linearField(0.3, 1.7, 3.1, 10.15, u_exp, v_exp, w_exp);
+  EXPECT_NEAR(u, u_exp, 1e-12);
+  EXPECT_NEAR(v, v_exp, 1e-12);
+  EXPECT_NEAR(w, w_exp, 1e-12);
+
+  // The last node of each axis is inside the grid
+  EXPECT_TRUE(field.sample(0.5, 2.0, 4.0, 10.2, u, v, w));
+  linearField(0.5, 2.0, 4.0, 10.2, u_exp, v_exp, w_exp);
+  EXPECT_NEAR(u, u_exp, 1e-12);
+
+  // Outside the grid the field is the one of the nearest point of the boundary
+  EXPECT_FALSE(field.sample(5.0, -1.0, 3.0, 20.0, u, v, w));
+  linearField(0.5, 0.0, 3.0, 10.2, u_exp, v_exp, w_exp);
+  EXPECT_NEAR(u, u_exp, 1e-12);
+  EXPECT_NEAR(v, v_exp, 1e-12);
+  EXPECT_NEAR(w, w_exp, 1e-12);
+
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// A field with a single time sample does not depend on time
+TEST(FlowFieldTest, Stationary)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/FlowFieldTestStationary.gzfmifld";
+  writeLinearField(filePath, 1);
+
+  gazebo_fmi::FlowField field;
+  ASSERT_TRUE(field.open(filePath));
+
+  double u, v, w, u_exp, v_exp, w_exp;
+  EXPECT_TRUE(field.sample(-0.2, 0.4, 2.5, 1000.0, u, v, w));
+  linearField(-0.2, 0.4, 2.5, 10.0, u_exp, v_exp, w_exp);
+  EXPECT_NEAR(u, u_exp, 1e-12);
+  EXPECT_NEAR(v, v_exp, 1e-12);
+  EXPECT_NEAR(w, w_exp, 1e-12);
+
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// The users of the same file share a single mapping, that is released with the last user
+TEST(FlowFieldTest, Shared)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/FlowFieldTestShared.gzfmifld";
+  writeLinearField(filePath, 2);
+
+  std::shared_ptr<const gazebo_fmi::FlowField> first = gazebo_fmi::FlowField::getShared(filePath);
+  ASSERT_TRUE(first != nullptr);
+  std::shared_ptr<const gazebo_fmi::FlowField> second = gazebo_fmi::FlowField::getShared(CMAKE_CURRENT_BINARY_DIR"/./FlowFieldTestShared.gzfmifld");
+  EXPECT_EQ(first.get(), second.get());
+
+  std::weak_ptr<const gazebo_fmi::FlowField> weak = first;
+  first.reset();
+  second.reset();
+  EXPECT_TRUE(weak.expired());
+
+  std::remove(filePath.c_str());
+  EXPECT_TRUE(gazebo_fmi::FlowField::getShared(filePath) == nullptr);
+}
+
+/////////////////////////////////////////////////
+/// Files that are truncated or are not flow fields are rejected
+TEST(FlowFieldTest, InvalidFiles)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/FlowFieldTestInvalid.gzfmifld";
+
+  gazebo_fmi::FlowFieldGrid grid;
+  grid.points = {{2, 2, 2, 1}};
+  EXPECT_FALSE(gazebo_fmi::writeFlowFieldFile(filePath, grid, std::vector<double>(3)));
+  grid.spacing[0] = 0.0;
+  EXPECT_FALSE(gazebo_fmi::writeFlowFieldFile(filePath, grid, std::vector<double>(24)));
+
+  FILE* file = std::fopen(filePath.c_str(), "wb");
+  ASSERT_TRUE(file != nullptr);
+  const char garbage[200] = "not a flow field";
+  std::fwrite(garbage, sizeof(garbage), 1, file);
+  std::fclose(file);
+
+  gazebo_fmi::FlowField field;
+  EXPECT_FALSE(field.open(filePath));
+
+  double u, v, w;
+  EXPECT_FALSE(field.sample(0.0, 0.0, 0.0, 0.0, u, v, w));
+  EXPECT_EQ(u, 0.0);
+
+  std::remove(filePath.c_str());
+}
@@ -8,6 +8,10 @@
  * at your option.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include <gazebo/physics/physics.hh>
 
 #include <gazebo/test/ServerFixture.hh>
@@ -23,6 +27,17 @@ class GazeboFMIUtilsComputeJointAccelerationTest : public gazebo::ServerFixture,
   public: void PluginTestHelper(const std::string &_physicsEngine,
                                 const std::string &worldName);
 
+  public: void PrismaticTest(const std::string &_physicsEngine);
+
+  public: void UniversalTest(const std::string &_physicsEngine);
+
+  public: void ScrewTest(const std::string &_physicsEngine);
+
+  /// Check the accelerations of the first nrOfAxes axes of a joint against the finite differences of the joint velocities
+  public: void FiniteDifferencesTestHelper(const std::string &_physicsEngine, const std::string &worldName,
+                                           const std::string &modelName, const std::string &jointName,
+                                           const unsigned int nrOfAxes);
+
 };
 
 void GazeboFMIUtilsComputeJointAccelerationTest::PluginTestHelper(const std::string &_physicsEngine,
@@ -57,6 +72,25 @@ void GazeboFMIUtilsComputeJointAccelerationTest::PluginTestHelper(const std::str
   double tol = 0.1;
   EXPECT_NEAR(finalJointAcceleration, 0.0, tol);
 
+  // The cache reads the same kinematics of the links
+  gazebo_fmi::JointAccelerationCache cache;
+  cache.configure({joint});
+  double cachedJointAcceleration = 0.0;
+  cache.compute(&cachedJointAcceleration);
+  EXPECT_DOUBLE_EQ(cachedJointAcceleration, finalJointAcceleration);
+
+  // The joints that are not needed are skipped, and their accelerations are left untouched
+  std::vector<double> maskedJointAccelerations = {-1.0, -1.0};
+  cache.configure({joint, joint}, {false, true});
+  EXPECT_EQ(cache.getNrOfJoints(), 1u);
+  cache.compute(maskedJointAccelerations.data());
+  EXPECT_DOUBLE_EQ(maskedJointAccelerations[0], -1.0);
+  EXPECT_DOUBLE_EQ(maskedJointAccelerations[1], finalJointAcceleration);
+
+  cache.configure({joint}, {false});
+  EXPECT_EQ(cache.getNrOfJoints(), 0u);
+  EXPECT_EQ(cache.getNrOfLinks(), 1u);
+
   // Unload the simulation
   Unload();
 }
@@ -74,12 +108,162 @@ void GazeboFMIUtilsComputeJointAccelerationTest::PluginTest(const std::string &_
   }
 }
 
+/////////////////////////////////////////////////////////////////////
+void GazeboFMIUtilsComputeJointAccelerationTest::PrismaticTest(const std::string &_physicsEngine)
+{
+  bool worldPaused = true;
+  std::string worldAbsPath = CMAKE_CURRENT_SOURCE_DIR"/test_ComputeJointAcceleration_Prismatic.world";
+  Load(worldAbsPath, worldPaused, _physicsEngine);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  ASSERT_TRUE(world != NULL);
+
+#if GAZEBO_MAJOR_VERSION >=8
+  auto model = world->ModelByName("slider_attached_to_world");
+  const double gravity_z = world->Gravity().Z();
+#else
+  auto model = world->GetModel("slider_attached_to_world");
+  const double gravity_z = world->GetPhysicsEngine()->GetGravity().z;
+#endif
+
+  // Run the world for a few steps
+  for(int i=0; i < 10; i++)
+  {
+    world->Step(1);
+  }
+
+  // The mass falls freely along the joint axis
+  auto joint = model->GetJoint("slider_joint");
+  double finalJointAcceleration = gazebo_fmi::ComputeJointAcceleration(joint);
+
+  gzdbg << "Final  acceleration " << finalJointAcceleration << std::endl;
+  double tol = 0.1;
+  EXPECT_NEAR(finalJointAcceleration, gravity_z, tol);
+
+  // Unload the simulation
+  Unload();
+}
+
+/////////////////////////////////////////////////////////////////////
+void GazeboFMIUtilsComputeJointAccelerationTest::FiniteDifferencesTestHelper(const std::string &_physicsEngine,
+                                                                            const std::string &worldName,
+                                                                            const std::string &modelName,
+                                                                            const std::string &jointName,
+                                                                            const unsigned int nrOfAxes)
+{
+  bool worldPaused = true;
+  std::string worldAbsPath = CMAKE_CURRENT_SOURCE_DIR"/" + worldName;
+  Load(worldAbsPath, worldPaused, _physicsEngine);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  ASSERT_TRUE(world != NULL);
+
+  gzdbg << "GazeboFMIUtilsComputeJointAccelerationTest: testing world " << worldName << std::endl;
+
+#if GAZEBO_MAJOR_VERSION >=8
+  auto model = world->ModelByName(modelName);
+  const double stepSize = world->Physics()->GetMaxStepSize();
+#else
+  auto model = world->GetModel(modelName);
+  const double stepSize = world->GetPhysicsEngine()->GetMaxStepSize();
+#endif
+  ASSERT_TRUE(model != NULL);
+  auto joint = model->GetJoint(jointName);
+  ASSERT_TRUE(joint != NULL);
+
+  // Start with a velocity on all the axes, so that the terms that depend on the velocities
+  // (e.g. the transport of the second axis of a universal joint) are not zero
+  for (unsigned int axis=0; axis < nrOfAxes; axis++)
+  {
+    joint->SetVelocity(axis, 1.0 + axis);
+  }
+  world->Step(1);
+
+  gazebo_fmi::JointAccelerationCache cache;
+  cache.configure({joint});
+
+  // The accelerations change slowly with respect to the step, so the backward difference of the velocities
+  // approximates the acceleration of the step regardless of how the physics engine integrates the velocities
+  std::vector<double> previousVelocities(nrOfAxes);
+  for (unsigned int axis=0; axis < nrOfAxes; axis++)
+  {
+    previousVelocities[axis] = joint->GetVelocity(axis);
+  }
+
+  double maxAcceleration = 0.0;
+  for (int i=0; i < 100; i++)
+  {
+    world->Step(1);
+
+    for (unsigned int axis=0; axis < nrOfAxes; axis++)
+    {
+      const double velocity = joint->GetVelocity(axis);
+      const double finiteDifference = (velocity - previousVelocities[axis])/stepSize;
+      previousVelocities[axis] = velocity;
+
+      const double acceleration = gazebo_fmi::ComputeJointAcceleration(joint, axis);
+      const double tol = 0.05*std::abs(finiteDifference) + 0.05;
+      EXPECT_NEAR(acceleration, finiteDifference, tol) << "axis " << axis << " at step " << i;
+      maxAcceleration = std::max(maxAcceleration, std::abs(acceleration));
+    }
+
+    // The cache computes the acceleration of the first axis
+    double cachedJointAcceleration = 0.0;
+    cache.compute(&cachedJointAcceleration);
+    EXPECT_DOUBLE_EQ(cachedJointAcceleration, gazebo_fmi::ComputeJointAcceleration(joint));
+  }
+
+  // The joint is actually accelerated
+  EXPECT_GT(maxAcceleration, 0.5);
+
+  // Unload the simulation
+  Unload();
+}
+
+/////////////////////////////////////////////////////////////////////
+void GazeboFMIUtilsComputeJointAccelerationTest::UniversalTest(const std::string &_physicsEngine)
+{
+  this->FiniteDifferencesTestHelper(_physicsEngine, "test_ComputeJointAcceleration_Universal.world",
+                                    "universal_pendulum_attached_to_world", "universal_joint", 2u);
+}
+
+/////////////////////////////////////////////////////////////////////
+void GazeboFMIUtilsComputeJointAccelerationTest::ScrewTest(const std::string &_physicsEngine)
+{
+  // Only ODE and DART simulate the coupling between the rotation and the translation of a screw joint
+  if (_physicsEngine != "ode" && _physicsEngine != "dart")
+  {
+    return;
+  }
+
+  this->FiniteDifferencesTestHelper(_physicsEngine, "test_ComputeJointAcceleration_Screw.world",
+                                    "nut_attached_to_world", "screw_joint", 1u);
+}
+
 /////////////////////////////////////////////////
 TEST_P(GazeboFMIUtilsComputeJointAccelerationTest, PluginTest)
 {
   PluginTest(GetParam());
 }
 
+/////////////////////////////////////////////////
+TEST_P(GazeboFMIUtilsComputeJointAccelerationTest, PrismaticTest)
+{
+  PrismaticTest(GetParam());
+}
+
+/////////////////////////////////////////////////
+TEST_P(GazeboFMIUtilsComputeJointAccelerationTest, UniversalTest)
+{
+  UniversalTest(GetParam());
+}
+
+/////////////////////////////////////////////////
+TEST_P(GazeboFMIUtilsComputeJointAccelerationTest, ScrewTest)
+{
+  ScrewTest(GetParam());
+}
+
 /////////////////////////////////////////////////
 INSTANTIATE_TEST_CASE_P(PhysicsEngines, GazeboFMIUtilsComputeJointAccelerationTest, PHYSICS_ENGINE_VALUES);
 
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include <gazebo_fmi/NativeFluidDynamics.hh>
+
+struct Wrenches
+{
+  std::vector<double> f_x, f_y, f_z, m_x, m_y, m_z;
+
+  explicit Wrenches(size_t n) : f_x(n), f_y(n), f_z(n), m_x(n), m_y(n), m_z(n) {}
+};
+
+static void evaluate(const gazebo_fmi::NativeFluidDynamicsModels& models,
+                     const std::vector<double>& v_x, const std::vector<double>& v_y, const std::vector<double>& v_z,
+                     Wrenches& wrenches)
+{
+  models.evaluate(v_x.data(), v_y.data(), v_z.data(),
+                  wrenches.f_x.data(), wrenches.f_y.data(), wrenches.f_z.data(),
+                  wrenches.m_x.data(), wrenches.m_y.data(), wrenches.m_z.data());
+}
+
+/////////////////////////////////////////////////
+/// Linear and quadratic drag oppose the velocity along each axis, bodies without a model get a zero wrench
+TEST(NativeFluidDynamicsTest, Drag)
+{
+  gazebo_fmi::NativeFluidDynamicsModels models;
+
+  gazebo_fmi::NativeFluidDynamicsModelOptions linear;
+  linear.enabled = true;
+  linear.type = gazebo_fmi::NativeFluidDynamicsModelType::linearDrag;
+  linear.coefficients = {{1.0, 2.0, 3.0}};
+  ASSERT_TRUE(models.addBody(linear, "NativeFluidDynamicsTest"));
+
+  gazebo_fmi::NativeFluidDynamicsModelOptions quadratic = linear;
+  quadratic.type = gazebo_fmi::NativeFluidDynamicsModelType::quadraticDrag;
+  ASSERT_TRUE(models.addBody(quadratic, "NativeFluidDynamicsTest"));
+
+  ASSERT_TRUE(models.addBody(gazebo_fmi::NativeFluidDynamicsModelOptions(), "NativeFluidDynamicsTest"));
+  ASSERT_EQ(models.getNrOfBodies(), 3u);
+
+  Wrenches wrenches(3);
+  evaluate(models, {2.0, 2.0, 2.0}, {-1.0, -1.0, -1.0}, {0.5, 0.5, 0.5}, wrenches);
+
+  EXPECT_DOUBLE_EQ(wrenches.f_x[0], -2.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_y[0], 2.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_z[0], -1.5);
+  EXPECT_DOUBLE_EQ(wrenches.f_x[1], -4.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_y[1], 2.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_z[1], -0.75);
+  EXPECT_DOUBLE_EQ(wrenches.m_x[1], 0.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_x[2], 0.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_y[2], 0.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_z[2], 0.0);
+}
+
+/////////////////////////////////////////////////
+/// Before the stall the lift is orthogonal to the velocity and grows with the angle of attack
+TEST(NativeFluidDynamicsTest, LiftDrag)
+{
+  gazebo_fmi::NativeFluidDynamicsModelOptions options;
+  options.enabled = true;
+  options.type = gazebo_fmi::NativeFluidDynamicsModelType::liftDrag;
+  options.fluidDensity = 1.0;
+  options.area = 2.0;
+  options.cla = 4.0;
+  options.cda = 0.5;
+  options.alphaStall = 0.3;
+  options.centerOfPressure = {{0.0, 1.0, 0.0}};
+
+  gazebo_fmi::NativeFluidDynamicsModels models;
+  ASSERT_TRUE(models.addBody(options, "NativeFluidDynamicsTest"));
+
+  // Moving forward and downward, the fluid comes from below with an angle of attack atan(1/10)
+  Wrenches wrenches(1);
+  evaluate(models, {10.0}, {0.0}, {-1.0}, wrenches);
+
+  const double alpha = std::atan(0.1);
+  const double q = 0.5*1.0*2.0*101.0;
+  const double lift = q*4.0*alpha;
+  const double drag = q*0.5*alpha;
+  const double c = 10.0/std::sqrt(101.0);
+  const double s = 1.0/std::sqrt(101.0);
+  EXPECT_NEAR(wrenches.f_x[0], lift*s - drag*c, 1e-9);
+  EXPECT_NEAR(wrenches.f_y[0], 0.0, 1e-9);
+  EXPECT_NEAR(wrenches.f_z[0], lift*c + drag*s, 1e-9);
+  EXPECT_GT(wrenches.f_z[0], 0.0);
+
+  // The force is applied in the center of pressure
+  EXPECT_NEAR(wrenches.m_x[0], wrenches.f_z[0], 1e-9);
+  EXPECT_NEAR(wrenches.m_z[0], -wrenches.f_x[0], 1e-9);
+
+  // The velocity along the span does not produce any force
+  evaluate(models, {0.0}, {5.0}, {0.0}, wrenches);
+  EXPECT_DOUBLE_EQ(wrenches.f_x[0], 0.0);
+  EXPECT_DOUBLE_EQ(wrenches.f_z[0], 0.0);
+}
+
+/////////////////////////////////////////////////
+/// Invalid options are rejected
+TEST(NativeFluidDynamicsTest, InvalidOptions)
+{
+  gazebo_fmi::NativeFluidDynamicsModelOptions options;
+  options.enabled = true;
+  options.type = gazebo_fmi::NativeFluidDynamicsModelType::liftDrag;
+  options.upward = {{2.0, 0.0, 0.0}};
+
+  gazebo_fmi::NativeFluidDynamicsModels models;
+  EXPECT_FALSE(models.addBody(options, "NativeFluidDynamicsTest"));
+  EXPECT_EQ(models.getNrOfBodies(), 0u);
+
+  options.upward = {{0.0, 0.0, 1.0}};
+  options.area = 0.0;
+  EXPECT_FALSE(models.addBody(options, "NativeFluidDynamicsTest"));
+
+  gazebo_fmi::NativeFluidDynamicsModelType type;
+  EXPECT_TRUE(gazebo_fmi::parseNativeFluidDynamicsModelType("lift_drag", type));
+  EXPECT_EQ(type, gazebo_fmi::NativeFluidDynamicsModelType::liftDrag);
+  EXPECT_FALSE(gazebo_fmi::parseNativeFluidDynamicsModelType("cubic_drag", type));
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/AsyncLogger.hh>
+#include <gazebo_fmi/RealTimeBudgetMonitor.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+/////////////////////////////////////////////////
+/// Run a step in which the i-th FMU takes fmuTimesInMilliseconds[i]
+void runStep(gazebo_fmi::RealTimeBudgetMonitor& monitor,
+             const std::vector<int>& fmuTimesInMilliseconds,
+             const double stepSizeInSeconds,
+             const double simulatedTimeInSeconds)
+{
+  monitor.beginStep();
+  for (size_t i=0; i < fmuTimesInMilliseconds.size(); i++)
+  {
+    monitor.beginFMU(i);
+    std::this_thread::sleep_for(std::chrono::milliseconds(fmuTimesInMilliseconds[i]));
+    monitor.endFMU(i);
+  }
+  monitor.endStep(stepSizeInSeconds, simulatedTimeInSeconds);
+}
+
+/////////////////////////////////////////////////
+/// The budget in seconds takes precedence over the fraction of the step size
+TEST(RealTimeBudgetMonitorTest, BudgetSelection)
+{
+  gazebo_fmi::RealTimeBudgetOptions options;
+  options.enabled = true;
+  options.budgetFraction = 0.5;
+  options.logPeriodInSeconds = 100.0;
+
+  // The budget is 0.5*0.1 s = 50 ms
+  gazebo_fmi::RealTimeBudgetMonitor fractionMonitor;
+  fractionMonitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0", "actuator_1"});
+  ASSERT_TRUE(fractionMonitor.isEnabled());
+  runStep(fractionMonitor, {2, 2}, 0.1, 0.1);
+  EXPECT_EQ(fractionMonitor.getStatistics().deadlineMisses, 0u);
+  runStep(fractionMonitor, {30, 30}, 0.1, 0.2);
+  EXPECT_EQ(fractionMonitor.getStatistics().deadlineMisses, 1u);
+
+  // The budget is 200 ms, whatever the step size
+  options.budgetInSeconds = 0.2;
+  gazebo_fmi::RealTimeBudgetMonitor budgetMonitor;
+  budgetMonitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0", "actuator_1"});
+  runStep(budgetMonitor, {30, 30}, 0.1, 0.1);
+  runStep(budgetMonitor, {30, 30}, 0.001, 0.101);
+  EXPECT_EQ(budgetMonitor.getStatistics().steps, 2u);
+  EXPECT_EQ(budgetMonitor.getStatistics().deadlineMisses, 0u);
+
+  // A disabled monitor does not measure anything
+  gazebo_fmi::RealTimeBudgetMonitor disabledMonitor;
+  disabledMonitor.configure(gazebo_fmi::RealTimeBudgetOptions(), "RealTimeBudgetMonitorTest", {"actuator_0"});
+  EXPECT_FALSE(disabledMonitor.isEnabled());
+  runStep(disabledMonitor, {30}, 0.01, 0.01);
+  EXPECT_EQ(disabledMonitor.getStatistics().steps, 0u);
+  EXPECT_EQ(disabledMonitor.getStatistics().fmus[0].calls, 0u);
+}
+
+/////////////////////////////////////////////////
+/// Deadline misses and overruns are accumulated, and attributed to the most expensive FMU of the step
+TEST(RealTimeBudgetMonitorTest, DeadlineMisses)
+{
+  gazebo_fmi::RealTimeBudgetOptions options;
+  options.enabled = true;
+  options.budgetInSeconds = 0.03;
+  options.logPeriodInSeconds = 100.0;
+
+  gazebo_fmi::RealTimeBudgetMonitor monitor;
+  monitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0", "actuator_1", "actuator_2"});
+  runStep(monitor, {5, 40, 1}, 0.001, 0.001);
+  runStep(monitor, {1, 1, 1}, 0.001, 0.002);
+  runStep(monitor, {50, 5, 1}, 0.001, 0.003);
+
+  const gazebo_fmi::RealTimeBudgetStatistics& statistics = monitor.getStatistics();
+  EXPECT_EQ(statistics.steps, 3u);
+  EXPECT_EQ(statistics.deadlineMisses, 2u);
+
+  // The overruns are at least 46-30 ms and 56-30 ms
+  EXPECT_GE(statistics.maxOverrunInSeconds, 0.026);
+  EXPECT_GE(statistics.totalOverrunInSeconds, 0.016+0.026);
+  EXPECT_LE(statistics.maxOverrunInSeconds, statistics.totalOverrunInSeconds);
+
+  ASSERT_EQ(statistics.fmus.size(), 3u);
+  EXPECT_EQ(statistics.fmus[0].name, "actuator_0");
+  EXPECT_EQ(statistics.fmus[0].deadlineMisses, 1u);
+  EXPECT_EQ(statistics.fmus[1].deadlineMisses, 1u);
+  EXPECT_EQ(statistics.fmus[2].deadlineMisses, 0u);
+  for (const gazebo_fmi::FMUBudgetStatistics& fmuStatistics : statistics.fmus)
+  {
+    EXPECT_EQ(fmuStatistics.calls, 3u);
+    EXPECT_LE(fmuStatistics.maxTimeInSeconds, fmuStatistics.totalTimeInSeconds);
+  }
+  EXPECT_GE(statistics.fmus[0].maxTimeInSeconds, 0.05);
+  EXPECT_GE(statistics.fmus[1].maxTimeInSeconds, 0.04);
+
+  // A new configuration resets the statistics
+  monitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0"});
+  EXPECT_EQ(monitor.getStatistics().steps, 0u);
+  EXPECT_EQ(monitor.getStatistics().deadlineMisses, 0u);
+  ASSERT_EQ(monitor.getStatistics().fmus.size(), 1u);
+}
+
+/////////////////////////////////////////////////
+/// With concurrent FMUs the wall-clock time of the step is compared with the budget
+TEST(RealTimeBudgetMonitorTest, ConcurrentFMUs)
+{
+  gazebo_fmi::RealTimeBudgetOptions options;
+  options.enabled = true;
+  options.budgetInSeconds = 0.05;
+  options.logPeriodInSeconds = 100.0;
+
+  gazebo_fmi::RealTimeBudgetMonitor monitor;
+  monitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0", "actuator_1"});
+  monitor.setConcurrentFMUs(true);
+
+  // The sum of the FMU times is 60 ms, but they overlap
+  monitor.beginStep();
+  std::vector<std::thread> threads;
+  for (size_t i=0; i < 2; i++)
+  {
+    threads.emplace_back([&monitor, i]()
+    {
+      monitor.beginFMU(i);
+      std::this_thread::sleep_for(std::chrono::milliseconds(30));
+      monitor.endFMU(i);
+    });
+  }
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  monitor.endStep(0.001, 0.001);
+  EXPECT_EQ(monitor.getStatistics().deadlineMisses, 0u);
+  EXPECT_GE(monitor.getStatistics().fmus[0].maxTimeInSeconds, 0.03);
+  EXPECT_GE(monitor.getStatistics().fmus[1].maxTimeInSeconds, 0.03);
+
+  // The time outside the FMUs is accounted as well, and the miss is attributed to the slowest FMU
+  monitor.beginStep();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  monitor.beginFMU(1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  monitor.endFMU(1);
+  monitor.endStep(0.001, 0.002);
+  EXPECT_EQ(monitor.getStatistics().deadlineMisses, 1u);
+  EXPECT_EQ(monitor.getStatistics().fmus[1].deadlineMisses, 1u);
+}
+
+/////////////////////////////////////////////////
+/// If the budget is checked by the scheduler, only the per-FMU statistics are accumulated
+TEST(RealTimeBudgetMonitorTest, BudgetCheckedByScheduler)
+{
+  gazebo_fmi::RealTimeBudgetOptions options;
+  options.enabled = true;
+  options.budgetInSeconds = 0.001;
+  options.logPeriodInSeconds = 100.0;
+
+  gazebo_fmi::RealTimeBudgetMonitor monitor;
+  monitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0"});
+  monitor.setCheckBudget(false);
+  runStep(monitor, {5}, 0.001, 0.001);
+  runStep(monitor, {5}, 0.001, 0.002);
+
+  EXPECT_EQ(monitor.getStatistics().steps, 2u);
+  EXPECT_EQ(monitor.getStatistics().deadlineMisses, 0u);
+  EXPECT_EQ(monitor.getStatistics().fmus[0].calls, 2u);
+  EXPECT_EQ(monitor.getStatistics().fmus[0].deadlineMisses, 0u);
+  EXPECT_GE(monitor.getStatistics().fmus[0].maxTimeInSeconds, 0.005);
+}
+
+/////////////////////////////////////////////////
+/// The deadline misses are logged at most once every log period
+TEST(RealTimeBudgetMonitorTest, LogRateLimiting)
+{
+  const std::string filePath = CMAKE_CURRENT_BINARY_DIR"/RealTimeBudgetMonitorTest.log";
+  std::remove(filePath.c_str());
+
+  // In a RealTimeSection the messages are written by the AsyncLogger, that can write them to a file
+  gazebo_fmi::RealTimeOptions realTimeOptions;
+  realTimeOptions.enabled = true;
+  realTimeOptions.fmuMemoryPoolSize = 64*1024;
+  realTimeOptions.lockMemory = false;
+  gazebo_fmi::RealTimeSafetyMonitor realTimeMonitor;
+  ASSERT_TRUE(realTimeMonitor.configure(realTimeOptions, "RealTimeBudgetMonitorTest"));
+  ASSERT_TRUE(realTimeMonitor.getLogger().setFileSink(filePath));
+
+  gazebo_fmi::RealTimeBudgetOptions options;
+  options.enabled = true;
+  options.budgetInSeconds = 0.001;
+  options.logPeriodInSeconds = 0.5;
+
+  gazebo_fmi::RealTimeBudgetMonitor monitor;
+  monitor.configure(options, "RealTimeBudgetMonitorTest", {"actuator_0", "actuator_1"});
+  {
+    gazebo_fmi::RealTimeSection section(realTimeMonitor);
+    // The durations are widely separated, so that the ranking of the FMUs does not depend on the accuracy of sleep_for
+    runStep(monitor, {1, 20}, 0.001, 0.001);
+    runStep(monitor, {1, 20}, 0.001, 0.002);
+    runStep(monitor, {1, 20}, 0.001, 0.003);
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    runStep(monitor, {1, 20}, 0.001, 0.004);
+  }
+  realTimeMonitor.getLogger().flush();
+  EXPECT_EQ(monitor.getStatistics().deadlineMisses, 4u);
+
+  std::vector<std::string> misses, expensiveFMUs;
+  std::ifstream file(filePath);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    if (line.find("exceeded the budget") != std::string::npos)
+    {
+      misses.push_back(line);
+    }
+    if (line.find("most expensive FMUs: actuator_1") != std::string::npos)
+    {
+      expensiveFMUs.push_back(line);
+    }
+  }
+
+  // The first miss is logged immediately, the following two are only counted in the message of the fourth one
+  ASSERT_EQ(misses.size(), 2u);
+  EXPECT_NE(misses[0].find("at sim time 0.001 s (1 deadline misses since last message, 1 in total)"), std::string::npos) << misses[0];
+  EXPECT_NE(misses[1].find("at sim time 0.004 s (3 deadline misses since last message, 4 in total)"), std::string::npos) << misses[1];
+  ASSERT_EQ(expensiveFMUs.size(), 2u);
+  EXPECT_NE(expensiveFMUs[0].find("actuator_0"), std::string::npos);
+
+  std::remove(filePath.c_str());
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
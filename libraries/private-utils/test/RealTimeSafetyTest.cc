@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include <gazebo_fmi/RealTimeSafety.hh>
+
+/////////////////////////////////////////////////
+/// The pool serves zeroed memory and reuses the freed blocks
+TEST(RealTimeSafetyTest, FMUMemoryPool)
+{
+  ASSERT_TRUE(gazebo_fmi::reserveFMUMemoryPool(1024*1024, false));
+  const size_t usageBefore = gazebo_fmi::getFMUMemoryPoolUsage();
+
+  double* values = static_cast<double*>(gazebo_fmi::fmuMemoryPoolAllocate(100, sizeof(double)));
+  ASSERT_NE(values, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(values) % 16, 0u);
+  EXPECT_GT(gazebo_fmi::getFMUMemoryPoolUsage(), usageBefore);
+  for (size_t i=0; i < 100; i++)
+  {
+    EXPECT_EQ(values[i], 0.0);
+    values[i] = 1.0 + i;
+  }
+  gazebo_fmi::fmuMemoryPoolFree(values);
+
+  // A block of the same size class is taken from the free list, and zeroed again
+  const size_t usageAfterFirst = gazebo_fmi::getFMUMemoryPoolUsage();
+  double* reused = static_cast<double*>(gazebo_fmi::fmuMemoryPoolAllocate(90, sizeof(double)));
+  ASSERT_EQ(reused, values);
+  EXPECT_EQ(gazebo_fmi::getFMUMemoryPoolUsage(), usageAfterFirst);
+  for (size_t i=0; i < 90; i++)
+  {
+    EXPECT_EQ(reused[i], 0.0);
+  }
+  gazebo_fmi::fmuMemoryPoolFree(reused);
+  gazebo_fmi::fmuMemoryPoolFree(nullptr);
+}
+
+/////////////////////////////////////////////////
+/// The pool grows to the largest request, not to the sum of the requests
+TEST(RealTimeSafetyTest, FMUMemoryPoolReservation)
+{
+  ASSERT_TRUE(gazebo_fmi::reserveFMUMemoryPool(2*1024*1024, false));
+  const size_t reserved = gazebo_fmi::getFMUMemoryPoolReservedSize();
+  EXPECT_GE(reserved, 2u*1024u*1024u);
+
+  // The plugins of a world with several models request the same size
+  for (int i=0; i < 10; i++)
+  {
+    ASSERT_TRUE(gazebo_fmi::reserveFMUMemoryPool(2*1024*1024, false));
+  }
+  ASSERT_TRUE(gazebo_fmi::reserveFMUMemoryPool(64*1024, false));
+  EXPECT_EQ(gazebo_fmi::getFMUMemoryPoolReservedSize(), reserved);
+
+  ASSERT_TRUE(gazebo_fmi::reserveFMUMemoryPool(reserved + 1024*1024, false));
+  EXPECT_EQ(gazebo_fmi::getFMUMemoryPoolReservedSize(), reserved + 1024*1024);
+}
+
+/////////////////////////////////////////////////
+/// The allocations that do not fit in the pool are violations only in a RealTimeSection
+TEST(RealTimeSafetyTest, Violations)
+{
+  const size_t largeAllocation = 64*1024*1024;
+
+  gazebo_fmi::RealTimeOptions options;
+  options.enabled = true;
+  options.fmuMemoryPoolSize = 64*1024;
+  options.lockMemory = false;
+  options.onViolation = gazebo_fmi::RealTimeViolationPolicy::refuse;
+
+  gazebo_fmi::RealTimeSafetyMonitor monitor;
+  ASSERT_TRUE(monitor.configure(options, "RealTimeSafetyTest"));
+
+  // Outside a section the allocation is served by the heap
+  EXPECT_FALSE(gazebo_fmi::isInRealTimeSection());
+  void* outside = gazebo_fmi::fmuMemoryPoolAllocate(1, largeAllocation);
+  EXPECT_NE(outside, nullptr);
+  gazebo_fmi::fmuMemoryPoolFree(outside);
+  EXPECT_EQ(monitor.getViolations(gazebo_fmi::RealTimeViolation::allocation), 0u);
+
+  {
+    gazebo_fmi::RealTimeSection section(monitor);
+    EXPECT_TRUE(gazebo_fmi::isInRealTimeSection());
+
+    // Refused, as the policy is refuse
+    EXPECT_EQ(gazebo_fmi::fmuMemoryPoolAllocate(1, largeAllocation), nullptr);
+    EXPECT_FALSE(gazebo_fmi::checkRealTimeOperation(gazebo_fmi::RealTimeViolation::lock));
+
+    // Small allocations are served by the pool, and are not violations
+    void* small = gazebo_fmi::fmuMemoryPoolAllocate(4, 8);
+    EXPECT_NE(small, nullptr);
+    gazebo_fmi::fmuMemoryPoolFree(small);
+  }
+  EXPECT_FALSE(gazebo_fmi::isInRealTimeSection());
+  EXPECT_EQ(monitor.getViolations(gazebo_fmi::RealTimeViolation::allocation), 1u);
+  EXPECT_EQ(monitor.getViolations(gazebo_fmi::RealTimeViolation::lock), 1u);
+
+  // A disabled monitor does not open a section
+  gazebo_fmi::RealTimeSafetyMonitor disabledMonitor;
+  ASSERT_TRUE(disabledMonitor.configure(gazebo_fmi::RealTimeOptions(), "RealTimeSafetyTest"));
+  {
+    gazebo_fmi::RealTimeSection section(disabledMonitor);
+    EXPECT_FALSE(gazebo_fmi::isInRealTimeSection());
+    EXPECT_TRUE(gazebo_fmi::checkRealTimeOperation(gazebo_fmi::RealTimeViolation::allocation));
+  }
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <gazebo_fmi/WorkerPool.hh>
+
+/////////////////////////////////////////////////
+/// Each task of each batch is run exactly once, also when consecutive batches have different sizes
+TEST(WorkerPoolTest, EachTaskRunOnce)
+{
+  gazebo_fmi::RealTimeSafetyMonitor monitor;
+  gazebo_fmi::WorkerPool pool;
+  ASSERT_TRUE(pool.configure(4, monitor, "WorkerPoolTest"));
+  EXPECT_EQ(pool.getNrOfThreads(), 4u);
+
+  std::vector<std::atomic<int>> counters(64);
+  std::function<void(size_t)> task = [&counters](size_t i) { counters[i]++; };
+
+  std::vector<int> expected(counters.size(), 0);
+  for (size_t batch=0; batch < 2000; batch++)
+  {
+    const size_t nrOfTasks = 1 + (batch*7) % counters.size();
+    pool.run(nrOfTasks, task);
+    for (size_t i=0; i < nrOfTasks; i++)
+    {
+      expected[i]++;
+    }
+  }
+
+  for (size_t i=0; i < counters.size(); i++)
+  {
+    EXPECT_EQ(counters[i].load(), expected[i]);
+  }
+}
+
+/////////////////////////////////////////////////
+/// With a single thread the tasks are run in order in the calling thread
+TEST(WorkerPoolTest, SingleThread)
+{
+  gazebo_fmi::RealTimeSafetyMonitor monitor;
+  gazebo_fmi::WorkerPool pool;
+  ASSERT_TRUE(pool.configure(1, monitor, "WorkerPoolTest"));
+  EXPECT_EQ(pool.getNrOfThreads(), 1u);
+
+  std::vector<size_t> order;
+  std::function<void(size_t)> task = [&order](size_t i) { order.push_back(i); };
+  pool.run(5, task);
+  EXPECT_EQ(order, std::vector<size_t>({0, 1, 2, 3, 4}));
+
+  EXPECT_FALSE(pool.configure(0, monitor, "WorkerPoolTest"));
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/AllocationTracker.hh>
+
+#include <atomic>
+#include <cerrno>
+#include <functional>
+
+// glibc entry points of the allocator, used by the replacements below
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+// The tracking flag is per thread, with the initial-exec TLS model of the executable, so accessing it never allocates.
+// The WorkerPool threads copy it from the thread that runs their batch (see CallbackAllocationProbe), and the counter
+// is shared so that their allocations are summed with the ones of the tracked thread. It is lock-free and
+// constant-initialized, so using it never allocates
+static thread_local bool t_tracking = false;
+static std::atomic<uint64_t> s_allocations{0};
+
+static inline void countAllocation()
+{
+    if (t_tracking)
+    {
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+extern "C"
+{
+
+void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    countAllocation();
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr && size != 0)
+    {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+}
+
+namespace gazebo_fmi
+{
+
+void AllocationTracker::begin()
+{
+    s_allocations.store(0, std::memory_order_relaxed);
+    t_tracking = true;
+}
+
+uint64_t AllocationTracker::end()
+{
+    t_tracking = false;
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+bool AllocationTracker::isTracking()
+{
+    return t_tracking;
+}
+
+uint64_t AllocationTracker::captureTracking()
+{
+    return t_tracking ? 1 : 0;
+}
+
+uint64_t AllocationTracker::exchangeTracking(const uint64_t tracking)
+{
+    const uint64_t previous = t_tracking ? 1 : 0;
+    t_tracking = (tracking != 0);
+    return previous;
+}
+
+CallbackAllocationProbe::CallbackAllocationProbe(const size_t warmupSteps):
+    m_warmupSteps(warmupSteps),
+    m_workerTracking(WorkerThreadState{&AllocationTracker::captureTracking, &AllocationTracker::exchangeTracking})
+{
+    for (size_t i=0; i < static_cast<size_t>(TrackedCallback::TotalCallbacks); i++)
+    {
+        m_allocations[i] = 0;
+        m_maxAllocationsPerStep[i] = 0;
+    }
+}
+
+void CallbackAllocationProbe::beginCallbacks(const TrackedCallback callback)
+{
+    // WorldUpdateBegin is the first event of a step
+    size_t steps = m_steps.load(std::memory_order_relaxed);
+    if (callback == TrackedCallback::worldUpdateBegin)
+    {
+        steps++;
+        m_steps.store(steps, std::memory_order_relaxed);
+    }
+
+    if (steps > m_warmupSteps)
+    {
+        AllocationTracker::begin();
+    }
+}
+
+void CallbackAllocationProbe::endCallbacks(const TrackedCallback callback)
+{
+    if (!AllocationTracker::isTracking())
+    {
+        return;
+    }
+
+    const uint64_t allocations = AllocationTracker::end();
+    const size_t index = static_cast<size_t>(callback);
+    m_allocations[index].fetch_add(allocations, std::memory_order_relaxed);
+    if (allocations > m_maxAllocationsPerStep[index].load(std::memory_order_relaxed))
+    {
+        m_maxAllocationsPerStep[index].store(allocations, std::memory_order_relaxed);
+    }
+
+    // BeforePhysicsUpdate is the last tracked event of a step
+    if (callback == TrackedCallback::beforePhysicsUpdate)
+    {
+        m_trackedSteps.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CallbackAllocationProbe::connectBeforeLoad()
+{
+    m_connections.push_back(gazebo::event::Events::ConnectWorldUpdateBegin(
+        std::bind(&CallbackAllocationProbe::beginCallbacks, this, TrackedCallback::worldUpdateBegin)));
+    m_connections.push_back(gazebo::event::Events::ConnectBeforePhysicsUpdate(
+        std::bind(&CallbackAllocationProbe::beginCallbacks, this, TrackedCallback::beforePhysicsUpdate)));
+}
+
+void CallbackAllocationProbe::connectAfterLoad()
+{
+    m_connections.push_back(gazebo::event::Events::ConnectWorldUpdateBegin(
+        std::bind(&CallbackAllocationProbe::endCallbacks, this, TrackedCallback::worldUpdateBegin)));
+    m_connections.push_back(gazebo::event::Events::ConnectBeforePhysicsUpdate(
+        std::bind(&CallbackAllocationProbe::endCallbacks, this, TrackedCallback::beforePhysicsUpdate)));
+}
+
+void CallbackAllocationProbe::disconnect()
+{
+    m_connections.clear();
+}
+
+size_t CallbackAllocationProbe::getTrackedSteps() const
+{
+    return m_trackedSteps.load(std::memory_order_relaxed);
+}
+
+uint64_t CallbackAllocationProbe::getAllocations(const TrackedCallback callback) const
+{
+    return m_allocations[static_cast<size_t>(callback)].load(std::memory_order_relaxed);
+}
+
+uint64_t CallbackAllocationProbe::getMaxAllocationsPerStep(const TrackedCallback callback) const
+{
+    return m_maxAllocationsPerStep[static_cast<size_t>(callback)].load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_ALLOCATION_TRACKER_HH
+#define GAZEBO_FMI_ALLOCATION_TRACKER_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gazebo/common/Events.hh>
+
+#include <gazebo_fmi/WorkerPool.hh>
+
+namespace gazebo_fmi
+{
+    /// \brief Counter of the heap allocations of the calling thread
+    ///
+    /// The library that contains this class replaces malloc, calloc, realloc, free, memalign, posix_memalign
+    /// and aligned_alloc of the process (forwarding them to the glibc implementation), so it should be linked
+    /// only in test executables. As operator new and the default FMU allocateMemory callback (calloc) use malloc,
+    /// their allocations are counted as well. The tracking flag is per thread, and only the allocations
+    /// performed between begin and end are counted. The counter is shared by the threads whose flag is set,
+    /// so with captureTracking and exchangeTracking in a WorkerThreadStatePropagation the allocations of the
+    /// WorkerPool threads that run tasks for the tracked thread are counted as well, and the ones of the
+    /// unrelated threads (as the Gazebo transport threads) are not. begin and end should not be nested.
+    class AllocationTracker
+    {
+    public:
+        /// \brief Start counting the allocations of the calling thread
+        static void begin();
+
+        /// \brief Stop counting the allocations of the calling thread
+        /// @return the number of allocations performed since the last call to begin
+        static uint64_t end();
+
+        /// \brief return true if the allocations of the calling thread are being counted
+        static bool isTracking();
+
+        /// \brief Tracking flag of the calling thread, as a WorkerThreadState
+        static uint64_t captureTracking();
+
+        /// \brief Set the tracking flag of the calling thread, and return the previous one, as a WorkerThreadState
+        static uint64_t exchangeTracking(const uint64_t tracking);
+    };
+
+    /// \brief Physics-thread callbacks in which the allocations are counted by CallbackAllocationProbe
+    enum class TrackedCallback
+    {
+        /// \brief Callbacks connected to the WorldUpdateBegin event, as the one of FMISingleBodyFluidDynamicsPlugin
+        worldUpdateBegin = 0,
+        /// \brief Callbacks connected to the BeforePhysicsUpdate event, as the one of FMIActuatorPlugin
+        beforePhysicsUpdate,
+        TotalCallbacks
+    };
+
+    /// \brief Count the allocations performed by the plugin callbacks connected to the WorldUpdateBegin
+    ///        and BeforePhysicsUpdate events, after a warm-up period
+    ///
+    /// The expected usage is:
+    /// ~~~
+    /// CallbackAllocationProbe probe(warmupSteps);
+    /// probe.connectBeforeLoad();
+    /// // load the world and its plugins
+    /// probe.connectAfterLoad();
+    /// // run the simulation
+    /// EXPECT_EQ(probe.getAllocations(TrackedCallback::beforePhysicsUpdate), 0u);
+    /// ~~~
+    /// Gazebo calls the callbacks of an event in the order in which they were connected, so the handlers
+    /// connected before the load of the world and after it bracket the callbacks of the plugins loaded with the world.
+    /// While the probe exists, the WorkerPool threads that step the FMUs for the physics thread count their allocations as well.
+    class CallbackAllocationProbe
+    {
+    private:
+        size_t m_warmupSteps;
+        std::atomic<size_t> m_steps{0};
+        std::atomic<size_t> m_trackedSteps{0};
+        std::atomic<uint64_t> m_allocations[static_cast<size_t>(TrackedCallback::TotalCallbacks)];
+        std::atomic<uint64_t> m_maxAllocationsPerStep[static_cast<size_t>(TrackedCallback::TotalCallbacks)];
+        std::vector<gazebo::event::ConnectionPtr> m_connections;
+        WorkerThreadStatePropagation m_workerTracking;
+
+        void beginCallbacks(const TrackedCallback callback);
+        void endCallbacks(const TrackedCallback callback);
+
+    public:
+        /// \brief Constructor
+        /// @param[in] warmupSteps number of steps in which the allocations are not counted
+        explicit CallbackAllocationProbe(const size_t warmupSteps);
+
+        /// \brief Connect the handlers that start counting, it should be called before loading the world
+        void connectBeforeLoad();
+
+        /// \brief Connect the handlers that stop counting, it should be called after loading the world
+        void connectAfterLoad();
+
+        /// \brief Disconnect all the handlers
+        void disconnect();
+
+        /// \brief Number of steps in which the allocations were counted
+        size_t getTrackedSteps() const;
+
+        /// \brief Total number of allocations performed in the callbacks of the specified event, after the warm-up
+        uint64_t getAllocations(const TrackedCallback callback) const;
+
+        /// \brief Maximum number of allocations performed in the callbacks of the specified event in a single step
+        uint64_t getMaxAllocationsPerStep(const TrackedCallback callback) const;
+    };
+}
+
+#endif
@@ -29,6 +29,7 @@
 
 #include <gazebo_fmi/GazeboFMIUtils.hh>
 
+#include <algorithm>
 #include <functional>
 
 #include <experimental/filesystem>
@@ -54,6 +55,31 @@ enum OutputIndex
 };
 }
 
+//////////////////////////////////////////////////
+FMIActuatorPlugin::~FMIActuatorPlugin()
+{
+    // The scheduler should not step the FMUs while they are destroyed
+    if (m_scheduler)
+    {
+        m_scheduler->removeClient(m_schedulerClientId);
+    }
+
+    // The streamer should not publish while the plugin is destroyed
+    m_variableStreamer.close();
+    m_variableStreamer.printReport();
+
+    m_budgetMonitor.printReport();
+    m_replayer.printReport();
+    for (auto current: m_actuators)
+    {
+        current->m_outputPredictor.printReport();
+        current->m_strongCoupling.printReport();
+        current->m_adaptiveStepper.printReport();
+    }
+    m_digest.dump();
+    m_realTimeMonitor.printReport();
+}
+
 //////////////////////////////////////////////////
 void FMIActuatorPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
 {
@@ -82,15 +108,114 @@ void FMIActuatorPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr
     // If necessary disable joint limits
     this->DisableVelocityEffortLimits();
 
-    // Try to open fmu for all joints in the plugin
-    if (!this->LoadFMUs(_parent))
+    // Reserve the FMU memory pool before loading the FMUs
+    if (!m_realTimeMonitor.configure(m_realTimeOptions, "FMIActuatorPlugin " + _parent->GetScopedName()))
+    {
+        gzerr << "FMIActuatorPlugin: error in configuring the real-time mode, plugin loading failed."
+              << std::endl;
+        return;
+    }
+
+    // Try to open fmu for all joints in the plugin, or the recording that replaces them
+    if (m_replayOptions.enabled)
+    {
+        if (!this->LoadReplay(_parent))
+        {
+            gzerr << "FMIActuatorPlugin: error in loading the replay recording, plugin loading failed."
+                  << std::endl;
+            return;
+        }
+    }
+    else if (!this->LoadFMUs(_parent))
     {
         gzerr << "FMIActuatorPlugin: error in loading FMUs, plugin loading failed."
               << std::endl;
         return;
     }
 
-    // Set up a physics update callback
+    // The recordings contain all the inputs, so that they can be checked when replayed
+    m_batch.configure(m_actuators, m_recorderOptions.enabled || m_replayOptions.enabled);
+
+    // Configure the real-time budget monitor
+    std::vector<std::string> fmuNames;
+    for (auto current: m_actuators)
+    {
+        fmuNames.push_back(current->m_name);
+    }
+    m_budgetMonitor.configure(m_budgetOptions, "FMIActuatorPlugin " + _parent->GetScopedName(), fmuNames);
+    m_digest.configure(m_digestOptions, "FMIActuatorPlugin " + _parent->GetScopedName(), fmuNames);
+
+    // Open the recording of FMU inputs and outputs, with channels named actuatorName/variableName
+    if (m_recorderOptions.enabled)
+    {
+        std::vector<std::string> channelNames;
+        for (auto current: m_actuators)
+        {
+            for (const std::string& variableName : current->m_inputVariablesDefaultNames)
+            {
+                channelNames.push_back(current->m_name + "/" + variableName);
+            }
+            for (const std::string& variableName : current->m_outputVariablesDefaultNames)
+            {
+                channelNames.push_back(current->m_name + "/" + variableName);
+            }
+        }
+
+        if (!m_recorder.open(m_recorderOptions.filePath, channelNames, m_recorderOptions.samplesPerChunk))
+        {
+            gzerr << "FMIActuatorPlugin: error in opening the recording, plugin loading failed." << std::endl;
+            return;
+        }
+    }
+
+    // Stream the variables of the FMUs requested by the clients, the replayed actuators have no FMU to read
+    if (m_streamingOptions.enabled && !m_replayOptions.enabled)
+    {
+        if (!this->LoadVariableStreaming(_parent))
+        {
+            gzerr << "FMIActuatorPlugin: error in configuring the streaming of FMU variables, plugin loading failed." << std::endl;
+            return;
+        }
+    }
+
+    // Everything used by the callback is allocated, so the memory can be locked
+    m_realTimeMonitor.lockMemory();
+
+    // If the FMIScheduler world plugin is loaded, the FMUs are stepped together with the ones of the other plugins
+    std::shared_ptr<FMUScheduler> scheduler = FMUScheduler::getInstance();
+    if (scheduler->isEnabled())
+    {
+        m_scheduler = scheduler;
+
+        // The update of the plugin is interleaved with the ones of the other plugins, so the budget is checked by the scheduler
+        m_budgetMonitor.setCheckBudget(false);
+
+        FMUSchedulerClient client;
+        client.name = "FMIActuatorPlugin " + _parent->GetScopedName();
+        client.nrOfTasks = m_replayOptions.enabled ? 0 : m_actuators.size();
+        for (auto current: m_actuators)
+        {
+            client.taskNames.push_back(current->m_name);
+        }
+        client.gather = [this](double simulatedTimeInSeconds, double stepSizeInSeconds)
+        {
+            RealTimeSection realTimeSection(m_realTimeMonitor);
+            this->GatherInputs(simulatedTimeInSeconds, stepSizeInSeconds);
+        };
+        client.step = [this](size_t task)
+        {
+            RealTimeSection realTimeSection(m_realTimeMonitor);
+            this->StepActuator(task);
+        };
+        client.scatter = [this]()
+        {
+            RealTimeSection realTimeSection(m_realTimeMonitor);
+            this->ApplyOutputs();
+        };
+        m_schedulerClientId = m_scheduler->addClient(client);
+    }
+
+    // Set up a physics update callback, that steps the FMUs only if they are not stepped by the scheduler
     this->m_connections.push_back(gazebo::event::Events::ConnectBeforePhysicsUpdate(
       boost::bind(&FMIActuatorPlugin::BeforePhysicsUpdateCallback, this, _1)));
 }
@@ -103,7 +228,59 @@ bool FMIActuatorPlugin::ParseParameters(gazebo::physics::ModelPtr _parent, sdf::
   {
       m_verbose = _sdf->Get<bool>("verbose");
   }
-  
+
+  if (!gazebo_fmi::parseRealTimeBudgetSDFElement(_sdf, m_budgetOptions))
+  {
+      gzerr << "FMIActuatorPlugin: failure in parsing realtime_budget tag" << std::endl;
+      return false;
+  }
+
+  if (!gazebo_fmi::parseRecorderSDFElement(_sdf, m_recorderOptions))
+  {
+      gzerr << "FMIActuatorPlugin: failure in parsing recorder tag" << std::endl;
+      return false;
+  }
+
+  if (!gazebo_fmi::parseReplaySDFElement(_sdf, m_replayOptions))
+  {
+      gzerr << "FMIActuatorPlugin: failure in parsing replay tag" << std::endl;
+      return false;
+  }
+
+  if (!gazebo_fmi::parseDeterminismDigestSDFElement(_sdf, m_digestOptions))
+  {
+      gzerr << "FMIActuatorPlugin: failure in parsing determinism_digest tag" << std::endl;
+      return false;
+  }
+
+  if (!gazebo_fmi::parseRealTimeSDFElement(_sdf, m_realTimeOptions))
+  {
+      gzerr << "FMIActuatorPlugin: failure in parsing realtime tag" << std::endl;
+      return false;
+  }
+
+  if (!gazebo_fmi::parseVariableStreamingSDFElement(_sdf, m_streamingOptions))
+  {
+      gzerr << "FMIActuatorPlugin: failure in parsing variable_streaming tag" << std::endl;
+      return false;
+  }
+
+  if (m_replayOptions.enabled && m_recorderOptions.enabled &&
+      m_replayOptions.filePath == m_recorderOptions.filePath)
+  {
+      gzerr << "FMIActuatorPlugin: the recorder file can not be the replayed file " << m_replayOptions.filePath << std::endl;
+      return false;
+  }
+
+  if (_sdf->HasElement("fmu_log_file"))
+  {
+      m_fmuLogger = AsyncLogger::getInstance();
+      if (!m_fmuLogger->setFileSink(_sdf->Get<std::string>("fmu_log_file")))
+      {
+          return false;
+      }
+  }
+
   sdf::ElementPtr elem = _sdf->GetElement("actuator");
   if(!elem)
   {
@@ -130,38 +307,70 @@ bool FMIActuatorPlugin::ParseParameters(gazebo::physics::ModelPtr _parent, sdf::
                << std::endl;
         return false;
       }
-      std::string jointName = elem->Get<std::string>("joint");
 
-      actuator->m_joint=FindJointInModel(jointName,_parent);
+      // Several joint elements bind all the joints to the same FMU
+      for (sdf::ElementPtr joint_elem = elem->GetElement("joint"); joint_elem; joint_elem = joint_elem->GetNextElement("joint"))
+      {
+        std::string jointName = joint_elem->Get<std::string>();
+        gazebo::physics::JointPtr joint = FindJointInModel(jointName,_parent);
+
+        // Store pointer to the joint we will actuate
+        if (!joint)
+        {
+           gzerr << "FMIActuatorPlugin: Invalid SDF, actuator joint " << jointName << " does not "
+                 << "exist!" << std::endl;
+          return false;
+        }
 
-      // Store pointer to the joint we will actuate
-      if (!actuator->m_joint)
+        if (std::find(actuator->m_joints.begin(), actuator->m_joints.end(), joint) != actuator->m_joints.end())
+        {
+           gzerr << "FMIActuatorPlugin: Invalid SDF, joint " << jointName << " appears more than once in the same actuator." << std::endl;
+          return false;
+        }
+
+        // Check type
+        bool typeOk = this->CheckJointType(joint);
+        if (!typeOk)
+        {
+          return false;
+        }
+
+        actuator->m_joints.push_back(joint);
+      }
+
+      if (actuator->m_name.empty())
       {
-         gzerr << "FMIActuatorPlugin: Invalid SDF, actuator joint " << jointName << " does not "
-               << "exist!" << std::endl;
-        return false;
+        actuator->m_name = actuator->m_joints[0]->GetScopedName();
       }
 
-      // Check type
-      bool typeOk = this->CheckJointType(actuator->m_joint);
-      if (!typeOk)
+      // The name identifies the FMU in the recording, in the replay and in the streaming of variables
+      for (auto other: m_actuators)
       {
-        return false;
+        if (other->m_name == actuator->m_name)
+        {
+          gzerr << "FMIActuatorPlugin: Invalid SDF, two actuator elements are named "
+                << actuator->m_name << "." << std::endl;
+          return false;
+        }
       }
 
-      if (!elem->HasElement("fmu"))
+      // In replay mode the FMU is not loaded, so it does not need to be available
+      if (!elem->HasElement("fmu") && !m_replayOptions.enabled)
       {
          gzerr << "FMIActuatorPlugin: Invalid SDF, fmu parameter not found."
                << std::endl;
         return false;
       }
 
-      actuator->m_fmuAbsolutePath =  gazebo::common::SystemPaths::Instance()->FindFile(elem->Get<std::string>("fmu"));
-      if (!std::experimental::filesystem::exists(actuator->m_fmuAbsolutePath))
+      if (!m_replayOptions.enabled)
       {
-        gzerr << "FMIActuatorPlugin: Impossible to find FMU named " << elem->Get<std::string>("fmu")
-              << " in the GAZEBO_RESOURCE_PATH directories" << std::endl;
-        return false;
+        actuator->m_fmuAbsolutePath =  gazebo::common::SystemPaths::Instance()->FindFile(elem->Get<std::string>("fmu"));
+        if (!std::experimental::filesystem::exists(actuator->m_fmuAbsolutePath))
+        {
+          gzerr << "FMIActuatorPlugin: Impossible to find FMU named " << elem->Get<std::string>("fmu")
+                << " in the GAZEBO_RESOURCE_PATH directories" << std::endl;
+          return false;
+        }
       }
 
 
@@ -187,6 +396,77 @@ bool FMIActuatorPlugin::ParseParameters(gazebo::physics::ModelPtr _parent, sdf::
         return false;
       }
 
+      // With several joints the variables are arrays, and each element of variable_names renames an array
+      actuator->SetNrOfJoints(actuator->m_joints.size());
+
+      if (!gazebo_fmi::parseFMULogLevelSDFElement(elem, actuator->m_fmuLogLevel))
+      {
+        gzerr << "FMIActuatorPlugin: failure in parsing fmu_log_level tag" << std::endl;
+        return false;
+      }
+
+      if (!gazebo_fmi::parseOutputPredictionSDFElement(elem, actuator->m_inputVariablesDefaultNames,
+                                                       actuator->m_outputPredictionOptions))
+      {
+        gzerr << "FMIActuatorPlugin: failure in parsing output_prediction tag" << std::endl;
+        return false;
+      }
+
+      // In replay mode there is no FMU to differentiate, so the coupling is always explicit
+      if (elem->HasElement("implicit_coupling") && !m_replayOptions.enabled)
+      {
+        actuator->m_implicitCoupling = elem->Get<bool>("implicit_coupling");
+      }
+
+      if (actuator->m_implicitCoupling && actuator->m_outputPredictionOptions.enabled)
+      {
+        gzerr << "FMIActuatorPlugin: implicit_coupling and output_prediction can not be enabled for the same actuator." << std::endl;
+        return false;
+      }
+
+      // In replay mode there is no FMU to step again, so the coupling is always explicit
+      if (!m_replayOptions.enabled && !gazebo_fmi::parseStrongCouplingSDFElement(elem, actuator->m_strongCouplingOptions))
+      {
+        gzerr << "FMIActuatorPlugin: failure in parsing strong_coupling tag" << std::endl;
+        return false;
+      }
+
+      if (actuator->m_strongCouplingOptions.enabled && (actuator->m_implicitCoupling || actuator->m_outputPredictionOptions.enabled))
+      {
+        gzerr << "FMIActuatorPlugin: strong_coupling can not be enabled together with implicit_coupling or output_prediction for the same actuator." << std::endl;
+        return false;
+      }
+
+      // In replay mode there is no FMU to roll back, so the FMU outputs are replayed at each step
+      if (!m_replayOptions.enabled && !gazebo_fmi::parseAdaptiveStepSDFElement(elem, actuator->m_adaptiveStepOptions))
+      {
+        gzerr << "FMIActuatorPlugin: failure in parsing adaptive_step tag" << std::endl;
+        return false;
+      }
+
+      if (actuator->m_adaptiveStepOptions.enabled &&
+          (actuator->m_implicitCoupling || actuator->m_outputPredictionOptions.enabled || actuator->m_strongCouplingOptions.enabled))
+      {
+        gzerr << "FMIActuatorPlugin: adaptive_step can not be enabled together with implicit_coupling, output_prediction or strong_coupling for the same actuator." << std::endl;
+        return false;
+      }
+
+      // The joint models of the implicit and strong coupling are the ones of a single joint
+      if (actuator->m_joints.size() > 1 && (actuator->m_implicitCoupling || actuator->m_strongCouplingOptions.enabled))
+      {
+        gzerr << "FMIActuatorPlugin: implicit_coupling and strong_coupling are available only for actuators with a single joint." << std::endl;
+        return false;
+      }
+
+      // The legacy tags refer to the variables of a single joint
+      if (actuator->m_joints.size() > 1 &&
+          (elem->HasElement("actuatorInputName") || elem->HasElement("jointPositionName") || elem->HasElement("jointVelocityName") ||
+           elem->HasElement("jointAccelerationName") || elem->HasElement("jointTorqueName")))
+      {
+        gzerr << "FMIActuatorPlugin: the deprecated variable name options are not supported by actuators with several joints, please use variable_names tag instead." << std::endl;
+        return false;
+      }
+
       // Legacy tags, used only for backcompatibiltiy
       if (elem->HasElement("actuatorInputName"))
       {
@@ -220,7 +500,10 @@ bool FMIActuatorPlugin::ParseParameters(gazebo::physics::ModelPtr _parent, sdf::
     
       if(m_verbose)
       {
-        gzmsg << "FMIActuatorPlugin: actuator loaded for joint name:" << jointName << std::endl;
+        for (auto joint: actuator->m_joints)
+        {
+          gzmsg << "FMIActuatorPlugin: actuator loaded for joint name:" << joint->GetScopedName() << std::endl;
+        }
       }
 
       elem = elem->GetNextElement("actuator");
@@ -246,8 +529,11 @@ bool FMIActuatorPlugin::DisableVelocityEffortLimits()
     {
         if (current->disableVelocityEffortLimits)
         {
-            current->m_joint->SetVelocityLimit(0u, -1.0);
-            current->m_joint->SetEffortLimit(0u, -1.0);
+            for (auto joint: current->m_joints)
+            {
+                joint->SetVelocityLimit(0u, -1.0);
+                joint->SetEffortLimit(0u, -1.0);
+            }
         }
     }
 }
@@ -265,14 +551,21 @@ bool FMIActuatorPlugin::LoadFMUs(gazebo::physics::ModelPtr _parent)
     {
         // FMUActuatorProperties& actuator = this->actuators[i];
         // gazebo::physics::JointPtr joint
-        std::string instanceName = current->m_joint->GetScopedName()+"_fmuTransmission";
+        std::string instanceName = current->m_joints[0]->GetScopedName()+"_fmuTransmission";
+        current->m_fmu.setLogLevel(current->m_fmuLogLevel);
+        current->m_fmu.setUseMemoryPool(m_realTimeMonitor.isEnabled());
         bool ok = current->m_fmu.load(current->m_fmuAbsolutePath, instanceName, simulatedTimeInSeconds);
         if (!ok) {
             return false;
         }
 
-        // Get references for input variables
-        ok = current->m_fmu.getInputVariableRefs(current->m_inputVariablesNames, current->m_inputVarReferences);
+        // Get references for input variables, the ones not renamed by variable_names may be missing in the FMU
+        std::vector<bool> optionalInputs(current->m_inputVariablesNames.size());
+        for (size_t k=0; k < optionalInputs.size(); k++)
+        {
+            optionalInputs[k] = current->m_inputVariablesNames[k] == current->m_inputVariablesDefaultNames[k];
+        }
+        ok = current->m_fmu.getInputVariableRefs(current->m_inputVariablesNames, optionalInputs, current->m_inputVarReferences);
         if (!ok) {
             return false;
         }
@@ -283,19 +576,165 @@ bool FMIActuatorPlugin::LoadFMUs(gazebo::physics::ModelPtr _parent)
         if (!ok) {
             return false;
         }
-        current->m_outputVarBuffers.resize(current->m_outputVarBuffers.size());
+        current->m_outputVarBuffers.resize(current->m_outputVarReferences.size());
+
+        // The inputs on which no output depends are not set in the FMU, see ActuatorJointBatch::configure for the ones not computed
+        ok = current->m_fmu.getUsedInputs(current->m_inputVarReferences, current->m_outputVarReferences, current->m_usedInputs);
+        if (!ok) {
+            return false;
+        }
+        for (size_t k=0; k < current->m_usedInputs.size(); k++)
+        {
+            if (!current->m_usedInputs[k] && current->m_inputVarReferences[k] != FMUUnboundVariableReference)
+            {
+                gzmsg << "FMIActuatorPlugin: the outputs of the FMU of " << current->m_name << " do not depend on "
+                      << current->m_inputVariablesNames[k] << ", that is not set." << std::endl;
+                current->m_inputVarReferences[k] = FMUUnboundVariableReference;
+            }
+        }
+
+        // Predict the outputs only if the FMU provides what the linear model needs
+        std::string ownerName = "FMIActuatorPlugin " + current->m_name;
+        if (current->m_outputPredictionOptions.enabled && FMUOutputPredictor::isSupportedBy(current->m_fmu, ownerName))
+        {
+            ok = current->m_outputPredictor.configure(current->m_outputPredictionOptions, current->m_inputVarReferences.size(),
+                                                      current->m_outputVarReferences.size(), ownerName);
+            if (!ok) {
+                return false;
+            }
+            current->m_outputPredictor.setFMU(current->m_fmu, simulatedTimeInSeconds);
+        }
+
+        if (current->m_adaptiveStepOptions.enabled && FMUAdaptiveStepper::isSupportedBy(current->m_fmu, ownerName))
+        {
+            ok = current->m_adaptiveStepper.configure(current->m_adaptiveStepOptions, current->m_inputVarReferences.size(),
+                                                      current->m_outputVarReferences.size(), ownerName);
+            if (!ok) {
+                return false;
+            }
+        }
+
+        if (current->m_strongCouplingOptions.enabled)
+        {
+            if (!(current->m_joints[0]->GetType() & gazebo::physics::Base::HINGE_JOINT))
+            {
+                gzwarn << "FMIActuatorPlugin: the strong coupling is available only for HingeJoint, "
+                       << "the coupling of " << current->m_name << " with the joint is explicit." << std::endl;
+            }
+            else if (FMUStrongCoupling::isSupportedBy(current->m_fmu, ownerName))
+            {
+                ok = current->m_strongCoupling.configure(current->m_strongCouplingOptions, current->m_inputVarReferences.size(),
+                                                         current->m_outputVarReferences.size(), ownerName);
+                if (!ok) {
+                    return false;
+                }
+
+                current->m_couplingInputs.resize(current->m_inputVarReferences.size());
+                CollectJointSubtreeLinks(current->m_joints[0], current->m_subtreeLinks);
+                FMUActuatorProperties* actuator = current.get();
+                current->m_couplingPlant = [this, actuator](const std::vector<double>& outputs, std::vector<double>& inputs)
+                {
+                    this->PredictJointState(*actuator, outputs, inputs);
+                };
+            }
+        }
+
+        if (current->m_implicitCoupling)
+        {
+            if (!current->m_fmu.providesDirectionalDerivatives())
+            {
+                gzwarn << "FMIActuatorPlugin: the FMU of " << current->m_name << " does not provide directional derivatives, "
+                       << "its coupling with the joint is explicit." << std::endl;
+                current->m_implicitCoupling = false;
+                continue;
+            }
+
+            current->m_jointStiffness = current->m_joints[0]->GetStiffness(0u);
+            current->m_jointDamping = current->m_joints[0]->GetDamping(0u);
+            current->m_jointSpringReference = current->m_joints[0]->GetSpringReferencePosition(0u);
+            current->m_couplingSeed.resize(current->m_inputVarReferences.size());
+            current->m_couplingDerivative.resize(current->m_outputVarReferences.size());
+        }
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////
+bool FMIActuatorPlugin::LoadReplay(gazebo::physics::ModelPtr _parent)
+{
+    if (!m_replayer.open(m_replayOptions, "FMIActuatorPlugin " + _parent->GetScopedName()))
+    {
+        return false;
+    }
+
+    // The channels have the same names used by the recorder, i.e. actuatorName/defaultVariableName
+    for (auto current: m_actuators)
+    {
+        std::vector<std::string> inputChannelNames, outputChannelNames;
+        for (const std::string& variableName : current->m_inputVariablesDefaultNames)
+        {
+            inputChannelNames.push_back(current->m_name + "/" + variableName);
+        }
+        for (const std::string& variableName : current->m_outputVariablesDefaultNames)
+        {
+            outputChannelNames.push_back(current->m_name + "/" + variableName);
+        }
+
+        if (!m_replayer.addFMU(inputChannelNames, outputChannelNames))
+        {
+            return false;
+        }
+
+        current->m_inputVarBuffers.resize(current->m_inputVariablesDefaultNames.size());
+        current->m_outputVarBuffers.resize(current->m_outputVariablesDefaultNames.size(), 0.0);
     }
 
+    gzmsg << "FMIActuatorPlugin: replaying the FMU outputs from " << m_replayOptions.filePath << std::endl;
     return true;
 }
 
+//////////////////////////////////////////////////
+bool FMIActuatorPlugin::LoadVariableStreaming(gazebo::physics::ModelPtr _parent)
+{
+    const std::string ownerName = "FMIActuatorPlugin " + _parent->GetScopedName();
+    if (!m_variableStreamer.configure(m_streamingOptions, ownerName,
+                                      [this](const std::string& streamName, double simulatedTimeInSeconds, const std::vector<double>& values)
+                                      {
+                                          m_variableStreamTopics.publish(streamName, simulatedTimeInSeconds, values);
+                                      }))
+    {
+        return false;
+    }
+
+    // The variables are named actuatorName/variableName, as the channels of the recorder
+    for (auto current: m_actuators)
+    {
+        if (!m_variableStreamer.addFMU(current->m_name, current->m_fmu))
+        {
+            return false;
+        }
+    }
+
+    const std::string topic = m_streamingOptions.topic.empty() ? "~/" + _parent->GetScopedName() + "/fmu_variables"
+                                                                : m_streamingOptions.topic;
+#if GAZEBO_MAJOR_VERSION >=8
+    const std::string worldName = _parent->GetWorld()->Name();
+#else
+    const std::string worldName = _parent->GetWorld()->GetName();
+#endif
+    return m_variableStreamTopics.advertise(m_variableStreamer, worldName, topic, ownerName);
+}
+
 //////////////////////////////////////////////////
 bool FMIActuatorPlugin::CheckJointType(gazebo::physics::JointPtr jointPtr)
 {
+    // The actuator drives the first axis of a universal joint, while its second axis is left free
+    const bool universal = jointPtr->GetType() & gazebo::physics::Base::UNIVERSAL_JOINT;
 #if GAZEBO_MAJOR_VERSION >=8
-    if (jointPtr->DOF() != 1)
+    if (jointPtr->DOF() != 1 && !universal)
 #else
-    if (jointPtr->GetAngleCount() != 1)
+    if (jointPtr->GetAngleCount() != 1 && !universal)
 #endif
     {
         gzerr << "FMIActuatorPlugin: joint " << jointPtr->GetScopedName() << " has "
@@ -304,14 +743,19 @@ bool FMIActuatorPlugin::CheckJointType(gazebo::physics::JointPtr jointPtr)
 #else
               << jointPtr->GetAngleCount() 
 #endif
-              << ", only joint with 1 DOFs are currently supported." << std::endl;
+              << ", only joint with 1 DOFs and universal joints are currently supported." << std::endl;
         return false;
     }
 
-    if (!(jointPtr->GetType() & gazebo::physics::Base::HINGE_JOINT))
+    if (universal)
+    {
+        gzmsg << "FMIActuatorPlugin: joint " << jointPtr->GetScopedName() << " is a universal joint, the actuator drives its first axis." << std::endl;
+    }
+
+    if (!IsJointAccelerationSupported(jointPtr))
     {
-        gzwarn << "FMIActuatorPlugin: joint " << jointPtr->GetScopedName() << " is not an HingeJoint. " << std::endl;
-        gzwarn << "Feedback on joint acceleration is currently available only for HingeJoint, "
+        gzwarn << "FMIActuatorPlugin: joint " << jointPtr->GetScopedName() << " is not a revolute, prismatic, universal or screw joint. " << std::endl;
+        gzwarn << "Feedback on joint acceleration is currently available only for these joints, "
                << "so it is possible to use this joint only with an FMU that is not using acceleration feedback." << std::endl;
         gzwarn << "See https://github.com/robotology/gazebo-fmi/issues/17 for more details." << std::endl;
     }
@@ -320,15 +764,90 @@ bool FMIActuatorPlugin::CheckJointType(gazebo::physics::JointPtr jointPtr)
 }
 
 //////////////////////////////////////////////////
-double FMIActuatorPlugin::GetJointAcceleration(gazebo::physics::JointPtr jointPtr)
+bool FMIActuatorPlugin::ComputeImplicitCoupling(FMUActuatorProperties& actuator)
+{
+    std::vector<double>& seed = actuator.m_couplingSeed;
+    std::vector<double>& derivative = actuator.m_couplingDerivative;
+
+    std::fill(seed.begin(), seed.end(), 0.0);
+    seed[FMIActuatorPluginNS::jointPosition] = 1.0;
+    bool ok = actuator.m_fmu.getDirectionalDerivative(actuator.m_outputVarReferences, actuator.m_inputVarReferences, seed, derivative);
+    const double torqueDerivativeWrtPosition = derivative[FMIActuatorPluginNS::jointTorque];
+
+    std::fill(seed.begin(), seed.end(), 0.0);
+    seed[FMIActuatorPluginNS::jointVelocity] = 1.0;
+    ok = ok && actuator.m_fmu.getDirectionalDerivative(actuator.m_outputVarReferences, actuator.m_inputVarReferences, seed, derivative);
+    const double torqueDerivativeWrtVelocity = derivative[FMIActuatorPluginNS::jointTorque];
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    // Only the stabilizing part of the linearization is applied implicitly, the rest remains in the explicit torque
+    actuator.m_couplingStiffness = std::max(0.0, -torqueDerivativeWrtPosition);
+    actuator.m_couplingDamping = std::max(0.0, -torqueDerivativeWrtVelocity);
+
+    return true;
+}
+
+//////////////////////////////////////////////////
+void FMIActuatorPlugin::ApplyImplicitCoupling(FMUActuatorProperties& actuator, const double position, const double velocity, double& jointTorque)
+{
+    if (!actuator.m_stepOk)
+    {
+        // Fall back to the explicit coupling for this step
+        actuator.m_joints[0]->SetStiffnessDamping(0u, actuator.m_jointStiffness, actuator.m_jointDamping, actuator.m_jointSpringReference);
+        return;
+    }
+
+    const double stiffness = actuator.m_couplingStiffness;
+    const double damping = actuator.m_couplingDamping;
+
+    // The spring of the transmission is at rest in the current position, combined with the one of the model
+    const double totalStiffness = actuator.m_jointStiffness + stiffness;
+    double springReference = actuator.m_jointSpringReference;
+    if (totalStiffness > 0.0)
+    {
+        springReference = (actuator.m_jointStiffness*actuator.m_jointSpringReference + stiffness*position)/totalStiffness;
+    }
+    actuator.m_joints[0]->SetStiffnessDamping(0u, totalStiffness, actuator.m_jointDamping + damping, springReference);
+
+    // In the current state the spring of the transmission applies no torque and its damper -damping*velocity,
+    // so they are removed from the torque applied explicitly
+    jointTorque += damping*velocity;
+}
+
+//////////////////////////////////////////////////
+void FMIActuatorPlugin::PredictJointState(FMUActuatorProperties& actuator, const std::vector<double>& outputs, std::vector<double>& inputs)
 {
-    return ComputeJointAcceleration(jointPtr);
+    const double acceleration = actuator.m_couplingFreeAcceleration +
+                                outputs[FMIActuatorPluginNS::jointTorque]/actuator.m_couplingEffectiveInertia;
+    const double velocity = actuator.m_couplingStartVelocity + acceleration*actuator.m_couplingStepSize;
+
+    inputs[FMIActuatorPluginNS::actuatorInput] = actuator.m_couplingActuatorInput;
+    inputs[FMIActuatorPluginNS::jointPosition] = actuator.m_couplingStartPosition + velocity*actuator.m_couplingStepSize;
+    inputs[FMIActuatorPluginNS::jointVelocity] = velocity;
+    inputs[FMIActuatorPluginNS::jointAcceleration] = acceleration;
 }
 
 
 //////////////////////////////////////////////////
 void FMIActuatorPlugin::BeforePhysicsUpdateCallback(const gazebo::common::UpdateInfo & updateInfo)
 {
+    // If the FMIScheduler world plugin was unloaded, the scheduler removed the client and the plugin steps its FMUs again
+    if (m_scheduler)
+    {
+        if (m_scheduler->isEnabled())
+        {
+            return;
+        }
+        m_scheduler.reset();
+        m_budgetMonitor.setCheckBudget(true);
+    }
+
+    RealTimeSection realTimeSection(m_realTimeMonitor);
+
     // TODO(traversaro): review this part
     double simulatedTimeInSeconds  = updateInfo.simTime.Double();
     auto world = gazebo::physics::get_world(updateInfo.worldName);
@@ -338,55 +857,211 @@ void FMIActuatorPlugin::BeforePhysicsUpdateCallback(const gazebo::common::Update
     double stepSizeInSeconds = world->GetPhysicsEngine()->GetMaxStepSize();
 #endif
 
+    this->GatherInputs(simulatedTimeInSeconds, stepSizeInSeconds);
 
-    // Update the stored joints according to the desired model.
-    for (auto current: m_actuators)
+    if (!m_replayOptions.enabled)
+    {
+        for (size_t i=0; i < m_actuators.size(); i++)
+        {
+            this->StepActuator(i);
+        }
+    }
+
+    this->ApplyOutputs();
+}
+
+//////////////////////////////////////////////////
+void FMIActuatorPlugin::GatherInputs(const double simulatedTimeInSeconds, const double stepSizeInSeconds)
+{
+    m_simulatedTimeInSeconds = simulatedTimeInSeconds;
+    m_stepSizeInSeconds = stepSizeInSeconds;
+
+    m_budgetMonitor.beginStep();
+    if (m_replayOptions.enabled)
     {
-        //FMUActuatorProperties& actuator = this->actuators[i];
+        m_replayer.seek(simulatedTimeInSeconds);
+    }
 
-        double actuatorInput = current->m_joint->GetForce(0u);
+    // Read the state of all the joints, before stepping any FMU
+    const size_t nrOfJoints = m_batch.joints.size();
+    for (size_t k=0; k < nrOfJoints; k++)
+    {
+        const gazebo::physics::JointPtr& joint = m_batch.joints[k];
+        m_batch.actuatorInput[k] = joint->GetForce(0u);
 #if GAZEBO_MAJOR_VERSION >=8
-        const double position = current->m_joint->Position(0u);
+        m_batch.position[k] = joint->Position(0u);
 #else
-        const double position = current->m_joint->GetAngle(0u).Radian();
+        m_batch.position[k] = joint->GetAngle(0u).Radian();
 #endif
-        const double velocity = current->m_joint->GetVelocity(0u);
-        const double acceleration = this->GetJointAcceleration(current->m_joint);
+        m_batch.velocity[k] = joint->GetVelocity(0u);
+    }
+    m_batch.accelerationCache.compute(m_batch.acceleration.data());
+
+    for (size_t i=0; i < m_actuators.size(); i++)
+    {
+        FMUActuatorProperties_sptr& current = m_actuators[i];
+
+        // This order should be coherent with the order defined in FMUActuatorProperties::SetNrOfJoints
+        const size_t offset = m_batch.actuatorOffsets[i];
+        const size_t actuatorJoints = m_batch.actuatorOffsets[i+1] - offset;
+        for (size_t j=0; j < actuatorJoints; j++)
+        {
+            double* jointInputs = current->m_inputVarBuffers.data() + j*FMIActuatorPluginNS::TotalInputs;
+            jointInputs[FMIActuatorPluginNS::actuatorInput] = m_batch.actuatorInput[offset+j];
+            jointInputs[FMIActuatorPluginNS::jointPosition] = m_batch.position[offset+j];
+            jointInputs[FMIActuatorPluginNS::jointVelocity] = m_batch.velocity[offset+j];
+            jointInputs[FMIActuatorPluginNS::jointAcceleration] = m_batch.acceleration[offset+j];
+        }
 
-        // This order should be coherent with the order defined in LoadFMUs
-        current->m_inputVarBuffers[0] = actuatorInput;
-        current->m_inputVarBuffers[1] = position;
-        current->m_inputVarBuffers[2] = velocity;
-        current->m_inputVarBuffers[3] = acceleration;
+        // The inertia moved by the joint changes with the configuration of the links that follow it
+        if (current->m_strongCoupling.isEnabled())
+        {
+            current->m_couplingEffectiveInertia = ComputeJointEffectiveInertia(current->m_joints[0], current->m_subtreeLinks);
 
+            // Without a positive inertia the joint model is not defined, and StepActuator falls back to the single FMU step
+            if (current->m_couplingEffectiveInertia <= 0.0 && !current->m_couplingInertiaWarned)
+            {
+                logFromCallback(LogLevel::warning, "gazebo_fmi", "The effective inertia of the joint of %s is %g, "
+                                "strong_coupling is disabled until it is positive", current->m_name.c_str(),
+                                current->m_couplingEffectiveInertia);
+                current->m_couplingInertiaWarned = true;
+            }
+        }
+
+        if (m_replayOptions.enabled)
+        {
+            // Take the outputs from the recording instead of simulating the FMU
+            m_budgetMonitor.beginFMU(i);
+            m_replayer.checkInputs(i, current->m_inputVarBuffers);
+            m_replayer.getOutputs(i, current->m_outputVarBuffers);
+            m_budgetMonitor.endFMU(i);
+        }
+    }
+}
+
+//////////////////////////////////////////////////
+void FMIActuatorPlugin::StepActuator(const size_t actuatorIndex)
+{
+    FMUActuatorProperties& current = *(m_actuators[actuatorIndex]);
+
+    // Each thread writes only the timer of the actuator it is stepping
+    m_budgetMonitor.beginFMU(actuatorIndex);
+
+    bool ok = true;
+    if (current.m_outputPredictor.isEnabled())
+    {
+        // Simulate the FMU only at the checkpoints, and predict its outputs in the other steps
+        ok = current.m_outputPredictor.step(current.m_fmu, current.m_inputVarReferences, current.m_outputVarReferences,
+                                            m_simulatedTimeInSeconds, m_stepSizeInSeconds,
+                                            current.m_inputVarBuffers, current.m_outputVarBuffers);
+    }
+    else if (current.m_strongCoupling.isEnabled() && current.m_couplingEffectiveInertia > 0.0)
+    {
+        // The measured acceleration includes the torque applied in the previous step, that is still in the output buffer
+        const size_t joint = m_batch.actuatorOffsets[actuatorIndex];
+        current.m_couplingActuatorInput = m_batch.actuatorInput[joint];
+        current.m_couplingStartPosition = m_batch.position[joint];
+        current.m_couplingStartVelocity = m_batch.velocity[joint];
+        current.m_couplingStepSize = m_stepSizeInSeconds;
+        current.m_couplingFreeAcceleration = m_batch.acceleration[joint] -
+            current.m_outputVarBuffers[FMIActuatorPluginNS::jointTorque]/current.m_couplingEffectiveInertia;
+
+        // Step the FMU again from the same state, with the joint state predicted with its torque, until the torque converges.
+        // The first guess is the joint state predicted with the torque of the previous step.
+        // The iterations use their own buffer, so that the measured joint state is the one recorded in ApplyOutputs.
+        this->PredictJointState(current, current.m_outputVarBuffers, current.m_couplingInputs);
+        ok = current.m_strongCoupling.step(current.m_fmu, current.m_inputVarReferences, current.m_outputVarReferences,
+                                           m_simulatedTimeInSeconds, m_stepSizeInSeconds, current.m_couplingPlant,
+                                           current.m_couplingInputs, current.m_outputVarBuffers);
+    }
+    else if (current.m_adaptiveStepper.isEnabled())
+    {
+        // Step the FMU only at the communication points, over macro steps of adaptive size
+        ok = current.m_adaptiveStepper.step(current.m_fmu, current.m_inputVarReferences, current.m_outputVarReferences,
+                                            m_simulatedTimeInSeconds, m_stepSizeInSeconds,
+                                            current.m_inputVarBuffers, current.m_outputVarBuffers);
+    }
+    else
+    {
         // Set input
-        bool ok = current->m_fmu.setInputVariables(current->m_inputVarReferences, current->m_inputVarBuffers);
+        ok = current.m_fmu.setInputVariables(current.m_inputVarReferences, current.m_inputVarBuffers);
 
         // Run fmu simulation
-        ok = ok && current->m_fmu.doStep(simulatedTimeInSeconds, stepSizeInSeconds);
+        ok = ok && current.m_fmu.doStep(m_simulatedTimeInSeconds, m_stepSizeInSeconds);
 
         // Get ouput
-        ok = ok && current->m_fmu.getOutputVariables(current->m_outputVarReferences, current->m_outputVarBuffers);
+        ok = ok && current.m_fmu.getOutputVariables(current.m_outputVarReferences, current.m_outputVarBuffers);
+    }
+
+    // The stiffness and damping of the transmission are applied to the joint by ApplyOutputs
+    if (ok && current.m_implicitCoupling)
+    {
+        ok = this->ComputeImplicitCoupling(current);
+    }
+    current.m_stepOk = ok;
 
-        if (!ok)
+    m_budgetMonitor.endFMU(actuatorIndex);
+}
+
+//////////////////////////////////////////////////
+void FMIActuatorPlugin::ApplyOutputs()
+{
+    m_recorder.beginSample(m_simulatedTimeInSeconds);
+    m_digest.beginStep(m_simulatedTimeInSeconds);
+    size_t recorderChannel = 0;
+
+    for (size_t i=0; i < m_actuators.size(); i++)
+    {
+        FMUActuatorProperties_sptr& current = m_actuators[i];
+
+        // This order should be coherent with the order defined in FMUActuatorProperties::SetNrOfJoints
+        const size_t offset = m_batch.actuatorOffsets[i];
+        const size_t actuatorJoints = m_batch.actuatorOffsets[i+1] - offset;
+        for (size_t j=0; j < actuatorJoints; j++)
         {
-            gzerr << "gazebo_fmi: Failure in simulating trasmission of " << current->m_joint->GetScopedName() << std::endl;
+            m_batch.torque[offset+j] = current->m_outputVarBuffers[j*FMIActuatorPluginNS::TotalOutputs + FMIActuatorPluginNS::jointTorque];
         }
 
-        // This order should be coherent with the order defined in LoadFMUs
-        double jointTorque = current->m_outputVarBuffers[0];
-
-        // Note: in ODE, Bullet and DART, two consecutive SetForce calls are added to the same buffer:
-        // for this reason, to overwrite the previous value we subtract it from the desired value
-        if (this->m_isSetForceCumulative)
+        // The joint spring and damper apply the stiffness and damping of the transmission, the rest is applied explicitly
+        if (current->m_implicitCoupling)
         {
-            current->m_joint->SetForce(0u, jointTorque-actuatorInput);
+            this->ApplyImplicitCoupling(*current, m_batch.position[offset], m_batch.velocity[offset], m_batch.torque[offset]);
         }
-        else
+
+        m_recorder.setChannels(recorderChannel, current->m_inputVarBuffers);
+        recorderChannel += current->m_inputVarBuffers.size();
+        m_recorder.setChannels(recorderChannel, current->m_outputVarBuffers);
+        recorderChannel += current->m_outputVarBuffers.size();
+
+        m_digest.update(i, current->m_inputVarBuffers);
+        m_digest.update(i, current->m_outputVarBuffers);
+
+        if (!current->m_stepOk)
         {
-            current->m_joint->SetForce(0u, jointTorque);
+            logFromCallback(LogLevel::error, "gazebo_fmi", "Failure in simulating trasmission of %s", current->m_name.c_str());
+            current->m_stepOk = true;
         }
     }
+
+    // Note: in ODE, Bullet and DART, two consecutive SetForce calls are added to the same buffer:
+    // for this reason, to overwrite the previous value we subtract it from the desired value
+    const size_t nrOfJoints = m_batch.joints.size();
+    const double cumulativeInput = this->m_isSetForceCumulative ? 1.0 : 0.0;
+    for (size_t k=0; k < nrOfJoints; k++)
+    {
+        m_batch.force[k] = m_batch.torque[k] - cumulativeInput*m_batch.actuatorInput[k];
+    }
+
+    // Apply the torques of all the joints, after stepping all the FMUs
+    for (size_t k=0; k < nrOfJoints; k++)
+    {
+        m_batch.joints[k]->SetForce(0u, m_batch.force[k]);
+    }
+
+    m_recorder.endSample();
+    m_digest.endStep();
+    m_variableStreamer.update(m_simulatedTimeInSeconds);
+    m_budgetMonitor.endStep(m_stepSizeInSeconds, m_simulatedTimeInSeconds);
 }
 
 //////////////////////////////////////////////////
@@ -436,3 +1111,56 @@ FMUActuatorProperties::FMUActuatorProperties()
     m_outputVariablesDefaultNames.resize(FMIActuatorPluginNS::TotalOutputs);
     m_outputVariablesDefaultNames[FMIActuatorPluginNS::jointTorque]     = "jointTorque";
 }
+
+//////////////////////////////////////////////////
+void FMUActuatorProperties::SetNrOfJoints(const size_t nrOfJoints)
+{
+    if (nrOfJoints == 1)
+    {
+        return;
+    }
+
+    // The indices are the ones of the elements of a Modelica array exported in a FMU
+    for (std::vector<std::string>* names : {&m_inputVariablesDefaultNames, &m_inputVariablesNames,
+                                            &m_outputVariablesDefaultNames, &m_outputVariablesNames})
+    {
+        std::vector<std::string> jointNames;
+        jointNames.swap(*names);
+        for (size_t j=1; j <= nrOfJoints; j++)
+        {
+            for (const std::string& name : jointNames)
+            {
+                names->push_back(name + "[" + std::to_string(j) + "]");
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////
+void ActuatorJointBatch::configure(const std::vector<FMUActuatorProperties_sptr>& actuators, const bool allInputs)
+{
+    joints.clear();
+    actuatorOffsets.assign(1, 0);
+    std::vector<bool> accelerationNeeded;
+    for (const FMUActuatorProperties_sptr& actuator : actuators)
+    {
+        joints.insert(joints.end(), actuator->m_joints.begin(), actuator->m_joints.end());
+        actuatorOffsets.push_back(joints.size());
+
+        // The strong coupling uses the acceleration to estimate the one due to the rest of the model
+        for (size_t j=0; j < actuator->m_joints.size(); j++)
+        {
+            accelerationNeeded.push_back(allInputs || actuator->m_usedInputs.empty() || actuator->m_strongCoupling.isEnabled() ||
+                                         actuator->m_usedInputs[j*FMIActuatorPluginNS::TotalInputs + FMIActuatorPluginNS::jointAcceleration]);
+        }
+    }
+
+    const size_t nrOfJoints = joints.size();
+    actuatorInput.assign(nrOfJoints, 0.0);
+    position.assign(nrOfJoints, 0.0);
+    velocity.assign(nrOfJoints, 0.0);
+    acceleration.assign(nrOfJoints, 0.0);
+    torque.assign(nrOfJoints, 0.0);
+    force.assign(nrOfJoints, 0.0);
+    accelerationCache.configure(joints, accelerationNeeded);
+}
@@ -37,13 +37,24 @@
 #include <gazebo/gazebo.hh>
 
 #include <gazebo_fmi/SDFConfigurationParsing.hh>
+#include <gazebo_fmi/DeterminismDigest.hh>
+#include <gazebo_fmi/FMUAdaptiveStep.hh>
 #include <gazebo_fmi/FMUCoSimulation.hh>
+#include <gazebo_fmi/FMUOutputPrediction.hh>
+#include <gazebo_fmi/FMURecording.hh>
+#include <gazebo_fmi/FMUReplay.hh>
+#include <gazebo_fmi/FMUScheduler.hh>
+#include <gazebo_fmi/FMUStrongCoupling.hh>
+#include <gazebo_fmi/FMUVariableStreaming.hh>
+#include <gazebo_fmi/GazeboFMIUtils.hh>
+#include <gazebo_fmi/RealTimeBudgetMonitor.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
 
 /// Example SDF:
 ///       <plugin name="fmi_actuator_plugin" filename="libFMIActuatorPlugin.so">
 ///        <actuator>
 ///          <name>actuator_0</name> <!-- optional -->
-///          <joint>JOINT_0</joint> <!-- name of joint to actuate in the model -->
+///          <joint>JOINT_0</joint> <!-- name of joint to actuate in the model, repeated for a multi-joint FMU -->
 ///          <fmu>electric_motor</fmu> <!-- name of the fmu -->
 ///        </actuator>
 ///       </plugin>
@@ -51,10 +62,24 @@
 ///
 /// Required fields:
 /// - name
-/// - joint
-/// - fmu:
+/// - joint: (one or more)
+/// - fmu: (optional if the plugin is in replay mode)
 /// Optional fields:
 /// - variable_names
+/// - fmu_log_level
+/// - output_prediction
+/// - implicit_coupling
+/// - strong_coupling
+/// - adaptive_step
+/// Optional plugin fields:
+/// - verbose
+/// - realtime_budget
+/// - fmu_log_file
+/// - recorder
+/// - replay
+/// - determinism_digest
+/// - realtime
+/// - variable_streaming
 
 
 namespace gazebo_fmi
@@ -64,7 +89,14 @@ namespace gazebo_fmi
     {
         public: FMUActuatorProperties();
 
-        /// \brief An identifier for the actuator.
+        /// \brief Repeat the default and actual variable names, that are the ones of a single joint, for nrOfJoints joints
+        ///
+        /// With several joints each name is repeated for each joint with the 1-based index of the joint, e.g. jointPosition[2],
+        /// and the variables are ordered by joint (all the inputs of the first joint, then the ones of the second, ...).
+        /// It should be called only once, after parsing the variable_names element.
+        public: void SetNrOfJoints(const size_t nrOfJoints);
+
+        /// \brief An identifier for the actuator, if not specified it is the scoped name of the joint.
         public: std::string m_name;
 
         public: std::string m_fmuAbsolutePath;
@@ -84,31 +116,138 @@ namespace gazebo_fmi
         /// \brief Flag to indicate that Gazebo's velocit and effort limits should be disabled
         public: bool disableVelocityEffortLimits{false};
 
+        /// \brief Verbosity of the log messages of the FMU
+        public: LogLevel m_fmuLogLevel{LogLevel::error};
+
         public: FMUCoSimulation m_fmu;
         public: std::vector<fmi2_value_reference_t> m_inputVarReferences;
         public: std::vector<fmi2_value_reference_t> m_outputVarReferences;
         public: std::vector<double> m_inputVarBuffers;
         public: std::vector<double> m_outputVarBuffers;
 
+        /// \brief Inputs on which the outputs of the FMU depend, the other ones are unbound and not set in the FMU
+        ///
+        /// Empty in replay mode, in which all the inputs are computed.
+        public: std::vector<bool> m_usedInputs;
+
+        /// \brief Options of the prediction of the FMU outputs, parsed from the output_prediction element
+        public: FMUOutputPredictionOptions m_outputPredictionOptions;
+
+        /// \brief Prediction of the FMU outputs, used in place of the FMU while the inputs barely change
+        public: FMUOutputPredictor m_outputPredictor;
+
+        /// \brief Flag to indicate that the stiffness and damping of the transmission are applied implicitly by the joint spring and damper
+        public: bool m_implicitCoupling{false};
+
+        /// \brief Stiffness, damping and spring reference of the joint in the model, to which the ones of the transmission are added
+        public: double m_jointStiffness{0.0};
+        public: double m_jointDamping{0.0};
+        public: double m_jointSpringReference{0.0};
+
+        /// \brief Buffers of the directional derivatives used by the implicit coupling
+        public: std::vector<double> m_couplingSeed;
+        public: std::vector<double> m_couplingDerivative;
+
+        /// \brief Options of the strong coupling with the joint, parsed from the strong_coupling element
+        public: FMUStrongCouplingOptions m_strongCouplingOptions;
+
+        /// \brief Iterations of the FMU step against the joint model, used in place of the single FMU step
+        public: FMUStrongCoupling m_strongCoupling;
+
+        /// \brief Joint model of the strong coupling, see FMIActuatorPlugin::PredictJointState
+        public: CouplingPlantFunction m_couplingPlant;
+
+        /// \brief Inputs of the FMU in the iterations of the strong coupling, with the predicted joint state
+        ///
+        /// m_inputVarBuffers keeps the measured joint state, that is the one recorded and replayed.
+        public: std::vector<double> m_couplingInputs;
+
+        /// \brief Links that follow the joint, whose inertia is moved by the joint torque
+        public: std::vector<gazebo::physics::LinkPtr> m_subtreeLinks;
+
+        /// \brief State of the joint model at the beginning of the step
+        public: double m_couplingActuatorInput{0.0};
+        public: double m_couplingStartPosition{0.0};
+        public: double m_couplingStartVelocity{0.0};
+        public: double m_couplingStepSize{0.0};
+
+        /// \brief Acceleration of the joint without the torque of the transmission, and inertia about the joint axis
+        public: double m_couplingFreeAcceleration{0.0};
+        public: double m_couplingEffectiveInertia{0.0};
+
+        /// \brief True if the warning on a non-positive effective inertia was already logged
+        public: bool m_couplingInertiaWarned{false};
+
+        /// \brief Options of the adaptive communication step, parsed from the adaptive_step element
+        public: FMUAdaptiveStepOptions m_adaptiveStepOptions;
+
+        /// \brief Adaptive communication step, used in place of stepping the FMU at each physics step
+        public: FMUAdaptiveStepper m_adaptiveStepper;
+
+        /// \brief Stiffness and damping of the transmission applied by the joint spring and damper, see FMIActuatorPlugin::ComputeImplicitCoupling
+        public: double m_couplingStiffness{0.0};
+        public: double m_couplingDamping{0.0};
+
+        /// \brief Outcome of the last step of the FMU, written by the thread that stepped it
+        public: bool m_stepOk{true};
+
         /// \brief Flag to indicate that the plugin is enabled
         public: bool m_enabled{true};
 
-        /// \brief The joints we want to actuate
-        public: gazebo::physics::JointPtr m_joint;
+        /// \brief The joints we want to actuate, all driven by the FMU
+        public: std::vector<gazebo::physics::JointPtr> m_joints;
 
     };
 
     using FMUActuatorProperties_sptr=std::shared_ptr<FMUActuatorProperties>;
 
+    /// \brief States and torques of the joints of all the actuators, stored as one array per quantity
+    ///
+    /// The joints are ordered by actuator and then as in FMUActuatorProperties::m_joints, so that the joint states are read
+    /// before stepping any FMU and the torques are written after stepping all of them, in loops that do not interleave
+    /// the Gazebo calls with the FMU calls.
+    struct ActuatorJointBatch
+    {
+        /// \brief Joints of all the actuators
+        std::vector<gazebo::physics::JointPtr> joints;
+
+        /// \brief Index of the first joint of each actuator, followed by the number of joints
+        std::vector<size_t> actuatorOffsets;
+
+        /// \brief Joint states at the beginning of the step, the actuator input is the force set by the controllers
+        std::vector<double> actuatorInput, position, velocity, acceleration;
+
+        /// \brief Torques computed by the FMUs, and forces passed to Joint::SetForce
+        std::vector<double> torque, force;
+
+        /// \brief Accelerations of the joints, computed reading the kinematics of each link once per step
+        gazebo_fmi::JointAccelerationCache accelerationCache;
+
+        /// \brief Store the joints of the actuators and allocate the arrays
+        ///
+        /// The accelerations are computed only for the joints whose jointAcceleration input is used by the FMU, or that
+        /// are strongly coupled with it, unless allInputs is true. The accelerations of the other joints are zero.
+        void configure(const std::vector<FMUActuatorProperties_sptr>& actuators, const bool allInputs);
+    };
+
     /// \brief Plugin for simulating a torque-speed curve for actuators.
     class GAZEBO_VISIBLE FMIActuatorPlugin : public gazebo::ModelPlugin
     {
+        /// \brief Destructor, unregisters from the scheduler, prints the real-time budget, replay, output prediction, strong coupling, adaptive step and real-time reports and dumps the determinism digest if enabled
+        public: ~FMIActuatorPlugin();
+
         /// Documentation inherited
         public: void Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf);
 
         private: bool ParseParameters(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf);
 
         private: bool LoadFMUs(gazebo::physics::ModelPtr _parent);
+
+        /// \brief Open the replay recording in place of the FMUs
+        private: bool LoadReplay(gazebo::physics::ModelPtr _parent);
+
+        /// \brief Add the variables of the FMUs to the catalogue of the streamer and advertise its topics
+        private: bool LoadVariableStreaming(gazebo::physics::ModelPtr _parent);
         
         private: gazebo::physics::JointPtr FindJointInModel(const std::string& jointName,const gazebo::physics::ModelPtr _parent);
 
@@ -118,23 +257,101 @@ namespace gazebo_fmi
         /// \brief Disable the velocity and effort limits (if the specific option is enabled)
         private: bool DisableVelocityEffortLimits();
 
-        /// \brief Compute joint acceleration (not directly provided by Gazebo)
-        private: double GetJointAcceleration(gazebo::physics::JointPtr jointPtr);
+        /// \brief Compute the stiffness and damping of the transmission, after the step of the FMU
+        ///
+        /// The stiffness and damping are the opposite of the derivatives of the joint torque with respect to
+        /// the joint position and velocity, obtained with fmi2GetDirectionalDerivative.
+        private: bool ComputeImplicitCoupling(FMUActuatorProperties& actuator);
+
+        /// \brief Set the joint spring and damper to the stiffness and damping of the transmission, and remove them from the torque
+        ///
+        /// If the step of the FMU failed, the spring and damper of the model are restored.
+        private: void ApplyImplicitCoupling(FMUActuatorProperties& actuator, const double position, const double velocity, double& jointTorque);
+
+        /// \brief Fill the FMU inputs with the joint state at the end of the step in which the FMU outputs are applied
+        ///
+        /// The joint is integrated with a semi-implicit Euler step, in which the rest of the model contributes
+        /// with the acceleration measured in the previous step without the torque of the transmission.
+        private: void PredictJointState(FMUActuatorProperties& actuator, const std::vector<double>& outputs, std::vector<double>& inputs);
+
+        /// \brief Read the states of all the joints, then set the FMU inputs, or replay the FMU outputs
+        private: void GatherInputs(const double simulatedTimeInSeconds, const double stepSizeInSeconds);
 
-        /// \brief Callback on before physics update event
+        /// \brief Step the FMU of the actuatorIndex-th actuator, possibly in a thread of the FMUScheduler
+        private: void StepActuator(const size_t actuatorIndex);
+
+        /// \brief Record the FMU outputs, then apply the torques of all the joints
+        private: void ApplyOutputs();
+
+        /// \brief Callback on before physics update event, used if the FMUs are not stepped by the FMUScheduler
         private: void BeforePhysicsUpdateCallback(const gazebo::common::UpdateInfo & updateInfo);
 
         /// \brief Corresponding actuator properties (power, max torque, etc.)
         private: std::vector<FMUActuatorProperties_sptr> m_actuators;
 
+        /// \brief Joint states and torques of all the actuators
+        private: ActuatorJointBatch m_batch;
+
         /// \brief Connections to events associated with this class.
         private: std::vector<gazebo::event::ConnectionPtr> m_connections;
 
+        /// \brief Time and step size of the current physics step, read by StepActuator and ApplyOutputs
+        private: double m_simulatedTimeInSeconds{0.0};
+        private: double m_stepSizeInSeconds{0.0};
+
+        /// \brief Scheduler of the world that steps the FMUs, if the FMIScheduler plugin is loaded
+        private: std::shared_ptr<FMUScheduler> m_scheduler;
+
+        /// \brief Identifier of the plugin in m_scheduler
+        private: uint64_t m_schedulerClientId{0};
+
         /// \brief False for simbody, true for ode|bullet|dart, see https://bitbucket.org/osrf/gazebo/issues/2507/joint-setforce-is-not-additive-in-simbody
         private: bool m_isSetForceCumulative{true};
 
         /// \brief Flag to indicate that we want the plugin to log in a verbose way
         private: bool m_verbose{false};
+
+        /// \brief Options of the real-time budget monitor, parsed from the realtime_budget element
+        private: RealTimeBudgetOptions m_budgetOptions;
+
+        /// \brief Monitor of the time spent in the FMUs with respect to the real-time budget
+        private: RealTimeBudgetMonitor m_budgetMonitor;
+
+        /// \brief Logger of the FMU messages, kept alive to preserve the fmu_log_file setting
+        private: std::shared_ptr<AsyncLogger> m_fmuLogger;
+
+        /// \brief Options of the recorder of FMU inputs and outputs, parsed from the recorder element
+        private: FMURecorderOptions m_recorderOptions;
+
+        /// \brief Recorder of FMU inputs and outputs
+        private: FMURecordingWriter m_recorder;
+
+        /// \brief Options of the replay of FMU outputs, parsed from the replay element
+        private: FMUReplayOptions m_replayOptions;
+
+        /// \brief Replay of FMU outputs, used in place of the FMUs if the replay element is present
+        private: FMUReplayer m_replayer;
+
+        /// \brief Options of the determinism digest, parsed from the determinism_digest element
+        private: DeterminismDigestOptions m_digestOptions;
+
+        /// \brief Rolling digest of FMU inputs and outputs
+        private: DeterminismDigest m_digest;
+
+        /// \brief Options of the streaming of FMU variables, parsed from the variable_streaming element
+        private: FMUVariableStreamingOptions m_streamingOptions;
+
+        /// \brief Streams of FMU variables requested by the clients
+        private: FMUVariableStreamer m_variableStreamer;
+
+        /// \brief Gazebo transport topics of the streams, declared after the streamer that they use
+        private: FMUVariableStreamTopics m_variableStreamTopics;
+
+        /// \brief Options of the real-time mode, parsed from the realtime element
+        private: RealTimeOptions m_realTimeOptions;
+
+        /// \brief Monitor of the real-time constraints of the callback
+        private: RealTimeSafetyMonitor m_realTimeMonitor;
     };
 
     // Register this plugin with the simulator
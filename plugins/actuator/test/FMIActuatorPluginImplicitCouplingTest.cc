@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cmath>
+
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo/test/ServerFixture.hh>
+
+class FMIActuatorPluginImplicitCouplingTest : public gazebo::ServerFixture
+{
+  /// \brief Simulate the world, and return the final position of the joint held by the stiff servo
+  public: double SimulateServo(const std::string &worldName);
+};
+
+double FMIActuatorPluginImplicitCouplingTest::SimulateServo(const std::string &worldName)
+{
+  // Defined by CMake
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+
+  gzdbg << "FMIActuatorPluginImplicitCouplingTest: testing world " << worldName << std::endl;
+
+  bool worldPaused = true;
+  std::string worldAbsPath = CMAKE_CURRENT_SOURCE_DIR"/" + worldName;
+  Load(worldAbsPath, worldPaused);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  EXPECT_TRUE(world != NULL);
+  if (!world)
+  {
+    return NAN;
+  }
+
+#if GAZEBO_MAJOR_VERSION >=8
+  auto joint = world->ModelByName("pendulum")->GetJoint("upper_joint");
+#else
+  auto joint = world->GetModel("pendulum")->GetJoint("upper_joint");
+#endif
+
+  world->Step(1000);
+
+#if GAZEBO_MAJOR_VERSION >=8
+  double finalJointPosition = joint->Position(0u);
+#else
+  double finalJointPosition = joint->GetAngle(0u).Radian();
+#endif
+  gzdbg << "Final position " << finalJointPosition << std::endl;
+
+  // Unload the simulation
+  Unload();
+
+  return finalJointPosition;
+}
+
+/////////////////////////////////////////////////
+/// With a physics step of 5 ms the stiff servo holds the pendulum only if the coupling is implicit
+TEST_F(FMIActuatorPluginImplicitCouplingTest, StiffServoWithLargeStep)
+{
+  // The servo stiffness is 1e5 Nm/rad, so the deflection due to gravity is below 1e-4 rad
+  double tol = 1e-3;
+
+  double implicitPosition = SimulateServo("test_ImplicitCoupling.world");
+  EXPECT_NEAR(implicitPosition, 0.0, tol);
+
+  // Written so that a NaN position (the simulation diverged) passes the check
+  double explicitPosition = SimulateServo("test_ExplicitCoupling.world");
+  EXPECT_FALSE(std::abs(explicitPosition) < tol);
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo/test/ServerFixture.hh>
+
+class FMIActuatorPluginMultiJointTest : public gazebo::ServerFixture
+{
+  /// \brief Simulate the world with a constant actuator input for each joint, and check the torque applied to each joint
+  ///
+  /// If actuatorLoaded is false, the plugin is expected to reject the actuator, so the torque is the actuator input.
+  public: void SimulateTwoJoints(const std::string &worldName, const bool actuatorLoaded);
+
+  /// \brief SetForce must be called inside the step, see FMIActuatorPluginKnownInputTest
+  public: void onUpdate(const gazebo::common::UpdateInfo & /*_info*/)
+  {
+    for (size_t j=0; j < m_joints.size(); j++)
+    {
+      m_joints[j]->SetForce(0, m_actuatorInputs[j]);
+    }
+  }
+
+  /// \brief Joints driven by the actuator, in the order of the joint elements
+  public: std::vector<gazebo::physics::JointPtr> m_joints;
+
+  /// \brief Actuator inputs, set in the joints by onUpdate
+  public: std::vector<double> m_actuatorInputs{0.5, -1.0};
+};
+
+void FMIActuatorPluginMultiJointTest::SimulateTwoJoints(const std::string &worldName, const bool actuatorLoaded)
+{
+  // Defined by CMake
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+
+  gzdbg << "FMIActuatorPluginMultiJointTest: testing world " << worldName << std::endl;
+
+  bool worldPaused = true;
+  std::string worldAbsPath = CMAKE_CURRENT_SOURCE_DIR"/" + worldName;
+  Load(worldAbsPath, worldPaused);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  ASSERT_TRUE(world != NULL);
+
+#if GAZEBO_MAJOR_VERSION >=8
+  auto model = world->ModelByName("two_wheels");
+#else
+  auto model = world->GetModel("two_wheels");
+#endif
+  ASSERT_TRUE(model != NULL);
+  m_joints = {model->GetJoint("first_joint"), model->GetJoint("second_joint")};
+  ASSERT_TRUE(m_joints[0] != NULL && m_joints[1] != NULL);
+
+  gazebo::event::ConnectionPtr updateConnection =
+    gazebo::event::Events::ConnectWorldUpdateBegin(std::bind(&FMIActuatorPluginMultiJointTest::onUpdate, this, std::placeholders::_1));
+
+  // Parameters of ReferenceTwoJointPD.fmu and ReferenceTwoJointPDRenamed.fmu
+  const double stiffness = 100.0;
+  const double damping = 1.0;
+  for (int step=0; step < 200; step++)
+  {
+    // The FMU reads the state of the joints at the beginning of the step
+    std::vector<double> expectedTorques(m_joints.size());
+    for (size_t j=0; j < m_joints.size(); j++)
+    {
+#if GAZEBO_MAJOR_VERSION >=8
+      double position = m_joints[j]->Position(0u);
+#else
+      double position = m_joints[j]->GetAngle(0u).Radian();
+#endif
+      double velocity = m_joints[j]->GetVelocity(0u);
+      expectedTorques[j] = actuatorLoaded ?
+        stiffness*(m_actuatorInputs[j] - position) - damping*velocity : m_actuatorInputs[j];
+    }
+
+    world->Step(1);
+
+    for (size_t j=0; j < m_joints.size(); j++)
+    {
+      EXPECT_NEAR(m_joints[j]->GetForce(0u), expectedTorques[j], 1e-6) << "joint " << j << " at step " << step;
+    }
+  }
+
+  // With the torques of the servo the joints move towards their inputs
+  if (actuatorLoaded)
+  {
+    EXPECT_GT(m_joints[0]->GetVelocity(0u), 0.0);
+    EXPECT_LT(m_joints[1]->GetVelocity(0u), 0.0);
+  }
+
+  updateConnection.reset();
+  m_joints.clear();
+  Unload();
+}
+
+/////////////////////////////////////////////////
+/// Each joint gets the torque computed by the FMU from its own elements of the arrays of inputs
+TEST_F(FMIActuatorPluginMultiJointTest, TorqueOfEachJoint)
+{
+  SimulateTwoJoints("test_MultiJoint.world", true);
+}
+
+/////////////////////////////////////////////////
+/// The variable_names tag renames the jointPosition array to q
+TEST_F(FMIActuatorPluginMultiJointTest, RenamedArray)
+{
+  SimulateTwoJoints("test_MultiJointRenamed.world", true);
+}
+
+/////////////////////////////////////////////////
+/// The implicit and strong coupling model a single joint, so they are rejected with several joints
+TEST_F(FMIActuatorPluginMultiJointTest, CouplingRejected)
+{
+  SimulateTwoJoints("test_MultiJointImplicitCoupling.world", false);
+  SimulateTwoJoints("test_MultiJointStrongCoupling.world", false);
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo/test/ServerFixture.hh>
+
+#include <gazebo_fmi/FMURecording.hh>
+
+class FMIActuatorPluginStrongCouplingReplayTest : public gazebo::ServerFixture
+{
+  /// \brief Simulate the world, and return the position of the joint at the beginning of each step
+  public: std::vector<double> SimulatePendulum(const std::string &worldName);
+};
+
+static const int nrOfSteps = 500;
+
+std::vector<double> FMIActuatorPluginStrongCouplingReplayTest::SimulatePendulum(const std::string &worldName)
+{
+  // Defined by CMake
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+
+  gzdbg << "FMIActuatorPluginStrongCouplingReplayTest: testing world " << worldName << std::endl;
+
+  std::vector<double> positions;
+
+  bool worldPaused = true;
+  std::string worldAbsPath = CMAKE_CURRENT_SOURCE_DIR"/" + worldName;
+  Load(worldAbsPath, worldPaused);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  EXPECT_TRUE(world != NULL);
+  if (!world)
+  {
+    return positions;
+  }
+
+#if GAZEBO_MAJOR_VERSION >=8
+  auto joint = world->ModelByName("pendulum")->GetJoint("upper_joint");
+#else
+  auto joint = world->GetModel("pendulum")->GetJoint("upper_joint");
+#endif
+
+  // The plugin reads the joint state at the beginning of each step
+  for (int step=0; step < nrOfSteps; step++)
+  {
+#if GAZEBO_MAJOR_VERSION >=8
+    positions.push_back(joint->Position(0u));
+#else
+    positions.push_back(joint->GetAngle(0u).Radian());
+#endif
+    world->Step(1);
+  }
+
+  // Unload the simulation, this closes the recording
+  Unload();
+
+  return positions;
+}
+
+/////////////////////////////////////////////////
+/// The recording of a strongly coupled actuator contains the measured joint state, not the one predicted
+/// in the iterations of the strong coupling, so that it is consistent with the inputs computed when it is replayed
+TEST_F(FMIActuatorPluginStrongCouplingReplayTest, RecordAndReplay)
+{
+  std::vector<double> recordedPositions = SimulatePendulum("test_StrongCouplingRecord.world");
+  ASSERT_EQ(recordedPositions.size(), static_cast<size_t>(nrOfSteps));
+
+  // Relative to the working directory of the test, as the file element of the worlds
+  gazebo_fmi::FMURecordingReader reader;
+  ASSERT_TRUE(reader.open("FMIActuatorPluginStrongCouplingReplayTest.gzfmirec"));
+  size_t positionChannel = 0;
+  ASSERT_TRUE(reader.getChannelIndex("upper_joint_actuator/jointPosition", positionChannel));
+  ASSERT_EQ(reader.getNrOfSamples(), static_cast<size_t>(nrOfSteps));
+  for (int step=0; step < nrOfSteps; step++)
+  {
+    EXPECT_DOUBLE_EQ(reader.getValue(step, positionChannel), recordedPositions[step]) << "at step " << step;
+  }
+  reader.close();
+
+  // The recorded torques drive the joint along the same trajectory, without the strong coupling
+  std::vector<double> replayedPositions = SimulatePendulum("test_StrongCouplingReplay.world");
+  ASSERT_EQ(replayedPositions.size(), static_cast<size_t>(nrOfSteps));
+  for (int step=0; step < nrOfSteps; step++)
+  {
+    EXPECT_NEAR(replayedPositions[step], recordedPositions[step], 1e-9) << "at step " << step;
+  }
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <cmath>
+
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo/test/ServerFixture.hh>
+
+#include <gazebo_fmi/FMUCoSimulation.hh>
+
+/// \brief Return the inputs of the actuator FMU that FMUCoSimulation::getUsedInputs marks as used for the joint torque
+std::vector<bool> GetUsedActuatorInputs(const std::string &fmuName)
+{
+  std::vector<std::string> inputNames = {"actuatorInput", "jointPosition", "jointVelocity", "jointAcceleration"};
+  std::vector<bool> optionalInputs(inputNames.size(), true);
+  std::vector<bool> usedInputs;
+
+  gazebo_fmi::FMUCoSimulation fmu;
+  std::vector<fmi2_value_reference_t> inputReferences, outputReferences;
+  EXPECT_TRUE(fmu.load(GAZEBO_FMI_REFERENCE_FMUS_DIR"/" + fmuName, fmuName, 0.0));
+  EXPECT_TRUE(fmu.getInputVariableRefs(inputNames, optionalInputs, inputReferences));
+  EXPECT_TRUE(fmu.getOutputVariableRefs({"jointTorque"}, outputReferences));
+  EXPECT_TRUE(fmu.getUsedInputs(inputReferences, outputReferences, usedInputs));
+  return usedInputs;
+}
+
+/////////////////////////////////////////////////
+/// The inputs are masked only if the FMU declares all the state on which its outputs depend
+TEST(FMIActuatorPluginUsedInputsTest, GetUsedInputs)
+{
+  // The torque of Identity is a pure function of actuatorInput
+  EXPECT_EQ(GetUsedActuatorInputs("ReferenceIdentity.fmu"), std::vector<bool>({true, false, false, false}));
+
+  // The torque of FirstOrderLag and FixedDelay depends on no input, but on a state that is not declared in ModelStructure
+  EXPECT_EQ(GetUsedActuatorInputs("ReferenceFirstOrderLag.fmu"), std::vector<bool>({true, true, true, true}));
+  EXPECT_EQ(GetUsedActuatorInputs("ReferenceFixedDelay.fmu"), std::vector<bool>({true, true, true, true}));
+}
+
+class FMIActuatorPluginFirstOrderLagTest : public gazebo::ServerFixture
+{
+  /// \brief Joint driven by the actuator
+  public: gazebo::physics::Joint* m_joint{nullptr};
+
+  /// \brief Actuator input, set in the joint by onUpdate
+  public: double m_actuatorInput{0.0};
+
+  /// \brief SetForce must be called inside the step, see FMIActuatorPluginKnownInputTest
+  public: void onUpdate(const gazebo::common::UpdateInfo & /*_info*/)
+  {
+    m_joint->SetForce(0, m_actuatorInput);
+  }
+};
+
+/////////////////////////////////////////////////
+/// The torque applied to the joint follows a constant actuatorInput with the first order lag of the FMU
+TEST_F(FMIActuatorPluginFirstOrderLagTest, TorqueFollowsInput)
+{
+  // Defined by CMake
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+
+  bool worldPaused = true;
+  Load(CMAKE_CURRENT_SOURCE_DIR"/test_FirstOrderLag.world", worldPaused);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  ASSERT_TRUE(world != NULL);
+
+#if GAZEBO_MAJOR_VERSION >=8
+  auto joint = world->ModelByName("wheel")->GetJoint("wheel_joint");
+  double stepSize = world->Physics()->GetMaxStepSize();
+#else
+  auto joint = world->GetModel("wheel")->GetJoint("wheel_joint");
+  double stepSize = world->GetPhysicsEngine()->GetMaxStepSize();
+#endif
+  ASSERT_TRUE(joint != NULL);
+  m_joint = joint.get();
+  m_actuatorInput = 10.0;
+  gazebo::event::ConnectionPtr updateConnection =
+    gazebo::event::Events::ConnectWorldUpdateBegin(std::bind(&FMIActuatorPluginFirstOrderLagTest::onUpdate, this, std::placeholders::_1));
+
+  // Time constant of ReferenceFirstOrderLag.fmu
+  const double timeConstant = 0.01;
+  const double alpha = 1.0 - std::exp(-stepSize/timeConstant);
+  for (int step=1; step <= 100; step++)
+  {
+    world->Step(1);
+
+    // The FMU integrates the lag exactly for a constant input
+    double expectedTorque = m_actuatorInput*(1.0 - std::pow(1.0 - alpha, step));
+    EXPECT_NEAR(joint->GetForce(0u), expectedTorque, 1e-6) << "at step " << step;
+  }
+
+  updateConnection.reset();
+  Unload();
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
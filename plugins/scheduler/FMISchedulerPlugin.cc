@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+
+#include "FMISchedulerPlugin.hh"
+
+#include <gazebo_fmi/SDFConfigurationParsing.hh>
+
+
+using namespace gazebo_fmi;
+
+//////////////////////////////////////////////////
+FMISchedulerPlugin::~FMISchedulerPlugin()
+{
+    if (m_scheduler)
+    {
+        m_scheduler->printReport();
+
+        // The model plugins that are still loaded step their FMUs again in their own callbacks
+        m_updateConnection.reset();
+        m_scheduler->disable();
+    }
+}
+
+//////////////////////////////////////////////////
+void FMISchedulerPlugin::Load(gazebo::physics::WorldPtr _world, sdf::ElementPtr _sdf)
+{
+    FMUSchedulerOptions options;
+    if (!parseSchedulerSDFElement(_sdf, options))
+    {
+        gzerr << "FMISchedulerPlugin: error in parsing SDF parameters, plugin loading failed." << std::endl;
+        return;
+    }
+
+#if GAZEBO_MAJOR_VERSION >=8
+    const std::string worldName = _world->Name();
+#else
+    const std::string worldName = _world->GetName();
+#endif
+
+    // The model plugins loaded from now on register with the scheduler
+    std::shared_ptr<FMUScheduler> scheduler = FMUScheduler::getInstance();
+    if (!scheduler->configure(options, "FMISchedulerPlugin " + worldName))
+    {
+        gzerr << "FMISchedulerPlugin: error in configuring the scheduler, plugin loading failed." << std::endl;
+        return;
+    }
+    m_scheduler = scheduler;
+    m_world = _world;
+
+    // Set up a physics update callback
+    m_updateConnection = gazebo::event::Events::ConnectBeforePhysicsUpdate(
+        boost::bind(&FMISchedulerPlugin::BeforePhysicsUpdateCallback, this, _1));
+}
+
+//////////////////////////////////////////////////
+void FMISchedulerPlugin::BeforePhysicsUpdateCallback(const gazebo::common::UpdateInfo & updateInfo)
+{
+    double simulatedTimeInSeconds = updateInfo.simTime.Double();
+#if GAZEBO_MAJOR_VERSION >=8
+    double stepSizeInSeconds = m_world->Physics()->GetMaxStepSize();
+#else
+    double stepSizeInSeconds = m_world->GetPhysicsEngine()->GetMaxStepSize();
+#endif
+
+    m_scheduler->runCycle(simulatedTimeInSeconds, stepSizeInSeconds);
+}
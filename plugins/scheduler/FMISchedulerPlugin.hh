@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+
+#ifndef GAZEBO_FMI_SCHEDULER_PLUGIN_HH
+#define GAZEBO_FMI_SCHEDULER_PLUGIN_HH
+
+#include <memory>
+#include <gazebo/common/Events.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/gazebo.hh>
+
+#include <gazebo_fmi/FMUScheduler.hh>
+
+/// Example SDF:
+///   <world name="default">
+///     <plugin name="fmi_scheduler_plugin" filename="libFMISchedulerPlugin.so">
+///       <threads>4</threads>
+///       <rebalance_period>100</rebalance_period>
+///     </plugin>
+///     ...
+///   </world>
+///
+/// Optional plugin fields:
+/// - threads
+/// - rebalance_period
+
+namespace gazebo_fmi
+{
+/// \brief Plugin that steps the FMUs of all the FMI actuator and fluid dynamics plugins of the world in a single cycle per physics step
+///
+/// The model plugins loaded after this plugin register with the FMUScheduler instead of connecting their own callbacks,
+/// and their FMUs are partitioned over the threads of the scheduler according to the measured cost of their steps.
+class GAZEBO_VISIBLE FMISchedulerPlugin : public gazebo::WorldPlugin
+{
+    /// \brief Destructor, prints the estimated load of the threads of the scheduler
+    public: ~FMISchedulerPlugin();
+
+    /// Documentation inherited
+    public: void Load(gazebo::physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+    /// \brief Callback on before physics update event
+    private: void BeforePhysicsUpdateCallback(const gazebo::common::UpdateInfo & updateInfo);
+
+    /// \brief World whose physics step size is passed to the FMUs
+    private: gazebo::physics::WorldPtr m_world;
+
+    /// \brief Scheduler shared with the model plugins
+    private: std::shared_ptr<FMUScheduler> m_scheduler;
+
+    /// \brief Connections to events associated with this class.
+    private: gazebo::event::ConnectionPtr m_updateConnection;
+};
+
+// Register this plugin with the simulator
+GZ_REGISTER_WORLD_PLUGIN(FMISchedulerPlugin);
+}
+
+#endif
@@ -11,6 +11,7 @@
 
 #include "FMISingleBodyFluidDynamicsPlugin.hh"
 
+#include <algorithm>
 #include <functional>
 
 #include <experimental/filesystem>
@@ -40,26 +41,72 @@ enum OutputIndex
     fluidDynamicMoment_z,
     TotalOutputs,
 };
+
+// Rotate the vectors v_i by the unit quaternions q_i, or by their conjugates if inverse is true,
+// as v + w t + u x t with t = 2 u x v, where w and u are the real and vector parts of the quaternion
+void rotateVectors(const size_t nrOfVectors, const bool inverse,
+                   const double* q_w, const double* q_x, const double* q_y, const double* q_z,
+                   double* __restrict v_x, double* __restrict v_y, double* __restrict v_z)
+{
+    const double sign = inverse ? -1.0 : 1.0;
+    for (size_t i=0; i < nrOfVectors; i++)
+    {
+        const double u_x = sign*q_x[i];
+        const double u_y = sign*q_y[i];
+        const double u_z = sign*q_z[i];
+        const double t_x = 2.0*(u_y*v_z[i] - u_z*v_y[i]);
+        const double t_y = 2.0*(u_z*v_x[i] - u_x*v_z[i]);
+        const double t_z = 2.0*(u_x*v_y[i] - u_y*v_x[i]);
+        const double r_x = v_x[i] + q_w[i]*t_x + (u_y*t_z - u_z*t_y);
+        const double r_y = v_y[i] + q_w[i]*t_y + (u_z*t_x - u_x*t_z);
+        const double r_z = v_z[i] + q_w[i]*t_z + (u_x*t_y - u_y*t_x);
+        v_x[i] = r_x;
+        v_y[i] = r_y;
+        v_z[i] = r_z;
+    }
+}
 }
 
 
 //////////////////////////////////////////////////
-void FMISingleBodyFluidDynamicsPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
+FMISingleBodyFluidDynamicsPlugin::~FMISingleBodyFluidDynamicsPlugin()
 {
-    // Configure default variable names
-    m_fmu.m_inputVariablesDefaultNames.resize(FMISingleBodyFluidDynamicsPluginNS::TotalInputs);
-    m_fmu.m_inputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_x] = "relativeVelocity_x";
-    m_fmu.m_inputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_y] = "relativeVelocity_y";
-    m_fmu.m_inputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_z] = "relativeVelocity_z";
-
-    m_fmu.m_outputVariablesDefaultNames.resize(FMISingleBodyFluidDynamicsPluginNS::TotalOutputs);
-    m_fmu.m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_x] = "fluidDynamicForce_x";
-    m_fmu.m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_y] = "fluidDynamicForce_y";
-    m_fmu.m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_z] = "fluidDynamicForce_z";
-    m_fmu.m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_x] = "fluidDynamicMoment_x";
-    m_fmu.m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_y] = "fluidDynamicMoment_y";
-    m_fmu.m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_z] = "fluidDynamicMoment_z";
+    // The scheduler should not step the FMUs while they are destroyed
+    if (m_scheduler)
+    {
+        m_scheduler->removeClient(m_schedulerClientId);
+    }
+
+    // The streamer should not publish while the plugin is destroyed
+    m_variableStreamer.close();
+    m_variableStreamer.printReport();
 
+    m_budgetMonitor.printReport();
+    m_replayer.printReport();
+    m_digest.dump();
+    m_realTimeMonitor.printReport();
+
+    if (m_flowFieldClampedSamples > 0)
+    {
+        gzwarn << "FMISingleBodyFluidDynamicsPlugin: the links were outside of the grid of the flow field " << m_flowFieldOptions.filePath
+               << " in " << m_flowFieldClampedSamples << " samples, consider enlarging the grid." << std::endl;
+    }
+
+    for (auto current: m_fmus)
+    {
+        current->m_adaptiveStepper.printReport();
+
+        if (current->m_surrogate.getNrOfClampedEvaluations() > 0)
+        {
+            gzwarn << "FMISingleBodyFluidDynamicsPlugin: the inputs of the surrogate of " << current->name << " were outside of its grid in "
+                   << current->m_surrogate.getNrOfClampedEvaluations() << " steps, consider enlarging the grid." << std::endl;
+        }
+    }
+}
+
+//////////////////////////////////////////////////
+void FMISingleBodyFluidDynamicsPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
+{
     // Bullet is not supported by this plugin, due to https://bitbucket.org/osrf/gazebo/issues/1476/implement-addxxxforce-for-bullet
     std::string physicsEngineName;
 #if GAZEBO_MAJOR_VERSION >=8
@@ -80,16 +127,145 @@ void FMISingleBodyFluidDynamicsPlugin::Load(gazebo::physics::ModelPtr _parent, s
     {
         gzerr << "FMISingleBodyFluidDynamicsPlugin: error in parsing SDF parameters, plugin loading failed."
               << std::endl;
+        return;
     }
 
-    if (!this->LoadFMUs(_parent))
+    // Reserve the FMU memory pool before loading the FMU
+    if (!m_realTimeMonitor.configure(m_realTimeOptions, "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName()))
     {
-        gzerr << "FMISingleBodyFluidDynamicsPlugin: error in loading FMUs, plugin loading failed."
+        gzerr << "FMISingleBodyFluidDynamicsPlugin: error in configuring the real-time mode, plugin loading failed."
               << std::endl;
         return;
     }
 
-    // Set up a physics update callback
+    // If the FMIScheduler world plugin is loaded, the FMUs are stepped together with the ones of the other plugins
+    std::shared_ptr<FMUScheduler> scheduler = FMUScheduler::getInstance();
+    if (scheduler->isEnabled())
+    {
+        m_scheduler = scheduler;
+        if (m_nrOfThreads > 1)
+        {
+            gzwarn << "FMISingleBodyFluidDynamicsPlugin: the threads element is ignored, the FMUs are stepped by the threads of the FMIScheduler plugin." << std::endl;
+        }
+    }
+
+    if (m_replayOptions.enabled)
+    {
+        if (!this->LoadReplay(_parent))
+        {
+            gzerr << "FMISingleBodyFluidDynamicsPlugin: error in loading the replay recording, plugin loading failed."
+                  << std::endl;
+            return;
+        }
+    }
+    else
+    {
+        if (!this->LoadFMUs(_parent))
+        {
+            gzerr << "FMISingleBodyFluidDynamicsPlugin: error in loading FMUs, plugin loading failed."
+                  << std::endl;
+            return;
+        }
+
+        // The FMUs are stepped in parallel, with at most one thread for each FMU, by the scheduler of the world if present
+        if (!m_scheduler &&
+            !m_workerPool.configure(std::max<size_t>(1, std::min(m_nrOfThreads, m_fmuIndices.size())), m_realTimeMonitor,
+                                    "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName()))
+        {
+            gzerr << "FMISingleBodyFluidDynamicsPlugin: error in configuring the worker threads, plugin loading failed."
+                  << std::endl;
+            return;
+        }
+        m_stepFMUTask = [this](size_t task) { this->StepFMU(m_fmuIndices[task]); };
+    }
+    m_batch.resize(m_fmus.size());
+
+    // Map the wind/current field, or share the mapping of another plugin that uses the same file
+    if (m_flowFieldOptions.enabled)
+    {
+        m_flowField = FlowField::getShared(m_flowFieldOptions.filePath);
+        if (!m_flowField)
+        {
+            gzerr << "FMISingleBodyFluidDynamicsPlugin: error in loading the flow field, plugin loading failed." << std::endl;
+            return;
+        }
+    }
+
+    // Configure the real-time budget monitor
+    std::vector<std::string> fmuNames;
+    for (auto current: m_fmus)
+    {
+        fmuNames.push_back(current->name);
+    }
+    m_budgetMonitor.configure(m_budgetOptions, "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName(), fmuNames);
+    m_budgetMonitor.setConcurrentFMUs(m_workerPool.getNrOfThreads() > 1);
+
+    // The update of the plugin is interleaved with the ones of the other plugins, so the budget is checked by the scheduler
+    m_budgetMonitor.setCheckBudget(!m_scheduler);
+    m_digest.configure(m_digestOptions, "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName(), fmuNames);
+
+    // Open the recording of FMU inputs and outputs, with channels named name/variableName
+    if (m_recorderOptions.enabled)
+    {
+        std::vector<std::string> channelNames;
+        for (auto current: m_fmus)
+        {
+            for (const std::string& variableName : current->m_inputVariablesDefaultNames)
+            {
+                channelNames.push_back(current->name + "/" + variableName);
+            }
+            for (const std::string& variableName : current->m_outputVariablesDefaultNames)
+            {
+                channelNames.push_back(current->name + "/" + variableName);
+            }
+        }
+
+        if (!m_recorder.open(m_recorderOptions.filePath, channelNames, m_recorderOptions.samplesPerChunk))
+        {
+            gzerr << "FMISingleBodyFluidDynamicsPlugin: error in opening the recording, plugin loading failed." << std::endl;
+            return;
+        }
+    }
+
+    // Stream the variables of the FMUs requested by the clients
+    if (m_streamingOptions.enabled && !this->LoadVariableStreaming(_parent))
+    {
+        gzerr << "FMISingleBodyFluidDynamicsPlugin: error in configuring the streaming of FMU variables, plugin loading failed." << std::endl;
+        return;
+    }
+
+    // Everything used by the callback is allocated, so the memory can be locked
+    m_realTimeMonitor.lockMemory();
+
+    if (m_scheduler)
+    {
+        // The scheduler runs the three phases in its before physics update callback, the step possibly in its threads
+        FMUSchedulerClient client;
+        client.name = "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName();
+        client.nrOfTasks = m_replayOptions.enabled ? 0 : m_fmuIndices.size();
+        for (size_t fmuIndex : m_fmuIndices)
+        {
+            client.taskNames.push_back(m_fmus[fmuIndex]->name);
+        }
+        client.gather = [this](double simulatedTimeInSeconds, double stepSizeInSeconds)
+        {
+            RealTimeSection realTimeSection(m_realTimeMonitor);
+            this->GatherInputs(simulatedTimeInSeconds, stepSizeInSeconds);
+        };
+        client.step = [this](size_t task)
+        {
+            RealTimeSection realTimeSection(m_realTimeMonitor);
+            this->StepFMU(m_fmuIndices[task]);
+        };
+        client.scatter = [this]()
+        {
+            RealTimeSection realTimeSection(m_realTimeMonitor);
+            this->ApplyOutputs();
+        };
+        m_schedulerClientId = m_scheduler->addClient(client);
+    }
+
+    // Set up a physics update callback, that steps the FMUs only if they are not stepped by the scheduler
     m_updateConnection =  gazebo::event::Events::ConnectWorldUpdateBegin(
         boost::bind(&FMISingleBodyFluidDynamicsPlugin::WorldUpdateBeginCallback, this, _1));
 }
@@ -98,13 +274,95 @@ void FMISingleBodyFluidDynamicsPlugin::Load(gazebo::physics::ModelPtr _parent, s
 // Read the SDF
 bool FMISingleBodyFluidDynamicsPlugin::ParseParameters(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
 {
-  if (_sdf->HasElement("single_body_fluid_dynamics"))
+  if (!gazebo_fmi::parseRealTimeBudgetSDFElement(_sdf, m_budgetOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing realtime_budget tag" << std::endl;
+    return false;
+  }
+
+  if (!gazebo_fmi::parseRecorderSDFElement(_sdf, m_recorderOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing recorder tag" << std::endl;
+    return false;
+  }
+
+  if (!gazebo_fmi::parseReplaySDFElement(_sdf, m_replayOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing replay tag" << std::endl;
+    return false;
+  }
+
+  if (!gazebo_fmi::parseDeterminismDigestSDFElement(_sdf, m_digestOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing determinism_digest tag" << std::endl;
+    return false;
+  }
+
+  if (!gazebo_fmi::parseRealTimeSDFElement(_sdf, m_realTimeOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing realtime tag" << std::endl;
+    return false;
+  }
+
+  if (!gazebo_fmi::parseVariableStreamingSDFElement(_sdf, m_streamingOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing variable_streaming tag" << std::endl;
+    return false;
+  }
+
+  if (!gazebo_fmi::parseFlowFieldSDFElement(_sdf, m_flowFieldOptions))
+  {
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing flow_field tag" << std::endl;
+    return false;
+  }
+
+  if (m_replayOptions.enabled && m_recorderOptions.enabled &&
+      m_replayOptions.filePath == m_recorderOptions.filePath)
   {
-    sdf::ElementPtr elem = _sdf->GetElement("single_body_fluid_dynamics");
+    gzerr << "FMISingleBodyFluidDynamicsPlugin: the recorder file can not be the replayed file " << m_replayOptions.filePath << std::endl;
+    return false;
+  }
+
+  if (_sdf->HasElement("fmu_log_file"))
+  {
+    m_fmuLogger = AsyncLogger::getInstance();
+    if (!m_fmuLogger->setFileSink(_sdf->Get<std::string>("fmu_log_file")))
+    {
+      return false;
+    }
+  }
+
+  if (_sdf->HasElement("threads"))
+  {
+    int nrOfThreads = _sdf->Get<int>("threads");
+    if (nrOfThreads < 1)
     {
+      gzerr << "FMISingleBodyFluidDynamicsPlugin: the threads element is " << nrOfThreads << ", but it should be at least 1." << std::endl;
+      return false;
+    }
+    m_nrOfThreads = static_cast<size_t>(nrOfThreads);
+  }
+
+  if (!_sdf->HasElement("single_body_fluid_dynamics"))
+  {
+      gzerr << "FMISingleBodyFluidDynamicsPlugin: Invalid SDF, no single_body_fluid_fynamics tag found." << std::endl;
+      return false;
+  }
+
+  size_t nrOfElements = 0;
+  for (sdf::ElementPtr elem = _sdf->GetElement("single_body_fluid_dynamics"); elem;
+       elem = elem->GetNextElement("single_body_fluid_dynamics"))
+  {
+      nrOfElements++;
+  }
+
+  sdf::ElementPtr elem = _sdf->GetElement("single_body_fluid_dynamics");
+  while (elem)
+  {
+      FMUSingleBodyFluidDynamicsProperties_sptr current = std::make_shared<FMUSingleBodyFluidDynamicsProperties>();
 
       if (elem->HasElement("name"))
-        m_fmu.name = elem->Get<std::string>("name");
+        current->name = elem->Get<std::string>("name");
 
       if (!elem->HasElement("link"))
       {
@@ -114,51 +372,113 @@ bool FMISingleBodyFluidDynamicsPlugin::ParseParameters(gazebo::physics::ModelPtr
       }
       std::string linkName = elem->Get<std::string>("link");
 
-      link=FindLinkInModel(linkName,_parent);
+      current->link = FindLinkInModel(linkName,_parent);
+
+      // Before the link was found by its name, a plugin with a single element
+      // always acted on the first link of the model, whatever the link element
+      if (!current->link && nrOfElements == 1)
+      {
+        current->link = _parent->GetLink("canonical");
+        if (current->link)
+        {
+          gzwarn << "FMISingleBodyFluidDynamicsPlugin: link " << linkName << " does not exist in model "
+                 << _parent->GetName() << ", using its canonical link " << current->link->GetName()
+                 << ". This fallback is deprecated, set the link element to the name of the link." << std::endl;
+        }
+      }
 
-      // Store pointer to the joint we will actuate
-      if (!link)
+      // Store pointer to the link on which the fluid acts
+      if (!current->link)
       {
          gzerr << "FMISingleBodyFluidDynamicsPlugin: Invalid SDF, link " << linkName << " does not "
                << "exist!" << std::endl;
         return false;
       }
 
-      if (!elem->HasElement("fmu"))
+      if (current->name.empty())
+      {
+        current->name = current->link->GetScopedName();
+      }
+
+      // The name identifies the FMU in the recording and in the replay
+      for (auto other: m_fmus)
+      {
+        if (other->name == current->name)
+        {
+          gzerr << "FMISingleBodyFluidDynamicsPlugin: Invalid SDF, two single_body_fluid_dynamics elements are named "
+                << current->name << "." << std::endl;
+          return false;
+        }
+      }
+
+      if (!gazebo_fmi::parseNativeModelSDFElement(elem, current->m_nativeModelOptions))
+      {
+        gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing native_model tag" << std::endl;
+        return false;
+      }
+
+      const bool useNativeModel = current->m_nativeModelOptions.enabled;
+      if (useNativeModel && elem->HasElement("fmu"))
+      {
+         gzerr << "FMISingleBodyFluidDynamicsPlugin: Invalid SDF, " << current->name
+               << " has both the fmu and the native_model elements." << std::endl;
+        return false;
+      }
+
+      // In replay mode the FMU is not loaded, so it does not need to be available
+      if (!elem->HasElement("fmu") && !m_replayOptions.enabled && !useNativeModel)
       {
          gzerr << "FMISingleBodyFluidDynamicsPlugin: Invalid SDF, fmu parameter not found."
                << std::endl;
         return false;
       }
 
-      m_fmu.fmuAbsolutePath =  gazebo::common::SystemPaths::Instance()->FindFile(elem->Get<std::string>("fmu"));
-      if (!std::experimental::filesystem::exists(m_fmu.fmuAbsolutePath))
+      if (!m_replayOptions.enabled && !useNativeModel)
       {
-        gzerr << "FMISingleBodyFluidDynamicsPlugin: Impossible to find FMU named " << elem->Get<std::string>("fmu")
-              << " in the GAZEBO_RESOURCE_PATH directories" << std::endl;
-        return false;
+        current->fmuAbsolutePath =  gazebo::common::SystemPaths::Instance()->FindFile(elem->Get<std::string>("fmu"));
+        if (!std::experimental::filesystem::exists(current->fmuAbsolutePath))
+        {
+          gzerr << "FMISingleBodyFluidDynamicsPlugin: Impossible to find FMU named " << elem->Get<std::string>("fmu")
+                << " in the GAZEBO_RESOURCE_PATH directories" << std::endl;
+          return false;
+        }
       }
 
       // Process variable_names element
       bool variableNamesOk = gazebo_fmi::parseVariableNamesSDFElement(elem,
-                                                                      m_fmu.m_inputVariablesDefaultNames,
-                                                                      m_fmu.m_inputVariablesNames,
-                                                                      m_fmu.m_outputVariablesDefaultNames,
-                                                                      m_fmu.m_outputVariablesNames);
+                                                                      current->m_inputVariablesDefaultNames,
+                                                                      current->m_inputVariablesNames,
+                                                                      current->m_outputVariablesDefaultNames,
+                                                                      current->m_outputVariablesNames);
 
       if (!variableNamesOk)
       {
         gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing variable_names tag" << std::endl;
         return false;
       }
-    }
-    return true;
-  }
-  else
-  {
-      gzerr << "FMISingleBodyFluidDynamicsPlugin: Invalid SDF, no single_body_fluid_fynamics tag found." << std::endl;
-      return false;
+
+      if (!gazebo_fmi::parseFMULogLevelSDFElement(elem, current->m_fmuLogLevel))
+      {
+        gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing fmu_log_level tag" << std::endl;
+        return false;
+      }
+
+      if (!gazebo_fmi::parseSurrogateSDFElement(elem, current->m_inputVariablesDefaultNames, current->m_surrogateOptions))
+      {
+        gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing surrogate tag" << std::endl;
+        return false;
+      }
+
+      if (!gazebo_fmi::parseAdaptiveStepSDFElement(elem, current->m_adaptiveStepOptions))
+      {
+        gzerr << "FMISingleBodyFluidDynamicsPlugin: failure in parsing adaptive_step tag" << std::endl;
+        return false;
+      }
+
+      m_fmus.push_back(current);
+      elem = elem->GetNextElement("single_body_fluid_dynamics");
   }
+  return true;
 }
 
 //////////////////////////////////////////////////
@@ -166,38 +486,208 @@ bool FMISingleBodyFluidDynamicsPlugin::LoadFMUs(gazebo::physics::ModelPtr _paren
 {
 #if GAZEBO_MAJOR_VERSION >=8
     double simulatedTimeInSeconds  = _parent->GetWorld()->SimTime().Double();
+    double stepSizeInSeconds = _parent->GetWorld()->Physics()->GetMaxStepSize();
 #else
     double simulatedTimeInSeconds  = _parent->GetWorld()->GetSimTime().Double();
+    double stepSizeInSeconds = _parent->GetWorld()->GetPhysicsEngine()->GetMaxStepSize();
 #endif
 
-    std::string instanceName = link->GetScopedName()+"_fmuSingleBodyFluidDynamics";
-    bool ok = m_fmu.fmu.load(m_fmu.fmuAbsolutePath, instanceName, simulatedTimeInSeconds);
-    if (!ok) {
-        return false;
+    for (size_t i=0; i < m_fmus.size(); i++)
+    {
+        FMUSingleBodyFluidDynamicsProperties_sptr current = m_fmus[i];
+        std::string ownerName = "FMISingleBodyFluidDynamicsPlugin " + current->name;
+
+        // The bodies simulated by FMUs get a zero wrench from the native models
+        if (!m_nativeModels.addBody(current->m_nativeModelOptions, ownerName))
+        {
+            return false;
+        }
+
+        if (current->m_nativeModelOptions.enabled)
+        {
+            current->inputVarBuffers.resize(current->m_inputVariablesDefaultNames.size());
+            current->outputVarBuffers.resize(current->m_outputVariablesDefaultNames.size(), 0.0);
+            continue;
+        }
+        m_fmuIndices.push_back(i);
+
+        std::string instanceName = current->link->GetScopedName()+"_fmuSingleBodyFluidDynamics";
+        current->fmu.setLogLevel(current->m_fmuLogLevel);
+        current->fmu.setUseMemoryPool(m_realTimeMonitor.isEnabled());
+        bool ok = current->fmu.load(current->fmuAbsolutePath, instanceName, simulatedTimeInSeconds);
+        if (!ok) {
+            return false;
+        }
+
+        // Get references for input variables
+        ok = current->fmu.getInputVariableRefs(current->m_inputVariablesNames, current->inputVarReferences);
+        if (!ok) {
+            return false;
+        }
+        current->inputVarBuffers.resize(current->inputVarReferences.size());
+
+        // Get references for output variables
+        ok = current->fmu.getOutputVariableRefs(current->m_outputVariablesNames, current->outputVarReferences);
+        if (!ok) {
+            return false;
+        }
+        current->outputVarBuffers.resize(current->outputVarReferences.size());
+
+        if (current->m_adaptiveStepOptions.enabled && FMUAdaptiveStepper::isSupportedBy(current->fmu, ownerName))
+        {
+            ok = current->m_adaptiveStepper.configure(current->m_adaptiveStepOptions, current->inputVarReferences.size(),
+                                                      current->outputVarReferences.size(), ownerName);
+            if (!ok) {
+                return false;
+            }
+        }
+
+        if (!current->m_surrogateOptions.enabled)
+        {
+            continue;
+        }
+
+        // A stateless FMU is sampled once, and then replaced by the interpolation of the samples
+        if (!current->fmu.isStateless(current->inputVarReferences, current->outputVarReferences))
+        {
+            gzwarn << "FMISingleBodyFluidDynamicsPlugin: the FMU of " << current->name
+                   << " is not stateless, the surrogate is disabled and the FMU is simulated." << std::endl;
+            continue;
+        }
+
+        ok = gazebo_fmi::loadOrBuildFMUSurrogate(current->m_surrogate, current->m_surrogateOptions, current->fmuAbsolutePath, current->fmu,
+                                                 current->inputVarReferences, current->outputVarReferences,
+                                                 simulatedTimeInSeconds, stepSizeInSeconds, ownerName);
+        if (!ok) {
+            return false;
+        }
+
+        // The FMU is not used anymore
+        current->fmu.unload();
     }
 
-    // Get references for input variables
-    ok = m_fmu.fmu.getInputVariableRefs(m_fmu.m_inputVariablesNames, m_fmu.inputVarReferences);
-    if (!ok) {
+    return true;
+}
+
+//////////////////////////////////////////////////
+bool FMISingleBodyFluidDynamicsPlugin::LoadReplay(gazebo::physics::ModelPtr _parent)
+{
+    if (!m_replayer.open(m_replayOptions, "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName()))
+    {
         return false;
     }
-    m_fmu.inputVarBuffers.resize(m_fmu.inputVarReferences.size());
 
-    // Get references for output variables
-    ok = m_fmu.fmu.getOutputVariableRefs(m_fmu.m_outputVariablesNames, m_fmu.outputVarReferences);
-    if (!ok) {
-        return false;
+    // The channels have the same names used by the recorder, i.e. name/defaultVariableName
+    for (auto current: m_fmus)
+    {
+        std::vector<std::string> inputChannelNames, outputChannelNames;
+        for (const std::string& variableName : current->m_inputVariablesDefaultNames)
+        {
+            inputChannelNames.push_back(current->name + "/" + variableName);
+        }
+        for (const std::string& variableName : current->m_outputVariablesDefaultNames)
+        {
+            outputChannelNames.push_back(current->name + "/" + variableName);
+        }
+
+        if (!m_replayer.addFMU(inputChannelNames, outputChannelNames))
+        {
+            return false;
+        }
+
+        current->inputVarBuffers.resize(current->m_inputVariablesDefaultNames.size());
+        current->outputVarBuffers.resize(current->m_outputVariablesDefaultNames.size(), 0.0);
     }
-    m_fmu.outputVarBuffers.resize(m_fmu.outputVarBuffers.size());
 
+    gzmsg << "FMISingleBodyFluidDynamicsPlugin: replaying the FMU outputs from " << m_replayOptions.filePath << std::endl;
     return true;
 }
 
+//////////////////////////////////////////////////
+bool FMISingleBodyFluidDynamicsPlugin::LoadVariableStreaming(gazebo::physics::ModelPtr _parent)
+{
+    const std::string ownerName = "FMISingleBodyFluidDynamicsPlugin " + _parent->GetScopedName();
+    if (!m_variableStreamer.configure(m_streamingOptions, ownerName,
+                                      [this](const std::string& streamName, double simulatedTimeInSeconds, const std::vector<double>& values)
+                                      {
+                                          m_variableStreamTopics.publish(streamName, simulatedTimeInSeconds, values);
+                                      }))
+    {
+        return false;
+    }
+
+    // The replayed, native and surrogate bodies have no FMU to read
+    for (auto current: m_fmus)
+    {
+        if (current->fmu.isLoaded() && !m_variableStreamer.addFMU(current->name, current->fmu))
+        {
+            return false;
+        }
+    }
+
+    const std::string topic = m_streamingOptions.topic.empty() ? "~/" + _parent->GetScopedName() + "/fmu_variables"
+                                                                : m_streamingOptions.topic;
+#if GAZEBO_MAJOR_VERSION >=8
+    const std::string worldName = _parent->GetWorld()->Name();
+#else
+    const std::string worldName = _parent->GetWorld()->GetName();
+#endif
+    return m_variableStreamTopics.advertise(m_variableStreamer, worldName, topic, ownerName);
+}
+
+//////////////////////////////////////////////////
+void FMISingleBodyFluidDynamicsPlugin::StepFMU(const size_t fmuIndex)
+{
+    FMUSingleBodyFluidDynamicsProperties& current = *(m_fmus[fmuIndex]);
+
+    // Each thread writes only the timer of the FMU it is stepping
+    m_budgetMonitor.beginFMU(fmuIndex);
+
+    bool ok = true;
+    if (current.m_surrogate.isValid())
+    {
+        ok = current.m_surrogate.evaluate(current.inputVarBuffers, current.outputVarBuffers);
+    }
+    else if (current.m_adaptiveStepper.isEnabled())
+    {
+        // Step the FMU only at the communication points, over macro steps of adaptive size
+        ok = current.m_adaptiveStepper.step(current.fmu, current.inputVarReferences, current.outputVarReferences,
+                                            m_simulatedTimeInSeconds, m_stepSizeInSeconds,
+                                            current.inputVarBuffers, current.outputVarBuffers);
+    }
+    else
+    {
+        ok = current.fmu.setInputVariables(current.inputVarReferences, current.inputVarBuffers);
+
+        // Run fmu simulation
+        ok = ok && current.fmu.doStep(m_simulatedTimeInSeconds, m_stepSizeInSeconds);
+
+        // Get ouput
+        ok = ok && current.fmu.getOutputVariables(current.outputVarReferences, current.outputVarBuffers);
+    }
+    current.stepOk = ok;
+
+    m_budgetMonitor.endFMU(fmuIndex);
+}
+
 //////////////////////////////////////////////////
 void FMISingleBodyFluidDynamicsPlugin::WorldUpdateBeginCallback(const gazebo::common::UpdateInfo & updateInfo)
 {
+    // If the FMIScheduler world plugin was unloaded, the scheduler removed the client and the plugin steps its FMUs again
+    if (m_scheduler)
+    {
+        if (m_scheduler->isEnabled())
+        {
+            return;
+        }
+        m_scheduler.reset();
+        m_budgetMonitor.setCheckBudget(true);
+    }
+
+    RealTimeSection realTimeSection(m_realTimeMonitor);
+
     // TODO(traversaro): review this part
-    double simulatedTimeInSeconds  = updateInfo.simTime.Double();
+    double simulatedTimeInSeconds = updateInfo.simTime.Double();
     auto world = gazebo::physics::get_world(updateInfo.worldName);
 #if GAZEBO_MAJOR_VERSION >=8
     double stepSizeInSeconds = world->Physics()->GetMaxStepSize();
@@ -205,77 +695,209 @@ void FMISingleBodyFluidDynamicsPlugin::WorldUpdateBeginCallback(const gazebo::co
     double stepSizeInSeconds = world->GetPhysicsEngine()->GetMaxStepSize();
 #endif
 
-    // Get input: relative velocity in link frame
+    this->GatherInputs(simulatedTimeInSeconds, stepSizeInSeconds);
+
+    // Step the FMUs, in parallel if the pool has more than one thread
+    if (!m_replayOptions.enabled)
+    {
+        m_workerPool.run(m_fmuIndices.size(), m_stepFMUTask);
+    }
+
+    this->ApplyOutputs();
+}
+
+//////////////////////////////////////////////////
+void FMISingleBodyFluidDynamicsPlugin::GatherInputs(const double simulatedTimeInSeconds, const double stepSizeInSeconds)
+{
+    m_simulatedTimeInSeconds = simulatedTimeInSeconds;
+    m_stepSizeInSeconds = stepSizeInSeconds;
+
+    // The whole update of the plugin is timed, as in the actuator plugin
+    m_budgetMonitor.beginStep();
+
+    // Gather the relative velocity and the orientation of all the links
     // TODO: check orientation
+    const size_t nrOfFMUs = m_fmus.size();
+    for (size_t i=0; i < nrOfFMUs; i++)
+    {
+        const gazebo::physics::LinkPtr& link = m_fmus[i]->link;
+        const ignition::math::Pose3d world_H_link = link->WorldPose();
+
+        // The velocity of the fluid is the one of the field in the link origin, if present, or the global wind
+        ignition::math::Vector3d worldFluidVel;
+        if (m_flowField)
+        {
+            const ignition::math::Vector3d& position = world_H_link.Pos();
+            double fluidVel_x, fluidVel_y, fluidVel_z;
+            if (!m_flowField->sample(position.X(), position.Y(), position.Z(), m_simulatedTimeInSeconds + m_flowFieldOptions.timeOffset,
+                                     fluidVel_x, fluidVel_y, fluidVel_z))
+            {
+                m_flowFieldClampedSamples++;
+            }
+            worldFluidVel.Set(fluidVel_x, fluidVel_y, fluidVel_z);
+        }
+        else
+        {
+            worldFluidVel = link->WorldWindLinearVel();
+        }
+
 #if GAZEBO_MAJOR_VERSION >= 8
-    ignition::math::Vector3d worldRelativeVel = link->WorldLinearVel()-link->WorldWindLinearVel();
+        ignition::math::Vector3d worldRelativeVel = link->WorldLinearVel()-worldFluidVel;
 #else
-    ignition::math::Vector3d worldRelativeVel = link->GetWorldLinearVel().Ign()-link->WorldWindLinearVel();
+        ignition::math::Vector3d worldRelativeVel = link->GetWorldLinearVel().Ign()-worldFluidVel;
 #endif
-    ignition::math::Matrix3d link_R_world = ignition::math::Matrix3d(link->WorldPose().Rot()).Transposed();
-    ignition::math::Vector3d linkRelativeVel = link_R_world*worldRelativeVel;
+        const ignition::math::Quaterniond& world_q_link = world_H_link.Rot();
+        m_batch.velocity_x[i] = worldRelativeVel[0];
+        m_batch.velocity_y[i] = worldRelativeVel[1];
+        m_batch.velocity_z[i] = worldRelativeVel[2];
+        m_batch.rotation_w[i] = world_q_link.W();
+        m_batch.rotation_x[i] = world_q_link.X();
+        m_batch.rotation_y[i] = world_q_link.Y();
+        m_batch.rotation_z[i] = world_q_link.Z();
+    }
+
+    // Express the relative velocities in the link frames
+    FMISingleBodyFluidDynamicsPluginNS::rotateVectors(nrOfFMUs, true,
+                                                      m_batch.rotation_w.data(), m_batch.rotation_x.data(),
+                                                      m_batch.rotation_y.data(), m_batch.rotation_z.data(),
+                                                      m_batch.velocity_x.data(), m_batch.velocity_y.data(), m_batch.velocity_z.data());
 
     // Set inputs
-    m_fmu.inputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_x] = linkRelativeVel[0];
-    m_fmu.inputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_y] = linkRelativeVel[1];
-    m_fmu.inputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_z] = linkRelativeVel[2];
-    bool ok = m_fmu.fmu.setInputVariables(m_fmu.inputVarReferences, m_fmu.inputVarBuffers);
+    for (size_t i=0; i < nrOfFMUs; i++)
+    {
+        std::vector<double>& inputs = m_fmus[i]->inputVarBuffers;
+        inputs[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_x] = m_batch.velocity_x[i];
+        inputs[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_y] = m_batch.velocity_y[i];
+        inputs[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_z] = m_batch.velocity_z[i];
+    }
 
-    // Run fmu simulation
-    ok = ok && m_fmu.fmu.doStep(simulatedTimeInSeconds, stepSizeInSeconds);
+    if (m_replayOptions.enabled)
+    {
+        // Take the outputs from the recording instead of simulating the FMUs
+        m_replayer.seek(m_simulatedTimeInSeconds);
+        for (size_t i=0; i < nrOfFMUs; i++)
+        {
+            m_budgetMonitor.beginFMU(i);
+            m_replayer.checkInputs(i, m_fmus[i]->inputVarBuffers);
+            m_replayer.getOutputs(i, m_fmus[i]->outputVarBuffers);
+            m_budgetMonitor.endFMU(i);
+        }
+    }
+    else
+    {
+        // Evaluate the native models of all the links, the FMUs are then stepped by StepFMU
+        m_nativeModels.evaluate(m_batch.velocity_x.data(), m_batch.velocity_y.data(), m_batch.velocity_z.data(),
+                                m_batch.force_x.data(), m_batch.force_y.data(), m_batch.force_z.data(),
+                                m_batch.moment_x.data(), m_batch.moment_y.data(), m_batch.moment_z.data());
+    }
+}
 
-    // Get ouput
-    ok = ok && m_fmu.fmu.getOutputVariables(m_fmu.outputVarReferences, m_fmu.outputVarBuffers);
+//////////////////////////////////////////////////
+void FMISingleBodyFluidDynamicsPlugin::ApplyOutputs()
+{
+    const size_t nrOfFMUs = m_fmus.size();
 
-    if (!ok)
+    m_recorder.beginSample(m_simulatedTimeInSeconds);
+    m_digest.beginStep(m_simulatedTimeInSeconds);
+
+    size_t recorderChannel = 0;
+    for (size_t i=0; i < nrOfFMUs; i++)
     {
-        gzerr << "gazebo_fmi: Failure in simulating single body fluid dynamics forces of link " << link->GetScopedName() << std::endl;
+        FMUSingleBodyFluidDynamicsProperties& current = *(m_fmus[i]);
+
+        // The outputs of the native models are recorded as the ones of a FMU
+        const bool native = current.m_nativeModelOptions.enabled && !m_replayOptions.enabled;
+        if (native)
+        {
+            std::vector<double>& outputs = current.outputVarBuffers;
+            outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_x] = m_batch.force_x[i];
+            outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_y] = m_batch.force_y[i];
+            outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_z] = m_batch.force_z[i];
+            outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_x] = m_batch.moment_x[i];
+            outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_y] = m_batch.moment_y[i];
+            outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_z] = m_batch.moment_z[i];
+        }
+
+        m_recorder.setChannels(recorderChannel, current.inputVarBuffers);
+        recorderChannel += current.inputVarBuffers.size();
+        m_recorder.setChannels(recorderChannel, current.outputVarBuffers);
+        recorderChannel += current.outputVarBuffers.size();
+
+        m_digest.update(i, current.inputVarBuffers);
+        m_digest.update(i, current.outputVarBuffers);
+
+        if (!current.stepOk)
+        {
+            logFromCallback(LogLevel::error, "gazebo_fmi", "Failure in simulating single body fluid dynamics forces of %s", current.name.c_str());
+            current.stepOk = true;
+        }
+
+        if (native)
+        {
+            continue;
+        }
+
+        // This order should be coherent with the order defined in LoadFMUs
+        const std::vector<double>& outputs = current.outputVarBuffers;
+        m_batch.force_x[i] = outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_x];
+        m_batch.force_y[i] = outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_y];
+        m_batch.force_z[i] = outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_z];
+        m_batch.moment_x[i] = outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_x];
+        m_batch.moment_y[i] = outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_y];
+        m_batch.moment_z[i] = outputs[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_z];
     }
 
-    // This order should be coherent with the order defined in LoadFMUs
-    ignition::math::Vector3d linkFluidForce, linkFluidMoment;
-    linkFluidForce[0] = m_fmu.outputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_x];
-    linkFluidForce[1] = m_fmu.outputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_y];
-    linkFluidForce[2] = m_fmu.outputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_z];
-    linkFluidMoment[0] = m_fmu.outputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_x];
-    linkFluidMoment[1] = m_fmu.outputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_y];
-    linkFluidMoment[2] = m_fmu.outputVarBuffers[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_z];
+    m_recorder.endSample();
+    m_digest.endStep();
+    m_variableStreamer.update(m_simulatedTimeInSeconds);
 
     // Rotate the forces with the world orientation
-    ignition::math::Matrix3d world_R_link = link_R_world.Transposed();
-    ignition::math::Vector3d worldFluidForce = world_R_link*linkFluidForce;
-    ignition::math::Vector3d worldFluidMoment = world_R_link*linkFluidMoment;
+    FMISingleBodyFluidDynamicsPluginNS::rotateVectors(nrOfFMUs, false,
+                                                      m_batch.rotation_w.data(), m_batch.rotation_x.data(),
+                                                      m_batch.rotation_y.data(), m_batch.rotation_z.data(),
+                                                      m_batch.force_x.data(), m_batch.force_y.data(), m_batch.force_z.data());
+    FMISingleBodyFluidDynamicsPluginNS::rotateVectors(nrOfFMUs, false,
+                                                      m_batch.rotation_w.data(), m_batch.rotation_x.data(),
+                                                      m_batch.rotation_y.data(), m_batch.rotation_z.data(),
+                                                      m_batch.moment_x.data(), m_batch.moment_y.data(), m_batch.moment_z.data());
+
+    // Apply the wrenches of all the links
+    for (size_t i=0; i < nrOfFMUs; i++)
+    {
+        const gazebo::physics::LinkPtr& link = m_fmus[i]->link;
+        link->AddForce(ignition::math::Vector3d(m_batch.force_x[i], m_batch.force_y[i], m_batch.force_z[i]));
+        link->AddTorque(ignition::math::Vector3d(m_batch.moment_x[i], m_batch.moment_y[i], m_batch.moment_z[i]));
+    }
 
-    link->AddForce(worldFluidForce);
-    link->AddTorque(worldFluidMoment);
+    m_budgetMonitor.endStep(m_stepSizeInSeconds, m_simulatedTimeInSeconds);
 }
 
 //////////////////////////////////////////////////
 gazebo::physics::LinkPtr FMISingleBodyFluidDynamicsPlugin::FindLinkInModel(const std::string& linkName, const gazebo::physics::ModelPtr _parent)
 {
-    link=nullptr;
+    gazebo::physics::LinkPtr link=nullptr;
     for (gazebo::physics::LinkPtr currentLink: _parent->GetLinks())
     {
         const std::string& currentLinkName=currentLink->GetName();
 
-        if(currentLinkName==linkName)
+        if(currentLinkName==linkName)//if you use the scoped name
         {
             link=currentLink;
             break;
         }
 
-        std::size_t lastJointNamePart = currentLinkName.find_last_of("::");
+        std::size_t lastLinkNamePart = currentLinkName.find_last_of("::");
         std::string currentLinkNameUnscoped;
-        if (lastJointNamePart==std::string::npos)
+        if (lastLinkNamePart==std::string::npos)//in the model the link names are unscoped
         {
             currentLinkNameUnscoped=currentLinkName;
         }
-        else//in the model the joint names are scoped
+        else//in the model the link names are scoped
         {
-            currentLinkNameUnscoped=currentLinkName.substr(lastJointNamePart+1);
+            currentLinkNameUnscoped=currentLinkName.substr(lastLinkNamePart+1);
         }
 
-        if (currentLinkNameUnscoped!=currentLinkName)
+        if (currentLinkNameUnscoped!=linkName)
             continue;
 
         link=currentLink;
@@ -283,3 +905,32 @@ gazebo::physics::LinkPtr FMISingleBodyFluidDynamicsPlugin::FindLinkInModel(const
     }
     return link;
 }
+
+//////////////////////////////////////////////////
+FMUSingleBodyFluidDynamicsProperties::FMUSingleBodyFluidDynamicsProperties()
+{
+    // Configure default variable names
+    m_inputVariablesDefaultNames.resize(FMISingleBodyFluidDynamicsPluginNS::TotalInputs);
+    m_inputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_x] = "relativeVelocity_x";
+    m_inputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_y] = "relativeVelocity_y";
+    m_inputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::relativeVelocity_z] = "relativeVelocity_z";
+
+    m_outputVariablesDefaultNames.resize(FMISingleBodyFluidDynamicsPluginNS::TotalOutputs);
+    m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_x] = "fluidDynamicForce_x";
+    m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_y] = "fluidDynamicForce_y";
+    m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicForce_z] = "fluidDynamicForce_z";
+    m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_x] = "fluidDynamicMoment_x";
+    m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_y] = "fluidDynamicMoment_y";
+    m_outputVariablesDefaultNames[FMISingleBodyFluidDynamicsPluginNS::fluidDynamicMoment_z] = "fluidDynamicMoment_z";
+}
+
+//////////////////////////////////////////////////
+void SingleBodyFluidDynamicsBatch::resize(const size_t nrOfLinks)
+{
+    for (std::vector<double>* component : {&velocity_x, &velocity_y, &velocity_z,
+                                           &rotation_w, &rotation_x, &rotation_y, &rotation_z,
+                                           &force_x, &force_y, &force_z, &moment_x, &moment_y, &moment_z})
+    {
+        component->assign(nrOfLinks, 0.0);
+    }
+}
@@ -13,20 +13,35 @@
 #define GAZEBO_FMI_SINGLE_BODY_FLUID_DYNAMICS_PLUGIN_HH
 
 #include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 #include <gazebo/common/Events.hh>
 #include <gazebo/physics/physics.hh>
 #include <gazebo/gazebo.hh>
 
+#include <gazebo_fmi/DeterminismDigest.hh>
+#include <gazebo_fmi/FMUAdaptiveStep.hh>
 #include <gazebo_fmi/FMUCoSimulation.hh>
+#include <gazebo_fmi/FMURecording.hh>
+#include <gazebo_fmi/FMUReplay.hh>
+#include <gazebo_fmi/FMUScheduler.hh>
+#include <gazebo_fmi/FMUSurrogate.hh>
+#include <gazebo_fmi/FMUVariableStreaming.hh>
+#include <gazebo_fmi/FlowField.hh>
+#include <gazebo_fmi/NativeFluidDynamics.hh>
+#include <gazebo_fmi/RealTimeBudgetMonitor.hh>
+#include <gazebo_fmi/RealTimeSafety.hh>
+#include <gazebo_fmi/WorkerPool.hh>
 
 namespace gazebo_fmi
 {
 /// \brief Properties for a FMU for single body fluid dynamics
 class FMUSingleBodyFluidDynamicsProperties
 {
-    /// \brief An identifier for the fmu
+    public: FMUSingleBodyFluidDynamicsProperties();
+
+    /// \brief An identifier for the fmu, if not specified it is the scoped name of the link
     public: std::string name;
 
     public: std::string fmuAbsolutePath;
@@ -43,17 +58,65 @@ class FMUSingleBodyFluidDynamicsProperties
     /// \brief Actual output variable names, after parsing variable_names
     public: std::vector<std::string> m_outputVariablesNames;
 
+    /// \brief Verbosity of the log messages of the FMU
+    public: LogLevel m_fmuLogLevel{LogLevel::error};
+
+    /// \brief Options of the tabulated surrogate, parsed from the surrogate element
+    public: FMUSurrogateOptions m_surrogateOptions;
+
+    /// \brief Table evaluated in place of the FMU, if the surrogate is enabled and the FMU is stateless
+    public: FMUSurrogateTable m_surrogate;
+
+    /// \brief Options of the adaptive communication step, parsed from the adaptive_step element
+    public: FMUAdaptiveStepOptions m_adaptiveStepOptions;
+
+    /// \brief Options of the native model used in place of the FMU, parsed from the native_model element
+    public: NativeFluidDynamicsModelOptions m_nativeModelOptions;
+
+    /// \brief Adaptive communication step, used in place of stepping the FMU at each physics step
+    public: FMUAdaptiveStepper m_adaptiveStepper;
+
     public: FMUCoSimulation fmu;
     public: std::vector<fmi2_value_reference_t> inputVarReferences;
     public: std::vector<fmi2_value_reference_t> outputVarReferences;
     public: std::vector<double> inputVarBuffers;
     public: std::vector<double> outputVarBuffers;
 
+    /// \brief The link of which we want to simulate the fluid dynamic forces
+    public: gazebo::physics::LinkPtr link;
+
+    /// \brief Outcome of the last step of the FMU, written by the thread that stepped it
+    public: bool stepOk{true};
+};
+
+using FMUSingleBodyFluidDynamicsProperties_sptr=std::shared_ptr<FMUSingleBodyFluidDynamicsProperties>;
+
+/// \brief Kinematics of the links and wrenches of the fluid, stored as one array per component
+///
+/// The i-th element of each array refers to the i-th FMU of the plugin, so that the frame rotations
+/// of all the links are computed in loops that the compiler can vectorize.
+struct SingleBodyFluidDynamicsBatch
+{
+    /// \brief Relative velocity of the links with respect to the fluid, in the world frame and then in the link frame
+    std::vector<double> velocity_x, velocity_y, velocity_z;
+
+    /// \brief Orientation of the links in the world frame, as unit quaternions
+    std::vector<double> rotation_w, rotation_x, rotation_y, rotation_z;
+
+    /// \brief Force and moment of the fluid, in the link frame and then in the world frame
+    std::vector<double> force_x, force_y, force_z;
+    std::vector<double> moment_x, moment_y, moment_z;
+
+    /// \brief Allocate the arrays for the specified number of links
+    void resize(const size_t nrOfLinks);
 };
 
-/// \brief Plugin for interaction between a single body and a surrounding fluid
+/// \brief Plugin for interaction between bodies and a surrounding fluid, each simulated as a single body by its own FMU
 class GAZEBO_VISIBLE FMISingleBodyFluidDynamicsPlugin : public gazebo::ModelPlugin
 {
+    /// \brief Destructor, unregisters from the scheduler, stops the streaming of FMU variables, prints the real-time budget, replay, surrogate, adaptive step, real-time and flow field reports and dumps the determinism digest if enabled
+    public: ~FMISingleBodyFluidDynamicsPlugin();
+
     /// Documentation inherited
     public: void Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf);
 
@@ -61,19 +124,110 @@ class GAZEBO_VISIBLE FMISingleBodyFluidDynamicsPlugin : public gazebo::ModelPlug
 
     private: bool LoadFMUs(gazebo::physics::ModelPtr _parent);
 
+    /// \brief Open the replay recording in place of the FMU
+    private: bool LoadReplay(gazebo::physics::ModelPtr _parent);
+
+    /// \brief Add the variables of the loaded FMUs to the catalogue of the streamer and advertise its topics
+    private: bool LoadVariableStreaming(gazebo::physics::ModelPtr _parent);
+
+    /// \brief Step the fmuIndex-th FMU, possibly in a thread of the worker pool or of the FMUScheduler
+    private: void StepFMU(const size_t fmuIndex);
+
     private: gazebo::physics::LinkPtr FindLinkInModel(const std::string& linkName, const gazebo::physics::ModelPtr _parent);
 
-    /// \brief Callback on world update begin
+    /// \brief Read the link kinematics and set the FMU inputs, then replay the outputs or evaluate the native models
+    private: void GatherInputs(const double simulatedTimeInSeconds, const double stepSizeInSeconds);
+
+    /// \brief Record the FMU outputs and apply the fluid wrenches to the links
+    private: void ApplyOutputs();
+
+    /// \brief Callback on world update begin, used if the FMUs are not stepped by the FMUScheduler
     private: void WorldUpdateBeginCallback(const gazebo::common::UpdateInfo & updateInfo);
 
-    /// \brief The link of which we want to simulate the fluid dynamic forces
-    private: gazebo::physics::LinkPtr link;
+    /// \brief FMUs, one for each single_body_fluid_dynamics element
+    private: std::vector<FMUSingleBodyFluidDynamicsProperties_sptr> m_fmus;
+
+    /// \brief Link kinematics and fluid wrenches of all the FMUs
+    private: SingleBodyFluidDynamicsBatch m_batch;
 
-    /// \brief FMU
-    private: FMUSingleBodyFluidDynamicsProperties m_fmu;
+    /// \brief Native models of all the links, the ones simulated by FMUs get a zero wrench
+    private: NativeFluidDynamicsModels m_nativeModels;
+
+    /// \brief Indices in m_fmus of the links simulated by FMUs
+    private: std::vector<size_t> m_fmuIndices;
+
+    /// \brief Number of threads in which the FMUs are stepped, parsed from the threads element
+    private: size_t m_nrOfThreads{1};
+
+    /// \brief Pool of threads stepping the FMUs in parallel
+    private: WorkerPool m_workerPool;
+
+    /// \brief Task of the worker pool, see StepFMU
+    private: std::function<void(size_t)> m_stepFMUTask;
+
+    /// \brief Time and step size of the current physics step, read by StepFMU
+    private: double m_simulatedTimeInSeconds{0.0};
+    private: double m_stepSizeInSeconds{0.0};
 
     /// \brief Connections to events associated with this class.
     private: gazebo::event::ConnectionPtr m_updateConnection;
+
+    /// \brief Scheduler of the world that steps the FMUs, if the FMIScheduler plugin is loaded
+    private: std::shared_ptr<FMUScheduler> m_scheduler;
+
+    /// \brief Identifier of the plugin in m_scheduler
+    private: uint64_t m_schedulerClientId{0};
+
+    /// \brief Options of the real-time budget monitor, parsed from the realtime_budget element
+    private: RealTimeBudgetOptions m_budgetOptions;
+
+    /// \brief Monitor of the time spent in the FMUs with respect to the real-time budget
+    private: RealTimeBudgetMonitor m_budgetMonitor;
+
+    /// \brief Logger of the FMU messages, kept alive to preserve the fmu_log_file setting
+    private: std::shared_ptr<AsyncLogger> m_fmuLogger;
+
+    /// \brief Options of the recorder of FMU inputs and outputs, parsed from the recorder element
+    private: FMURecorderOptions m_recorderOptions;
+
+    /// \brief Recorder of FMU inputs and outputs
+    private: FMURecordingWriter m_recorder;
+
+    /// \brief Options of the replay of FMU outputs, parsed from the replay element
+    private: FMUReplayOptions m_replayOptions;
+
+    /// \brief Replay of FMU outputs, used in place of the FMU if the replay element is present
+    private: FMUReplayer m_replayer;
+
+    /// \brief Options of the determinism digest, parsed from the determinism_digest element
+    private: DeterminismDigestOptions m_digestOptions;
+
+    /// \brief Rolling digest of FMU inputs and outputs
+    private: DeterminismDigest m_digest;
+
+    /// \brief Options of the wind/current field, parsed from the flow_field element
+    private: FlowFieldOptions m_flowFieldOptions;
+
+    /// \brief Wind/current field sampled in the link origins in place of the global wind, shared with the other plugins
+    private: std::shared_ptr<const FlowField> m_flowField;
+
+    /// \brief Number of samples of the flow field in which a link was outside of its grid
+    private: uint64_t m_flowFieldClampedSamples{0};
+
+    /// \brief Options of the streaming of FMU variables, parsed from the variable_streaming element
+    private: FMUVariableStreamingOptions m_streamingOptions;
+
+    /// \brief Streams of FMU variables requested by the clients
+    private: FMUVariableStreamer m_variableStreamer;
+
+    /// \brief Gazebo transport topics of the streams, declared after the streamer that they use
+    private: FMUVariableStreamTopics m_variableStreamTopics;
+
+    /// \brief Options of the real-time mode, parsed from the realtime element
+    private: RealTimeOptions m_realTimeOptions;
+
+    /// \brief Monitor of the real-time constraints of the callback
+    private: RealTimeSafetyMonitor m_realTimeMonitor;
 };
 
 // Register this plugin with the simulator
@@ -30,6 +30,9 @@ class FMISingleBodyFluidDynamicsPluginTest : public gazebo::ServerFixture,
                                 const std::string &worldName,
                                 const PluginTestHelperOptions& options);
 
+  /// \brief Check that each link of a plugin with several links is subject to the force of its own FMU
+  public: void TwoLinksTest(const std::string &_physicsEngine);
+
 };
 
 void FMISingleBodyFluidDynamicsPluginTest::PluginTestHelper(const std::string &_physicsEngine,
@@ -110,12 +113,64 @@ void FMISingleBodyFluidDynamicsPluginTest::PluginTest(const std::string &_physic
   this->PluginTestHelper(_physicsEngine, "test_LinearFriction.world", options);
 }
 
+/////////////////////////////////////////////////////////////////////
+void FMISingleBodyFluidDynamicsPluginTest::TwoLinksTest(const std::string &_physicsEngine)
+{
+  // See PluginTestHelper
+  if (_physicsEngine == "bullet") {
+      return;
+  }
+
+  // Defined by CMake
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddGazeboPaths(CMAKE_CURRENT_BINARY_DIR);
+
+  bool worldPaused = true;
+  Load(CMAKE_CURRENT_SOURCE_DIR"/test_TwoLinks.world", worldPaused, _physicsEngine);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  ASSERT_TRUE(world != NULL);
+
+  auto model = world->ModelByName("floating_cubes");
+  ASSERT_TRUE(model != NULL);
+  auto firstLink = model->GetLink("first_cube");
+  auto secondLink = model->GetLink("second_cube");
+  ASSERT_TRUE(firstLink != NULL && secondLink != NULL);
+
+  // Both cubes start with a velocity of 1 m/s in the x direction
+  double initialVel = 1.0;
+  firstLink->SetLinearVel(ignition::math::Vector3d(initialVel, 0.0, 0.0));
+  secondLink->SetLinearVel(ignition::math::Vector3d(initialVel, 0.0, 0.0));
+
+  int nrOfSteps = 2000;
+  double timestep = 0.001;
+  world->Step(nrOfSteps);
+
+  // The first cube is stopped by the linear friction, as in test_LinearFriction.world
+  double firstPosX = firstLink->WorldPose().Pos()[0];
+  EXPECT_GT(firstPosX, 0.096);
+  EXPECT_LT(firstPosX, 0.1);
+
+  // The second cube is subject to the null friction only, so its velocity remains constant
+  double secondPosX = secondLink->WorldPose().Pos()[0];
+  EXPECT_NEAR(secondPosX, initialVel*nrOfSteps*timestep, timestep*initialVel);
+
+  // Unload the simulation
+  Unload();
+}
+
 /////////////////////////////////////////////////
 TEST_P(FMISingleBodyFluidDynamicsPluginTest, PluginTest)
 {
   PluginTest(GetParam());
 }
 
+/////////////////////////////////////////////////
+TEST_P(FMISingleBodyFluidDynamicsPluginTest, TwoLinksTest)
+{
+  TwoLinksTest(GetParam());
+}
+
 INSTANTIATE_TEST_CASE_P(PhysicsEngines, FMISingleBodyFluidDynamicsPluginTest, PHYSICS_ENGINE_VALUES);
 
 /////////////////////////////////////////////////
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gazebo/physics/physics.hh>
+
+#include <gazebo/test/ServerFixture.hh>
+
+#include <gazebo_fmi/AllocationTracker.hh>
+#include <gazebo_fmi/WorkerPool.hh>
+
+// Steps in which the allocations are not counted, as the first steps can lazily initialize the FMUs and Gazebo
+static const size_t warmupSteps = 100;
+static const size_t trackedSteps = 1000;
+
+class FMIPluginsAllocationTest : public gazebo::ServerFixture
+{
+  public: void AllocationTestHelper(const std::string &worldName);
+};
+
+void FMIPluginsAllocationTest::AllocationTestHelper(const std::string &worldName)
+{
+  // Defined by CMake
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_ACTUATOR_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_SINGLE_BODY_FLUID_DYNAMICS_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddPluginPaths(FMI_SCHEDULER_PLUGIN_BUILD_DIR);
+  gazebo::common::SystemPaths::Instance()->AddGazeboPaths(GAZEBO_FMI_REFERENCE_FMUS_DIR);
+
+  gzdbg << "FMIPluginsAllocationTest: testing world " << worldName << std::endl;
+
+  // The handlers connected before the load are called before the plugins callbacks,
+  // the ones connected after the load are called after them
+  gazebo_fmi::CallbackAllocationProbe probe(warmupSteps);
+  probe.connectBeforeLoad();
+
+  bool worldPaused = true;
+  std::string worldAbsPath = CMAKE_CURRENT_SOURCE_DIR"/" + worldName;
+  Load(worldAbsPath, worldPaused);
+
+  gazebo::physics::WorldPtr world = gazebo::physics::get_world("default");
+  ASSERT_TRUE(world != NULL);
+
+  probe.connectAfterLoad();
+  world->Step(warmupSteps + trackedSteps);
+  probe.disconnect();
+
+  ASSERT_EQ(probe.getTrackedSteps(), trackedSteps);
+  EXPECT_EQ(probe.getAllocations(gazebo_fmi::TrackedCallback::beforePhysicsUpdate), 0u)
+    << "the callbacks of FMIActuatorPlugin allocated up to "
+    << probe.getMaxAllocationsPerStep(gazebo_fmi::TrackedCallback::beforePhysicsUpdate) << " times in a step";
+  EXPECT_EQ(probe.getAllocations(gazebo_fmi::TrackedCallback::worldUpdateBegin), 0u)
+    << "the callbacks of FMISingleBodyFluidDynamicsPlugin allocated up to "
+    << probe.getMaxAllocationsPerStep(gazebo_fmi::TrackedCallback::worldUpdateBegin) << " times in a step";
+
+  // Unload the simulation
+  Unload();
+}
+
+/////////////////////////////////////////////////
+/// The allocations of the unrelated threads, as the Gazebo transport threads, are not counted
+TEST(AllocationTrackerTest, IgnoresOtherThreads)
+{
+  std::atomic<int> stage{0};
+  std::thread worker([&stage]()
+  {
+    while (stage.load() != 1)
+    {
+      std::this_thread::yield();
+    }
+    std::unique_ptr<int> allocated(new int(1));
+    stage.store(2);
+  });
+
+  gazebo_fmi::AllocationTracker::begin();
+  stage.store(1);
+  while (stage.load() != 2)
+  {
+    std::this_thread::yield();
+  }
+  uint64_t allocations = gazebo_fmi::AllocationTracker::end();
+  worker.join();
+
+  EXPECT_EQ(allocations, 0u);
+}
+
+/////////////////////////////////////////////////
+/// The allocations of the WorkerPool threads that run tasks for the tracked thread, as the workers that step the FMUs, are counted
+TEST(AllocationTrackerTest, CountsWorkerPoolThreads)
+{
+  gazebo_fmi::RealTimeSafetyMonitor monitor;
+  gazebo_fmi::WorkerPool pool;
+  ASSERT_TRUE(pool.configure(4, monitor, "AllocationTrackerTest"));
+
+  const size_t nrOfTasks = 64;
+  std::vector<std::unique_ptr<int>> allocated(nrOfTasks);
+  std::function<void(size_t)> task = [&allocated](size_t i) { allocated[i].reset(new int(1)); };
+
+  gazebo_fmi::WorkerThreadStatePropagation propagation(gazebo_fmi::WorkerThreadState{
+    &gazebo_fmi::AllocationTracker::captureTracking, &gazebo_fmi::AllocationTracker::exchangeTracking});
+  gazebo_fmi::AllocationTracker::begin();
+  pool.run(nrOfTasks, task);
+  uint64_t allocations = gazebo_fmi::AllocationTracker::end();
+
+  EXPECT_EQ(allocations, nrOfTasks);
+}
+
+/////////////////////////////////////////////////
+TEST_F(FMIPluginsAllocationTest, NoAllocationInCallbacks)
+{
+  AllocationTestHelper("test_Allocation.world");
+}
+
+/////////////////////////////////////////////////
+TEST_F(FMIPluginsAllocationTest, NoAllocationInCallbacksRealTimeMode)
+{
+  AllocationTestHelper("test_AllocationRealTime.world");
+}
+
+/////////////////////////////////////////////////
+/// With the FMIScheduler plugin the FMUs of both plugins are stepped in its BeforePhysicsUpdate callback,
+/// also in the worker threads of the scheduler, whose allocations are counted as well
+TEST_F(FMIPluginsAllocationTest, NoAllocationInCallbacksScheduler)
+{
+  AllocationTestHelper("test_AllocationScheduler.world");
+}
+
+/////////////////////////////////////////////////
+/// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
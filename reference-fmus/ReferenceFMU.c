@@ -0,0 +1,652 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "ReferenceFMU.h"
+
+#include <string.h>
+
+/* Saved state of an instance, see fmi2GetFMUstate */
+typedef struct ReferenceModelState
+{
+    fmi2Boolean initialized;
+    double time;
+    double* reals;
+    int* integers;
+    double* states;
+    size_t nrOfStates;
+} ReferenceModelState;
+
+void referenceFMULog(const ReferenceModelInstance* instance, fmi2Status status, const char* message)
+{
+    if (!instance || !instance->functions->logger)
+    {
+        return;
+    }
+
+    if (instance->loggingOn || status != fmi2OK)
+    {
+        instance->functions->logger(instance->functions->componentEnvironment, instance->instanceName,
+                                    status, status == fmi2OK ? "logAll" : "logStatusError", "%s", message);
+    }
+}
+
+static void* allocate(const ReferenceModelInstance* instance, size_t nrOfElements, size_t elementSize)
+{
+    /* allocateMemory has calloc semantics, and it may return NULL for zero-size requests */
+    if (nrOfElements == 0)
+    {
+        nrOfElements = 1;
+    }
+    return instance->functions->allocateMemory(nrOfElements, elementSize);
+}
+
+static fmi2Status checkValueReferences(const ReferenceModelInstance* instance, const fmi2ValueReference vr[], size_t nvr, size_t nrOfVariables)
+{
+    size_t i;
+    for (i = 0; i < nvr; i++)
+    {
+        if (vr[i] >= nrOfVariables)
+        {
+            referenceFMULog(instance, fmi2Error, "invalid value reference");
+            return fmi2Error;
+        }
+    }
+    return fmi2OK;
+}
+
+/***************************************************
+ Common functions
+****************************************************/
+
+const char* fmi2GetTypesPlatform(void)
+{
+    return fmi2TypesPlatform;
+}
+
+const char* fmi2GetVersion(void)
+{
+    return fmi2Version;
+}
+
+fmi2Status fmi2SetDebugLogging(fmi2Component c, fmi2Boolean loggingOn, size_t nCategories, const fmi2String categories[])
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    (void)nCategories;
+    (void)categories;
+    instance->loggingOn = loggingOn;
+    return fmi2OK;
+}
+
+fmi2Component fmi2Instantiate(fmi2String instanceName, fmi2Type fmuType, fmi2String fmuGUID,
+                              fmi2String fmuResourceLocation, const fmi2CallbackFunctions* functions,
+                              fmi2Boolean visible, fmi2Boolean loggingOn)
+{
+    ReferenceModelInstance* instance;
+    (void)fmuGUID;
+    (void)fmuResourceLocation;
+    (void)visible;
+
+    if (!functions || !functions->allocateMemory || !functions->freeMemory)
+    {
+        return NULL;
+    }
+
+    if (fmuType != fmi2CoSimulation)
+    {
+        if (functions->logger)
+        {
+            functions->logger(functions->componentEnvironment, instanceName, fmi2Error, "logStatusError",
+                              "the reference FMUs support only Co-Simulation");
+        }
+        return NULL;
+    }
+
+    instance = (ReferenceModelInstance*)functions->allocateMemory(1, sizeof(ReferenceModelInstance));
+    if (!instance)
+    {
+        return NULL;
+    }
+
+    instance->functions = functions;
+    instance->loggingOn = loggingOn;
+    instance->initialized = fmi2False;
+    instance->time = 0.0;
+    instance->states = NULL;
+    instance->nrOfStates = 0;
+
+    instance->instanceName = (char*)allocate(instance, strlen(instanceName ? instanceName : "") + 1, sizeof(char));
+    instance->reals = (double*)allocate(instance, referenceModel.nrOfReals, sizeof(double));
+    instance->integers = (int*)allocate(instance, referenceModel.nrOfIntegers, sizeof(int));
+    if (!instance->instanceName || !instance->reals || !instance->integers)
+    {
+        fmi2FreeInstance(instance);
+        return NULL;
+    }
+
+    strcpy(instance->instanceName, instanceName ? instanceName : "");
+    if (referenceModel.nrOfReals > 0)
+    {
+        memcpy(instance->reals, referenceModel.realStartValues, referenceModel.nrOfReals*sizeof(double));
+    }
+    if (referenceModel.nrOfIntegers > 0)
+    {
+        memcpy(instance->integers, referenceModel.integerStartValues, referenceModel.nrOfIntegers*sizeof(int));
+    }
+
+    return instance;
+}
+
+void fmi2FreeInstance(fmi2Component c)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    fmi2CallbackFreeMemory freeMemory;
+
+    if (!instance)
+    {
+        return;
+    }
+
+    freeMemory = instance->functions->freeMemory;
+    freeMemory(instance->states);
+    freeMemory(instance->integers);
+    freeMemory(instance->reals);
+    freeMemory(instance->instanceName);
+    freeMemory(instance);
+}
+
+fmi2Status fmi2SetupExperiment(fmi2Component c, fmi2Boolean toleranceDefined, fmi2Real tolerance,
+                               fmi2Real startTime, fmi2Boolean stopTimeDefined, fmi2Real stopTime)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    (void)toleranceDefined;
+    (void)tolerance;
+    (void)stopTimeDefined;
+    (void)stopTime;
+    instance->time = startTime;
+    return fmi2OK;
+}
+
+fmi2Status fmi2EnterInitializationMode(fmi2Component c)
+{
+    (void)c;
+    return fmi2OK;
+}
+
+fmi2Status fmi2ExitInitializationMode(fmi2Component c)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+
+    instance->functions->freeMemory(instance->states);
+    instance->nrOfStates = referenceModel.computeNrOfStates ? referenceModel.computeNrOfStates(instance) : 0;
+    instance->states = (double*)allocate(instance, instance->nrOfStates, sizeof(double));
+    if (!instance->states)
+    {
+        referenceFMULog(instance, fmi2Error, "impossible to allocate the states");
+        return fmi2Error;
+    }
+
+    if (referenceModel.initialize)
+    {
+        referenceModel.initialize(instance);
+    }
+
+    instance->initialized = fmi2True;
+    return fmi2OK;
+}
+
+fmi2Status fmi2Terminate(fmi2Component c)
+{
+    (void)c;
+    return fmi2OK;
+}
+
+fmi2Status fmi2Reset(fmi2Component c)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+
+    instance->functions->freeMemory(instance->states);
+    instance->states = NULL;
+    instance->nrOfStates = 0;
+    instance->initialized = fmi2False;
+    instance->time = 0.0;
+    if (referenceModel.nrOfReals > 0)
+    {
+        memcpy(instance->reals, referenceModel.realStartValues, referenceModel.nrOfReals*sizeof(double));
+    }
+    if (referenceModel.nrOfIntegers > 0)
+    {
+        memcpy(instance->integers, referenceModel.integerStartValues, referenceModel.nrOfIntegers*sizeof(int));
+    }
+    return fmi2OK;
+}
+
+fmi2Status fmi2GetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2Real value[])
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    size_t i;
+
+    if (checkValueReferences(instance, vr, nvr, referenceModel.nrOfReals) != fmi2OK)
+    {
+        return fmi2Error;
+    }
+
+    for (i = 0; i < nvr; i++)
+    {
+        value[i] = instance->reals[vr[i]];
+    }
+    return fmi2OK;
+}
+
+fmi2Status fmi2GetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2Integer value[])
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    size_t i;
+
+    if (checkValueReferences(instance, vr, nvr, referenceModel.nrOfIntegers) != fmi2OK)
+    {
+        return fmi2Error;
+    }
+
+    for (i = 0; i < nvr; i++)
+    {
+        value[i] = instance->integers[vr[i]];
+    }
+    return fmi2OK;
+}
+
+fmi2Status fmi2GetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2Boolean value[])
+{
+    (void)value;
+    return checkValueReferences((ReferenceModelInstance*)c, vr, nvr, 0);
+}
+
+fmi2Status fmi2GetString(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2String value[])
+{
+    (void)value;
+    return checkValueReferences((ReferenceModelInstance*)c, vr, nvr, 0);
+}
+
+fmi2Status fmi2SetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2Real value[])
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    size_t i;
+
+    if (checkValueReferences(instance, vr, nvr, referenceModel.nrOfReals) != fmi2OK)
+    {
+        return fmi2Error;
+    }
+
+    for (i = 0; i < nvr; i++)
+    {
+        instance->reals[vr[i]] = value[i];
+    }
+    return fmi2OK;
+}
+
+fmi2Status fmi2SetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2Integer value[])
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    size_t i;
+
+    if (checkValueReferences(instance, vr, nvr, referenceModel.nrOfIntegers) != fmi2OK)
+    {
+        return fmi2Error;
+    }
+
+    /* The Integer variables are structural parameters, that can not be changed after the initialization */
+    if (instance->initialized && nvr > 0)
+    {
+        referenceFMULog(instance, fmi2Error, "Integer parameters can not be changed after the initialization");
+        return fmi2Error;
+    }
+
+    for (i = 0; i < nvr; i++)
+    {
+        instance->integers[vr[i]] = value[i];
+    }
+    return fmi2OK;
+}
+
+fmi2Status fmi2SetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2Boolean value[])
+{
+    (void)value;
+    return checkValueReferences((ReferenceModelInstance*)c, vr, nvr, 0);
+}
+
+fmi2Status fmi2SetString(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2String value[])
+{
+    (void)value;
+    return checkValueReferences((ReferenceModelInstance*)c, vr, nvr, 0);
+}
+
+/***************************************************
+ FMU state
+****************************************************/
+
+static void freeState(const ReferenceModelInstance* instance, ReferenceModelState* state)
+{
+    if (!state)
+    {
+        return;
+    }
+    instance->functions->freeMemory(state->states);
+    instance->functions->freeMemory(state->integers);
+    instance->functions->freeMemory(state->reals);
+    instance->functions->freeMemory(state);
+}
+
+static ReferenceModelState* allocateState(const ReferenceModelInstance* instance, size_t nrOfStates)
+{
+    ReferenceModelState* state = (ReferenceModelState*)allocate(instance, 1, sizeof(ReferenceModelState));
+    if (!state)
+    {
+        return NULL;
+    }
+
+    state->nrOfStates = nrOfStates;
+    state->reals = (double*)allocate(instance, referenceModel.nrOfReals, sizeof(double));
+    state->integers = (int*)allocate(instance, referenceModel.nrOfIntegers, sizeof(int));
+    state->states = (double*)allocate(instance, nrOfStates, sizeof(double));
+    if (!state->reals || !state->integers || !state->states)
+    {
+        freeState(instance, state);
+        return NULL;
+    }
+    return state;
+}
+
+fmi2Status fmi2GetFMUstate(fmi2Component c, fmi2FMUstate* FMUstate)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    ReferenceModelState* state = (ReferenceModelState*)*FMUstate;
+
+    /* Reuse the memory of a previous state if possible, so that repeated calls do not allocate */
+    if (state && state->nrOfStates != instance->nrOfStates)
+    {
+        freeState(instance, state);
+        state = NULL;
+    }
+    if (!state)
+    {
+        state = allocateState(instance, instance->nrOfStates);
+        if (!state)
+        {
+            referenceFMULog(instance, fmi2Error, "impossible to allocate the FMU state");
+            return fmi2Error;
+        }
+    }
+
+    state->initialized = instance->initialized;
+    state->time = instance->time;
+    memcpy(state->reals, instance->reals, referenceModel.nrOfReals*sizeof(double));
+    memcpy(state->integers, instance->integers, referenceModel.nrOfIntegers*sizeof(int));
+    memcpy(state->states, instance->states, instance->nrOfStates*sizeof(double));
+
+    *FMUstate = state;
+    return fmi2OK;
+}
+
+fmi2Status fmi2SetFMUstate(fmi2Component c, fmi2FMUstate FMUstate)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    const ReferenceModelState* state = (const ReferenceModelState*)FMUstate;
+
+    if (!state)
+    {
+        return fmi2Error;
+    }
+
+    if (state->nrOfStates != instance->nrOfStates)
+    {
+        double* states = (double*)allocate(instance, state->nrOfStates, sizeof(double));
+        if (!states)
+        {
+            referenceFMULog(instance, fmi2Error, "impossible to allocate the states");
+            return fmi2Error;
+        }
+        instance->functions->freeMemory(instance->states);
+        instance->states = states;
+        instance->nrOfStates = state->nrOfStates;
+    }
+
+    instance->initialized = state->initialized;
+    instance->time = state->time;
+    memcpy(instance->reals, state->reals, referenceModel.nrOfReals*sizeof(double));
+    memcpy(instance->integers, state->integers, referenceModel.nrOfIntegers*sizeof(int));
+    memcpy(instance->states, state->states, state->nrOfStates*sizeof(double));
+    return fmi2OK;
+}
+
+fmi2Status fmi2FreeFMUstate(fmi2Component c, fmi2FMUstate* FMUstate)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    if (FMUstate)
+    {
+        freeState(instance, (ReferenceModelState*)*FMUstate);
+        *FMUstate = NULL;
+    }
+    return fmi2OK;
+}
+
+/* The serialized state is: initialized, time, nrOfStates, reals, integers, states */
+static size_t serializedSize(size_t nrOfStates)
+{
+    return sizeof(fmi2Boolean) + sizeof(double) + sizeof(size_t) +
+           referenceModel.nrOfReals*sizeof(double) + referenceModel.nrOfIntegers*sizeof(int) + nrOfStates*sizeof(double);
+}
+
+fmi2Status fmi2SerializedFMUstateSize(fmi2Component c, fmi2FMUstate FMUstate, size_t* size)
+{
+    const ReferenceModelState* state = (const ReferenceModelState*)FMUstate;
+    (void)c;
+    *size = serializedSize(state->nrOfStates);
+    return fmi2OK;
+}
+
+fmi2Status fmi2SerializeFMUstate(fmi2Component c, fmi2FMUstate FMUstate, fmi2Byte serializedState[], size_t size)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    const ReferenceModelState* state = (const ReferenceModelState*)FMUstate;
+    fmi2Byte* position = serializedState;
+
+    if (size < serializedSize(state->nrOfStates))
+    {
+        referenceFMULog(instance, fmi2Error, "buffer too small to serialize the FMU state");
+        return fmi2Error;
+    }
+
+    memcpy(position, &state->initialized, sizeof(fmi2Boolean));
+    position += sizeof(fmi2Boolean);
+    memcpy(position, &state->time, sizeof(double));
+    position += sizeof(double);
+    memcpy(position, &state->nrOfStates, sizeof(size_t));
+    position += sizeof(size_t);
+    memcpy(position, state->reals, referenceModel.nrOfReals*sizeof(double));
+    position += referenceModel.nrOfReals*sizeof(double);
+    memcpy(position, state->integers, referenceModel.nrOfIntegers*sizeof(int));
+    position += referenceModel.nrOfIntegers*sizeof(int);
+    memcpy(position, state->states, state->nrOfStates*sizeof(double));
+    return fmi2OK;
+}
+
+fmi2Status fmi2DeSerializeFMUstate(fmi2Component c, const fmi2Byte serializedState[], size_t size, fmi2FMUstate* FMUstate)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    const fmi2Byte* position = serializedState;
+    ReferenceModelState* state;
+    fmi2Boolean initialized;
+    double time;
+    size_t nrOfStates;
+
+    if (size < serializedSize(0))
+    {
+        referenceFMULog(instance, fmi2Error, "serialized FMU state too small");
+        return fmi2Error;
+    }
+
+    memcpy(&initialized, position, sizeof(fmi2Boolean));
+    position += sizeof(fmi2Boolean);
+    memcpy(&time, position, sizeof(double));
+    position += sizeof(double);
+    memcpy(&nrOfStates, position, sizeof(size_t));
+    position += sizeof(size_t);
+
+    if (size != serializedSize(nrOfStates))
+    {
+        referenceFMULog(instance, fmi2Error, "serialized FMU state has the wrong size");
+        return fmi2Error;
+    }
+
+    state = allocateState(instance, nrOfStates);
+    if (!state)
+    {
+        referenceFMULog(instance, fmi2Error, "impossible to allocate the FMU state");
+        return fmi2Error;
+    }
+
+    state->initialized = initialized;
+    state->time = time;
+    memcpy(state->reals, position, referenceModel.nrOfReals*sizeof(double));
+    position += referenceModel.nrOfReals*sizeof(double);
+    memcpy(state->integers, position, referenceModel.nrOfIntegers*sizeof(int));
+    position += referenceModel.nrOfIntegers*sizeof(int);
+    memcpy(state->states, position, nrOfStates*sizeof(double));
+
+    *FMUstate = state;
+    return fmi2OK;
+}
+
+fmi2Status fmi2GetDirectionalDerivative(fmi2Component c, const fmi2ValueReference vUnknown_ref[], size_t nUnknown,
+                                        const fmi2ValueReference vKnown_ref[], size_t nKnown,
+                                        const fmi2Real dvKnown[], fmi2Real dvUnknown[])
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    size_t i, j;
+
+    if (checkValueReferences(instance, vUnknown_ref, nUnknown, referenceModel.nrOfReals) != fmi2OK ||
+        checkValueReferences(instance, vKnown_ref, nKnown, referenceModel.nrOfReals) != fmi2OK)
+    {
+        return fmi2Error;
+    }
+
+    for (i = 0; i < nUnknown; i++)
+    {
+        dvUnknown[i] = 0.0;
+        if (!referenceModel.directionalDerivative)
+        {
+            continue;
+        }
+        for (j = 0; j < nKnown; j++)
+        {
+            dvUnknown[i] += referenceModel.directionalDerivative(instance, vUnknown_ref[i], vKnown_ref[j])*dvKnown[j];
+        }
+    }
+    return fmi2OK;
+}
+
+/***************************************************
+ Co-Simulation functions
+****************************************************/
+
+fmi2Status fmi2SetRealInputDerivatives(fmi2Component c, const fmi2ValueReference vr[], size_t nvr,
+                                       const fmi2Integer order[], const fmi2Real value[])
+{
+    (void)vr;
+    (void)nvr;
+    (void)order;
+    (void)value;
+    referenceFMULog((ReferenceModelInstance*)c, fmi2Error, "input derivatives are not supported");
+    return fmi2Error;
+}
+
+fmi2Status fmi2GetRealOutputDerivatives(fmi2Component c, const fmi2ValueReference vr[], size_t nvr,
+                                        const fmi2Integer order[], fmi2Real value[])
+{
+    (void)vr;
+    (void)nvr;
+    (void)order;
+    (void)value;
+    referenceFMULog((ReferenceModelInstance*)c, fmi2Error, "output derivatives are not supported");
+    return fmi2Error;
+}
+
+fmi2Status fmi2DoStep(fmi2Component c, fmi2Real currentCommunicationPoint, fmi2Real communicationStepSize,
+                      fmi2Boolean noSetFMUStatePriorToCurrentPoint)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    fmi2Status status;
+    (void)noSetFMUStatePriorToCurrentPoint;
+
+    if (!instance->initialized)
+    {
+        referenceFMULog(instance, fmi2Error, "fmi2DoStep called before the end of the initialization");
+        return fmi2Error;
+    }
+
+    if (communicationStepSize < 0.0)
+    {
+        referenceFMULog(instance, fmi2Error, "negative communication step size");
+        return fmi2Error;
+    }
+
+    instance->time = currentCommunicationPoint;
+    status = referenceModel.doStep(instance, communicationStepSize);
+    instance->time = currentCommunicationPoint + communicationStepSize;
+    return status;
+}
+
+fmi2Status fmi2CancelStep(fmi2Component c)
+{
+    (void)c;
+    return fmi2Error;
+}
+
+fmi2Status fmi2GetStatus(fmi2Component c, const fmi2StatusKind s, fmi2Status* value)
+{
+    (void)c;
+    (void)s;
+    (void)value;
+    return fmi2Discard;
+}
+
+fmi2Status fmi2GetRealStatus(fmi2Component c, const fmi2StatusKind s, fmi2Real* value)
+{
+    ReferenceModelInstance* instance = (ReferenceModelInstance*)c;
+    if (s == fmi2LastSuccessfulTime)
+    {
+        *value = instance->time;
+        return fmi2OK;
+    }
+    return fmi2Discard;
+}
+
+fmi2Status fmi2GetIntegerStatus(fmi2Component c, const fmi2StatusKind s, fmi2Integer* value)
+{
+    (void)c;
+    (void)s;
+    (void)value;
+    return fmi2Discard;
+}
+
+fmi2Status fmi2GetBooleanStatus(fmi2Component c, const fmi2StatusKind s, fmi2Boolean* value)
+{
+    (void)c;
+    (void)s;
+    (void)value;
+    return fmi2Discard;
+}
+
+fmi2Status fmi2GetStringStatus(fmi2Component c, const fmi2StatusKind s, fmi2String* value)
+{
+    (void)c;
+    (void)s;
+    (void)value;
+    return fmi2Discard;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef GAZEBO_FMI_REFERENCE_FMU_H
+#define GAZEBO_FMI_REFERENCE_FMU_H
+
+/*
+ * Minimal implementation of the FMI 2.0 for Co-Simulation API, shared by all the reference FMUs.
+ *
+ * Each reference model is a C file that defines the referenceModel variable, describing its variables
+ * and implementing its dynamics, and that is compiled together with ReferenceFMU.c in a FMU by the
+ * add_reference_fmu CMake function. The value references of the Real (Integer) variables are the
+ * indices in the reals (integers) array of the instance, and the order of the variables in
+ * the modelDescription.xml template of the model must be coherent with them.
+ *
+ * Besides the Real and Integer variables, a model can have an arbitrary number of continuous states,
+ * allocated when the instance exits the initialization mode. The whole instance state (time, variables
+ * and states) can be saved, restored and serialized through the fmi2GetFMUstate family of functions.
+ */
+
+#include <stddef.h>
+
+#include <FMI2/fmi2Functions.h>
+
+typedef struct ReferenceModelInstance
+{
+    /* Callbacks passed to fmi2Instantiate, that must be valid until fmi2FreeInstance */
+    const fmi2CallbackFunctions* functions;
+    char* instanceName;
+    fmi2Boolean loggingOn;
+
+    /* True after fmi2ExitInitializationMode */
+    fmi2Boolean initialized;
+
+    double time;
+
+    double* reals;
+    int* integers;
+
+    double* states;
+    size_t nrOfStates;
+} ReferenceModelInstance;
+
+typedef struct ReferenceModel
+{
+    /* Number of Real variables, with value references 0 ... nrOfReals-1 */
+    size_t nrOfReals;
+
+    /* Start values of the Real variables */
+    const double* realStartValues;
+
+    /* Number of Integer variables, with value references 0 ... nrOfIntegers-1 */
+    size_t nrOfIntegers;
+
+    /* Start values of the Integer variables */
+    const int* integerStartValues;
+
+    /* Number of continuous states, computed from the parameters when the instance exits the initialization mode */
+    size_t (*computeNrOfStates)(const ReferenceModelInstance* instance);
+
+    /* Initialize the states and the outputs, called when the instance exits the initialization mode (can be NULL) */
+    void (*initialize)(ReferenceModelInstance* instance);
+
+    /* Integrate the model from instance->time to instance->time+stepSize, and update the outputs.
+       Returns fmi2OK on success. */
+    fmi2Status (*doStep)(ReferenceModelInstance* instance, double stepSize);
+
+    /* Partial derivative of the Real output of value reference output with respect to
+       the Real input of value reference input at the current communication point (can be NULL
+       if the model has no direct feedthrough, in which case the derivatives are zero) */
+    double (*directionalDerivative)(const ReferenceModelInstance* instance, fmi2ValueReference output, fmi2ValueReference input);
+} ReferenceModel;
+
+/* Description of the model compiled in the FMU, defined by the model file */
+extern const ReferenceModel referenceModel;
+
+/* Log a message through the logger callback of the instance, if logging is on or if the status is not fmi2OK */
+void referenceFMULog(const ReferenceModelInstance* instance, fmi2Status status, const char* message);
+
+#endif
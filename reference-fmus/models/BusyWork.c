@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Actuator with a tunable computational cost, to stress-test the plugins.
+ *
+ * The model has nrOfStates parallel first order lags, with time constants
+ * timeConstant*(i+1)/nrOfStates, driven by actuatorInput, and jointTorque is their mean.
+ * Each step is integrated with iterationsPerStep substeps, so the cost of a step is
+ * proportional to nrOfStates*iterationsPerStep, and the size of the FMU state
+ * (see fmi2GetFMUstate) is proportional to nrOfStates.
+ */
+
+#include "ReferenceFMU.h"
+
+#include <math.h>
+
+#ifndef BUSY_WORK_NR_OF_STATES
+#define BUSY_WORK_NR_OF_STATES 8
+#endif
+
+#ifndef BUSY_WORK_ITERATIONS_PER_STEP
+#define BUSY_WORK_ITERATIONS_PER_STEP 10
+#endif
+
+#ifndef BUSY_WORK_TIME_CONSTANT
+#define BUSY_WORK_TIME_CONSTANT 0.01
+#endif
+
+enum
+{
+    actuatorInput = 0,
+    jointPosition,
+    jointVelocity,
+    jointAcceleration,
+    jointTorque,
+    timeConstant,
+    nrOfReals
+};
+
+enum
+{
+    nrOfStates = 0,
+    iterationsPerStep,
+    nrOfIntegers
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0, BUSY_WORK_TIME_CONSTANT};
+static const int integerStartValues[nrOfIntegers] = {BUSY_WORK_NR_OF_STATES, BUSY_WORK_ITERATIONS_PER_STEP};
+
+static size_t computeNrOfStates(const ReferenceModelInstance* instance)
+{
+    return instance->integers[nrOfStates] > 0 ? (size_t)instance->integers[nrOfStates] : 1;
+}
+
+static void initialize(ReferenceModelInstance* instance)
+{
+    size_t i;
+    for (i = 0; i < instance->nrOfStates; i++)
+    {
+        instance->states[i] = 0.0;
+    }
+    instance->reals[jointTorque] = 0.0;
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    const size_t n = instance->nrOfStates;
+    const int iterations = instance->integers[iterationsPerStep] > 0 ? instance->integers[iterationsPerStep] : 1;
+    const double dt = stepSize/iterations;
+    const double u = instance->reals[actuatorInput];
+    double sum = 0.0;
+    size_t i;
+    int k;
+
+    for (k = 0; k < iterations; k++)
+    {
+        for (i = 0; i < n; i++)
+        {
+            const double tau = instance->reals[timeConstant]*(double)(i + 1)/(double)n;
+            const double alpha = (tau > 0.0) ? 1.0 - exp(-dt/tau) : 1.0;
+            instance->states[i] += alpha*(u - instance->states[i]);
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        sum += instance->states[i];
+    }
+    instance->reals[jointTorque] = sum/(double)n;
+    return fmi2OK;
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    nrOfIntegers, integerStartValues,
+    computeNrOfStates,
+    initialize,
+    doStep,
+    NULL
+};
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Actuator whose torque follows the input with a first order lag:
+ *   timeConstant*d(jointTorque)/dt = actuatorInput - jointTorque
+ * integrated exactly for a constant input over the step.
+ */
+
+#include "ReferenceFMU.h"
+
+#include <math.h>
+
+#ifndef FIRST_ORDER_LAG_TIME_CONSTANT
+#define FIRST_ORDER_LAG_TIME_CONSTANT 0.01
+#endif
+
+enum
+{
+    actuatorInput = 0,
+    jointPosition,
+    jointVelocity,
+    jointAcceleration,
+    jointTorque,
+    timeConstant,
+    nrOfReals
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0, FIRST_ORDER_LAG_TIME_CONSTANT};
+
+static size_t computeNrOfStates(const ReferenceModelInstance* instance)
+{
+    (void)instance;
+    return 1;
+}
+
+static void initialize(ReferenceModelInstance* instance)
+{
+    instance->states[0] = 0.0;
+    instance->reals[jointTorque] = instance->states[0];
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    const double T = instance->reals[timeConstant];
+    const double alpha = (T > 0.0) ? 1.0 - exp(-stepSize/T) : 1.0;
+    instance->states[0] += alpha*(instance->reals[actuatorInput] - instance->states[0]);
+    instance->reals[jointTorque] = instance->states[0];
+    return fmi2OK;
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    0, NULL,
+    computeNrOfStates,
+    initialize,
+    doStep,
+    NULL
+};
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Actuator whose torque is the input delayed by a fixed time:
+ *   jointTorque(t) = actuatorInput(t - delay)
+ * and zero before the delay is elapsed. The inputs are stored in a ring buffer of
+ * bufferSize samples, that needs to be larger than delay/stepSize.
+ */
+
+#include "ReferenceFMU.h"
+
+#ifndef FIXED_DELAY_DELAY
+#define FIXED_DELAY_DELAY 0.01
+#endif
+
+#ifndef FIXED_DELAY_BUFFER_SIZE
+#define FIXED_DELAY_BUFFER_SIZE 1024
+#endif
+
+enum
+{
+    actuatorInput = 0,
+    jointPosition,
+    jointVelocity,
+    jointAcceleration,
+    jointTorque,
+    delay,
+    nrOfReals
+};
+
+enum
+{
+    bufferSize = 0,
+    nrOfIntegers
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0, FIXED_DELAY_DELAY};
+static const int integerStartValues[nrOfIntegers] = {FIXED_DELAY_BUFFER_SIZE};
+
+/* The states are: the index of the next sample, the number of stored samples, a flag set
+   when the buffer is too small, and the ring buffers of the times and of the values of the samples */
+static size_t computeNrOfStates(const ReferenceModelInstance* instance)
+{
+    const int size = instance->integers[bufferSize] > 0 ? instance->integers[bufferSize] : 1;
+    return 3 + 2*(size_t)size;
+}
+
+static void initialize(ReferenceModelInstance* instance)
+{
+    instance->states[0] = 0.0;
+    instance->states[1] = 0.0;
+    instance->states[2] = 0.0;
+    instance->reals[jointTorque] = 0.0;
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    const size_t size = (instance->nrOfStates - 3)/2;
+    double* times = instance->states + 3;
+    double* values = times + size;
+    size_t next = (size_t)instance->states[0];
+    size_t count = (size_t)instance->states[1];
+    const double outputTime = instance->time + stepSize - instance->reals[delay];
+    size_t i;
+
+    times[next] = instance->time;
+    values[next] = instance->reals[actuatorInput];
+    next = (next + 1) % size;
+    if (count < size)
+    {
+        count++;
+    }
+
+    /* Zero-order hold of the newest sample not newer than outputTime */
+    instance->reals[jointTorque] = 0.0;
+    for (i = 1; i <= count; i++)
+    {
+        const size_t sample = (next + size - i) % size;
+        if (times[sample] <= outputTime + 1e-9*stepSize)
+        {
+            instance->reals[jointTorque] = values[sample];
+            break;
+        }
+    }
+
+    if (count == size && times[next] > outputTime && instance->states[2] == 0.0)
+    {
+        referenceFMULog(instance, fmi2Warning, "the delay is longer than the buffer, increase bufferSize");
+        instance->states[2] = 1.0;
+    }
+
+    instance->states[0] = (double)next;
+    instance->states[1] = (double)count;
+    return fmi2OK;
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    nrOfIntegers, integerStartValues,
+    computeNrOfStates,
+    initialize,
+    doStep,
+    NULL
+};
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Actuator with no dynamics: jointTorque = gain*actuatorInput
+ */
+
+#include "ReferenceFMU.h"
+
+#ifndef IDENTITY_GAIN
+#define IDENTITY_GAIN 1.0
+#endif
+
+enum
+{
+    actuatorInput = 0,
+    jointPosition,
+    jointVelocity,
+    jointAcceleration,
+    jointTorque,
+    gain,
+    nrOfReals
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0, IDENTITY_GAIN};
+
+static void initialize(ReferenceModelInstance* instance)
+{
+    instance->reals[jointTorque] = instance->reals[gain]*instance->reals[actuatorInput];
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    (void)stepSize;
+    instance->reals[jointTorque] = instance->reals[gain]*instance->reals[actuatorInput];
+    return fmi2OK;
+}
+
+static double directionalDerivative(const ReferenceModelInstance* instance, fmi2ValueReference output, fmi2ValueReference input)
+{
+    return (output == jointTorque && input == actuatorInput) ? instance->reals[gain] : 0.0;
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    0, NULL,
+    NULL,
+    initialize,
+    doStep,
+    directionalDerivative
+};
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Single body fluid dynamics with a quadratic drag:
+ *   fluidDynamicForce = -0.5*density*dragCoefficient*area*|relativeVelocity|*relativeVelocity
+ * and no moment.
+ */
+
+#include "ReferenceFMU.h"
+
+#include <math.h>
+
+#ifndef QUADRATIC_DRAG_DENSITY
+#define QUADRATIC_DRAG_DENSITY 1000.0
+#endif
+
+#ifndef QUADRATIC_DRAG_DRAG_COEFFICIENT
+#define QUADRATIC_DRAG_DRAG_COEFFICIENT 1.0
+#endif
+
+#ifndef QUADRATIC_DRAG_AREA
+#define QUADRATIC_DRAG_AREA 0.01
+#endif
+
+enum
+{
+    relativeVelocity_x = 0,
+    relativeVelocity_y,
+    relativeVelocity_z,
+    fluidDynamicForce_x,
+    fluidDynamicForce_y,
+    fluidDynamicForce_z,
+    fluidDynamicMoment_x,
+    fluidDynamicMoment_y,
+    fluidDynamicMoment_z,
+    density,
+    dragCoefficient,
+    area,
+    nrOfReals
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+                                                  QUADRATIC_DRAG_DENSITY, QUADRATIC_DRAG_DRAG_COEFFICIENT, QUADRATIC_DRAG_AREA};
+
+static double gain(const ReferenceModelInstance* instance)
+{
+    return 0.5*instance->reals[density]*instance->reals[dragCoefficient]*instance->reals[area];
+}
+
+static double speed(const ReferenceModelInstance* instance)
+{
+    const double* v = instance->reals + relativeVelocity_x;
+    return sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+}
+
+static void computeOutputs(ReferenceModelInstance* instance)
+{
+    const double k = gain(instance)*speed(instance);
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        instance->reals[fluidDynamicForce_x + i] = -k*instance->reals[relativeVelocity_x + i];
+        instance->reals[fluidDynamicMoment_x + i] = 0.0;
+    }
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    (void)stepSize;
+    computeOutputs(instance);
+    return fmi2OK;
+}
+
+/* d(force_i)/d(v_j) = -gain*(|v|*delta_ij + v_i*v_j/|v|) */
+static double directionalDerivative(const ReferenceModelInstance* instance, fmi2ValueReference output, fmi2ValueReference input)
+{
+    const double norm = speed(instance);
+    double derivative;
+
+    if (output < fluidDynamicForce_x || output > fluidDynamicForce_z || input > relativeVelocity_z)
+    {
+        return 0.0;
+    }
+
+    derivative = (output - fluidDynamicForce_x == input) ? norm : 0.0;
+    if (norm > 0.0)
+    {
+        derivative += instance->reals[output - fluidDynamicForce_x]*instance->reals[input]/norm;
+    }
+    return -gain(instance)*derivative;
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    0, NULL,
+    NULL,
+    computeOutputs,
+    doStep,
+    directionalDerivative
+};
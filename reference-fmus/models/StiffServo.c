@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Stiff position servo, that drives the joint to the position given by the input:
+ *   jointTorque = stiffness*(actuatorInput - jointPosition) - damping*jointVelocity
+ * With the default parameters, its coupling with the joint is unstable for a pendulum
+ * simulated with an explicit coupling and a physics step of a few milliseconds.
+ */
+
+#include "ReferenceFMU.h"
+
+#ifndef STIFF_SERVO_STIFFNESS
+#define STIFF_SERVO_STIFFNESS 100000.0
+#endif
+
+#ifndef STIFF_SERVO_DAMPING
+#define STIFF_SERVO_DAMPING 100.0
+#endif
+
+enum
+{
+    actuatorInput = 0,
+    jointPosition,
+    jointVelocity,
+    jointAcceleration,
+    jointTorque,
+    stiffness,
+    damping,
+    nrOfReals
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0, STIFF_SERVO_STIFFNESS, STIFF_SERVO_DAMPING};
+
+static void computeTorque(ReferenceModelInstance* instance)
+{
+    double* r = instance->reals;
+    r[jointTorque] = r[stiffness]*(r[actuatorInput] - r[jointPosition]) - r[damping]*r[jointVelocity];
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    (void)stepSize;
+    computeTorque(instance);
+    return fmi2OK;
+}
+
+static double directionalDerivative(const ReferenceModelInstance* instance, fmi2ValueReference output, fmi2ValueReference input)
+{
+    if (output != jointTorque)
+    {
+        return 0.0;
+    }
+
+    switch (input)
+    {
+        case actuatorInput:
+            return instance->reals[stiffness];
+        case jointPosition:
+            return -instance->reals[stiffness];
+        case jointVelocity:
+            return -instance->reals[damping];
+        default:
+            return 0.0;
+    }
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    0, NULL,
+    NULL,
+    computeTorque,
+    doStep,
+    directionalDerivative
+};
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+/*
+ * Position servo of two joints, with the variables of a multi-joint actuator as elements of arrays of two elements:
+ *   jointTorque[i] = stiffness*(actuatorInput[i] - jointPosition[i]) - damping*jointVelocity[i]
+ * The variables of the i-th joint have consecutive value references, starting from (i-1)*nrOfJointVariables.
+ */
+
+#include "ReferenceFMU.h"
+
+#ifndef TWO_JOINT_PD_STIFFNESS
+#define TWO_JOINT_PD_STIFFNESS 100.0
+#endif
+
+#ifndef TWO_JOINT_PD_DAMPING
+#define TWO_JOINT_PD_DAMPING 1.0
+#endif
+
+#define TWO_JOINT_PD_NR_OF_JOINTS 2
+
+enum
+{
+    actuatorInput = 0,
+    jointPosition,
+    jointVelocity,
+    jointAcceleration,
+    jointTorque,
+    nrOfJointVariables
+};
+
+enum
+{
+    stiffness = TWO_JOINT_PD_NR_OF_JOINTS*nrOfJointVariables,
+    damping,
+    nrOfReals
+};
+
+static const double realStartValues[nrOfReals] = {0.0, 0.0, 0.0, 0.0, 0.0,
+                                                  0.0, 0.0, 0.0, 0.0, 0.0,
+                                                  TWO_JOINT_PD_STIFFNESS, TWO_JOINT_PD_DAMPING};
+
+static void computeTorques(ReferenceModelInstance* instance)
+{
+    double* r = instance->reals;
+    for (size_t i=0; i < TWO_JOINT_PD_NR_OF_JOINTS; i++)
+    {
+        double* joint = r + i*nrOfJointVariables;
+        joint[jointTorque] = r[stiffness]*(joint[actuatorInput] - joint[jointPosition]) - r[damping]*joint[jointVelocity];
+    }
+}
+
+static fmi2Status doStep(ReferenceModelInstance* instance, double stepSize)
+{
+    (void)stepSize;
+    computeTorques(instance);
+    return fmi2OK;
+}
+
+static double directionalDerivative(const ReferenceModelInstance* instance, fmi2ValueReference output, fmi2ValueReference input)
+{
+    /* The torque of a joint depends only on the inputs of the same joint */
+    if (output >= stiffness || output % nrOfJointVariables != jointTorque ||
+        input/nrOfJointVariables != output/nrOfJointVariables)
+    {
+        return 0.0;
+    }
+
+    switch (input % nrOfJointVariables)
+    {
+        case actuatorInput:
+            return instance->reals[stiffness];
+        case jointPosition:
+            return -instance->reals[stiffness];
+        case jointVelocity:
+            return -instance->reals[damping];
+        default:
+            return 0.0;
+    }
+}
+
+const ReferenceModel referenceModel = {
+    nrOfReals, realStartValues,
+    0, NULL,
+    NULL,
+    computeTorques,
+    doStep,
+    directionalDerivative
+};
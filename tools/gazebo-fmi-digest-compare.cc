@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/DeterminismDigest.hh>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// Compare two determinism digest files written by the gazebo-fmi plugins (see the determinism_digest SDF element),
+/// and print the range of steps containing the first divergent step and the FMUs that diverged in it.
+/// The exit code is 0 if the files match, 1 if they diverge and 2 in case of errors.
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: gazebo-fmi-digest-compare <digest file A> <digest file B>" << std::endl;
+        return 2;
+    }
+
+    std::string ownerA, ownerB;
+    std::vector<std::string> fmuNamesA, fmuNamesB;
+    std::vector<gazebo_fmi::DeterminismCheckpoint> checkpointsA, checkpointsB;
+    if (!gazebo_fmi::readDeterminismDigestFile(argv[1], ownerA, fmuNamesA, checkpointsA) ||
+        !gazebo_fmi::readDeterminismDigestFile(argv[2], ownerB, fmuNamesB, checkpointsB))
+    {
+        return 2;
+    }
+
+    if (fmuNamesA != fmuNamesB)
+    {
+        std::cerr << "gazebo-fmi-digest-compare: the two files contain different FMUs." << std::endl;
+        return 2;
+    }
+
+    uint64_t lastMatchingStep = 0;
+    const size_t nrOfCheckpoints = std::min(checkpointsA.size(), checkpointsB.size());
+    for (size_t i=0; i < nrOfCheckpoints; i++)
+    {
+        const gazebo_fmi::DeterminismCheckpoint& a = checkpointsA[i];
+        const gazebo_fmi::DeterminismCheckpoint& b = checkpointsB[i];
+
+        if (a.step != b.step)
+        {
+            std::cerr << "gazebo-fmi-digest-compare: the two files have checkpoints at different steps ("
+                      << a.step << " and " << b.step << "), use the same checkpoint_period." << std::endl;
+            return 2;
+        }
+
+        if (a.digest == b.digest)
+        {
+            lastMatchingStep = a.step;
+            continue;
+        }
+
+        std::cout << "First divergence between step " << lastMatchingStep+1 << " and step " << a.step
+                  << " (time " << a.simulatedTimeInSeconds << " in " << argv[1] << ", "
+                  << b.simulatedTimeInSeconds << " in " << argv[2] << ")." << std::endl;
+
+        bool divergentFMUs = false;
+        for (size_t fmu=0; fmu < fmuNamesA.size(); fmu++)
+        {
+            if (a.fmuDigests[fmu] != b.fmuDigests[fmu])
+            {
+                std::cout << "  Divergent FMU: " << fmuNamesA[fmu] << std::endl;
+                divergentFMUs = true;
+            }
+        }
+        if (!divergentFMUs)
+        {
+            std::cout << "  The FMU inputs and outputs match, only the simulated time diverged." << std::endl;
+        }
+        return 1;
+    }
+
+    if (checkpointsA.size() != checkpointsB.size())
+    {
+        std::cout << "The digests match up to step " << lastMatchingStep
+                  << ", but one of the runs is longer than the other." << std::endl;
+        return 1;
+    }
+
+    std::cout << "The digests match for all the " << lastMatchingStep << " steps." << std::endl;
+    return EXIT_SUCCESS;
+}
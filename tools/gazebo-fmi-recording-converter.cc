@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2018 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include <gazebo_fmi/FMURecording.hh>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef GAZEBO_FMI_HAS_MATIO
+#include <matio.h>
+#endif
+
+/// Convert a FMU recording written by the gazebo-fmi plugins (see the recorder SDF element)
+/// to a CSV file (one column for the time, one for each channel) or to a MAT file (one column
+/// vector for the time, one for each channel).
+
+namespace
+{
+
+bool hasSuffix(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size()-suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool convertToCSV(const gazebo_fmi::FMURecordingReader& reader, const std::string& outputPath)
+{
+    std::FILE* file = std::fopen(outputPath.c_str(), "w");
+    if (!file)
+    {
+        std::cerr << "gazebo-fmi-recording-converter: impossible to create " << outputPath << std::endl;
+        return false;
+    }
+
+    const std::vector<std::string>& channelNames = reader.getChannelNames();
+    std::fprintf(file, "time");
+    for (const std::string& channelName : channelNames)
+    {
+        std::fprintf(file, ",%s", channelName.c_str());
+    }
+    std::fprintf(file, "\n");
+
+    for (size_t sample=0; sample < reader.getNrOfSamples(); sample++)
+    {
+        std::fprintf(file, "%.17g", reader.getTime(sample));
+        for (size_t channel=0; channel < channelNames.size(); channel++)
+        {
+            std::fprintf(file, ",%.17g", reader.getValue(sample, channel));
+        }
+        std::fprintf(file, "\n");
+    }
+
+    return std::fclose(file) == 0;
+}
+
+#ifdef GAZEBO_FMI_HAS_MATIO
+std::string toMatVariableName(const std::string& channelName)
+{
+    // MAT variable names need to start with a letter and can contain only letters, digits and underscores
+    std::string variableName;
+    for (char c : channelName)
+    {
+        variableName.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    if (variableName.empty() || !std::isalpha(static_cast<unsigned char>(variableName[0])))
+    {
+        variableName = "c_" + variableName;
+    }
+    return variableName.substr(0, 63);
+}
+
+bool writeColumnToMat(mat_t* mat, const std::string& variableName, std::vector<double>& column)
+{
+    size_t dims[2] = {column.size(), 1};
+    matvar_t* matvar = Mat_VarCreate(variableName.c_str(), MAT_C_DOUBLE, MAT_T_DOUBLE, 2, dims, column.data(), 0);
+    if (!matvar)
+    {
+        return false;
+    }
+    bool ok = Mat_VarWrite(mat, matvar, MAT_COMPRESSION_NONE) == 0;
+    Mat_VarFree(matvar);
+    return ok;
+}
+
+bool convertToMAT(const gazebo_fmi::FMURecordingReader& reader, const std::string& outputPath)
+{
+    mat_t* mat = Mat_Create(outputPath.c_str(), NULL);
+    if (!mat)
+    {
+        std::cerr << "gazebo-fmi-recording-converter: impossible to create " << outputPath << std::endl;
+        return false;
+    }
+
+    std::vector<double> column(reader.getNrOfSamples());
+    for (size_t sample=0; sample < reader.getNrOfSamples(); sample++)
+    {
+        column[sample] = reader.getTime(sample);
+    }
+    bool ok = writeColumnToMat(mat, "time", column);
+
+    const std::vector<std::string>& channelNames = reader.getChannelNames();
+    for (size_t channel=0; channel < channelNames.size() && ok; channel++)
+    {
+        for (size_t sample=0; sample < reader.getNrOfSamples(); sample++)
+        {
+            column[sample] = reader.getValue(sample, channel);
+        }
+        ok = writeColumnToMat(mat, toMatVariableName(channelNames[channel]), column);
+    }
+
+    Mat_Close(mat);
+    return ok;
+}
+#endif
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: gazebo-fmi-recording-converter <input recording> <output.csv|output.mat>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::string inputPath = argv[1];
+    const std::string outputPath = argv[2];
+
+    gazebo_fmi::FMURecordingReader reader;
+    if (!reader.open(inputPath))
+    {
+        return EXIT_FAILURE;
+    }
+
+    bool ok = false;
+    if (hasSuffix(outputPath, ".csv"))
+    {
+        ok = convertToCSV(reader, outputPath);
+    }
+    else if (hasSuffix(outputPath, ".mat"))
+    {
+#ifdef GAZEBO_FMI_HAS_MATIO
+        ok = convertToMAT(reader, outputPath);
+#else
+        std::cerr << "gazebo-fmi-recording-converter: compiled without matio, MAT output is not supported." << std::endl;
+#endif
+    }
+    else
+    {
+        std::cerr << "gazebo-fmi-recording-converter: unknown output format for " << outputPath
+                  << ", use the .csv or .mat extension." << std::endl;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}